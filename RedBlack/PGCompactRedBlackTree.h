@@ -0,0 +1,182 @@
+//
+//  PGCompactRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGCompactRedBlackTree is a red-black tree whose nodes are stored contiguously in a single growable array.
+ @discussion Nodes refer to one another using 32-bit indexes into the array rather than pointers, and each node's color
+     is packed into its parent index, so a node takes 24 bytes instead of the 48 a PGRedBlackTree node does. Nodes are
+     laid out in the order they're allocated. Trees built from sorted objects and trees whose layout has been optimized
+     with -optimizeLayout are laid out breadth-first, so the top levels of the tree, which every search visits, share a
+     handful of cache lines.
+
+     The tree stores copies of its objects and orders them using a comparator, just like PGRedBlackTree, and supports the
+     same basic membership, order statistic, and enumeration operations. It can hold at most 2^31 - 1 objects.
+ */
+@interface PGCompactRedBlackTree : NSObject <NSFastEnumeration>
+
+/*!
+ @abstract The number of objects in the tree.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract Creates and returns a tree that uses compare: to compare its objects.
+ @result A new empty tree.
+ */
++ (PGCompactRedBlackTree *)tree;
+
+/*!
+ @abstract Creates and returns a tree that uses the specified comparator to compare its objects.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A new empty tree or nil if comparator is nil.
+ */
++ (PGCompactRedBlackTree *)treeWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Creates and returns a tree containing copies of the objects in the specified sorted array.
+ @discussion See -initWithSortedArray:comparator: for more information.
+ @param array The objects to add to the tree, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A new tree containing copies of the objects in array or nil if comparator is nil.
+ */
++ (PGCompactRedBlackTree *)treeWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized tree that uses compare: to compare its objects.
+ @result A newly initialized tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified comparator to compare its objects.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified comparator and has room for the specified number of
+     objects before it needs to grow its node array.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @param capacity The number of objects the tree should have room for.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator capacity:(NSUInteger)capacity;
+
+/*!
+ @abstract Returns an initialized tree containing copies of the objects in the specified sorted array.
+ @discussion The tree is built in O(n) time and laid out breadth-first. If array is not sorted according to comparator,
+     the tree's behavior is undefined.
+ @param array The objects to add to the tree, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A newly initialized tree containing copies of the objects in array or nil if comparator is nil.
+ */
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
+/*!
+ @abstract Adds a copy of the specified object to the tree.
+ @param object The object whose copy will be added. May not be nil.
+ @throws NSInvalidArgumentException if object is nil
+ */
+- (void)addObject:(id <NSCopying>)object;
+
+/*!
+ @abstract Adds a copy of each object in the specified array to the tree.
+ @discussion If the tree is empty, the objects are sorted once and the tree is built directly from them and laid out
+     breadth-first. Otherwise, the objects are added one at a time.
+ @param array The array to add objects from.
+ */
+- (void)addObjectsFromArray:(NSArray *)array;
+
+/*!
+ @abstract Returns whether an object equivalent to the one specified is in the tree.
+ @param object The object whose membership in the tree is being tested.
+ @result Returns YES when an object equivalent to the one specified is in the tree and NO otherwise.
+ */
+- (BOOL)containsObject:(id)object;
+
+/*!
+ @abstract Returns an object in the tree that is equivalent to the one specified.
+ @discussion This behaves exactly like -[PGRedBlackTree member:].
+ @param object The object being searched for.
+ @result The object in the tree that is equivalent to the one specified, or nil if there is no such object.
+ */
+- (id)member:(id)object;
+
+/*!
+ @abstract Removes the specified object from the tree.
+ @discussion If the object is in the tree multiple times, only the one returned by -member: is removed. Does nothing if
+     the object is not in the tree.
+ @param object The object to remove.
+ */
+- (void)removeObject:(id)object;
+
+/*!
+ @abstract Removes all objects from the tree.
+ @discussion The tree keeps its node array so that it can be refilled without growing it again.
+ */
+- (void)removeAllObjects;
+
+/*!
+ @abstract Returns the object at the specified index in the tree's sorted order.
+ @param index The index of the object to return.
+ @throws NSRangeException if index is greater than or equal to the tree's count
+ @result The object at the specified index.
+ */
+- (id)objectAtIndex:(NSUInteger)index;
+
+/*!
+ @abstract Returns the smallest object in the tree or nil if the tree is empty.
+ */
+- (id)firstObject;
+
+/*!
+ @abstract Returns the largest object in the tree or nil if the tree is empty.
+ */
+- (id)lastObject;
+
+/*!
+ @abstract Executes the specified block on each object in the tree in ascending order.
+ @param block The block to execute. May not be nil.
+ @throws NSInvalidArgumentException if block is nil
+ */
+- (void)enumerateObjectsUsingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Returns an array of all the objects in the tree in ascending order.
+ */
+- (NSArray *)allObjects;
+
+/*!
+ @abstract Lays the tree's nodes out breadth-first in a node array that is just large enough to hold them.
+ @discussion Insertions and removals place nodes wherever there is room, so a tree's layout degrades as it is mutated.
+     Invoking this method periodically, e.g., after a large batch of changes, restores a cache-friendly layout and releases
+     unused node storage. It takes O(n) time.
+ */
+- (void)optimizeLayout;
+
+@end
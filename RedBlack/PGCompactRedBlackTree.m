@@ -0,0 +1,992 @@
+//
+//  PGCompactRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGCompactRedBlackTree.h"
+
+#import "PGUtilities.h"
+
+
+#pragma mark Compact nodes
+
+// Nodes refer to each other by their index in the tree's node array. Index 0 is the sentinel, which plays the role of
+// PGRedBlackTreeNodeSentinel and T.nil in CLRS: it is black, has a count of 0, and its parent may be set temporarily
+// during removal. The high bit of parentAndColor is set when the node is red.
+typedef struct _PGCompactRedBlackTreeNode {
+    id object;
+    uint32_t leftChild;
+    uint32_t rightChild;
+    uint32_t parentAndColor;
+    uint32_t count;
+} PGCompactRedBlackTreeNode;
+
+static const uint32_t PGCompactRedBlackTreeSentinel = 0;
+static const uint32_t PGCompactRedBlackTreeRedBit = 0x80000000u;
+static const uint32_t PGCompactRedBlackTreeMaximumNodeCount = 0x7FFFFFFFu;
+
+// The node array and its bookkeeping. Freed nodes are kept on a list linked through their right children. Because the
+// array can move when it grows, nodes are only ever held by index.
+typedef struct _PGCompactRedBlackTreeStorage {
+    PGCompactRedBlackTreeNode *nodes;
+    uint32_t capacity;
+    uint32_t usedCount;
+    uint32_t freeNodes;
+    uint32_t root;
+} PGCompactRedBlackTreeStorage;
+
+
+NS_INLINE uint32_t PGCompactNodeParent(PGCompactRedBlackTreeNode *nodes, uint32_t node)
+{
+    return nodes[node].parentAndColor & ~PGCompactRedBlackTreeRedBit;
+}
+
+
+NS_INLINE void PGCompactNodeSetParent(PGCompactRedBlackTreeNode *nodes, uint32_t node, uint32_t parent)
+{
+    nodes[node].parentAndColor = (nodes[node].parentAndColor & PGCompactRedBlackTreeRedBit) | parent;
+}
+
+
+NS_INLINE BOOL PGCompactNodeIsRed(PGCompactRedBlackTreeNode *nodes, uint32_t node)
+{
+    return (nodes[node].parentAndColor & PGCompactRedBlackTreeRedBit) != 0;
+}
+
+
+NS_INLINE void PGCompactNodeSetRed(PGCompactRedBlackTreeNode *nodes, uint32_t node, BOOL isRed)
+{
+    nodes[node].parentAndColor = isRed ? nodes[node].parentAndColor | PGCompactRedBlackTreeRedBit
+                                       : nodes[node].parentAndColor & ~PGCompactRedBlackTreeRedBit;
+}
+
+
+NS_INLINE uint32_t PGCompactNodeLeftmostSubnode(PGCompactRedBlackTreeNode *nodes, uint32_t node)
+{
+    while (nodes[node].leftChild != PGCompactRedBlackTreeSentinel) {
+        node = nodes[node].leftChild;
+    }
+
+    return node;
+}
+
+
+NS_INLINE uint32_t PGCompactNodeRightmostSubnode(PGCompactRedBlackTreeNode *nodes, uint32_t node)
+{
+    while (nodes[node].rightChild != PGCompactRedBlackTreeSentinel) {
+        node = nodes[node].rightChild;
+    }
+
+    return node;
+}
+
+
+static uint32_t PGCompactNodeSuccessor(PGCompactRedBlackTreeNode *nodes, uint32_t node)
+{
+    if (nodes[node].rightChild != PGCompactRedBlackTreeSentinel) {
+        return PGCompactNodeLeftmostSubnode(nodes, nodes[node].rightChild);
+    }
+
+    uint32_t parent = PGCompactNodeParent(nodes, node);
+    while (parent != PGCompactRedBlackTreeSentinel && node == nodes[parent].rightChild) {
+        node = parent;
+        parent = PGCompactNodeParent(nodes, node);
+    }
+
+    return parent;
+}
+
+
+#pragma mark - Storage
+
+// Functions that allocate can throw, so they take the receiver and selector of the method that called them for their
+// exceptions' reasons, just as if the method had thrown the exception itself.
+
+static void PGCompactRedBlackTreeStorageGrow(PGCompactRedBlackTreeStorage *storage, NSUInteger capacity, id receiver, SEL selector)
+{
+    if (capacity <= storage->capacity) return;
+    if (capacity > (NSUInteger)PGCompactRedBlackTreeMaximumNodeCount + 1) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(receiver, selector, @"Compact red-black trees cannot hold more than %lu objects.",
+                                                                (unsigned long)PGCompactRedBlackTreeMaximumNodeCount)
+                                     userInfo:nil];
+    }
+
+    PGCompactRedBlackTreeNode *nodes = realloc(storage->nodes, capacity * sizeof(PGCompactRedBlackTreeNode));
+    if (!nodes) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(receiver, selector, @"Could not allocate %lu compact red-black tree nodes.", (unsigned long)capacity)
+                                     userInfo:nil];
+    }
+
+    storage->nodes = nodes;
+    storage->capacity = (uint32_t)capacity;
+}
+
+
+static void PGCompactRedBlackTreeStorageInitialize(PGCompactRedBlackTreeStorage *storage, NSUInteger capacity, id receiver, SEL selector)
+{
+    // Make room for the sentinel in addition to the requested nodes
+    memset(storage, 0, sizeof(PGCompactRedBlackTreeStorage));
+    PGCompactRedBlackTreeStorageGrow(storage, MAX(capacity + 1, 16), receiver, selector);
+    memset(&storage->nodes[PGCompactRedBlackTreeSentinel], 0, sizeof(PGCompactRedBlackTreeNode));
+    storage->usedCount = 1;
+}
+
+
+static uint32_t PGCompactRedBlackTreeStorageCreateNode(PGCompactRedBlackTreeStorage *storage, uint32_t parent, id object, id receiver, SEL selector)
+{
+    // Recycle a freed node if we have one. Otherwise, use the next node in the array, doubling it if it's full.
+    uint32_t node = storage->freeNodes;
+    if (node != PGCompactRedBlackTreeSentinel) {
+        storage->freeNodes = storage->nodes[node].rightChild;
+    } else {
+        if (storage->usedCount == storage->capacity) {
+            PGCompactRedBlackTreeStorageGrow(storage, MIN((NSUInteger)storage->capacity * 2, (NSUInteger)PGCompactRedBlackTreeMaximumNodeCount + 1),
+                                             receiver, selector);
+            if (storage->usedCount == storage->capacity) {
+                @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                               reason:PGExceptionString(receiver, selector, @"Compact red-black trees cannot hold more than %lu objects.",
+                                                                        (unsigned long)PGCompactRedBlackTreeMaximumNodeCount)
+                                             userInfo:nil];
+            }
+        }
+
+        node = storage->usedCount++;
+    }
+
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    nodes[node].object = [object retain];
+    nodes[node].leftChild = PGCompactRedBlackTreeSentinel;
+    nodes[node].rightChild = PGCompactRedBlackTreeSentinel;
+    nodes[node].parentAndColor = parent | PGCompactRedBlackTreeRedBit;
+    nodes[node].count = 1;
+    return node;
+}
+
+
+static void PGCompactRedBlackTreeStorageFreeNode(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    [storage->nodes[node].object release];
+    storage->nodes[node].object = nil;
+    storage->nodes[node].rightChild = storage->freeNodes;
+    storage->freeNodes = node;
+}
+
+
+static void PGCompactRedBlackTreeStorageRemoveAllNodes(PGCompactRedBlackTreeStorage *storage)
+{
+    // Free nodes always have nil objects, so we can release every used node's object in one pass over the array
+    for (uint32_t node = 1; node < storage->usedCount; ++node) {
+        [storage->nodes[node].object release];
+    }
+
+    storage->usedCount = 1;
+    storage->freeNodes = PGCompactRedBlackTreeSentinel;
+    storage->root = PGCompactRedBlackTreeSentinel;
+}
+
+
+#pragma mark - Rebalancing
+
+static void PGCompactRedBlackTreeStorageRotateLeft(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    uint32_t other = nodes[node].rightChild;
+    uint32_t parent = PGCompactNodeParent(nodes, node);
+
+    nodes[node].rightChild = nodes[other].leftChild;
+    if (nodes[other].leftChild != PGCompactRedBlackTreeSentinel) {
+        PGCompactNodeSetParent(nodes, nodes[other].leftChild, node);
+    }
+
+    PGCompactNodeSetParent(nodes, other, parent);
+    if (parent == PGCompactRedBlackTreeSentinel) {
+        storage->root = other;
+    } else if (node == nodes[parent].leftChild) {
+        nodes[parent].leftChild = other;
+    } else {
+        nodes[parent].rightChild = other;
+    }
+
+    nodes[other].leftChild = node;
+    PGCompactNodeSetParent(nodes, node, other);
+
+    nodes[other].count = nodes[node].count;
+    nodes[node].count = nodes[nodes[node].leftChild].count + nodes[nodes[node].rightChild].count + 1;
+}
+
+
+static void PGCompactRedBlackTreeStorageRotateRight(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    uint32_t other = nodes[node].leftChild;
+    uint32_t parent = PGCompactNodeParent(nodes, node);
+
+    nodes[node].leftChild = nodes[other].rightChild;
+    if (nodes[other].rightChild != PGCompactRedBlackTreeSentinel) {
+        PGCompactNodeSetParent(nodes, nodes[other].rightChild, node);
+    }
+
+    PGCompactNodeSetParent(nodes, other, parent);
+    if (parent == PGCompactRedBlackTreeSentinel) {
+        storage->root = other;
+    } else if (node == nodes[parent].rightChild) {
+        nodes[parent].rightChild = other;
+    } else {
+        nodes[parent].leftChild = other;
+    }
+
+    nodes[other].rightChild = node;
+    PGCompactNodeSetParent(nodes, node, other);
+
+    nodes[other].count = nodes[node].count;
+    nodes[node].count = nodes[nodes[node].leftChild].count + nodes[nodes[node].rightChild].count + 1;
+}
+
+
+static void PGCompactRedBlackTreeStorageFixPropertiesAfterInsertion(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    // Note: this code is adapted from the pseudocode in CLRS. The sentinel is black, so the root's parent never
+    // looks red.
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    while (PGCompactNodeIsRed(nodes, PGCompactNodeParent(nodes, node))) {
+        uint32_t parent = PGCompactNodeParent(nodes, node);
+        uint32_t grandparent = PGCompactNodeParent(nodes, parent);
+        if (parent == nodes[grandparent].leftChild) {
+            uint32_t uncle = nodes[grandparent].rightChild;
+            if (PGCompactNodeIsRed(nodes, uncle)) {
+                PGCompactNodeSetRed(nodes, parent, NO);
+                PGCompactNodeSetRed(nodes, uncle, NO);
+                PGCompactNodeSetRed(nodes, grandparent, YES);
+                node = grandparent;
+                continue;
+            }
+
+            if (node == nodes[parent].rightChild) {
+                node = parent;
+                PGCompactRedBlackTreeStorageRotateLeft(storage, node);
+                parent = PGCompactNodeParent(nodes, node);
+            }
+
+            PGCompactNodeSetRed(nodes, parent, NO);
+            PGCompactNodeSetRed(nodes, grandparent, YES);
+            PGCompactRedBlackTreeStorageRotateRight(storage, grandparent);
+        } else {
+            uint32_t uncle = nodes[grandparent].leftChild;
+            if (PGCompactNodeIsRed(nodes, uncle)) {
+                PGCompactNodeSetRed(nodes, parent, NO);
+                PGCompactNodeSetRed(nodes, uncle, NO);
+                PGCompactNodeSetRed(nodes, grandparent, YES);
+                node = grandparent;
+                continue;
+            }
+
+            if (node == nodes[parent].leftChild) {
+                node = parent;
+                PGCompactRedBlackTreeStorageRotateRight(storage, node);
+                parent = PGCompactNodeParent(nodes, node);
+            }
+
+            PGCompactNodeSetRed(nodes, parent, NO);
+            PGCompactNodeSetRed(nodes, grandparent, YES);
+            PGCompactRedBlackTreeStorageRotateLeft(storage, grandparent);
+        }
+    }
+
+    PGCompactNodeSetRed(nodes, storage->root, NO);
+}
+
+
+static void PGCompactRedBlackTreeStorageFixPropertiesAfterRemoval(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    // Note: this code is adapted from the pseudocode in CLRS. node may be the sentinel, in which case its parent was set
+    // by the removal.
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    while (node != storage->root && !PGCompactNodeIsRed(nodes, node)) {
+        uint32_t parent = PGCompactNodeParent(nodes, node);
+        if (node == nodes[parent].leftChild) {
+            uint32_t sibling = nodes[parent].rightChild;
+            if (PGCompactNodeIsRed(nodes, sibling)) {
+                PGCompactNodeSetRed(nodes, sibling, NO);
+                PGCompactNodeSetRed(nodes, parent, YES);
+                PGCompactRedBlackTreeStorageRotateLeft(storage, parent);
+                sibling = nodes[parent].rightChild;
+            }
+
+            if (!PGCompactNodeIsRed(nodes, nodes[sibling].leftChild) && !PGCompactNodeIsRed(nodes, nodes[sibling].rightChild)) {
+                PGCompactNodeSetRed(nodes, sibling, YES);
+                node = parent;
+                continue;
+            }
+
+            if (!PGCompactNodeIsRed(nodes, nodes[sibling].rightChild)) {
+                PGCompactNodeSetRed(nodes, nodes[sibling].leftChild, NO);
+                PGCompactNodeSetRed(nodes, sibling, YES);
+                PGCompactRedBlackTreeStorageRotateRight(storage, sibling);
+                sibling = nodes[parent].rightChild;
+            }
+
+            PGCompactNodeSetRed(nodes, sibling, PGCompactNodeIsRed(nodes, parent));
+            PGCompactNodeSetRed(nodes, parent, NO);
+            PGCompactNodeSetRed(nodes, nodes[sibling].rightChild, NO);
+            PGCompactRedBlackTreeStorageRotateLeft(storage, parent);
+            node = storage->root;
+        } else {
+            uint32_t sibling = nodes[parent].leftChild;
+            if (PGCompactNodeIsRed(nodes, sibling)) {
+                PGCompactNodeSetRed(nodes, sibling, NO);
+                PGCompactNodeSetRed(nodes, parent, YES);
+                PGCompactRedBlackTreeStorageRotateRight(storage, parent);
+                sibling = nodes[parent].leftChild;
+            }
+
+            if (!PGCompactNodeIsRed(nodes, nodes[sibling].leftChild) && !PGCompactNodeIsRed(nodes, nodes[sibling].rightChild)) {
+                PGCompactNodeSetRed(nodes, sibling, YES);
+                node = parent;
+                continue;
+            }
+
+            if (!PGCompactNodeIsRed(nodes, nodes[sibling].leftChild)) {
+                PGCompactNodeSetRed(nodes, nodes[sibling].rightChild, NO);
+                PGCompactNodeSetRed(nodes, sibling, YES);
+                PGCompactRedBlackTreeStorageRotateLeft(storage, sibling);
+                sibling = nodes[parent].leftChild;
+            }
+
+            PGCompactNodeSetRed(nodes, sibling, PGCompactNodeIsRed(nodes, parent));
+            PGCompactNodeSetRed(nodes, parent, NO);
+            PGCompactNodeSetRed(nodes, nodes[sibling].leftChild, NO);
+            PGCompactRedBlackTreeStorageRotateRight(storage, parent);
+            node = storage->root;
+        }
+    }
+
+    PGCompactNodeSetRed(nodes, node, NO);
+}
+
+
+// Replaces the subtree rooted at node with the one rooted at replacement. replacement may be the sentinel.
+static void PGCompactRedBlackTreeStorageTransplant(PGCompactRedBlackTreeStorage *storage, uint32_t node, uint32_t replacement)
+{
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+    uint32_t parent = PGCompactNodeParent(nodes, node);
+    if (parent == PGCompactRedBlackTreeSentinel) {
+        storage->root = replacement;
+    } else if (node == nodes[parent].leftChild) {
+        nodes[parent].leftChild = replacement;
+    } else {
+        nodes[parent].rightChild = replacement;
+    }
+
+    PGCompactNodeSetParent(nodes, replacement, parent);
+}
+
+
+static void PGCompactRedBlackTreeStorageRemoveNode(PGCompactRedBlackTreeStorage *storage, uint32_t node)
+{
+    PGCompactRedBlackTreeNode *nodes = storage->nodes;
+
+    // The node that is physically unlinked is node itself if it has at most one child and its successor otherwise.
+    // Either way, every ancestor of that node loses a descendant.
+    uint32_t unlinked = node;
+    if (nodes[node].leftChild != PGCompactRedBlackTreeSentinel && nodes[node].rightChild != PGCompactRedBlackTreeSentinel) {
+        unlinked = PGCompactNodeLeftmostSubnode(nodes, nodes[node].rightChild);
+    }
+
+    for (uint32_t ancestor = PGCompactNodeParent(nodes, unlinked); ancestor != PGCompactRedBlackTreeSentinel; ancestor = PGCompactNodeParent(nodes, ancestor)) {
+        --nodes[ancestor].count;
+    }
+
+    // Note: this code is adapted from the pseudocode in CLRS. Unlike PGRedBlackTreeNodeRemoveFromTree, it moves the
+    // successor into node's place instead of moving objects between nodes.
+    BOOL unlinkedWasRed = PGCompactNodeIsRed(nodes, unlinked);
+    uint32_t child;
+    if (nodes[node].leftChild == PGCompactRedBlackTreeSentinel) {
+        child = nodes[node].rightChild;
+        PGCompactRedBlackTreeStorageTransplant(storage, node, child);
+    } else if (nodes[node].rightChild == PGCompactRedBlackTreeSentinel) {
+        child = nodes[node].leftChild;
+        PGCompactRedBlackTreeStorageTransplant(storage, node, child);
+    } else {
+        child = nodes[unlinked].rightChild;
+        if (PGCompactNodeParent(nodes, unlinked) == node) {
+            PGCompactNodeSetParent(nodes, child, unlinked);
+        } else {
+            PGCompactRedBlackTreeStorageTransplant(storage, unlinked, child);
+            nodes[unlinked].rightChild = nodes[node].rightChild;
+            PGCompactNodeSetParent(nodes, nodes[unlinked].rightChild, unlinked);
+        }
+
+        PGCompactRedBlackTreeStorageTransplant(storage, node, unlinked);
+        nodes[unlinked].leftChild = nodes[node].leftChild;
+        PGCompactNodeSetParent(nodes, nodes[unlinked].leftChild, unlinked);
+        PGCompactNodeSetRed(nodes, unlinked, PGCompactNodeIsRed(nodes, node));
+        nodes[unlinked].count = nodes[node].count;
+    }
+
+    if (!unlinkedWasRed) {
+        PGCompactRedBlackTreeStorageFixPropertiesAfterRemoval(storage, child);
+    }
+
+    // The fixup may have changed the sentinel's parent, but nothing reads it outside of removal
+    PGCompactNodeSetParent(nodes, PGCompactRedBlackTreeSentinel, PGCompactRedBlackTreeSentinel);
+    PGCompactRedBlackTreeStorageFreeNode(storage, node);
+}
+
+
+#pragma mark - Layout
+
+typedef struct _PGCompactRedBlackTreeLayoutEntry {
+    NSUInteger location;
+    NSUInteger length;
+    uint32_t parent;
+    BOOL isLeftChild;
+    NSUInteger depth;
+} PGCompactRedBlackTreeLayoutEntry;
+
+
+// Builds a tree containing the sorted objects in storage, which must be empty, numbering nodes breadth-first. The shape
+// and coloring are the same as PGRedBlackTreeNodeCreateWithSortedObjects: every level is full except possibly the
+// deepest, whose nodes are red.
+static void PGCompactRedBlackTreeStorageBuildWithSortedObjects(PGCompactRedBlackTreeStorage *storage, id const *objects, NSUInteger count,
+                                                               id receiver, SEL selector)
+{
+    if (count == 0) return;
+    PGCompactRedBlackTreeStorageGrow(storage, count + 1, receiver, selector);
+
+    NSUInteger redDepth = 0;
+    while ((count >> (redDepth + 1)) > 0) {
+        ++redDepth;
+    }
+
+    if (redDepth == 0) redDepth = NSUIntegerMax;
+
+    // The queue holds each subtree's range of objects until we get to it. Subtrees are numbered in the order they come
+    // off the queue, which is breadth-first.
+    PGCompactRedBlackTreeLayoutEntry *queue = malloc(count * sizeof(PGCompactRedBlackTreeLayoutEntry));
+    if (!queue) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(receiver, selector, @"Could not allocate layout queue.")
+                                     userInfo:nil];
+    }
+
+    NSUInteger head = 0, tail = 0;
+    queue[tail++] = (PGCompactRedBlackTreeLayoutEntry){ 0, count, PGCompactRedBlackTreeSentinel, NO, 0 };
+    while (head < tail) {
+        PGCompactRedBlackTreeLayoutEntry entry = queue[head++];
+        NSUInteger middle = entry.location + entry.length / 2;
+
+        uint32_t node = PGCompactRedBlackTreeStorageCreateNode(storage, entry.parent, objects[middle], receiver, selector);
+        PGCompactRedBlackTreeNode *nodes = storage->nodes;
+        PGCompactNodeSetRed(nodes, node, entry.depth == redDepth);
+        nodes[node].count = (uint32_t)entry.length;
+
+        if (entry.parent == PGCompactRedBlackTreeSentinel) {
+            storage->root = node;
+        } else if (entry.isLeftChild) {
+            nodes[entry.parent].leftChild = node;
+        } else {
+            nodes[entry.parent].rightChild = node;
+        }
+
+        if (middle > entry.location) {
+            queue[tail++] = (PGCompactRedBlackTreeLayoutEntry){ entry.location, middle - entry.location, node, YES, entry.depth + 1 };
+        }
+
+        if (entry.location + entry.length > middle + 1) {
+            queue[tail++] = (PGCompactRedBlackTreeLayoutEntry){ middle + 1, entry.location + entry.length - middle - 1, node, NO, entry.depth + 1 };
+        }
+    }
+
+    free(queue);
+}
+
+
+// Copies the tree in storage into a new node array that is numbered breadth-first and has no free nodes
+static void PGCompactRedBlackTreeStorageOptimizeLayout(PGCompactRedBlackTreeStorage *storage, NSUInteger count, id receiver, SEL selector)
+{
+    PGCompactRedBlackTreeStorage newStorage;
+    PGCompactRedBlackTreeStorageInitialize(&newStorage, count, receiver, selector);
+    if (count == 0) {
+        free(storage->nodes);
+        *storage = newStorage;
+        return;
+    }
+
+    // The ith node in breadth-first order becomes node i + 1, so a child's new index is known as soon as it's queued.
+    // The queue holds old indexes.
+    uint32_t *queue = malloc(count * sizeof(uint32_t));
+    if (!queue) {
+        free(newStorage.nodes);
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(receiver, selector, @"Could not allocate layout queue.")
+                                     userInfo:nil];
+    }
+
+    PGCompactRedBlackTreeNode *oldNodes = storage->nodes;
+    PGCompactRedBlackTreeNode *newNodes = newStorage.nodes;
+    NSUInteger head = 0, tail = 0;
+    queue[tail++] = storage->root;
+    newNodes[1].parentAndColor = PGCompactRedBlackTreeSentinel;
+
+    while (head < tail) {
+        uint32_t oldNode = queue[head];
+        uint32_t newNode = (uint32_t)++head;
+
+        // The node's parent was filled in when it was queued
+        newNodes[newNode].object = oldNodes[oldNode].object;
+        newNodes[newNode].count = oldNodes[oldNode].count;
+        PGCompactNodeSetRed(newNodes, newNode, PGCompactNodeIsRed(oldNodes, oldNode));
+
+        newNodes[newNode].leftChild = PGCompactRedBlackTreeSentinel;
+        if (oldNodes[oldNode].leftChild != PGCompactRedBlackTreeSentinel) {
+            queue[tail++] = oldNodes[oldNode].leftChild;
+            newNodes[newNode].leftChild = (uint32_t)tail;
+            newNodes[tail].parentAndColor = newNode;
+        }
+
+        newNodes[newNode].rightChild = PGCompactRedBlackTreeSentinel;
+        if (oldNodes[oldNode].rightChild != PGCompactRedBlackTreeSentinel) {
+            queue[tail++] = oldNodes[oldNode].rightChild;
+            newNodes[newNode].rightChild = (uint32_t)tail;
+            newNodes[tail].parentAndColor = newNode;
+        }
+    }
+
+    free(queue);
+    free(oldNodes);
+
+    // Objects were moved, not copied, so there's nothing to release
+    newStorage.usedCount = (uint32_t)count + 1;
+    newStorage.root = 1;
+    *storage = newStorage;
+}
+
+
+#pragma mark - Private interfaces
+
+@interface PGCompactRedBlackTree () {
+    PGCompactRedBlackTreeStorage _storage;
+    unsigned long _mutationCount;
+}
+
+@property(readwrite, assign) NSUInteger count;
+@property(readwrite, copy) NSComparator comparator;
+
+- (void)addObjectsFromSortedArray:(NSArray *)array;
+- (uint32_t)nodeForObject:(id)object;
+
+@end
+
+
+@interface PGCompactRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGCompactRedBlackTree
+
++ (PGCompactRedBlackTree *)tree
+{
+    return [[[self alloc] init] autorelease];
+}
+
+
++ (PGCompactRedBlackTree *)treeWithComparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithComparator:comparator] autorelease];
+}
+
+
++ (PGCompactRedBlackTree *)treeWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithSortedArray:array comparator:comparator] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    }];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator
+{
+    return [self initWithComparator:comparator capacity:0];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator capacity:(NSUInteger)capacity
+{
+    if (!comparator) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        [self setComparator:comparator];
+        PGCompactRedBlackTreeStorageInitialize(&_storage, capacity, self, _cmd);
+    }
+
+    return self;
+}
+
+
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    self = [self initWithComparator:comparator capacity:[array count]];
+    if (self) {
+        [self addObjectsFromSortedArray:array];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    PGCompactRedBlackTreeStorageRemoveAllNodes(&_storage);
+    free(_storage.nodes);
+    [_comparator release];
+    [super dealloc];
+}
+
+
+#pragma mark - Insertion
+
+- (void)addObject:(id)object
+{
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    }
+
+    // Create the node first, since doing so may move the node array
+    object = [object copy];
+    uint32_t newNode = PGCompactRedBlackTreeStorageCreateNode(&_storage, PGCompactRedBlackTreeSentinel, object, self, _cmd);
+    [object release];
+
+    PGCompactRedBlackTreeNode *nodes = _storage.nodes;
+    uint32_t parent = PGCompactRedBlackTreeSentinel;
+    uint32_t node = _storage.root;
+    BOOL isLeftChild = NO;
+    while (node != PGCompactRedBlackTreeSentinel) {
+        ++nodes[node].count;
+        parent = node;
+        isLeftChild = _comparator(object, nodes[node].object) < NSOrderedSame;
+        node = isLeftChild ? nodes[node].leftChild : nodes[node].rightChild;
+    }
+
+    PGCompactNodeSetParent(nodes, newNode, parent);
+    if (parent == PGCompactRedBlackTreeSentinel) {
+        _storage.root = newNode;
+    } else if (isLeftChild) {
+        nodes[parent].leftChild = newNode;
+    } else {
+        nodes[parent].rightChild = newNode;
+    }
+
+    PGCompactRedBlackTreeStorageFixPropertiesAfterInsertion(&_storage, newNode);
+    [self setCount:_count + 1];
+    ++_mutationCount;
+}
+
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+    if (!array) return;
+
+    // If we're empty, it's cheaper to sort the objects once and build the tree directly. The sort must be stable so that
+    // equal objects end up in the same order they would have if they had been inserted one at a time.
+    if (_count == 0) {
+        [self addObjectsFromSortedArray:[array sortedArrayWithOptions:NSSortStable usingComparator:_comparator]];
+        return;
+    }
+
+    PGCompactRedBlackTreeStorageGrow(&_storage, (NSUInteger)_storage.usedCount + [array count], self, _cmd);
+    for (id object in array) {
+        [self addObject:object];
+    }
+}
+
+
+- (void)addObjectsFromSortedArray:(NSArray *)array
+{
+    NSAssert(_count == 0, PGAssertionString(self, _cmd, @"Cannot build a tree that already has objects."));
+
+    NSUInteger count = [array count];
+    if (count == 0) return;
+
+    id *objects = malloc(count * sizeof(id));
+    if (!objects) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                     userInfo:nil];
+    }
+
+    // Like -addObject:, we store copies of the objects
+    [array getObjects:objects range:NSMakeRange(0, count)];
+    for (NSUInteger i = 0; i < count; ++i) {
+        objects[i] = [objects[i] copy];
+    }
+
+    // Start from an empty array so that the nodes are numbered breadth-first from the beginning of it
+    PGCompactRedBlackTreeStorageRemoveAllNodes(&_storage);
+    PGCompactRedBlackTreeStorageBuildWithSortedObjects(&_storage, objects, count, self, _cmd);
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        [objects[i] release];
+    }
+
+    free(objects);
+    [self setCount:count];
+    ++_mutationCount;
+}
+
+
+#pragma mark - Membership
+
+- (BOOL)containsObject:(id)object
+{
+    return [self member:object] != nil;
+}
+
+
+- (id)member:(id)object
+{
+    uint32_t node = [self nodeForObject:object];
+    return node != PGCompactRedBlackTreeSentinel ? _storage.nodes[node].object : nil;
+}
+
+
+- (uint32_t)nodeForObject:(id)object
+{
+    if (!object) return PGCompactRedBlackTreeSentinel;
+
+    // Find the first node that is equal to object according to the comparator and then check it and its successors for
+    // one that is equal according to -isEqual:
+    PGCompactRedBlackTreeNode *nodes = _storage.nodes;
+    uint32_t candidate = PGCompactRedBlackTreeSentinel;
+    uint32_t node = _storage.root;
+    while (node != PGCompactRedBlackTreeSentinel) {
+        if (_comparator(nodes[node].object, object) >= NSOrderedSame) {
+            candidate = node;
+            node = nodes[node].leftChild;
+        } else {
+            node = nodes[node].rightChild;
+        }
+    }
+
+    for (node = candidate; node != PGCompactRedBlackTreeSentinel && _comparator(nodes[node].object, object) == NSOrderedSame;
+         node = PGCompactNodeSuccessor(nodes, node)) {
+        id candidateObject = nodes[node].object;
+        if (object == candidateObject || ([object hash] == [candidateObject hash] && [object isEqual:candidateObject])) {
+            return node;
+        }
+    }
+
+    return PGCompactRedBlackTreeSentinel;
+}
+
+
+#pragma mark - Removal
+
+- (void)removeObject:(id)object
+{
+    uint32_t node = [self nodeForObject:object];
+    if (node == PGCompactRedBlackTreeSentinel) return;
+
+    PGCompactRedBlackTreeStorageRemoveNode(&_storage, node);
+    [self setCount:_count - 1];
+    ++_mutationCount;
+}
+
+
+- (void)removeAllObjects
+{
+    if (_count == 0) return;
+    PGCompactRedBlackTreeStorageRemoveAllNodes(&_storage);
+    [self setCount:0];
+    ++_mutationCount;
+}
+
+
+#pragma mark - Order statistics
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    if (index >= _count) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Index %lu beyond bounds of tree with count %lu.",
+                                                                (unsigned long)index, (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    PGCompactRedBlackTreeNode *nodes = _storage.nodes;
+    uint32_t node = _storage.root;
+    while (true) {
+        NSUInteger leftCount = nodes[nodes[node].leftChild].count;
+        if (index == leftCount) return nodes[node].object;
+
+        if (index < leftCount) {
+            node = nodes[node].leftChild;
+        } else {
+            index -= leftCount + 1;
+            node = nodes[node].rightChild;
+        }
+    }
+}
+
+
+- (id)firstObject
+{
+    if (_count == 0) return nil;
+    return _storage.nodes[PGCompactNodeLeftmostSubnode(_storage.nodes, _storage.root)].object;
+}
+
+
+- (id)lastObject
+{
+    if (_count == 0) return nil;
+    return _storage.nodes[PGCompactNodeRightmostSubnode(_storage.nodes, _storage.root)].object;
+}
+
+
+#pragma mark - Enumeration
+
+- (void)enumerateObjectsUsingBlock:(void (^)(id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    if (_count == 0) return;
+
+    PGCompactRedBlackTreeNode *nodes = _storage.nodes;
+    BOOL stop = NO;
+    for (uint32_t node = PGCompactNodeLeftmostSubnode(nodes, _storage.root); node != PGCompactRedBlackTreeSentinel && !stop;
+         node = PGCompactNodeSuccessor(nodes, node)) {
+        block(nodes[node].object, &stop);
+    }
+}
+
+
+- (NSArray *)allObjects
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:_count];
+    [self enumerateObjectsUsingBlock:^(id object, BOOL *stop) {
+        [objects addObject:object];
+    }];
+
+    return objects;
+}
+
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // We keep the index of the next node to visit in extra[0]. Because mutationsPtr points to our mutation count, the
+    // enumeration will throw before we're called again if the tree is mutated, so the index remains valid.
+    PGCompactRedBlackTreeNode *nodes = _storage.nodes;
+    uint32_t node = PGCompactRedBlackTreeSentinel;
+    if (state->state == 0) {
+        state->state = 1;
+        state->mutationsPtr = &_mutationCount;
+        if (_count > 0) node = PGCompactNodeLeftmostSubnode(nodes, _storage.root);
+    } else {
+        node = (uint32_t)state->extra[0];
+    }
+
+    NSUInteger count = 0;
+    while (node != PGCompactRedBlackTreeSentinel && count < length) {
+        buffer[count++] = nodes[node].object;
+        node = PGCompactNodeSuccessor(nodes, node);
+    }
+
+    state->extra[0] = node;
+    state->itemsPtr = buffer;
+    return count;
+}
+
+
+#pragma mark - Layout
+
+- (void)optimizeLayout
+{
+    PGCompactRedBlackTreeStorageOptimizeLayout(&_storage, _count, self, _cmd);
+    ++_mutationCount;
+}
+
+@end
+
+
+#pragma mark - Test helpers
+
+@implementation PGCompactRedBlackTree (PropertyVerification)
+
+// Returns the black height of node's subtree, or -1 if the subtree violates any red-black or order statistic property
+static NSInteger PGCompactNodeVerifySubtree(PGCompactRedBlackTreeNode *nodes, uint32_t node, NSComparator comparator)
+{
+    if (node == PGCompactRedBlackTreeSentinel) return PGCompactNodeIsRed(nodes, node) || nodes[node].count != 0 ? -1 : 1;
+
+    uint32_t leftChild = nodes[node].leftChild;
+    uint32_t rightChild = nodes[node].rightChild;
+    if (leftChild != PGCompactRedBlackTreeSentinel &&
+        (PGCompactNodeParent(nodes, leftChild) != node || comparator(nodes[leftChild].object, nodes[node].object) > NSOrderedSame)) {
+        return -1;
+    }
+
+    if (rightChild != PGCompactRedBlackTreeSentinel &&
+        (PGCompactNodeParent(nodes, rightChild) != node || comparator(nodes[rightChild].object, nodes[node].object) < NSOrderedSame)) {
+        return -1;
+    }
+
+    if (PGCompactNodeIsRed(nodes, node) && (PGCompactNodeIsRed(nodes, leftChild) || PGCompactNodeIsRed(nodes, rightChild))) return -1;
+    if (nodes[node].count != nodes[leftChild].count + nodes[rightChild].count + 1) return -1;
+
+    NSInteger leftBlackHeight = PGCompactNodeVerifySubtree(nodes, leftChild, comparator);
+    NSInteger rightBlackHeight = PGCompactNodeVerifySubtree(nodes, rightChild, comparator);
+    if (leftBlackHeight < 0 || leftBlackHeight != rightBlackHeight) return -1;
+    return leftBlackHeight + (PGCompactNodeIsRed(nodes, node) ? 0 : 1);
+}
+
+
+- (BOOL)fulfillsProperties
+{
+    if (_storage.root == PGCompactRedBlackTreeSentinel) return _count == 0;
+    if (PGCompactNodeIsRed(_storage.nodes, _storage.root) || PGCompactNodeParent(_storage.nodes, _storage.root) != PGCompactRedBlackTreeSentinel) {
+        return NO;
+    }
+
+    return _storage.nodes[_storage.root].count == _count && PGCompactNodeVerifySubtree(_storage.nodes, _storage.root, _comparator) > 0;
+}
+
+@end
@@ -0,0 +1,68 @@
+//
+//  PGComparators.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+/*!
+ @header PGComparators
+ @abstract Defines functions that create specialized comparators for sorted collections.
+ @discussion Comparators are invoked on every step of every search, so the cost of a single comparison is often what
+     bounds a tree's performance. These comparators avoid the generic message-sending paths where they can. They are
+     all safe to invoke from multiple threads at once.
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract Returns a comparator that compares objects by sending them the specified selector.
+ @discussion The implementation for the class of the first object the comparator compares is looked up once and
+     cached, so comparisons between objects of that class cost a single function call instead of a message send.
+     Objects of other classes are sent the selector with objc_msgSend. Method implementations are assumed not to change
+     once objects have been compared.
+ @param selector The selector to send. It must take a single object argument and return an NSComparisonResult.
+ @result A comparator that compares objects using selector or nil if selector is NULL.
+ */
+extern NSComparator PGComparatorWithSelector(SEL selector);
+
+/*!
+ @abstract Returns a comparator that orders NSNumbers by their values.
+ @discussion Integers are compared as 64-bit integers and floating-point numbers as doubles without going through
+     -compare:. Mixed integer and floating-point values, NaNs, and NSDecimalNumbers are compared using -compare:, so the
+     order is always the same as -compare:'s. Every object compared must be an NSNumber. Every call returns the same
+     comparator, so callers can recognize numeric order by comparing a comparator with this one.
+ @result A comparator for NSNumbers.
+ */
+extern NSComparator PGNumericComparator(void);
+
+/*!
+ @abstract Returns a comparator that orders NSStrings using the specified options.
+ @discussion If options is exactly NSLiteralSearch, strings are ordered by their Unicode code points, which is also the
+     order of their UTF-8 bytes. Strings whose ASCII bytes are available directly are compared with memcmp; others are
+     compared a buffer of UTF-16 code units at a time. This differs from -compare:options: with NSLiteralSearch, which
+     orders strings by UTF-16 code unit, so characters outside the Basic Multilingual Plane sort after U+E000 through
+     U+FFFF here but before them there. Any other options are passed to -compare:options:. Every object compared must be
+     an NSString.
+ @param options The options to use when comparing strings.
+ @result A comparator for NSStrings.
+ */
+extern NSComparator PGStringComparatorWithOptions(NSStringCompareOptions options);
@@ -0,0 +1,257 @@
+//
+//  PGComparators.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGComparators.h"
+
+#import <objc/message.h>
+#import <objc/runtime.h>
+
+#ifdef __APPLE__
+#import <CoreFoundation/CoreFoundation.h>
+#endif
+
+
+#pragma mark Selector comparators
+
+typedef NSComparisonResult (*PGComparisonImplementation)(id object1, SEL selector, id object2);
+
+typedef struct _PGImplementationCacheEntry {
+    Class objectClass;
+    PGComparisonImplementation implementation;
+} PGImplementationCacheEntry;
+
+
+// Holds a comparator's cached implementation so that it's freed along with the comparator. The entry is written once
+// and never changed, so readers on other threads see either no entry or a complete one.
+@interface PGImplementationCache : NSObject {
+@public
+    PGImplementationCacheEntry *volatile _entry;
+}
+
+@end
+
+
+@implementation PGImplementationCache
+
+- (void)dealloc
+{
+    free(_entry);
+    [super dealloc];
+}
+
+@end
+
+
+NSComparator PGComparatorWithSelector(SEL selector)
+{
+    if (!selector) return nil;
+
+    PGImplementationCache *cache = [[PGImplementationCache alloc] init];
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) {
+        // Sending a message to nil returns 0
+        if (!object1) return NSOrderedSame;
+
+        Class objectClass = object_getClass(object1);
+        PGImplementationCacheEntry *entry = cache->_entry;
+        if (entry && entry->objectClass == objectClass) {
+            return entry->implementation(object1, selector, object2);
+        }
+
+        // Only the first class compared is cached. Objects of other classes are sent the message normally, which uses
+        // the runtime's own method cache.
+        if (entry) return ((PGComparisonImplementation)objc_msgSend)(object1, selector, object2);
+
+        PGComparisonImplementation implementation = (PGComparisonImplementation)class_getMethodImplementation(objectClass, selector);
+        PGImplementationCacheEntry *newEntry = malloc(sizeof(PGImplementationCacheEntry));
+        if (newEntry) {
+            newEntry->objectClass = objectClass;
+            newEntry->implementation = implementation;
+
+            // If another thread beat us to it, keep its entry
+            if (!__sync_bool_compare_and_swap(&cache->_entry, NULL, newEntry)) free(newEntry);
+        }
+
+        return implementation(object1, selector, object2);
+    };
+
+    // Copying the block retains the cache
+    comparator = [[comparator copy] autorelease];
+    [cache release];
+    return comparator;
+}
+
+
+#pragma mark - Numeric comparators
+
+typedef NS_ENUM(NSUInteger, PGNumberKind) {
+    PGNumberKindSigned,
+    PGNumberKindUnsigned,
+    PGNumberKindFloatingPoint,
+    PGNumberKindOther
+};
+
+
+static PGNumberKind PGNumberKindForType(const char *type)
+{
+    if (!type || type[0] == '\0' || type[1] != '\0') return PGNumberKindOther;
+
+    switch (type[0]) {
+        case 'c': case 's': case 'i': case 'l': case 'q':
+            return PGNumberKindSigned;
+        case 'B': case 'C': case 'S': case 'I': case 'L': case 'Q':
+            return PGNumberKindUnsigned;
+        case 'f': case 'd':
+            return PGNumberKindFloatingPoint;
+        default:
+            return PGNumberKindOther;
+    }
+}
+
+
+NS_INLINE NSComparisonResult PGCompareValues(long long value1, long long value2)
+{
+    return value1 < value2 ? NSOrderedAscending : (value1 > value2 ? NSOrderedDescending : NSOrderedSame);
+}
+
+
+NS_INLINE NSComparisonResult PGCompareUnsignedValues(unsigned long long value1, unsigned long long value2)
+{
+    return value1 < value2 ? NSOrderedAscending : (value1 > value2 ? NSOrderedDescending : NSOrderedSame);
+}
+
+
+static NSComparisonResult PGCompareNumbers(NSNumber *number1, NSNumber *number2)
+{
+    PGNumberKind kind1 = PGNumberKindForType([number1 objCType]);
+    PGNumberKind kind2 = PGNumberKindForType([number2 objCType]);
+
+    if (kind1 == PGNumberKindSigned && kind2 == PGNumberKindSigned) {
+        return PGCompareValues([number1 longLongValue], [number2 longLongValue]);
+    } else if (kind1 == PGNumberKindUnsigned && kind2 == PGNumberKindUnsigned) {
+        return PGCompareUnsignedValues([number1 unsignedLongLongValue], [number2 unsignedLongLongValue]);
+    } else if (kind1 == PGNumberKindSigned && kind2 == PGNumberKindUnsigned) {
+        long long value1 = [number1 longLongValue];
+        return value1 < 0 ? NSOrderedAscending : PGCompareUnsignedValues(value1, [number2 unsignedLongLongValue]);
+    } else if (kind1 == PGNumberKindUnsigned && kind2 == PGNumberKindSigned) {
+        long long value2 = [number2 longLongValue];
+        return value2 < 0 ? NSOrderedDescending : PGCompareUnsignedValues([number1 unsignedLongLongValue], value2);
+    } else if (kind1 == PGNumberKindFloatingPoint && kind2 == PGNumberKindFloatingPoint) {
+        // NSDecimalNumbers claim to be doubles, but converting them to doubles can lose precision
+        static Class decimalNumberClass = Nil;
+        if (!decimalNumberClass) decimalNumberClass = [NSDecimalNumber class];
+
+        if (![number1 isKindOfClass:decimalNumberClass] && ![number2 isKindOfClass:decimalNumberClass]) {
+            double value1 = [number1 doubleValue];
+            double value2 = [number2 doubleValue];
+            if (value1 < value2) return NSOrderedAscending;
+            if (value1 > value2) return NSOrderedDescending;
+            if (value1 == value2) return NSOrderedSame;
+        }
+    }
+
+    // Mixed kinds, NaNs, and NSDecimalNumbers are left to NSNumber
+    return [number1 compare:number2];
+}
+
+
+// The block captures nothing, so it's a global block that is never copied or freed, and every caller gets the same one
+static NSComparisonResult (^const PGNumericComparatorBlock)(id, id) = ^NSComparisonResult(id object1, id object2) {
+    return PGCompareNumbers(object1, object2);
+};
+
+
+NSComparator PGNumericComparator(void)
+{
+    return PGNumericComparatorBlock;
+}
+
+
+#pragma mark - String comparators
+
+// The number of UTF-16 code units compared at a time when a string's bytes aren't directly available
+#define PGStringComparisonBufferLength 64
+
+
+// Code point order differs from UTF-16 code unit order only in that surrogates, which encode code points above U+FFFF,
+// must sort after U+E000 through U+FFFF. Shifting those down and surrogates up fixes that.
+NS_INLINE unichar PGCodePointOrderForCodeUnit(unichar codeUnit)
+{
+    if (codeUnit >= 0xE000) return codeUnit - 0x800;
+    if (codeUnit >= 0xD800) return codeUnit + 0x2000;
+    return codeUnit;
+}
+
+
+static NSComparisonResult PGCompareStringsLiterally(NSString *string1, NSString *string2)
+{
+#ifdef __APPLE__
+    // Many strings are stored as 8-bit ASCII internally, in which case we can compare their bytes directly. ASCII has one
+    // byte per code unit, so the strings' lengths are their byte counts, even if they contain null characters.
+    const char *bytes1 = CFStringGetCStringPtr((CFStringRef)string1, kCFStringEncodingASCII);
+    const char *bytes2 = bytes1 ? CFStringGetCStringPtr((CFStringRef)string2, kCFStringEncodingASCII) : NULL;
+    if (bytes1 && bytes2) {
+        CFIndex length1 = CFStringGetLength((CFStringRef)string1);
+        CFIndex length2 = CFStringGetLength((CFStringRef)string2);
+        int result = memcmp(bytes1, bytes2, (size_t)MIN(length1, length2));
+        if (result != 0) return result < 0 ? NSOrderedAscending : NSOrderedDescending;
+        return PGCompareValues(length1, length2);
+    }
+#endif
+
+    NSUInteger length1 = [string1 length];
+    NSUInteger length2 = [string2 length];
+    NSUInteger commonLength = MIN(length1, length2);
+    unichar buffer1[PGStringComparisonBufferLength];
+    unichar buffer2[PGStringComparisonBufferLength];
+
+    for (NSUInteger location = 0; location < commonLength; location += PGStringComparisonBufferLength) {
+        NSRange range = NSMakeRange(location, MIN(commonLength - location, (NSUInteger)PGStringComparisonBufferLength));
+        [string1 getCharacters:buffer1 range:range];
+        [string2 getCharacters:buffer2 range:range];
+
+        for (NSUInteger i = 0; i < range.length; ++i) {
+            if (buffer1[i] != buffer2[i]) {
+                return PGCodePointOrderForCodeUnit(buffer1[i]) < PGCodePointOrderForCodeUnit(buffer2[i]) ? NSOrderedAscending
+                                                                                                          : NSOrderedDescending;
+            }
+        }
+    }
+
+    return PGCompareUnsignedValues(length1, length2);
+}
+
+
+NSComparator PGStringComparatorWithOptions(NSStringCompareOptions options)
+{
+    if (options == NSLiteralSearch) {
+        return [[^NSComparisonResult(id object1, id object2) {
+            return PGCompareStringsLiterally(object1, object2);
+        } copy] autorelease];
+    }
+
+    return [[^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2 options:options];
+    } copy] autorelease];
+}
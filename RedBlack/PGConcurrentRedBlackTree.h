@@ -0,0 +1,115 @@
+//
+//  PGConcurrentRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGRedBlackTree;
+
+/*!
+ @abstract PGConcurrentRedBlackTree is a red-black tree that one writer thread can mutate while any number of reader
+     threads query immutable snapshots of it.
+ @discussion All of the tree's methods are thread-safe. Readers do not query the tree directly. Instead, they take a
+     snapshot using -snapshot and query that. A snapshot is an ordinary, immutable PGRedBlackTree, so any number of
+     threads can search, count, and enumerate it at the same time without locking, and it does not change when the
+     tree is mutated later.
+
+     Snapshots are built lazily and shared. The tree logs each mutation made since its last snapshot, and the first call
+     to -snapshot after a mutation replays the log on a copy of that snapshot. The copy takes linear time but is built
+     without holding the tree's lock, so writers and readers of existing snapshots never wait for it. Readers that need
+     a snapshot another thread is already building wait for that one instead of building their own. Every later call
+     returns the same snapshot until the tree is mutated again, so taking a snapshot is cheap when reads outnumber
+     writes. If the tree is mutated more times than it has objects without a snapshot being taken, the log is discarded
+     and the next snapshot copies the tree while holding the lock. A snapshot's memory is reclaimed once the tree and
+     all of its readers have released it.
+ */
+@interface PGConcurrentRedBlackTree : NSObject
+
+/*!
+ @abstract The number of objects in the tree.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract Creates and returns a concurrent tree that uses the specified block to compare its objects.
+ @param comparator The block used to compare objects in the new tree. Because it is invoked by readers of snapshots,
+     it must be safe to invoke from multiple threads at once. May not be nil.
+ @result A new concurrent tree or nil if comparator is nil.
+ */
++ (PGConcurrentRedBlackTree *)treeWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized concurrent tree that uses compare: to compare its objects.
+ @result A newly initialized concurrent tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized concurrent tree that uses the specified block to compare its objects.
+ @discussion This is the designated initializer.
+ @param comparator The block used to compare objects in the new tree. Because it is invoked by readers of snapshots,
+     it must be safe to invoke from multiple threads at once. May not be nil.
+ @result A newly initialized concurrent tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Adds a copy of the specified object to the tree.
+ @discussion See -[PGRedBlackTree addObject:]. Existing snapshots are unaffected.
+ @param object The object whose copy will be added. May not be nil.
+ @throws NSInvalidArgumentException if object is nil
+ */
+- (void)addObject:(id <NSCopying>)object;
+
+/*!
+ @abstract Adds a copy of each object in the specified array to the tree.
+ @discussion See -[PGRedBlackTree addObjectsFromArray:]. Existing snapshots are unaffected.
+ @param array The array to add objects from.
+ */
+- (void)addObjectsFromArray:(NSArray *)array;
+
+/*!
+ @abstract Removes the specified object from the tree.
+ @discussion See -[PGRedBlackTree removeObject:]. Existing snapshots are unaffected.
+ @param object The object to remove.
+ */
+- (void)removeObject:(id)object;
+
+/*!
+ @abstract Removes all objects from the tree.
+ @discussion Existing snapshots are unaffected.
+ */
+- (void)removeAllObjects;
+
+/*!
+ @abstract Returns an immutable snapshot of the tree's current contents.
+ @discussion The snapshot may be queried and enumerated from any number of threads concurrently. Attempting to mutate
+     it throws an NSInternalInconsistencyException. If the tree has not been mutated since the last snapshot was taken,
+     that snapshot is returned again. Otherwise, this takes O(n + m log n) time, where m is the number of mutations
+     made since then, almost all of which is spent without holding the tree's lock.
+ @result An immutable tree containing the tree's objects.
+ */
+- (PGRedBlackTree *)snapshot;
+
+@end
@@ -0,0 +1,343 @@
+//
+//  PGConcurrentRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGConcurrentRedBlackTree.h"
+
+#include <pthread.h>
+
+#import "PGRedBlackTree.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Constants
+
+// The log of mutations made since the last snapshot is discarded once it holds more objects than this and than the tree
+static const NSUInteger PGConcurrentRedBlackTreeMinimumLogCapacity = 1024;
+
+
+#pragma mark - Log entries
+
+// Records one mutation so that it can be replayed on a copy of the last snapshot
+@interface PGConcurrentRedBlackTreeLogEntry : NSObject {
+@public
+    NSArray *_objects;
+    BOOL _removal;
+}
+
+- (id)initWithObjects:(NSArray *)objects removal:(BOOL)removal;
+
+@end
+
+
+@implementation PGConcurrentRedBlackTreeLogEntry
+
+- (id)initWithObjects:(NSArray *)objects removal:(BOOL)removal
+{
+    self = [super init];
+    if (self) {
+        _objects = [objects copy];
+        _removal = removal;
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_objects release];
+    [super dealloc];
+}
+
+@end
+
+
+#pragma mark - Private interfaces
+
+@interface PGRedBlackTree (SnapshotAccessors)
+- (id)initWithObjectsInTree:(PGRedBlackTree *)tree immutable:(BOOL)immutable;
+- (void)makeImmutable;
+@end
+
+
+@interface PGConcurrentRedBlackTree () {
+    pthread_mutex_t _lock;
+    pthread_cond_t _snapshotCondition;
+    PGRedBlackTree *_tree;
+    unsigned long _mutationCount;
+
+    // The last snapshot published, which reflects the first _snapshotMutationCount mutations. While there is one, the
+    // log holds every mutation made since, in order. If the log grows too large, it and the snapshot are discarded.
+    PGRedBlackTree *_snapshot;
+    unsigned long _snapshotMutationCount;
+    NSMutableArray *_log;
+    NSUInteger _logObjectCount;
+
+    // The number of snapshots being built outside the lock and the most mutations any of them reflects
+    NSUInteger _buildCount;
+    unsigned long _buildMutationCount;
+}
+
+// Records a mutation that was just made to _tree. Must be called with the tree locked.
+- (void)logMutationWithObjects:(NSArray *)objects removal:(BOOL)removal;
+
+// Publishes a snapshot that reflects the first mutationCount mutations if it is newer than the current one and the log
+// can be trimmed to start where it ends. Must be called with the tree locked.
+- (void)publishSnapshot:(PGRedBlackTree *)snapshot mutationCount:(unsigned long)mutationCount;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGConcurrentRedBlackTree
+
++ (PGConcurrentRedBlackTree *)treeWithComparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithComparator:comparator] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    }];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator
+{
+    if (!comparator) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        pthread_cond_init(&_snapshotCondition, NULL);
+        _tree = [[PGRedBlackTree alloc] initWithComparator:comparator];
+        _snapshot = [[PGRedBlackTree alloc] initWithObjectsInTree:_tree immutable:YES];
+        _log = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_log release];
+    [_snapshot release];
+    [_tree release];
+    pthread_cond_destroy(&_snapshotCondition);
+    pthread_mutex_destroy(&_lock);
+    [super dealloc];
+}
+
+
+- (NSUInteger)count
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = [_tree count];
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+
+#pragma mark - Mutation
+
+- (void)addObject:(id)object
+{
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    }
+
+    // Log the same copy we add so that replaying the log can't see the object change later
+    object = [[object copy] autorelease];
+
+    pthread_mutex_lock(&_lock);
+    [_tree addObject:object];
+    [self logMutationWithObjects:@[ object ] removal:NO];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+    if ([array count] == 0) return;
+
+    NSMutableArray *copies = [NSMutableArray arrayWithCapacity:[array count]];
+    for (id object in array) {
+        [copies addObject:[[object copy] autorelease]];
+    }
+
+    pthread_mutex_lock(&_lock);
+    [_tree addObjectsFromArray:copies];
+    [self logMutationWithObjects:copies removal:NO];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)removeObject:(id)object
+{
+    if (!object) return;
+
+    // Like additions, log a copy so that replaying the log can't see the caller's object change later
+    object = [[object copy] autorelease];
+
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = [_tree count];
+    [_tree removeObject:object];
+    if ([_tree count] != count) [self logMutationWithObjects:@[ object ] removal:YES];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)removeAllObjects
+{
+    pthread_mutex_lock(&_lock);
+    if ([_tree count] > 0) {
+        [_tree removeAllObjects];
+        ++_mutationCount;
+
+        // The new snapshot is just an empty tree, so there's no need to log anything
+        [self publishSnapshot:[[[PGRedBlackTree alloc] initWithObjectsInTree:_tree immutable:YES] autorelease] mutationCount:_mutationCount];
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)logMutationWithObjects:(NSArray *)objects removal:(BOOL)removal
+{
+    ++_mutationCount;
+    if (!_snapshot) return;
+
+    PGConcurrentRedBlackTreeLogEntry *entry = [[PGConcurrentRedBlackTreeLogEntry alloc] initWithObjects:objects removal:removal];
+    [_log addObject:entry];
+    [entry release];
+    _logObjectCount += [objects count];
+
+    // Once replaying the log would take longer than copying the tree, stop keeping it. The next snapshot has to copy the
+    // tree with the lock held, but that only happens after more mutations than the tree has objects.
+    if (_logObjectCount > MAX(PGConcurrentRedBlackTreeMinimumLogCapacity, [_tree count])) {
+        [_snapshot release];
+        _snapshot = nil;
+        [_log removeAllObjects];
+        _logObjectCount = 0;
+    }
+}
+
+
+#pragma mark - Snapshots
+
+- (PGRedBlackTree *)snapshot
+{
+    pthread_mutex_lock(&_lock);
+    unsigned long mutationCount = _mutationCount;
+
+    // If another thread is already building a snapshot that reflects every mutation made before we were called, wait
+    // for it instead of building the same thing ourselves
+    while ((!_snapshot || _snapshotMutationCount < mutationCount) && _buildCount > 0 && _buildMutationCount >= mutationCount) {
+        pthread_cond_wait(&_snapshotCondition, &_lock);
+    }
+
+    if (_snapshot && _snapshotMutationCount >= mutationCount) {
+        PGRedBlackTree *snapshot = [_snapshot retain];
+        pthread_mutex_unlock(&_lock);
+        return [snapshot autorelease];
+    }
+
+    // Without a log, all we can do is copy the tree
+    if (!_snapshot) {
+        PGRedBlackTree *snapshot = [[PGRedBlackTree alloc] initWithObjectsInTree:_tree immutable:YES];
+        [self publishSnapshot:snapshot mutationCount:_mutationCount];
+        pthread_mutex_unlock(&_lock);
+        return [snapshot autorelease];
+    }
+
+    // Otherwise, replay the log on a copy of the last snapshot. Snapshots and log entries never change, so we only need
+    // the lock to get them. Building the copy takes linear time, so we do that without the lock, which keeps writers and
+    // readers of the current snapshot from waiting on us.
+    PGRedBlackTree *lastSnapshot = [_snapshot retain];
+    NSArray *log = [_log copy];
+    mutationCount = _mutationCount;
+    ++_buildCount;
+    _buildMutationCount = MAX(_buildMutationCount, mutationCount);
+    pthread_mutex_unlock(&_lock);
+
+    PGRedBlackTree *snapshot = [[PGRedBlackTree alloc] initWithObjectsInTree:lastSnapshot immutable:NO];
+    for (PGConcurrentRedBlackTreeLogEntry *entry in log) {
+        if (entry->_removal) {
+            [snapshot removeObject:[entry->_objects objectAtIndex:0]];
+        } else if ([entry->_objects count] == 1) {
+            [snapshot addObject:[entry->_objects objectAtIndex:0]];
+        } else {
+            [snapshot addObjectsFromArray:entry->_objects];
+        }
+    }
+
+    [snapshot makeImmutable];
+    [log release];
+    [lastSnapshot release];
+
+    pthread_mutex_lock(&_lock);
+    [self publishSnapshot:snapshot mutationCount:mutationCount];
+    if (--_buildCount == 0) _buildMutationCount = 0;
+    pthread_cond_broadcast(&_snapshotCondition);
+    pthread_mutex_unlock(&_lock);
+
+    return [snapshot autorelease];
+}
+
+
+- (void)publishSnapshot:(PGRedBlackTree *)snapshot mutationCount:(unsigned long)mutationCount
+{
+    if (_snapshot) {
+        // A snapshot that's no newer than ours has nothing to add
+        if (mutationCount <= _snapshotMutationCount) return;
+
+        // The log starts right after the current snapshot, so drop the entries the new snapshot already reflects
+        NSUInteger entryCount = MIN((NSUInteger)(mutationCount - _snapshotMutationCount), [_log count]);
+        for (NSUInteger i = 0; i < entryCount; ++i) {
+            _logObjectCount -= [((PGConcurrentRedBlackTreeLogEntry *)[_log objectAtIndex:i])->_objects count];
+        }
+
+        [_log removeObjectsInRange:NSMakeRange(0, entryCount)];
+    } else if (mutationCount != _mutationCount) {
+        // The log was discarded, so unless the snapshot reflects every mutation, there's no log to start after it
+        return;
+    }
+
+    [_snapshot release];
+    _snapshot = [snapshot retain];
+    _snapshotMutationCount = mutationCount;
+}
+
+@end
@@ -0,0 +1,269 @@
+//
+//  PGFrozenSortedSet.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGFrozenSortedSet is an immutable sorted collection that is optimized for lookups.
+ @discussion A frozen sorted set answers the same queries as a PGRedBlackTree that is no longer changing, so the two can
+     be used interchangeably once a tree has been built. Frozen sets are usually created with -[PGRedBlackTree frozenCopy].
+
+     Objects are stored twice in contiguous arrays: once in ascending order, which is used for enumeration and order
+     statistics, and once in Eytzinger order, i.e., in the breadth-first order of a complete binary search tree, which is
+     used for searching. A search reads the array from front to back, the first few levels of the implicit tree share a
+     cache line, and the location of the next comparison is computed instead of branched to, so the processor can
+     prefetch several levels ahead.
+
+     If the set's comparator is PGNumericComparator and every object is an NSNumber with an integer value, the set also
+     stores each object's value in an Eytzinger-ordered array of 64-bit integers. Searches for integer NSNumbers then
+     compare those integers directly instead of invoking the comparator. Other comparators may order integers
+     differently, even if they happen to agree on the set's own objects, so they always search using the comparator.
+ */
+@interface PGFrozenSortedSet : NSObject <NSCopying, NSFastEnumeration>
+
+/*!
+ @abstract The number of objects in the set.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract The comparator the set uses to order its objects.
+ */
+@property(readonly, copy) NSComparator comparator;
+
+/*!
+ @abstract Creates and returns a frozen set containing copies of the objects in the specified sorted array.
+ @discussion See -initWithSortedArray:comparator: for more information.
+ @param array The objects to add to the set, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new set. May not be nil.
+ @result A new set containing copies of the objects in array or nil if comparator is nil.
+ */
++ (PGFrozenSortedSet *)frozenSetWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized frozen set containing copies of the objects in the specified sorted array.
+ @discussion The set is built in O(n) time. If array is not sorted according to comparator, the set's behavior is
+     undefined.
+ @param array The objects to add to the set, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new set. May not be nil.
+ @result A newly initialized set containing copies of the objects in array or nil if comparator is nil.
+ */
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns whether an object equivalent to the one specified is in the set.
+ @discussion This method returns YES if and only if [set member:object] returns a valid object.
+ @param object The object whose membership in the set is being tested.
+ @result Returns YES when an object equivalent to the one specified is in the set and NO otherwise.
+ */
+- (BOOL)containsObject:(id)object;
+
+/*!
+ @abstract Returns an object in the set that is equivalent to the one specified.
+ @discussion This behaves exactly like -[PGRedBlackTree member:].
+ @param object The object being searched for.
+ @result The object in the set that is equivalent to the one specified, or nil if there is no such object.
+ */
+- (id)member:(id)object;
+
+/*!
+ @abstract Executes the specified block using each object in the set in ascending order according to the set's
+     comparator.
+ @param block The block to apply to the elements in the set. May not be nil. The block takes two arguments:
+ @param obj The element in the set.
+ @param stop A reference to a Boolean value. The block can set the value to YES to stop further processing of the set. The
+     stop argument is an out-only argument. You should only ever set this Boolean to YES within the block.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsUsingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that lies between two bounds.
+ @discussion This behaves exactly like the PGRedBlackTree method of the same name and takes O(log n + k) time, where k is
+     the number of objects visited.
+ @param fromObject The lower bound. If nil, there is no lower bound.
+ @param fromInclusive Whether objects equal to fromObject according to the set's comparator should be visited.
+ @param toObject The upper bound. If nil, there is no upper bound.
+ @param toInclusive Whether objects equal to toObject according to the set's comparator should be visited.
+ @param options A bitmask that specifies the options for the enumeration. Only NSEnumerationReverse is supported.
+ @param block The block to apply to the elements in the set. May not be nil. The block takes two arguments:
+ @param obj The element in the set.
+ @param stop A reference to a Boolean value. The block can set the value to YES to stop further processing of the set. The
+     stop argument is an out-only argument. You should only ever set this Boolean to YES within the block.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that is less than the specified object in ascending
+     order according to the set's comparator.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that is less than or equal to the specified object
+     in ascending order according to the set's comparator.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that is equal to the specified object in ascending
+     order according to the set's comparator.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that is greater than or equal to the specified
+     object in ascending order according to the set's comparator.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the set that is greater than the specified object in
+     ascending order according to the set's comparator.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsGreaterThanObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Returns the first object in the set, or nil if the set is empty.
+ */
+- (id)firstObject;
+
+/*!
+ @abstract Returns the last object in the set, or nil if the set is empty.
+ */
+- (id)lastObject;
+
+/*!
+ @abstract Returns the object at the specified index in the set's ascending order.
+ @discussion This takes O(1) time.
+ @param index An index within the bounds of the set.
+ @throws NSRangeException if index is greater than or equal to the set's count.
+ @result The object at index.
+ */
+- (id)objectAtIndex:(NSUInteger)index;
+
+/*!
+ @abstract Returns the index of the object returned by -member: in the set's ascending order.
+ @param object The object whose index is being requested.
+ @result The index of the set's object that is equivalent to the one specified, or NSNotFound if there is no such
+     object.
+ */
+- (NSUInteger)indexOfObject:(id)object;
+
+/*!
+ @abstract Returns the objects whose indexes are in the specified range in ascending order according to the set's
+     comparator.
+ @param range A range within the bounds of the set.
+ @throws NSRangeException if range is not within the bounds of the set.
+ @result The objects in the specified range.
+ */
+- (NSArray *)objectsInRange:(NSRange)range;
+
+/*!
+ @abstract Returns the number of objects in the set that are less than the specified object according to the set's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ */
+- (NSUInteger)countOfObjectsLessThanObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the set that are less than or equal to the specified object according to the
+     set's comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ */
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the set that are equal to the specified object according to the set's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ */
+- (NSUInteger)countOfObjectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the set that are greater than or equal to the specified object according to
+     the set's comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ */
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the set that are greater than the specified object according to the set's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ */
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object;
+
+/*!
+ @abstract Copies the objects whose indexes are in the specified range into a C array.
+ @discussion The objects are copied in ascending order according to the set's comparator. They are not retained.
+ @param objects A C array of objects of size at least the length of the range specified by range.
+ @param range A range within the bounds of the set.
+ @throws NSRangeException if range is not within the bounds of the set.
+ */
+- (void)getObjects:(id *)objects range:(NSRange)range;
+
+/*!
+ @abstract Returns all the objects in the set in ascending order according to the set's comparator.
+ */
+- (NSArray *)allObjects;
+
+/*!
+ @abstract Returns the objects in the set that are less than the specified object according to the set's comparator.
+ */
+- (NSArray *)objectsLessThanObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the set that are less than or equal to the specified object according to the set's
+     comparator.
+ */
+- (NSArray *)objectsLessThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the set that are equal to the specified object according to the set's comparator.
+ */
+- (NSArray *)objectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the set that are greater than or equal to the specified object according to the set's
+     comparator.
+ */
+- (NSArray *)objectsGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the set that are greater than the specified object according to the set's comparator.
+ */
+- (NSArray *)objectsGreaterThanObject:(id)object;
+
+@end
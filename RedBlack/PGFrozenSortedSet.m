@@ -0,0 +1,529 @@
+//
+//  PGFrozenSortedSet.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGFrozenSortedSet.h"
+
+#import "PGComparators.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Eytzinger layout
+
+// The layout arrays are 1-based: the root of the implicit tree is at index 1 and the children of node k are at 2k and
+// 2k + 1, so index 0 can stand for "no node." Searches prefetch the node this many times further along, which is the
+// first of that node's descendants four levels down.
+static const NSUInteger PGFrozenSortedSetPrefetchStride = 16;
+
+
+// Returns the node that follows node in ascending order, or 0 if there is none
+NS_INLINE NSUInteger PGFrozenSortedSetSuccessorNode(NSUInteger node, NSUInteger count)
+{
+    if (2 * node + 1 <= count) {
+        node = 2 * node + 1;
+        while (2 * node <= count) {
+            node *= 2;
+        }
+
+        return node;
+    }
+
+    // Climb past every ancestor of which we're a right descendant. Those are the trailing 1 bits of node.
+    return node >> __builtin_ffsl((long)~node);
+}
+
+
+NS_INLINE NSUInteger PGFrozenSortedSetFirstNode(NSUInteger count)
+{
+    NSUInteger node = count > 0 ? 1 : 0;
+    while (2 * node <= count && node > 0) {
+        node *= 2;
+    }
+
+    return node;
+}
+
+
+// Returns the first node that is not less than object, or not less than or equal to object if inclusive is YES, or 0 if
+// there is no such node. The next node to visit is computed from the comparison rather than branched to.
+static NSUInteger PGFrozenSortedSetSearchObjects(id const *layout, NSUInteger count, id object, NSComparator comparator, BOOL inclusive)
+{
+    NSComparisonResult threshold = inclusive ? NSOrderedDescending : NSOrderedSame;
+    NSUInteger node = 1;
+    while (node <= count) {
+        __builtin_prefetch(layout + PGFrozenSortedSetPrefetchStride * node);
+        node = 2 * node + (comparator(layout[node], object) < threshold);
+    }
+
+    return node >> __builtin_ffsl((long)~node);
+}
+
+
+// Like PGFrozenSortedSetSearchObjects, but compares integer keys directly
+static NSUInteger PGFrozenSortedSetSearchKeys(int64_t const *keys, NSUInteger count, int64_t key, BOOL inclusive)
+{
+    NSUInteger node = 1;
+    if (inclusive) {
+        while (node <= count) {
+            __builtin_prefetch(keys + PGFrozenSortedSetPrefetchStride * node);
+            node = 2 * node + (keys[node] <= key);
+        }
+    } else {
+        while (node <= count) {
+            __builtin_prefetch(keys + PGFrozenSortedSetPrefetchStride * node);
+            node = 2 * node + (keys[node] < key);
+        }
+    }
+
+    return node >> __builtin_ffsl((long)~node);
+}
+
+
+// Gets object's value as a 64-bit integer if it's an NSNumber whose value is an integer that fits in one
+static BOOL PGFrozenSortedSetGetKey(id object, int64_t *key)
+{
+    if (![object isKindOfClass:[NSNumber class]]) return NO;
+
+    const char *type = [object objCType];
+    if (!type || type[0] == '\0' || type[1] != '\0') return NO;
+
+    switch (type[0]) {
+        case 'c': case 's': case 'i': case 'l': case 'q':
+            *key = [object longLongValue];
+            return YES;
+        case 'B': case 'C': case 'S': case 'I': case 'L': case 'Q': {
+            unsigned long long value = [object unsignedLongLongValue];
+            if (value > INT64_MAX) return NO;
+            *key = (int64_t)value;
+            return YES;
+        }
+        default:
+            return NO;
+    }
+}
+
+
+#pragma mark - Private interfaces
+
+@interface PGFrozenSortedSet () {
+    id *_objects;
+    id *_layout;
+    NSUInteger *_ranks;
+    int64_t *_keys;
+}
+
+@property(readwrite, assign) NSUInteger count;
+@property(readwrite, copy) NSComparator comparator;
+
+- (id)initWithObjects:(id const *)objects count:(NSUInteger)count comparator:(NSComparator)comparator copyObjects:(BOOL)copyObjects;
+- (void)createKeys;
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object inclusive:(BOOL)inclusive;
+- (NSArray *)objectsFromIndex:(NSUInteger)fromIndex toIndex:(NSUInteger)toIndex;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGFrozenSortedSet
+
++ (PGFrozenSortedSet *)frozenSetWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithSortedArray:array comparator:comparator] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithSortedArray:nil comparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    }];
+}
+
+
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    NSUInteger count = [array count];
+    id *objects = NULL;
+    if (count > 0) {
+        objects = malloc(count * sizeof(id));
+        if (!objects) {
+            @throw [NSException exceptionWithName:NSMallocException
+                                           reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                         userInfo:nil];
+        }
+
+        [array getObjects:objects range:NSMakeRange(0, count)];
+    }
+
+    self = [self initWithObjects:objects count:count comparator:comparator copyObjects:YES];
+    free(objects);
+    return self;
+}
+
+
+- (id)initWithObjects:(id const *)objects count:(NSUInteger)count comparator:(NSComparator)comparator copyObjects:(BOOL)copyObjects
+{
+    if (!comparator) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        [self setComparator:comparator];
+        [self setCount:count];
+
+        _objects = malloc(MAX(count, 1) * sizeof(id));
+        _layout = malloc((count + 1) * sizeof(id));
+        _ranks = malloc((count + 1) * sizeof(NSUInteger));
+        if (!_objects || !_layout || !_ranks) {
+            // Create the exception first, since its reason describes self. -dealloc frees whichever buffers were
+            // allocated, and since none of them hold objects yet, there is nothing for it to release.
+            NSException *exception = [NSException exceptionWithName:NSMallocException
+                                                             reason:PGExceptionString(self, _cmd, @"Could not allocate storage for %lu objects.", (unsigned long)count)
+                                                           userInfo:nil];
+            [self setCount:0];
+            [self release];
+            @throw exception;
+        }
+
+        for (NSUInteger i = 0; i < count; ++i) {
+            _objects[i] = copyObjects ? [objects[i] copy] : [objects[i] retain];
+        }
+
+        // Visiting the implicit tree's nodes in order and handing out objects in order lays them out breadth-first
+        NSUInteger node = PGFrozenSortedSetFirstNode(count);
+        for (NSUInteger rank = 0; rank < count; ++rank) {
+            _layout[node] = _objects[rank];
+            _ranks[node] = rank;
+            node = PGFrozenSortedSetSuccessorNode(node, count);
+        }
+
+        [self createKeys];
+    }
+
+    return self;
+}
+
+
+- (void)createKeys
+{
+    // Integer keys can only stand in for a comparator that is known to order NSNumbers by value. Checking the objects
+    // against an arbitrary comparator isn't enough: it says nothing about how the comparator orders the probes.
+    if (_count == 0 || _comparator != PGNumericComparator()) return;
+
+    _keys = malloc((_count + 1) * sizeof(int64_t));
+    if (!_keys) return;
+
+    for (NSUInteger node = 1; node <= _count; ++node) {
+        if (!PGFrozenSortedSetGetKey(_layout[node], &_keys[node])) {
+            free(_keys);
+            _keys = NULL;
+            return;
+        }
+    }
+}
+
+
+- (void)dealloc
+{
+    if (_objects) {
+        for (NSUInteger i = 0; i < _count; ++i) {
+            [_objects[i] release];
+        }
+    }
+
+    free(_objects);
+    free(_layout);
+    free(_ranks);
+    free(_keys);
+    [_comparator release];
+    [super dealloc];
+}
+
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    // We're immutable, so copies can be shared
+    return [self retain];
+}
+
+
+#pragma mark - Searching
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object inclusive:(BOOL)inclusive
+{
+    int64_t key;
+    NSUInteger node = _keys && PGFrozenSortedSetGetKey(object, &key) ? PGFrozenSortedSetSearchKeys(_keys, _count, key, inclusive)
+                                                                     : PGFrozenSortedSetSearchObjects(_layout, _count, object, _comparator, inclusive);
+    return node != 0 ? _ranks[node] : _count;
+}
+
+
+- (BOOL)containsObject:(id)object
+{
+    return [self member:object] != nil;
+}
+
+
+- (id)member:(id)object
+{
+    NSUInteger index = [self indexOfObject:object];
+    return index != NSNotFound ? _objects[index] : nil;
+}
+
+
+- (NSUInteger)indexOfObject:(id)object
+{
+    if (!object) return NSNotFound;
+
+    // Check each object that is equal to object according to the comparator, starting with the first, for one that is
+    // equal according to -isEqual:. When we have integer keys, we can tell where that run ends without the comparator.
+    int64_t key;
+    BOOL hasKey = _keys && PGFrozenSortedSetGetKey(object, &key);
+    NSUInteger node = hasKey ? PGFrozenSortedSetSearchKeys(_keys, _count, key, NO)
+                             : PGFrozenSortedSetSearchObjects(_layout, _count, object, _comparator, NO);
+
+    while (node != 0 && (hasKey ? _keys[node] == key : _comparator(_layout[node], object) == NSOrderedSame)) {
+        id candidate = _layout[node];
+        if (object == candidate || ([object hash] == [candidate hash] && [object isEqual:candidate])) {
+            return _ranks[node];
+        }
+
+        node = PGFrozenSortedSetSuccessorNode(node, _count);
+    }
+
+    return NSNotFound;
+}
+
+
+#pragma mark - Enumeration
+
+- (void)enumerateObjectsUsingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:YES toObject:nil inclusive:YES options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    NSUInteger fromIndex = fromObject ? [self countOfObjectsLessThanObject:fromObject inclusive:!fromInclusive] : 0;
+    NSUInteger toIndex = toObject ? [self countOfObjectsLessThanObject:toObject inclusive:toInclusive] : _count;
+
+    BOOL stop = NO;
+    if (options & NSEnumerationReverse) {
+        for (NSUInteger i = toIndex; i > fromIndex && !stop; --i) {
+            block(_objects[i - 1], &stop);
+        }
+    } else {
+        for (NSUInteger i = fromIndex; i < toIndex && !stop; ++i) {
+            block(_objects[i], &stop);
+        }
+    }
+}
+
+
+- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:YES toObject:object inclusive:NO options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:YES toObject:object inclusive:YES options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:object inclusive:YES options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:nil inclusive:YES options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsGreaterThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:NO toObject:nil inclusive:YES options:0 usingBlock:block];
+}
+
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // Our objects are already in a contiguous array in order, so we can hand it out directly. We never change, so the
+    // mutations pointer can point anywhere that doesn't change.
+    if (state->state != 0) return 0;
+
+    state->state = 1;
+    state->mutationsPtr = &state->extra[0];
+    state->itemsPtr = _objects;
+    return _count;
+}
+
+
+#pragma mark - Order statistics
+
+- (id)firstObject
+{
+    return _count > 0 ? _objects[0] : nil;
+}
+
+
+- (id)lastObject
+{
+    return _count > 0 ? _objects[_count - 1] : nil;
+}
+
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    if (index >= _count) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Index %lu beyond bounds of set with count %lu.",
+                                                                (unsigned long)index, (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    return _objects[index];
+}
+
+
+- (NSArray *)objectsInRange:(NSRange)range
+{
+    if (NSMaxRange(range) > _count || NSMaxRange(range) < range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of set with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    return [self objectsFromIndex:range.location toIndex:NSMaxRange(range)];
+}
+
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object
+{
+    return [self countOfObjectsLessThanObject:object inclusive:NO];
+}
+
+
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object
+{
+    return [self countOfObjectsLessThanObject:object inclusive:YES];
+}
+
+
+- (NSUInteger)countOfObjectsEqualToObject:(id)object
+{
+    return [self countOfObjectsLessThanObject:object inclusive:YES] - [self countOfObjectsLessThanObject:object inclusive:NO];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object
+{
+    return _count - [self countOfObjectsLessThanObject:object inclusive:NO];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object
+{
+    return _count - [self countOfObjectsLessThanObject:object inclusive:YES];
+}
+
+
+- (void)getObjects:(id *)objects range:(NSRange)range
+{
+    if (NSMaxRange(range) > _count || NSMaxRange(range) < range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of set with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    if (range.length > 0) memcpy(objects, _objects + range.location, range.length * sizeof(id));
+}
+
+
+#pragma mark - Object arrays
+
+- (NSArray *)objectsFromIndex:(NSUInteger)fromIndex toIndex:(NSUInteger)toIndex
+{
+    if (fromIndex >= toIndex) return [NSArray array];
+    return [NSArray arrayWithObjects:_objects + fromIndex count:toIndex - fromIndex];
+}
+
+
+- (NSArray *)allObjects
+{
+    return [self objectsFromIndex:0 toIndex:_count];
+}
+
+
+- (NSArray *)objectsLessThanObject:(id)object
+{
+    return [self objectsFromIndex:0 toIndex:[self countOfObjectsLessThanObject:object inclusive:NO]];
+}
+
+
+- (NSArray *)objectsLessThanOrEqualToObject:(id)object
+{
+    return [self objectsFromIndex:0 toIndex:[self countOfObjectsLessThanObject:object inclusive:YES]];
+}
+
+
+- (NSArray *)objectsEqualToObject:(id)object
+{
+    return [self objectsFromIndex:[self countOfObjectsLessThanObject:object inclusive:NO]
+                          toIndex:[self countOfObjectsLessThanObject:object inclusive:YES]];
+}
+
+
+- (NSArray *)objectsGreaterThanOrEqualToObject:(id)object
+{
+    return [self objectsFromIndex:[self countOfObjectsLessThanObject:object inclusive:NO] toIndex:_count];
+}
+
+
+- (NSArray *)objectsGreaterThanObject:(id)object
+{
+    return [self objectsFromIndex:[self countOfObjectsLessThanObject:object inclusive:YES] toIndex:_count];
+}
+
+@end
@@ -0,0 +1,158 @@
+//
+//  PGIntervalRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract A half-open interval [start, end) of doubles.
+ @discussion An interval contains every point p for which start <= p < end. Intervals whose start equals their end are
+     empty and don't contain or overlap anything.
+ */
+typedef struct {
+    double start;
+    double end;
+} PGInterval;
+
+NS_INLINE PGInterval PGIntervalMake(double start, double end)
+{
+    PGInterval interval;
+    interval.start = start;
+    interval.end = end;
+    return interval;
+}
+
+
+/*!
+ @abstract PGIntervalRedBlackTree is a red-black tree of intervals that answers overlap and stabbing queries.
+ @discussion Each entry in the tree has an interval and an object. Entries are ordered by the start of their intervals,
+     and each node also stores the largest end of any interval in its subtree. Queries use those to skip every subtree
+     that can't contain a match, so finding the k entries that overlap an interval or contain a point takes O(log n + k)
+     time rather than a scan of every entry that starts before the query ends. Objects are retained, not copied, and
+     never affect the order of the tree. Entries with equal starts are kept in the order they were added.
+
+     The tree shares its node, rebalancing, and allocation code with PGRedBlackTree.
+ */
+@interface PGIntervalRedBlackTree : NSObject
+
+/*!
+ @abstract The number of entries in the tree.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract Creates and returns an empty tree.
+ @result A new empty tree.
+ */
++ (PGIntervalRedBlackTree *)tree;
+
+/*!
+ @abstract Returns an initialized empty tree.
+ @result A newly initialized tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized tree that has room for the specified number of entries.
+ @discussion This is the designated initializer.
+ @param capacity The number of entries for which space should be reserved.
+ @result A newly initialized tree.
+ */
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/*!
+ @abstract Adds an entry with the specified interval and object to the tree.
+ @discussion If the tree already has entries whose intervals have the same start, the new entry is placed after them.
+ @param interval The interval of the new entry. Its end must be greater than or equal to its start.
+ @param object The object associated with the interval. This object is retained by the tree. May not be nil.
+ @throws NSInvalidArgumentException if object is nil or interval's end is less than its start or either is NaN.
+ */
+- (void)addInterval:(PGInterval)interval object:(id)object;
+
+/*!
+ @abstract Returns whether the tree has an entry with exactly the specified interval.
+ @param interval The interval being searched for.
+ @result YES if an entry with the interval is in the tree and NO otherwise.
+ */
+- (BOOL)containsInterval:(PGInterval)interval;
+
+/*!
+ @abstract Removes the first entry with exactly the specified interval whose object is equal to the specified object.
+ @param interval The interval of the entry to remove.
+ @param object The object of the entry to remove. Objects are compared using -isEqual:.
+ @result YES if an entry was removed and NO otherwise.
+ */
+- (BOOL)removeInterval:(PGInterval)interval object:(id)object;
+
+/*!
+ @abstract Removes all entries from the tree.
+ */
+- (void)removeAllIntervals;
+
+/*!
+ @abstract Executes the specified block for every entry whose interval overlaps [start, end).
+ @discussion Entries are enumerated in order of their starts. An entry's interval overlaps [start, end) if it contains
+     some point that [start, end) also contains. This takes O(log n + k) time, where k is the number of entries
+     enumerated.
+ @param start The start of the interval to test against.
+ @param end The end of the interval to test against. If this is less than or equal to start, nothing overlaps it.
+ @param block The block to apply to the entries. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsOverlappingStart:(double)start end:(double)end
+                              usingBlock:(void (^)(PGInterval interval, id object, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block for every entry whose interval contains the specified point.
+ @discussion Entries are enumerated in order of their starts. This takes O(log n + k) time, where k is the number of
+     entries enumerated.
+ @param point The point to test.
+ @param block The block to apply to the entries. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsContainingPoint:(double)point usingBlock:(void (^)(PGInterval interval, id object, BOOL *stop))block;
+
+/*!
+ @abstract Returns the objects of the entries whose intervals overlap [start, end) in order of their starts.
+ @param start The start of the interval to test against.
+ @param end The end of the interval to test against.
+ @result The objects whose intervals overlap [start, end).
+ */
+- (NSArray *)objectsOverlappingStart:(double)start end:(double)end;
+
+/*!
+ @abstract Returns the objects of the entries whose intervals contain the specified point in order of their starts.
+ @param point The point to test.
+ @result The objects whose intervals contain point.
+ */
+- (NSArray *)objectsContainingPoint:(double)point;
+
+/*!
+ @abstract Executes the specified block for every entry in the tree in order of their starts.
+ @param block The block to apply to the entries. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateIntervalsAndObjectsUsingBlock:(void (^)(PGInterval interval, id object, BOOL *stop))block;
+
+@end
@@ -0,0 +1,371 @@
+//
+//  PGIntervalRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGIntervalRedBlackTree.h"
+
+#import "PGRedBlackTreeNode.h"
+#import "PGUtilities.h"
+
+#import <math.h>
+
+
+#pragma mark Interval nodes
+
+// Interval nodes are ordinary nodes followed by an interval and the largest end of any interval in their subtree.
+// Because the node is the struct's first member, a pointer to an interval node can be used anywhere a node pointer can,
+// and all rebalancing is done by the shared node functions, which keep maximumEnd up to date using the tree's update
+// function.
+typedef struct _PGIntervalRedBlackTreeNode {
+    PGRedBlackTreeNode node;
+    PGInterval interval;
+    double maximumEnd;
+} PGIntervalRedBlackTreeNode;
+
+
+NS_INLINE PGInterval PGIntervalRedBlackTreeNodeGetInterval(PGRedBlackTreeNode *node)
+{
+    return ((PGIntervalRedBlackTreeNode *)node)->interval;
+}
+
+
+NS_INLINE double PGIntervalRedBlackTreeNodeGetMaximumEnd(PGRedBlackTreeNode *node)
+{
+    return ((PGIntervalRedBlackTreeNode *)node)->maximumEnd;
+}
+
+
+static void PGIntervalRedBlackTreeNodeUpdate(PGRedBlackTreeNode *node)
+{
+    double maximumEnd = PGIntervalRedBlackTreeNodeGetInterval(node).end;
+    if (!PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
+        maximumEnd = MAX(maximumEnd, PGIntervalRedBlackTreeNodeGetMaximumEnd(node->leftChild));
+    }
+
+    if (!PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+        maximumEnd = MAX(maximumEnd, PGIntervalRedBlackTreeNodeGetMaximumEnd(node->rightChild));
+    }
+
+    ((PGIntervalRedBlackTreeNode *)node)->maximumEnd = maximumEnd;
+}
+
+
+// Invokes block with every node in the subtree whose interval overlaps [start, end), which must not be empty, in order.
+// Returns YES if the block stopped the enumeration.
+static BOOL PGIntervalRedBlackTreeNodeEnumerateSubnodesOverlapping(PGRedBlackTreeNode *node, double start, double end,
+                                                                   void (^block)(PGInterval, id, BOOL *))
+{
+    // If every interval in the subtree ends at or before start, none of them can overlap. Right subtrees are handled by
+    // looping rather than recursing, so we only recurse as deep as the tree is high.
+    while (!PGRedBlackTreeNodeIsSentinel(node) && PGIntervalRedBlackTreeNodeGetMaximumEnd(node) > start) {
+        if (PGIntervalRedBlackTreeNodeEnumerateSubnodesOverlapping(node->leftChild, start, end, block)) return YES;
+
+        // This node and everything after it start at or after end, so nothing else can overlap
+        PGInterval interval = PGIntervalRedBlackTreeNodeGetInterval(node);
+        if (interval.start >= end) return NO;
+
+        if (interval.end > start && interval.start < interval.end) {
+            BOOL stop = NO;
+            block(interval, node->object, &stop);
+            if (stop) return YES;
+        }
+
+        node = node->rightChild;
+    }
+
+    return NO;
+}
+
+
+#pragma mark - Private interfaces
+
+@interface PGIntervalRedBlackTree () {
+    PGRedBlackTreeCore _core;
+}
+
+@property(readwrite, assign) NSUInteger count;
+
+- (PGRedBlackTreeNode *)firstNodeWithInterval:(PGInterval)interval object:(id)object;
+
+@end
+
+
+@interface PGIntervalRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGIntervalRedBlackTree
+
++ (PGIntervalRedBlackTree *)tree
+{
+    return [[[self alloc] init] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithCapacity:0];
+}
+
+
+- (id)initWithCapacity:(NSUInteger)capacity
+{
+    self = [super init];
+    if (self) {
+        _core.pool = PGRedBlackTreeNodePoolCreate(sizeof(PGIntervalRedBlackTreeNode), capacity);
+        _core.updateNode = PGIntervalRedBlackTreeNodeUpdate;
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    PGRedBlackTreeNodePoolRelease(_core.pool, _core.root);
+    [super dealloc];
+}
+
+
+#pragma mark - Adding and removing entries
+
+- (void)addInterval:(PGInterval)interval object:(id)object
+{
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    } else if (!(interval.start <= interval.end)) {
+        // This also catches NaNs
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Interval [%g, %g) ends before it starts.",
+                                                                interval.start, interval.end)
+                                     userInfo:nil];
+    }
+
+    PGRedBlackTreeNode *newNode;
+
+    if (!_core.root) {
+        newNode = PGRedBlackTreeNodeCreate(_core.pool, NULL, object);
+        _core.root = newNode;
+    } else {
+        // Equal starts go to the right so that entries with the same start stay in the order they were added. The new
+        // node will be in the subtree of every node we pass on the way down, so update their counts and largest ends
+        // as we go.
+        PGRedBlackTreeNode *node = _core.root;
+        while (true) {
+            ++node->count;
+            PGIntervalRedBlackTreeNode *intervalNode = (PGIntervalRedBlackTreeNode *)node;
+            if (interval.end > intervalNode->maximumEnd) intervalNode->maximumEnd = interval.end;
+
+            if (interval.start < intervalNode->interval.start) {
+                if (PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
+                    newNode = PGRedBlackTreeNodeCreate(_core.pool, node, object);
+                    node->leftChild = newNode;
+                    break;
+                }
+
+                node = node->leftChild;
+            } else {
+                if (PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+                    newNode = PGRedBlackTreeNodeCreate(_core.pool, node, object);
+                    node->rightChild = newNode;
+                    break;
+                }
+
+                node = node->rightChild;
+            }
+        }
+    }
+
+    ((PGIntervalRedBlackTreeNode *)newNode)->interval = interval;
+    ((PGIntervalRedBlackTreeNode *)newNode)->maximumEnd = interval.end;
+    PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(newNode, &_core);
+    [self setCount:_count + 1];
+}
+
+
+- (BOOL)removeInterval:(PGInterval)interval object:(id)object
+{
+    PGRedBlackTreeNode *node = [self firstNodeWithInterval:interval object:object];
+    if (!node) return NO;
+
+    PGRedBlackTreeNodeRemoveFromTree(node, &_core);
+    [self setCount:_count - 1];
+    return YES;
+}
+
+
+- (void)removeAllIntervals
+{
+    if (!_core.root) return;
+    PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+    _core.root = NULL;
+    [self setCount:0];
+}
+
+
+#pragma mark - Searching
+
+- (BOOL)containsInterval:(PGInterval)interval
+{
+    return [self firstNodeWithInterval:interval object:nil] != NULL;
+}
+
+
+// If object is nil, any object matches
+- (PGRedBlackTreeNode *)firstNodeWithInterval:(PGInterval)interval object:(id)object
+{
+    // Find the first node whose start is at least interval's. Every time we go left, node is the best candidate so far.
+    PGRedBlackTreeNode *node = NULL;
+    for (PGRedBlackTreeNode *candidate = _core.root; candidate && !PGRedBlackTreeNodeIsSentinel(candidate); ) {
+        if (PGIntervalRedBlackTreeNodeGetInterval(candidate).start >= interval.start) {
+            node = candidate;
+            candidate = candidate->leftChild;
+        } else {
+            candidate = candidate->rightChild;
+        }
+    }
+
+    // Then check every node with the same start
+    for ( ; node && PGIntervalRedBlackTreeNodeGetInterval(node).start == interval.start; node = PGRedBlackTreeNodeSuccessor(node)) {
+        if (PGIntervalRedBlackTreeNodeGetInterval(node).end == interval.end &&
+            (!object || object == node->object || [object isEqual:node->object])) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+
+- (void)enumerateObjectsOverlappingStart:(double)start end:(double)end usingBlock:(void (^)(PGInterval, id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    // Empty query intervals don't overlap anything
+    if (!_core.root || !(start < end)) return;
+    PGIntervalRedBlackTreeNodeEnumerateSubnodesOverlapping(_core.root, start, end, block);
+}
+
+
+- (void)enumerateObjectsContainingPoint:(double)point usingBlock:(void (^)(PGInterval, id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    // An interval contains point exactly when it overlaps the smallest interval that starts at point
+    if (!_core.root || isnan(point) || point == INFINITY) return;
+    PGIntervalRedBlackTreeNodeEnumerateSubnodesOverlapping(_core.root, point, nextafter(point, INFINITY), block);
+}
+
+
+- (NSArray *)objectsOverlappingStart:(double)start end:(double)end
+{
+    NSMutableArray *objects = [NSMutableArray array];
+    [self enumerateObjectsOverlappingStart:start end:end usingBlock:^(PGInterval interval, id object, BOOL *stop) {
+        [objects addObject:object];
+    }];
+
+    return objects;
+}
+
+
+- (NSArray *)objectsContainingPoint:(double)point
+{
+    NSMutableArray *objects = [NSMutableArray array];
+    [self enumerateObjectsContainingPoint:point usingBlock:^(PGInterval interval, id object, BOOL *stop) {
+        [objects addObject:object];
+    }];
+
+    return objects;
+}
+
+
+#pragma mark - Enumeration
+
+- (void)enumerateIntervalsAndObjectsUsingBlock:(void (^)(PGInterval, id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    if (!_core.root) return;
+    BOOL stop = NO;
+    for (PGRedBlackTreeNode *node = PGRedBlackTreeNodeLeftmostSubnode(_core.root); node; node = PGRedBlackTreeNodeSuccessor(node)) {
+        block(PGIntervalRedBlackTreeNodeGetInterval(node), node->object, &stop);
+        if (stop) return;
+    }
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PGIntervalRedBlackTree (PropertyVerification)
+
+- (BOOL)fulfillsProperties
+{
+    if (!_core.root) return _count == 0;
+
+    // Our objects don't determine the tree's order, so check the structure with the shared function and then check
+    // the starts and largest ends ourselves
+    if (!PGRedBlackTreeNodeFulfillsProperties(_core.root, NULL) ||
+        _core.root->count != _count) {
+        return NO;
+    }
+
+    __block BOOL fulfillsProperties = YES;
+    __block PGRedBlackTreeNode *previousNode = NULL;
+    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_core.root, ^(PGRedBlackTreeNode *n, BOOL *stop) {
+        double maximumEnd = PGIntervalRedBlackTreeNodeGetInterval(n).end;
+        if (!PGRedBlackTreeNodeIsSentinel(n->leftChild)) maximumEnd = MAX(maximumEnd, PGIntervalRedBlackTreeNodeGetMaximumEnd(n->leftChild));
+        if (!PGRedBlackTreeNodeIsSentinel(n->rightChild)) maximumEnd = MAX(maximumEnd, PGIntervalRedBlackTreeNodeGetMaximumEnd(n->rightChild));
+
+        if (PGIntervalRedBlackTreeNodeGetMaximumEnd(n) != maximumEnd ||
+            (previousNode && PGIntervalRedBlackTreeNodeGetInterval(previousNode).start > PGIntervalRedBlackTreeNodeGetInterval(n).start)) {
+            fulfillsProperties = NO;
+            *stop = YES;
+        }
+
+        previousNode = n;
+    });
+
+    return fulfillsProperties;
+}
+
+@end
@@ -0,0 +1,182 @@
+//
+//  PGMultisetRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGMultisetRedBlackTree is a red-black tree that keeps all objects that are equal according to its comparator
+     together in a single node.
+ @discussion A PGRedBlackTree stores each object in its own node, so a key that is shared by k objects occupies k nodes
+     and finding a specific one of them with -member: or -removeObject: takes O(log n + k) time and up to k invocations of
+     -hash and -isEqual:. A multiset tree instead stores a bucket of objects in each node, so its size and height depend
+     only on the number of distinct keys. Finding a key's bucket takes O(log m) comparisons, where m is the number of
+     distinct keys, and enumerating or counting the objects equal to a key just reads its bucket.
+
+     Objects within a bucket are kept in the order in which they were added. Buckets can optionally keep a hash table of
+     their objects once they grow large, which makes -member: and -removeObject: take expected O(log m) time regardless of
+     how many objects share a key. As with PGRedBlackTree, objects' implementations of -hash and -isEqual: must be consistent with
+     the tree's comparator.
+ */
+@interface PGMultisetRedBlackTree : NSObject <NSFastEnumeration>
+
+/*!
+ @abstract The number of objects in the tree.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract The number of distinct keys in the tree, i.e., the number of objects that are pairwise unequal according to
+     the tree's comparator.
+ */
+@property(readonly, assign) NSUInteger keyCount;
+
+/*!
+ @abstract Creates and returns a tree that uses compare: to compare its objects.
+ @result A new empty tree.
+ */
++ (PGMultisetRedBlackTree *)tree;
+
+/*!
+ @abstract Creates and returns a tree that uses the specified comparator to compare its objects.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A new empty tree or nil if comparator is nil.
+ */
++ (PGMultisetRedBlackTree *)treeWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized tree that uses compare: to compare its objects and does not index its buckets.
+ @result A newly initialized tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified comparator to compare its objects and does not index its
+     buckets.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified comparator to compare its objects.
+ @discussion Indexed buckets build a hash table of their objects once they hold more than a few objects. This costs a
+     little time on every insertion and removal and some memory per object, but makes finding a specific object in a
+     large bucket take constant time rather than time proportional to the bucket's size.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @param indexesBuckets Whether large buckets should keep a hash table of their objects.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator indexesBuckets:(BOOL)indexesBuckets;
+
+/*!
+ @abstract Adds a copy of the specified object to the tree.
+ @discussion If the tree already has objects equal to the specified one according to its comparator, the copy is added
+     to the end of their bucket without creating a node.
+ @param object The object whose copy will be added. May not be nil.
+ @throws NSInvalidArgumentException if object is nil
+ */
+- (void)addObject:(id <NSCopying>)object;
+
+/*!
+ @abstract Returns whether an object equivalent to the one specified is in the tree.
+ @param object The object whose membership in the tree is being tested.
+ @result Returns YES when an object equivalent to the one specified is in the tree and NO otherwise.
+ */
+- (BOOL)containsObject:(id)object;
+
+/*!
+ @abstract Returns an object in the tree that is equivalent to the one specified.
+ @discussion The object's bucket is found using the tree's comparator and then searched for an object that has the same
+     hash as the specified object and is equal to it according to -isEqual:. If there are several, the one that was
+     added first is returned.
+ @param object The object being searched for.
+ @result The object in the tree that is equivalent to the one specified, or nil if there is no such object.
+ */
+- (id)member:(id)object;
+
+/*!
+ @abstract Removes the object returned by -member: from the tree.
+ @discussion Does nothing if the object is not in the tree.
+ @param object The object to remove.
+ */
+- (void)removeObject:(id)object;
+
+/*!
+ @abstract Removes all objects that are equal to the specified object according to the tree's comparator.
+ @discussion This removes the object's whole bucket in O(log m) time.
+ @param object The object whose equals should be removed.
+ */
+- (void)removeObjectsEqualToObject:(id)object;
+
+/*!
+ @abstract Removes all objects from the tree.
+ */
+- (void)removeAllObjects;
+
+/*!
+ @abstract Returns the number of objects in the tree that are equal to the specified object according to the tree's
+     comparator.
+ @discussion This takes O(log m) time.
+ */
+- (NSUInteger)countOfObjectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the tree that are equal to the specified object according to the tree's comparator in
+     the order in which they were added.
+ */
+- (NSArray *)objectsEqualToObject:(id)object;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is equal to the specified object according
+     to the tree's comparator, in the order in which they were added.
+ @param block The block to apply to the objects. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree in ascending order according to the tree's
+     comparator. Equal objects are visited in the order in which they were added.
+ @param block The block to apply to the objects. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsUsingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Returns the first object in the tree, or nil if the tree is empty.
+ */
+- (id)firstObject;
+
+/*!
+ @abstract Returns the last object in the tree, or nil if the tree is empty.
+ */
+- (id)lastObject;
+
+/*!
+ @abstract Returns all the objects in the tree in ascending order according to the tree's comparator.
+ */
+- (NSArray *)allObjects;
+
+@end
@@ -0,0 +1,671 @@
+//
+//  PGMultisetRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGMultisetRedBlackTree.h"
+
+#import "PGRedBlackTreeNode.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Buckets
+
+// Buckets that index their objects start doing so once they hold more than this many objects
+static const NSUInteger PGRedBlackTreeBucketIndexThreshold = 16;
+
+// Buckets don't compact their slots until they have at least this many tombstones
+static const NSUInteger PGRedBlackTreeBucketCompactionThreshold = 16;
+
+// Fills the slots of removed objects until the bucket is compacted
+static id PGRedBlackTreeBucketTombstone = nil;
+
+// Each node's object is a bucket of objects that are equal according to the tree's comparator. Buckets are never empty.
+// Their key is one of their objects and is what the tree compares against.
+@interface PGRedBlackTreeBucket : NSObject <NSFastEnumeration> {
+@public
+    id _key;
+
+@private
+    // The bucket's objects in the order they were added. Removing an object replaces it with a tombstone rather than
+    // shifting every later object down, so that indexed buckets can remove objects without a linear scan. Tombstones at
+    // the end of the array are removed immediately, and the array is compacted once most of its slots are tombstones.
+    NSMutableArray *_slots;
+
+    // The slot of the bucket's first object and the number of objects it holds
+    NSUInteger _firstSlot;
+    NSUInteger _count;
+
+    // Maps each object to the slots of all of the bucket's objects that are equal to it according to -isEqual:
+    NSMapTable *_index;
+
+    unsigned long _mutationCount;
+}
+
+- (id)initWithObject:(id)object;
+
+- (NSUInteger)count;
+- (id)firstObject;
+- (id)lastObject;
+- (NSArray *)allObjects;
+
+- (void)addObject:(id)object indexed:(BOOL)indexed;
+- (id)member:(id)object;
+- (BOOL)removeObject:(id)object;
+
+// Copies up to length of the bucket's objects, starting at *slot, into buffer and sets *slot to the slot after the last
+// one copied. Returns the number of objects copied. If *slot is not past the bucket's last slot afterward, buffer is full.
+- (NSUInteger)getObjects:(id *)buffer count:(NSUInteger)length fromSlot:(NSUInteger *)slot;
+- (BOOL)hasObjectsFromSlot:(NSUInteger)slot;
+
+@end
+
+
+@implementation PGRedBlackTreeBucket
+
++ (void)initialize
+{
+    if (self == [PGRedBlackTreeBucket class]) {
+        PGRedBlackTreeBucketTombstone = [[NSObject alloc] init];
+    }
+}
+
+
+- (id)initWithObject:(id)object
+{
+    self = [super init];
+    if (self) {
+        _key = [object retain];
+        _slots = [[NSMutableArray alloc] initWithObjects:object, nil];
+        _count = 1;
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_key release];
+    [_slots release];
+    [_index release];
+    [super dealloc];
+}
+
+
+- (NSUInteger)count
+{
+    return _count;
+}
+
+
+- (id)firstObject
+{
+    return _count > 0 ? [_slots objectAtIndex:_firstSlot] : nil;
+}
+
+
+- (id)lastObject
+{
+    return _count > 0 ? [_slots lastObject] : nil;
+}
+
+
+- (NSArray *)allObjects
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:_count];
+    for (id object in self) {
+        [objects addObject:object];
+    }
+
+    return objects;
+}
+
+
+#pragma mark - Adding, finding, and removing objects
+
+- (void)indexObject:(id)object inSlot:(NSUInteger)slot
+{
+    NSMutableIndexSet *equalObjectSlots = [_index objectForKey:object];
+    if (equalObjectSlots) {
+        [equalObjectSlots addIndex:slot];
+    } else {
+        [_index setObject:[NSMutableIndexSet indexSetWithIndex:slot] forKey:object];
+    }
+}
+
+
+- (void)rebuildIndex
+{
+    [_index removeAllObjects];
+    NSUInteger slotCount = [_slots count];
+    for (NSUInteger slot = _firstSlot; slot < slotCount; ++slot) {
+        id object = [_slots objectAtIndex:slot];
+        if (object != PGRedBlackTreeBucketTombstone) [self indexObject:object inSlot:slot];
+    }
+}
+
+
+- (void)addObject:(id)object indexed:(BOOL)indexed
+{
+    [_slots addObject:object];
+    ++_count;
+    ++_mutationCount;
+
+    if (_index) {
+        [self indexObject:object inSlot:[_slots count] - 1];
+    } else if (indexed && _count > PGRedBlackTreeBucketIndexThreshold) {
+        _index = [[NSMapTable strongToStrongObjectsMapTable] retain];
+        [self rebuildIndex];
+    }
+}
+
+
+- (NSUInteger)slotOfObject:(id)object
+{
+    if (_index) {
+        NSMutableIndexSet *equalObjectSlots = [_index objectForKey:object];
+        return equalObjectSlots ? [equalObjectSlots firstIndex] : NSNotFound;
+    }
+
+    NSUInteger hash = [object hash];
+    NSUInteger slotCount = [_slots count];
+    for (NSUInteger slot = _firstSlot; slot < slotCount; ++slot) {
+        id candidate = [_slots objectAtIndex:slot];
+        if (candidate == PGRedBlackTreeBucketTombstone) continue;
+        if (object == candidate || (hash == [candidate hash] && [object isEqual:candidate])) return slot;
+    }
+
+    return NSNotFound;
+}
+
+
+- (id)member:(id)object
+{
+    NSUInteger slot = [self slotOfObject:object];
+    return slot != NSNotFound ? [_slots objectAtIndex:slot] : nil;
+}
+
+
+- (BOOL)removeObject:(id)object
+{
+    NSUInteger slot = [self slotOfObject:object];
+    if (slot == NSNotFound) return NO;
+
+    if (_index) {
+        NSMutableIndexSet *equalObjectSlots = [_index objectForKey:object];
+        [equalObjectSlots removeIndex:slot];
+        if ([equalObjectSlots count] == 0) [_index removeObjectForKey:object];
+    }
+
+    [_slots replaceObjectAtIndex:slot withObject:PGRedBlackTreeBucketTombstone];
+    --_count;
+    ++_mutationCount;
+
+    // Keep tombstones off the end so that -lastObject can read the last slot, and skip over any at the start. Each slot
+    // is only passed over once between compactions, so this takes amortized constant time.
+    while ([_slots count] > 0 && [_slots lastObject] == PGRedBlackTreeBucketTombstone) {
+        [_slots removeLastObject];
+    }
+
+    NSUInteger slotCount = [_slots count];
+    while (_firstSlot < slotCount && [_slots objectAtIndex:_firstSlot] == PGRedBlackTreeBucketTombstone) {
+        ++_firstSlot;
+    }
+
+    if (_firstSlot >= slotCount) _firstSlot = 0;
+
+    // Don't keep a removed object alive just to serve as our key
+    if (_count > 0 && slot < _firstSlot) {
+        [_key release];
+        _key = [[_slots objectAtIndex:_firstSlot] retain];
+    }
+
+    // Compacting takes time proportional to the number of slots, but we only do it once tombstones outnumber objects,
+    // so its cost is spread over at least as many removals
+    NSUInteger tombstoneCount = slotCount - _count;
+    if (tombstoneCount >= PGRedBlackTreeBucketCompactionThreshold && tombstoneCount > _count) {
+        NSMutableArray *slots = [[NSMutableArray alloc] initWithCapacity:_count];
+        for (id bucketObject in self) {
+            [slots addObject:bucketObject];
+        }
+
+        [_slots release];
+        _slots = slots;
+        _firstSlot = 0;
+        if (_index) [self rebuildIndex];
+    }
+
+    return YES;
+}
+
+
+#pragma mark - Enumeration
+
+- (NSUInteger)getObjects:(id *)buffer count:(NSUInteger)length fromSlot:(NSUInteger *)slot
+{
+    NSUInteger slotCount = [_slots count];
+    NSUInteger nextSlot = MAX(*slot, _firstSlot);
+    NSUInteger count = 0;
+    while (count < length && nextSlot < slotCount) {
+        // Copy a run of slots straight into the buffer and then squeeze out any tombstones it contained
+        NSUInteger copyCount = MIN(length - count, slotCount - nextSlot);
+        [_slots getObjects:buffer + count range:NSMakeRange(nextSlot, copyCount)];
+        nextSlot += copyCount;
+
+        NSUInteger end = count + copyCount;
+        for (NSUInteger i = count; i < end; ++i) {
+            if (buffer[i] != PGRedBlackTreeBucketTombstone) buffer[count++] = buffer[i];
+        }
+    }
+
+    *slot = nextSlot;
+    return count;
+}
+
+
+- (BOOL)hasObjectsFromSlot:(NSUInteger)slot
+{
+    return slot < [_slots count];
+}
+
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // We keep the next slot in extra[0]
+    if (state->state == 0) {
+        state->state = 1;
+        state->mutationsPtr = &_mutationCount;
+        state->extra[0] = 0;
+    }
+
+    NSUInteger slot = state->extra[0];
+    NSUInteger count = [self getObjects:buffer count:length fromSlot:&slot];
+    state->extra[0] = slot;
+    state->itemsPtr = buffer;
+    return count;
+}
+
+@end
+
+
+#pragma mark - Bucket nodes
+
+NS_INLINE PGRedBlackTreeBucket *PGMultisetRedBlackTreeNodeGetBucket(PGRedBlackTreeNode *node)
+{
+    return (PGRedBlackTreeBucket *)node->object;
+}
+
+
+#pragma mark - Private interfaces
+
+@interface PGMultisetRedBlackTree () {
+    PGRedBlackTreeCore _core;
+    BOOL _indexesBuckets;
+    unsigned long _mutationCount;
+}
+
+@property(readwrite, assign) NSUInteger count;
+@property(readwrite, assign) NSUInteger keyCount;
+@property(readwrite, copy) NSComparator comparator;
+
+- (PGRedBlackTreeNode *)nodeForKey:(id)object;
+
+@end
+
+
+@interface PGMultisetRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGMultisetRedBlackTree
+
++ (PGMultisetRedBlackTree *)tree
+{
+    return [[[self alloc] init] autorelease];
+}
+
+
++ (PGMultisetRedBlackTree *)treeWithComparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithComparator:comparator] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    }];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator
+{
+    return [self initWithComparator:comparator indexesBuckets:NO];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator indexesBuckets:(BOOL)indexesBuckets
+{
+    if (!comparator) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        [self setComparator:comparator];
+        _indexesBuckets = indexesBuckets;
+        _core.pool = PGRedBlackTreeNodePoolCreate(sizeof(PGRedBlackTreeNode), 0);
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    PGRedBlackTreeNodePoolRelease(_core.pool, _core.root);
+    [_comparator release];
+    [super dealloc];
+}
+
+
+#pragma mark - Adding and removing objects
+
+- (void)addObject:(id)object
+{
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    }
+
+    object = [[object copy] autorelease];
+
+    // Look for the object's bucket, remembering where a new node for it would go in case there isn't one
+    PGRedBlackTreeNode *parent = NULL;
+    NSComparisonResult result = NSOrderedSame;
+    for (PGRedBlackTreeNode *node = _core.root; node && !PGRedBlackTreeNodeIsSentinel(node); ) {
+        result = _comparator(object, PGMultisetRedBlackTreeNodeGetBucket(node)->_key);
+        if (result == NSOrderedSame) {
+            [PGMultisetRedBlackTreeNodeGetBucket(node) addObject:object indexed:_indexesBuckets];
+            [self setCount:_count + 1];
+            ++_mutationCount;
+            return;
+        }
+
+        parent = node;
+        node = result < NSOrderedSame ? node->leftChild : node->rightChild;
+    }
+
+    PGRedBlackTreeBucket *bucket = [[PGRedBlackTreeBucket alloc] initWithObject:object];
+    PGRedBlackTreeNode *newNode = PGRedBlackTreeNodeCreate(_core.pool, parent, bucket);
+    [bucket release];
+
+    if (!parent) {
+        _core.root = newNode;
+    } else if (result < NSOrderedSame) {
+        parent->leftChild = newNode;
+    } else {
+        parent->rightChild = newNode;
+    }
+
+    // The new node is in the subtree of every node on the path we took to get here
+    for (PGRedBlackTreeNode *ancestor = parent; ancestor; ancestor = ancestor->parent) {
+        ++ancestor->count;
+    }
+
+    PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(newNode, &_core);
+    [self setCount:_count + 1];
+    [self setKeyCount:_keyCount + 1];
+    ++_mutationCount;
+}
+
+
+- (void)removeObject:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    if (!node || ![PGMultisetRedBlackTreeNodeGetBucket(node) removeObject:object]) return;
+
+    if ([PGMultisetRedBlackTreeNodeGetBucket(node) count] == 0) {
+        PGRedBlackTreeNodeRemoveFromTree(node, &_core);
+        [self setKeyCount:_keyCount - 1];
+    }
+
+    [self setCount:_count - 1];
+    ++_mutationCount;
+}
+
+
+- (void)removeObjectsEqualToObject:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    if (!node) return;
+
+    [self setCount:_count - [PGMultisetRedBlackTreeNodeGetBucket(node) count]];
+    PGRedBlackTreeNodeRemoveFromTree(node, &_core);
+    [self setKeyCount:_keyCount - 1];
+    ++_mutationCount;
+}
+
+
+- (void)removeAllObjects
+{
+    if (!_core.root) return;
+    PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+    _core.root = NULL;
+    [self setCount:0];
+    [self setKeyCount:0];
+    ++_mutationCount;
+}
+
+
+#pragma mark - Searching
+
+- (PGRedBlackTreeNode *)nodeForKey:(id)object
+{
+    if (!object) return NULL;
+
+    PGRedBlackTreeNode *node = _core.root;
+    while (node && !PGRedBlackTreeNodeIsSentinel(node)) {
+        NSComparisonResult result = _comparator(object, PGMultisetRedBlackTreeNodeGetBucket(node)->_key);
+        if (result == NSOrderedSame) return node;
+        node = result < NSOrderedSame ? node->leftChild : node->rightChild;
+    }
+
+    return NULL;
+}
+
+
+- (BOOL)containsObject:(id)object
+{
+    return [self member:object] != nil;
+}
+
+
+- (id)member:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    return node ? [PGMultisetRedBlackTreeNodeGetBucket(node) member:object] : nil;
+}
+
+
+- (NSUInteger)countOfObjectsEqualToObject:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    return node ? [PGMultisetRedBlackTreeNodeGetBucket(node) count] : 0;
+}
+
+
+- (NSArray *)objectsEqualToObject:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    return node ? [PGMultisetRedBlackTreeNodeGetBucket(node) allObjects] : [NSArray array];
+}
+
+
+- (id)firstObject
+{
+    if (!_core.root) return nil;
+    return [PGMultisetRedBlackTreeNodeGetBucket(PGRedBlackTreeNodeLeftmostSubnode(_core.root))firstObject];
+}
+
+
+- (id)lastObject
+{
+    if (!_core.root) return nil;
+    return [PGMultisetRedBlackTreeNodeGetBucket(PGRedBlackTreeNodeRightmostSubnode(_core.root))lastObject];
+}
+
+
+#pragma mark - Enumeration
+
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    PGRedBlackTreeNode *node = [self nodeForKey:object];
+    if (!node) return;
+
+    BOOL stop = NO;
+    for (id bucketObject in PGMultisetRedBlackTreeNodeGetBucket(node)) {
+        block(bucketObject, &stop);
+        if (stop) return;
+    }
+}
+
+
+- (void)enumerateObjectsUsingBlock:(void (^)(id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    if (!_core.root) return;
+    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_core.root, ^(PGRedBlackTreeNode *node, BOOL *stop) {
+        for (id bucketObject in PGMultisetRedBlackTreeNodeGetBucket(node)) {
+            block(bucketObject, stop);
+            if (*stop) return;
+        }
+    });
+}
+
+
+- (NSArray *)allObjects
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:_count];
+    if (!_core.root) return objects;
+
+    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_core.root, ^(PGRedBlackTreeNode *node, BOOL *stop) {
+        for (id bucketObject in PGMultisetRedBlackTreeNodeGetBucket(node)) {
+            [objects addObject:bucketObject];
+        }
+    });
+
+    return objects;
+}
+
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // We keep the node we're enumerating in extra[0] and the next slot of its bucket in extra[1]. Because
+    // mutationsPtr points to our mutation count, the enumeration will throw before we're called again if the tree is
+    // mutated, so the node remains valid.
+    PGRedBlackTreeNode *node;
+    NSUInteger slot;
+    if (state->state == 0) {
+        state->state = 1;
+        state->mutationsPtr = &_mutationCount;
+        node = _core.root ? PGRedBlackTreeNodeLeftmostSubnode(_core.root) : NULL;
+        slot = 0;
+    } else {
+        node = (PGRedBlackTreeNode *)state->extra[0];
+        slot = state->extra[1];
+    }
+
+    NSUInteger count = 0;
+    while (node && count < length) {
+        PGRedBlackTreeBucket *bucket = PGMultisetRedBlackTreeNodeGetBucket(node);
+        count += [bucket getObjects:buffer + count count:length - count fromSlot:&slot];
+        if (![bucket hasObjectsFromSlot:slot]) {
+            node = PGRedBlackTreeNodeSuccessor(node);
+            slot = 0;
+        }
+    }
+
+    state->extra[0] = (unsigned long)node;
+    state->extra[1] = slot;
+    state->itemsPtr = buffer;
+    return count;
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PGMultisetRedBlackTree (PropertyVerification)
+
+- (BOOL)fulfillsProperties
+{
+    PGRedBlackTreeNode *node = _core.root;
+    if (!node) return _count == 0 && _keyCount == 0;
+
+    if (!PGRedBlackTreeNodeFulfillsProperties(_core.root, NULL)) {
+        return NO;
+    }
+
+    // Our buckets don't determine the tree's order, so check the structure with the shared function and then check that
+    // the keys are strictly increasing and that every bucket's objects are equal to its key ourselves
+    NSUInteger count = 0;
+    NSUInteger keyCount = 0;
+    PGRedBlackTreeBucket *previousBucket = nil;
+    for (node = leaf; node; node = PGRedBlackTreeNodeSuccessor(node)) {
+        PGRedBlackTreeBucket *bucket = PGMultisetRedBlackTreeNodeGetBucket(node);
+        if ([bucket count] == 0) return NO;
+        if (previousBucket && _comparator(previousBucket->_key, bucket->_key) != NSOrderedAscending) return NO;
+
+        for (id object in bucket) {
+            if (_comparator(object, bucket->_key) != NSOrderedSame) return NO;
+        }
+
+        count += [bucket count];
+        ++keyCount;
+        previousBucket = bucket;
+    }
+
+    return count == _count && keyCount == _keyCount && _core.root->count == _keyCount;
+}
+
+@end
@@ -26,13 +26,81 @@
 
 #import <Foundation/Foundation.h>
 
-@interface PGRedBlackTree : NSObject
+@class PGFrozenSortedSet;
+@class PGRedBlackTreeCursor;
+
+/*!
+ @abstract Keys for the dictionary returned by -[PGRedBlackTree statistics].
+ @discussion The height, black height, and depth histogram keys are always present. The others are only present when the
+     tree is built with PG_RED_BLACK_TREE_STATISTICS defined to 1, and are counted since the tree was created or its
+     statistics were last reset. The depth histogram is an array whose ith element is the number of nodes at depth i.
+     Node allocation and free counts are for the tree's node pool, which it shares with trees split from it.
+ */
+extern NSString *const PGRedBlackTreeStatisticsComparisonCountKey;
+extern NSString *const PGRedBlackTreeStatisticsRotationCountKey;
+extern NSString *const PGRedBlackTreeStatisticsInsertionFixupIterationCountKey;
+extern NSString *const PGRedBlackTreeStatisticsRemovalFixupIterationCountKey;
+extern NSString *const PGRedBlackTreeStatisticsNodeAllocationCountKey;
+extern NSString *const PGRedBlackTreeStatisticsNodeFreeCountKey;
+extern NSString *const PGRedBlackTreeStatisticsHeightKey;
+extern NSString *const PGRedBlackTreeStatisticsBlackHeightKey;
+extern NSString *const PGRedBlackTreeStatisticsDepthHistogramKey;
+
+/*!
+ @abstract Error codes in PGErrorDomain for errors that occur while reading or writing tree archives.
+ @constant PGRedBlackTreeArchiveErrorUnsupportedObject The tree contains an object that cannot be archived. Only
+     NSNumbers, NSStrings, and NSData can be.
+ @constant PGRedBlackTreeArchiveErrorInvalidFile The file is not a tree archive, was written by a machine with a
+     different byte order, is damaged, or holds objects that are out of order according to the comparator it was read
+     with.
+ */
+typedef NS_ENUM(NSInteger, PGRedBlackTreeArchiveError) {
+    PGRedBlackTreeArchiveErrorUnsupportedObject = 1,
+    PGRedBlackTreeArchiveErrorInvalidFile
+};
+
+/*!
+ @abstract Which object a tree with a maximum count evicts when adding objects would take it over that count.
+ @constant PGRedBlackTreeEvictionNone The tree has no maximum count.
+ @constant PGRedBlackTreeEvictionFirstObject The first (smallest) objects are evicted, so the tree keeps the largest ones.
+ @constant PGRedBlackTreeEvictionLastObject The last (largest) objects are evicted, so the tree keeps the smallest ones.
+ */
+typedef NS_ENUM(NSUInteger, PGRedBlackTreeEviction) {
+    PGRedBlackTreeEvictionNone,
+    PGRedBlackTreeEvictionFirstObject,
+    PGRedBlackTreeEvictionLastObject
+};
+
+@interface PGRedBlackTree : NSObject <NSFastEnumeration>
 
 /*!
  @abstract The number of items in the tree.
  */
 @property(readonly, assign) NSUInteger count;
 
+/*!
+ @abstract Whether the tree keeps a hash index of its objects.
+ @discussion When this is YES, the tree keeps a hash table from each of its objects to where it is stored, keyed by
+     -hash and -isEqual:. -containsObject:, -member:, -indexOfObject:, and -removeObject: then find objects in expected
+     O(1) time instead of searching the tree with its comparator. -addObject:, -removeObject:, and -removeAllObjects
+     update the index as they go. Other mutations leave it to be rebuilt in O(n) time by the next lookup, which means
+     that lookups on a mutable tree may modify it and must not run concurrently on multiple threads. Immutable trees
+     build their index in O(n) time as soon as this is set to YES, so their lookups never modify them and may run
+     concurrently, though this property must not be changed while they do. The index takes 32 to 64 bytes per object,
+     so it is best suited to read-heavy trees. Setting this to NO frees the index. Defaults to NO.
+ */
+@property(readwrite, assign) BOOL indexesObjects;
+
+/*!
+ @abstract The maximum number of objects the tree holds, or NSUIntegerMax if it has no maximum.
+ */
+@property(readonly, assign) NSUInteger maximumCount;
+
+/*!
+ @abstract Which objects the tree evicts when it would otherwise hold more than its maximum count.
+ */
+@property(readonly, assign) PGRedBlackTreeEviction eviction;
+
 /*!
  @abstract Creates and returns a tree that uses compare: as its selector.
  @discussion All objects added to the tree must respond to compare:.
@@ -56,6 +124,51 @@
  */
 + (PGRedBlackTree *)treeWithComparator:(NSComparator)comparator;
 
+/*!
+ @abstract Creates and returns a tree of NSNumbers ordered by their values.
+ @discussion See -initWithNumericKeys for more information.
+ @result A new empty tree.
+ */
++ (PGRedBlackTree *)treeWithNumericKeys;
+
+/*!
+ @abstract Creates and returns a tree of NSStrings ordered using the specified string comparison options.
+ @discussion See -initWithStringKeysUsingOptions: for more information.
+ @param options The options used to compare strings in the new tree.
+ @result A new empty tree.
+ */
++ (PGRedBlackTree *)treeWithStringKeysUsingOptions:(NSStringCompareOptions)options;
+
+/*!
+ @abstract Creates and returns a tree that uses compare: as its selector and holds no more than the specified number of
+     objects.
+ @discussion See -initWithComparator:maximumCount:evict: for more information.
+ @param maximumCount The maximum number of objects the tree holds.
+ @param eviction Which objects the tree evicts when it is over its maximum count.
+ @result A new empty tree.
+ */
++ (PGRedBlackTree *)treeWithMaximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction;
+
+/*!
+ @abstract Creates and returns a tree that uses compare: as its selector and contains copies of the objects in the
+     specified array.
+ @discussion The objects are sorted once and the tree is then built directly from the sorted objects, which is
+     considerably faster than adding them one at a time. All objects in the array must respond to compare:.
+ @param array The objects to add to the tree.
+ @result A new tree containing copies of the objects in array.
+ */
++ (PGRedBlackTree *)treeWithArray:(NSArray *)array;
+
+/*!
+ @abstract Creates and returns a tree that uses the specified block to compare its objects and contains copies of the
+     objects in the specified array, which must already be sorted using that block.
+ @discussion See -initWithSortedArray:comparator: for more information.
+ @param array The objects to add to the tree, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A new tree containing copies of the objects in array or nil if comparator is nil.
+ */
++ (PGRedBlackTree *)treeWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
 
 /*!
  @abstract Returns an initialized tree that uses compare: as its selector.
@@ -66,12 +179,38 @@
 
 /*!
  @abstract Returns an initialized tree that uses the specified selector to compare its objects.
- @discussion All objects added to the tree must respond to the specified selector.
+ @discussion All objects added to the tree must respond to the specified selector. The selector's implementation is
+     looked up once and invoked directly, so comparing objects of the same class does not send any messages. See
+     PGComparatorWithSelector for more information.
  @param selector The selector used to compare objects in the new tree. May not be NULL.
  @result A newly initialized tree or nil if selector is NULL.
  */
 - (id)initWithSelector:(SEL)selector;
 
+/*!
+ @abstract Returns an initialized tree of NSNumbers ordered by their values.
+ @discussion Objects are ordered exactly as -compare: orders them, but integers and floating-point numbers are compared
+     directly rather than through -compare:. All objects added to the tree must be NSNumbers. See PGNumericComparator
+     for more information.
+ @result A newly initialized tree.
+ */
+- (id)initWithNumericKeys;
+
+/*!
+ @abstract Returns an initialized tree of NSStrings ordered using the specified string comparison options.
+ @discussion If options is NSLiteralSearch, strings are ordered by Unicode code point and compared without sending
+     -compare:options:, using memcmp when both strings are stored as ASCII. Otherwise, strings are compared using
+     -compare:options: with the specified options. All objects added to the tree must be NSStrings. See
+     PGStringComparatorWithOptions for more information.
+
+     Code point order is not the order that -compare:options: gives with NSLiteralSearch, which compares UTF-16 code
+     units. Characters outside the Basic Multilingual Plane, like most emoji, sort after U+E000 through U+FFFF in the
+     tree but before them with -compare:options:. Use a comparator block if the tree must match -compare:options:.
+ @param options The options used to compare strings in the new tree.
+ @result A newly initialized tree.
+ */
+- (id)initWithStringKeysUsingOptions:(NSStringCompareOptions)options;
+
 /*!
  @abstract Returns an initialized tree that uses the specified block to compare its objects.
  @param comparator The block used to compare objects in the new tree. This block follows the same conventions as comparator
@@ -80,6 +219,88 @@
  */
 - (id)initWithComparator:(NSComparator)comparator;
 
+/*!
+ @abstract Returns an initialized tree that uses compare: as its selector and has room for the specified number of objects.
+ @discussion All objects added to the tree must respond to compare:. The tree allocates its nodes out of large slabs of
+     memory. This method allocates enough space for capacity objects up front so that they can be added without any
+     further allocation.
+ @param capacity The number of objects for which space should be reserved.
+ @result A newly initialized tree.
+ */
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/*!
+ @abstract Returns an initialized tree that uses compare: as its selector and holds no more than the specified number of
+     objects.
+ @discussion See -initWithComparator:maximumCount:evict: for more information.
+ @param maximumCount The maximum number of objects the tree holds.
+ @param eviction Which objects the tree evicts when it is over its maximum count.
+ @result A newly initialized tree.
+ */
+- (id)initWithMaximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified block to compare its objects and holds no more than the
+     specified number of objects.
+ @discussion Whenever adding objects to the tree (including by joining or unioning other trees with it) takes it over
+     its maximum count, the tree evicts its first or last objects until it is back at the maximum. This makes it easy
+     to keep the k largest or smallest objects from a stream. When the tree is full, -addObject: compares a new object
+     to the one it would evict, and if the new object would be evicted immediately, it isn't added at all.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @param maximumCount The maximum number of objects the tree holds.
+ @param eviction Which objects the tree evicts when it is over its maximum count. If this is PGRedBlackTreeEvictionNone,
+     maximumCount is ignored.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator maximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified block to compare its objects and contains copies of the
+     objects in the specified array, which must already be sorted using that block.
+ @discussion The tree is built directly from the sorted objects in linear time without invoking the comparator at all.
+     The resulting tree is perfectly balanced. Because the comparator is never invoked, the array is not checked to
+     ensure that it is sorted. If it isn't, the tree's behavior is undefined.
+ @param array The objects to add to the tree, sorted in ascending order according to comparator.
+ @param comparator The block used to compare objects in the new tree. May not be nil.
+ @result A newly initialized tree containing copies of the objects in array or nil if comparator is nil.
+ */
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator;
+
+/*!
+ @abstract Returns an initialized tree that uses the specified block to compare its objects and has room for the
+     specified number of objects.
+ @discussion This is the designated initializer.
+ @param comparator The block used to compare objects in the new tree. This block follows the same conventions as comparator
+     blocks in Foundation. May not be nil.
+ @param capacity The number of objects for which space should be reserved.
+ @result A newly initialized tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator capacity:(NSUInteger)capacity;
+
+/*!
+ @abstract Creates and returns a tree containing the objects in the specified archive.
+ @discussion See -initWithContentsOfFile:comparator:error: for more information.
+ @param path The path of an archive written by -writeToFile:error:.
+ @param comparator The comparator the archived tree used. May not be nil.
+ @param error On failure, set to an error describing the problem. May be NULL.
+ @result A new tree containing the archived objects, or nil if comparator is nil or the archive could not be read.
+ */
++ (PGRedBlackTree *)treeWithContentsOfFile:(NSString *)path comparator:(NSComparator)comparator error:(NSError **)error;
+
+/*!
+ @abstract Returns an initialized tree containing the objects in the specified archive.
+ @discussion The archive is memory-mapped and its objects are already sorted, so the tree is built in O(n) time. The
+     comparator is only used to check that each object is ordered after the one before it, which takes n - 1
+     comparisons. If the comparator doesn't order the archive's objects the same way as the comparator of the tree that
+     was archived, or the archive is damaged, reading it fails with PGRedBlackTreeArchiveErrorInvalidFile.
+ @param path The path of an archive written by -writeToFile:error:.
+ @param comparator The comparator the archived tree used. May not be nil.
+ @param error On failure, set to an error describing the problem. May be NULL.
+ @result A newly initialized tree containing the archived objects, or nil if comparator is nil or the archive could not
+     be read.
+ */
+- (id)initWithContentsOfFile:(NSString *)path comparator:(NSComparator)comparator error:(NSError **)error;
+
 /*!
  @abstract Returns the number of objects in the tree.
  @result The number of items in the tree.
@@ -98,14 +319,46 @@
  */
 - (void)addObject:(id <NSCopying>)object;
 
+/*!
+ @abstract Adds a copy of the specified object to the tree, starting the search for its position at a cursor.
+ @discussion This is useful when adding objects in or near sorted order, e.g., timestamps that mostly increase. If the
+     object belongs immediately before or after the cursor's position, it is added using at most two comparisons rather
+     than O(log n). The farther the object's position is from the cursor, the more comparisons it takes, up to about
+     twice as many as -addObject:. After the object is added, the cursor is positioned at it, so the same cursor can
+     be passed to each addition in a sequence.
+
+     Even without a hint, an object that is greater than or equal to the tree's last object is added using a single
+     comparison.
+ @param object The object whose copy will be added. May not be nil.
+ @param hint A cursor positioned near where the object belongs, e.g., at the previous object added or at the result of
+     a seek. If hint is nil, belongs to another tree, or is invalid because the tree was mutated since it was
+     positioned, this method behaves like -addObject:. If the object is not added because it would immediately be
+     evicted, the cursor is not moved.
+ @throws NSInvalidArgumentException if object is nil
+ */
+- (void)addObject:(id <NSCopying>)object hint:(PGRedBlackTreeCursor *)hint;
+
 /*!
  @abstract Adds a copy of each object in the specified array to the tree. 
- @discussion If array is nil, this method does nothing. Otherwise, it simply repeatedly invokes addObject: on the
-     tree using the objects in array.
+ @discussion Equivalent to invoking -addObjectsFromArray:sorted: with NO.
  @param array The array to add objects from
  */
 - (void)addObjectsFromArray:(NSArray *)array;
 
+/*!
+ @abstract Adds a copy of each object in the specified array to the tree in a single batch.
+ @discussion If array is nil or empty, this method does nothing. Unless sorted is YES, the objects are first sorted once
+     using the tree's comparator. If the tree is empty, it is then built directly from the sorted objects. If the batch
+     is at least as large as the tree, the tree's objects and the batch are merged and the tree is rebuilt. Otherwise,
+     each object is inserted starting from where the previous one was, rather than from the root. All of these take
+     considerably fewer comparisons than adding the objects one at a time. Equal objects end up in the same order they
+     would have if they had been added one at a time.
+ @param array The array to add objects from
+ @param sorted Whether array is already sorted according to the tree's comparator. If this is YES and the array is not
+     sorted, the tree's behavior is undefined.
+ */
+- (void)addObjectsFromArray:(NSArray *)array sorted:(BOOL)sorted;
+
 /*!
  @abstract Returns whether an object equivalent to the one specified is in the tree.
  @discussion This method returns YES if and only if [tree member:object] returns a valid object.
@@ -141,11 +394,126 @@
  */
 - (void)removeObject:(id)object;
 
+/*!
+ @abstract Removes and returns the first object in the tree.
+ @discussion The tree keeps track of its first and last nodes, so this unlinks the first node directly without
+     searching for it. Together with -addObject:, this lets the tree serve as a priority queue.
+ @result The object that was removed, or nil if the tree is empty.
+ */
+- (id)popFirstObject;
+
+/*!
+ @abstract Removes and returns the last object in the tree.
+ @discussion See -popFirstObject.
+ @result The object that was removed, or nil if the tree is empty.
+ */
+- (id)popLastObject;
+
+/*!
+ @abstract Removes the objects in the specified array from the tree in a single batch.
+ @discussion This has the same effect as invoking -removeObject: with each object in array, except that the batch is
+     sorted once and the objects are found in a single pass over the tree, with each search starting where the previous
+     one ended. If an object is in array multiple times, that many equivalent objects are removed from the tree. Objects
+     that are not in the tree are ignored.
+ @param array The array of objects to remove.
+ */
+- (void)removeObjectsInArray:(NSArray *)array;
+
 /*!
  @abstract Removes all objects from the tree.
+ @discussion This releases every object in the tree and frees the memory used to store them.
  */
 - (void)removeAllObjects;
 
+/*!
+ @abstract Removes the objects in the tree that are less than the specified object.
+ @discussion Rather than removing the objects one at a time, this splits them out of the tree in O(log n) time and
+     then frees them.
+ @param object The object to compare against. If nil, this method does nothing.
+ */
+- (void)removeObjectsLessThanObject:(id)object;
+
+/*!
+ @abstract Removes the objects in the tree that are greater than or equal to one object and less than another.
+ @discussion Rather than removing the objects one at a time, this splits them out of the tree and joins the rest back
+     together in O(log n) time and then frees them.
+ @param fromObject The lower bound, which is inclusive. If nil, there is no lower bound.
+ @param toObject The upper bound, which is exclusive. If nil, there is no upper bound.
+ */
+- (void)removeObjectsInRangeFromObject:(id)fromObject toObject:(id)toObject;
+
+/*!
+ @abstract Moves the objects in the tree that are greater than or equal to the specified object into a new tree.
+ @discussion This takes O(log n) time. Unless all or none of the objects move, the two trees share the memory used to
+     store their objects, so allocation in either tree takes a lock until one of them is deallocated.
+ @param object The object at which to split the tree. May not be nil.
+ @result A new tree that uses the receiver's comparator and contains the objects that were greater than or equal to
+     object. The receiver is left with the objects less than object.
+ @throws NSInvalidArgumentException if object is nil.
+ */
+- (PGRedBlackTree *)splitAtObject:(id)object;
+
+/*!
+ @abstract Moves all of the objects in the specified tree to the end of the receiver.
+ @discussion Every object in tree must be greater than or equal to every object in the receiver. If tree was split from
+     the receiver or shares memory with it, this takes O(log n) time. Otherwise, tree's objects must first be copied,
+     which takes O(m) time. Either way, tree is empty afterward.
+ @param tree The tree whose objects should be moved to the receiver.
+ @throws NSInvalidArgumentException if tree is the receiver or its objects do not all follow the receiver's.
+ */
+- (void)joinWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Adds the objects in the specified tree that are not equal to any object in the receiver.
+ @discussion Objects are considered equal if the receiver's comparator returns NSOrderedSame when comparing them. Both
+     trees should order their objects the same way. Rather than adding objects one at a time, this uses a divide-and-
+     conquer algorithm based on splitting and joining subtrees, which takes O(m log(n/m + 1)) time, where m and n are
+     the sizes of the smaller and larger trees, plus O(m) to copy the other tree's nodes. Large trees are processed
+     concurrently on multiple threads, so the comparator must be safe to invoke from multiple threads at once. The
+     added objects are shared with, not copied from, the other tree.
+ @param tree The tree whose objects should be added. It is not modified.
+ */
+- (void)unionWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Removes the objects in the receiver that are not equal to any object in the specified tree.
+ @discussion See -unionWithTree: for a discussion of equality, performance, and concurrency.
+ @param tree The tree to intersect with. It is not modified. If it is nil, all objects are removed.
+ */
+- (void)intersectWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Removes the objects in the receiver that are equal to any object in the specified tree.
+ @discussion See -unionWithTree: for a discussion of equality, performance, and concurrency.
+ @param tree The tree whose objects should be removed. It is not modified.
+ */
+- (void)minusTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Returns a new tree containing the receiver's objects and the objects in the specified tree that are not
+     equal to any of them.
+ @discussion See -unionWithTree:.
+ @param tree The tree whose objects should be added. It is not modified.
+ @result A new tree that uses the receiver's comparator.
+ */
+- (PGRedBlackTree *)treeByUnioningWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Returns a new tree containing the receiver's objects that are equal to some object in the specified tree.
+ @discussion See -intersectWithTree:.
+ @param tree The tree to intersect with. It is not modified.
+ @result A new tree that uses the receiver's comparator.
+ */
+- (PGRedBlackTree *)treeByIntersectingWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Returns a new tree containing the receiver's objects that are not equal to any object in the specified tree.
+ @discussion See -minusTree:.
+ @param tree The tree whose objects should be excluded. It is not modified.
+ @result A new tree that uses the receiver's comparator.
+ */
+- (PGRedBlackTree *)treeBySubtractingTree:(PGRedBlackTree *)tree;
+
 /*!
  @abstract Executes the specified block using each object in the tree in ascending order according to the tree's comparator.
  @param block The block to apply to the elements in the tree. May not be nil. The block takes two arguments:
@@ -156,6 +524,29 @@
  */
 - (void)enumerateObjectsUsingBlock:(void (^)(id obj, BOOL *stop))block;
 
+/*!
+ @abstract Executes the specified block using each object in the tree that lies between two bounds.
+ @discussion The tree seeks directly to the first object within the bounds and then visits objects in order until it
+     passes the other bound, so this takes O(log n + k) time, where k is the number of objects visited. Objects are
+     visited in ascending order according to the tree's comparator unless options includes NSEnumerationReverse, in
+     which case they are visited in descending order starting with the object nearest the upper bound. This makes it
+     cheap to find the last few objects before a given object.
+ @param fromObject The lower bound. If nil, there is no lower bound.
+ @param fromInclusive Whether objects equal to fromObject according to the tree's comparator should be visited.
+ @param toObject The upper bound. If nil, there is no upper bound.
+ @param toInclusive Whether objects equal to toObject according to the tree's comparator should be visited.
+ @param options A bitmask that specifies the options for the enumeration. Only NSEnumerationReverse is supported.
+ @param block The block to apply to the elements in the tree. May not be nil. The block takes two arguments:
+ @param obj The element in the tree.
+ @param stop A reference to a Boolean value. The block can set the value to YES to stop further processing of the tree. The
+     stop argument is an out-only argument. You should only ever set this Boolean to YES within the block.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id obj, BOOL *stop))block;
+
 /*!
  @abstract Executes the specified block using each object in the tree that is less than the specified object in ascending
      order according to the tree's comparator.
@@ -214,7 +605,7 @@
 /*!
  @abstract Returns the first object in the tree.
  @discussion This object is guaranteed to be less than or equal to every other object in the tree according to the tree's 
-     comparator.
+     comparator. The tree keeps track of its first node, so this usually takes O(1) time.
  @result The first object in the tree, or nil if the tree is empty.
  */
 - (id)firstObject;
@@ -222,11 +613,93 @@
 /*!
  @abstract Returns the last object in the tree.
  @discussion This object is guaranteed to be greater than or equal to every other object in the tree according to the tree's
-     comparator.
+     comparator. The tree keeps track of its last node, so this usually takes O(1) time.
  @result The last object in the tree, or nil if the tree is empty.
  */
 - (id)lastObject;
 
+/*!
+ @abstract Returns the object at the specified index in the tree's ascending order.
+ @discussion Every node in the tree keeps track of the number of nodes in its subtree, so this takes O(log n) time.
+ @param index An index within the bounds of the tree.
+ @throws NSRangeException if index is greater than or equal to the tree's count.
+ @result The object at index.
+ */
+- (id)objectAtIndex:(NSUInteger)index;
+
+/*!
+ @abstract Returns the index of the object returned by -member: in the tree's ascending order.
+ @param object The object whose index is being requested.
+ @result The index of the tree's object that is equivalent to the one specified, or NSNotFound if there is no such
+     object.
+ */
+- (NSUInteger)indexOfObject:(id)object;
+
+/*!
+ @abstract Returns the objects whose indexes are in the specified range in ascending order according to the tree's
+     comparator.
+ @param range A range within the bounds of the tree.
+ @throws NSRangeException if range is not within the bounds of the tree.
+ @result The objects in the specified range.
+ */
+- (NSArray *)objectsInRange:(NSRange)range;
+
+/*!
+ @abstract Returns the number of objects in the tree that are less than the specified object according to the tree's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ @result The number of objects in the tree that are less than the specified object.
+ */
+- (NSUInteger)countOfObjectsLessThanObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are less than or equal to the specified object according to
+     the tree's comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ @result The number of objects in the tree that are less than or equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are equal to the specified object according to the tree's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ @result The number of objects in the tree that are equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are greater than or equal to the specified object according
+     to the tree's comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ @result The number of objects in the tree that are greater than or equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are greater than the specified object according to the tree's
+     comparator.
+ @discussion This takes O(log n) time and does not enumerate the objects being counted.
+ @result The number of objects in the tree that are greater than the specified object.
+ */
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object;
+
+/*!
+ @abstract Copies the objects whose indexes are in the specified range into a C array.
+ @discussion The objects are copied in ascending order according to the tree's comparator. They are not retained.
+ @param objects A C array of objects of size at least the length of the range specified by range.
+ @param range A range within the bounds of the tree.
+ @throws NSRangeException if range is not within the bounds of the tree.
+ */
+- (void)getObjects:(id *)objects range:(NSRange)range;
+
+/*!
+ @abstract Returns a new cursor positioned at the tree's first object.
+ @discussion See PGRedBlackTreeCursor for more information.
+ @result A new cursor for the tree.
+ */
+- (PGRedBlackTreeCursor *)cursor;
+
 /*!
  @abstract Returns all in the tree in ascending order according to the tree's comparator.
  */
@@ -275,4 +748,44 @@
  */
 - (NSArray *)objectsGreaterThanObject:(id)object;
 
+/*!
+ @abstract Writes the tree's objects to a binary archive at the specified path.
+ @discussion The archive consists of a fixed-size header, an array of fixed-size entries in ascending order, and a payload
+     region holding the bytes of strings and data that the entries refer to by offset. NSNumbers are stored directly in
+     their entries. Objects are streamed to the file in order as the tree is traversed. The archive is written to a
+     temporary file that replaces the file at path only once it is complete.
+
+     Archives use the writing machine's byte order and can only be read by machines with the same byte order.
+ @param path The path at which to write the archive.
+ @param error On failure, set to an error describing the problem. May be NULL.
+ @result Whether the archive was written. Fails with PGRedBlackTreeArchiveErrorUnsupportedObject if the tree contains
+     an object that is not an NSNumber, NSString, or NSData.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error;
+
+/*!
+ @abstract Returns an immutable, read-optimized copy of the tree.
+ @discussion The frozen set shares the tree's objects and answers the same membership, order statistic, and range
+     queries as the tree. It is built in O(n) time and is not affected by later changes to the tree. See
+     PGFrozenSortedSet for more information.
+ @result A frozen sorted set containing the tree's objects.
+ */
+- (PGFrozenSortedSet *)frozenCopy;
+
+/*!
+ @abstract Returns a snapshot of statistics about the tree's shape and operations.
+ @discussion See PGRedBlackTreeStatisticsHeightKey and related keys for the contents of the dictionary. Computing the
+     shape statistics takes O(n) time. Operation counters are compiled out unless PG_RED_BLACK_TREE_STATISTICS is defined
+     to 1, in which case they cost an increment per comparison, rotation, fixup iteration, and node allocation or free.
+     Counts made while set operations run concurrently are approximate.
+ @result A dictionary of statistics about the tree.
+ */
+- (NSDictionary *)statistics;
+
+/*!
+ @abstract Resets the tree's operation counters to zero.
+ @discussion Does nothing unless the tree is built with PG_RED_BLACK_TREE_STATISTICS defined to 1.
+ */
+- (void)resetStatistics;
+
 @end
@@ -26,11 +26,33 @@
 
 #import "PGRedBlackTree.h"
 
+#import "PGComparators.h"
+#import "PGFrozenSortedSet.h"
+#import "PGRedBlackTreeCursor.h"
 #import "PGRedBlackTreeNode.h"
+#import "PGRedBlackTreeNodeHashTable.h"
 #import "PGUtilities.h"
 
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
 
-#pragma mark Red-Black Tree Properties
+
+#pragma mark Constants
+
+NSString *const PGRedBlackTreeStatisticsComparisonCountKey = @"PGRedBlackTreeStatisticsComparisonCount";
+NSString *const PGRedBlackTreeStatisticsRotationCountKey = @"PGRedBlackTreeStatisticsRotationCount";
+NSString *const PGRedBlackTreeStatisticsInsertionFixupIterationCountKey = @"PGRedBlackTreeStatisticsInsertionFixupIterationCount";
+NSString *const PGRedBlackTreeStatisticsRemovalFixupIterationCountKey = @"PGRedBlackTreeStatisticsRemovalFixupIterationCount";
+NSString *const PGRedBlackTreeStatisticsNodeAllocationCountKey = @"PGRedBlackTreeStatisticsNodeAllocationCount";
+NSString *const PGRedBlackTreeStatisticsNodeFreeCountKey = @"PGRedBlackTreeStatisticsNodeFreeCount";
+NSString *const PGRedBlackTreeStatisticsHeightKey = @"PGRedBlackTreeStatisticsHeight";
+NSString *const PGRedBlackTreeStatisticsBlackHeightKey = @"PGRedBlackTreeStatisticsBlackHeight";
+NSString *const PGRedBlackTreeStatisticsDepthHistogramKey = @"PGRedBlackTreeStatisticsDepthHistogram";
+
+
+#pragma mark - Red-Black Tree Properties
 
 // For reference, these are the five properties of red-black trees.
 //    1. A node is either red or black.
@@ -40,22 +62,346 @@
 //    5. Every simple path from a given node to any of its descendant leaves contains the same number of black nodes.
 
 
+#pragma mark - Private functions
+
+static int PGCompareIndexes(const void *a, const void *b)
+{
+    NSUInteger index1 = *(const NSUInteger *)a;
+    NSUInteger index2 = *(const NSUInteger *)b;
+    return index1 < index2 ? -1 : (index1 > index2 ? 1 : 0);
+}
+
+
+// Adds the number of nodes at each depth of node's subtree to histogram, which must have room for the subtree's height.
+// Red-black trees with n nodes are no more than 2 log2(n + 1) high, so this doesn't recurse deeply.
+static void PGAddNodeDepthsToHistogram(PGRedBlackTreeNode *node, NSUInteger depth, NSUInteger *histogram)
+{
+    if (PGRedBlackTreeNodeIsSentinel(node)) return;
+    ++histogram[depth];
+    PGAddNodeDepthsToHistogram(node->leftChild, depth + 1, histogram);
+    PGAddNodeDepthsToHistogram(node->rightChild, depth + 1, histogram);
+}
+
+
+#pragma mark - Archives
+
+// An archive is a header, followed by an entry for each object in ascending order, followed by a payload region. Entries
+// hold NSNumbers directly and refer to the UTF-8 bytes of strings and the bytes of data by their offset in the payload
+// region. Everything is fixed-size and naturally aligned, so a mapped archive can be read in place.
+static const char PGRedBlackTreeArchiveMagic[8] = { 'P', 'G', 'R', 'B', 'T', 'R', 'E', 'E' };
+static const uint32_t PGRedBlackTreeArchiveVersion = 1;
+static const uint32_t PGRedBlackTreeArchiveByteOrderMark = 0x01020304;
+static const size_t PGRedBlackTreeArchiveBufferSize = 1 << 20;
+
+typedef NS_ENUM(uint32_t, PGRedBlackTreeArchiveEntryType) {
+    PGRedBlackTreeArchiveEntryTypeInt64 = 1,
+    PGRedBlackTreeArchiveEntryTypeUInt64,
+    PGRedBlackTreeArchiveEntryTypeDouble,
+    PGRedBlackTreeArchiveEntryTypeString,
+    PGRedBlackTreeArchiveEntryTypeData
+};
+
+typedef struct _PGRedBlackTreeArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint64_t count;
+    uint64_t payloadLength;
+} PGRedBlackTreeArchiveHeader;
+
+typedef struct _PGRedBlackTreeArchiveEntry {
+    uint64_t value;
+    uint32_t length;
+    uint32_t type;
+} PGRedBlackTreeArchiveEntry;
+
+
+// Entries and payload bytes are buffered separately and written to their own regions of the file as the buffers fill
+typedef struct _PGRedBlackTreeArchiveWriter {
+    int fileDescriptor;
+    PGRedBlackTreeArchiveEntry *entries;
+    NSUInteger entryCount;
+    off_t entriesOffset;
+    uint8_t *payload;
+    NSUInteger payloadBufferLength;
+    off_t payloadOffset;
+    uint64_t payloadLength;
+} PGRedBlackTreeArchiveWriter;
+
+typedef NS_ENUM(NSUInteger, PGRedBlackTreeArchiveWriterStatus) {
+    PGRedBlackTreeArchiveWriterStatusSuccess,
+    PGRedBlackTreeArchiveWriterStatusUnsupportedObject,
+    PGRedBlackTreeArchiveWriterStatusWriteFailed
+};
+
+
+static BOOL PGRedBlackTreeArchiveWrite(int fileDescriptor, const void *bytes, size_t length, off_t offset)
+{
+    while (length > 0) {
+        ssize_t writtenLength = pwrite(fileDescriptor, bytes, length, offset);
+        if (writtenLength < 0) {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+
+        bytes = (const uint8_t *)bytes + writtenLength;
+        length -= writtenLength;
+        offset += writtenLength;
+    }
+
+    return YES;
+}
+
+
+static BOOL PGRedBlackTreeArchiveWriterFlush(PGRedBlackTreeArchiveWriter *writer)
+{
+    size_t entriesLength = writer->entryCount * sizeof(PGRedBlackTreeArchiveEntry);
+    if (!PGRedBlackTreeArchiveWrite(writer->fileDescriptor, writer->entries, entriesLength, writer->entriesOffset) ||
+        !PGRedBlackTreeArchiveWrite(writer->fileDescriptor, writer->payload, writer->payloadBufferLength, writer->payloadOffset)) {
+        return NO;
+    }
+
+    writer->entriesOffset += entriesLength;
+    writer->entryCount = 0;
+    writer->payloadOffset += writer->payloadBufferLength;
+    writer->payloadBufferLength = 0;
+    return YES;
+}
+
+
+// Makes room for length more payload bytes in the writer's buffer, flushing it if necessary
+static BOOL PGRedBlackTreeArchiveWriterReservePayload(PGRedBlackTreeArchiveWriter *writer, size_t length)
+{
+    return writer->payloadBufferLength + length <= PGRedBlackTreeArchiveBufferSize || PGRedBlackTreeArchiveWriterFlush(writer);
+}
+
+
+static PGRedBlackTreeArchiveWriterStatus PGRedBlackTreeArchiveWriterAppendObject(PGRedBlackTreeArchiveWriter *writer, id object)
+{
+    PGRedBlackTreeArchiveEntry entry = { 0, 0, 0 };
+
+    if ([object isKindOfClass:[NSNumber class]] && ![object isKindOfClass:[NSDecimalNumber class]]) {
+        const char *type = [object objCType];
+        if (strcmp(type, @encode(float)) == 0 || strcmp(type, @encode(double)) == 0) {
+            double value = [object doubleValue];
+            memcpy(&entry.value, &value, sizeof(value));
+            entry.type = PGRedBlackTreeArchiveEntryTypeDouble;
+        } else if (strchr("CSILQ", type[0]) && [object unsignedLongLongValue] > INT64_MAX) {
+            entry.value = [object unsignedLongLongValue];
+            entry.type = PGRedBlackTreeArchiveEntryTypeUInt64;
+        } else {
+            entry.value = (uint64_t)[object longLongValue];
+            entry.type = PGRedBlackTreeArchiveEntryTypeInt64;
+        }
+    } else if ([object isKindOfClass:[NSString class]]) {
+        // Encode the string directly into the payload buffer
+        NSUInteger maximumLength = [object maximumLengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        NSUInteger usedLength = 0;
+        if (maximumLength > PGRedBlackTreeArchiveBufferSize) {
+            // The string is too large for the buffer, so it can only be written directly
+            NSData *data = [object dataUsingEncoding:NSUTF8StringEncoding];
+            if (!data || [data length] > UINT32_MAX) return PGRedBlackTreeArchiveWriterStatusUnsupportedObject;
+            if (!PGRedBlackTreeArchiveWriterFlush(writer) ||
+                !PGRedBlackTreeArchiveWrite(writer->fileDescriptor, [data bytes], [data length], writer->payloadOffset)) {
+                return PGRedBlackTreeArchiveWriterStatusWriteFailed;
+            }
+
+            usedLength = [data length];
+            writer->payloadOffset += usedLength;
+        } else {
+            if (!PGRedBlackTreeArchiveWriterReservePayload(writer, maximumLength)) return PGRedBlackTreeArchiveWriterStatusWriteFailed;
+            if (![object getBytes:writer->payload + writer->payloadBufferLength maxLength:maximumLength usedLength:&usedLength
+                         encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, [object length]) remainingRange:NULL]) {
+                return PGRedBlackTreeArchiveWriterStatusUnsupportedObject;
+            }
+
+            writer->payloadBufferLength += usedLength;
+        }
+
+        entry.value = writer->payloadLength;
+        entry.length = (uint32_t)usedLength;
+        entry.type = PGRedBlackTreeArchiveEntryTypeString;
+        writer->payloadLength += usedLength;
+    } else if ([object isKindOfClass:[NSData class]]) {
+        NSUInteger length = [object length];
+        if (length > UINT32_MAX) return PGRedBlackTreeArchiveWriterStatusUnsupportedObject;
+
+        if (length > PGRedBlackTreeArchiveBufferSize) {
+            if (!PGRedBlackTreeArchiveWriterFlush(writer) ||
+                !PGRedBlackTreeArchiveWrite(writer->fileDescriptor, [object bytes], length, writer->payloadOffset)) {
+                return PGRedBlackTreeArchiveWriterStatusWriteFailed;
+            }
+
+            writer->payloadOffset += length;
+        } else {
+            if (!PGRedBlackTreeArchiveWriterReservePayload(writer, length)) return PGRedBlackTreeArchiveWriterStatusWriteFailed;
+            [object getBytes:writer->payload + writer->payloadBufferLength length:length];
+            writer->payloadBufferLength += length;
+        }
+
+        entry.value = writer->payloadLength;
+        entry.length = (uint32_t)length;
+        entry.type = PGRedBlackTreeArchiveEntryTypeData;
+        writer->payloadLength += length;
+    } else {
+        return PGRedBlackTreeArchiveWriterStatusUnsupportedObject;
+    }
+
+    if (writer->entryCount == PGRedBlackTreeArchiveBufferSize / sizeof(PGRedBlackTreeArchiveEntry) && !PGRedBlackTreeArchiveWriterFlush(writer)) {
+        return PGRedBlackTreeArchiveWriterStatusWriteFailed;
+    }
+
+    writer->entries[writer->entryCount++] = entry;
+    return PGRedBlackTreeArchiveWriterStatusSuccess;
+}
+
+
+// Creates the objects in the archive in bytes, which is length bytes long. Returns NO if the archive is invalid. The
+// objects are returned retained in a malloced array that the caller must free.
+static BOOL PGRedBlackTreeArchiveCreateObjects(const uint8_t *bytes, size_t length, id **outObjects, NSUInteger *outCount)
+{
+    PGRedBlackTreeArchiveHeader header;
+    if (length < sizeof(header)) return NO;
+    memcpy(&header, bytes, sizeof(header));
+
+    if (memcmp(header.magic, PGRedBlackTreeArchiveMagic, sizeof(header.magic)) != 0 || header.version != PGRedBlackTreeArchiveVersion ||
+        header.byteOrderMark != PGRedBlackTreeArchiveByteOrderMark) {
+        return NO;
+    }
+
+    size_t entriesLength = length - sizeof(header);
+    if (header.count > entriesLength / sizeof(PGRedBlackTreeArchiveEntry) ||
+        header.payloadLength != entriesLength - header.count * sizeof(PGRedBlackTreeArchiveEntry)) {
+        return NO;
+    }
+
+    NSUInteger count = (NSUInteger)header.count;
+    const PGRedBlackTreeArchiveEntry *entries = (const PGRedBlackTreeArchiveEntry *)(bytes + sizeof(header));
+    const uint8_t *payload = (const uint8_t *)(entries + count);
+    id *objects = malloc(MAX(count, 1) * sizeof(id));
+    if (!objects) return NO;
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        PGRedBlackTreeArchiveEntry entry = entries[i];
+        BOOL hasPayload = entry.type == PGRedBlackTreeArchiveEntryTypeString || entry.type == PGRedBlackTreeArchiveEntryTypeData;
+        if (hasPayload && (entry.value > header.payloadLength || entry.length > header.payloadLength - entry.value)) {
+            objects[i] = nil;
+        } else {
+            switch (entry.type) {
+                case PGRedBlackTreeArchiveEntryTypeInt64:
+                    objects[i] = [[NSNumber alloc] initWithLongLong:(long long)entry.value];
+                    break;
+                case PGRedBlackTreeArchiveEntryTypeUInt64:
+                    objects[i] = [[NSNumber alloc] initWithUnsignedLongLong:entry.value];
+                    break;
+                case PGRedBlackTreeArchiveEntryTypeDouble: {
+                    double value;
+                    memcpy(&value, &entry.value, sizeof(value));
+                    objects[i] = [[NSNumber alloc] initWithDouble:value];
+                    break;
+                }
+                case PGRedBlackTreeArchiveEntryTypeString:
+                    objects[i] = [[NSString alloc] initWithBytes:payload + entry.value length:entry.length encoding:NSUTF8StringEncoding];
+                    break;
+                case PGRedBlackTreeArchiveEntryTypeData:
+                    objects[i] = [[NSData alloc] initWithBytes:payload + entry.value length:entry.length];
+                    break;
+                default:
+                    objects[i] = nil;
+                    break;
+            }
+        }
+
+        if (!objects[i]) {
+            for (NSUInteger j = 0; j < i; ++j) {
+                [objects[j] release];
+            }
+
+            free(objects);
+            return NO;
+        }
+    }
+
+    *outObjects = objects;
+    *outCount = count;
+    return YES;
+}
+
+
+static NSError *PGRedBlackTreeArchivePOSIXError(NSString *path)
+{
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey : path }];
+}
+
+
 #pragma mark - Private interfaces
 
-@interface PGRedBlackTree ()
+@interface PGRedBlackTree () {
+    PGRedBlackTreeCore _core;
+    unsigned long _mutationCount;
+    BOOL _immutable;
+    BOOL _indexesObjects;
+
+    // The hash index is current when its mutation count matches ours. Mutations that don't update it leave it stale.
+    PGRedBlackTreeNodeHashTable *_nodeHashTable;
+    unsigned long _nodeHashTableMutationCount;
+
+    // The first and last nodes are cached the same way. They're NULL until they've been found.
+    PGRedBlackTreeNode *_firstNode;
+    PGRedBlackTreeNode *_lastNode;
+    unsigned long _extremeNodesMutationCount;
+
+#if PG_RED_BLACK_TREE_STATISTICS
+    // _comparator wraps _originalComparator so that it can count comparisons
+    NSComparator _comparator;
+    NSComparator _originalComparator;
+    PGRedBlackTreeStatistics _statistics;
+#endif
+}
 
 @property(readwrite, assign) NSUInteger count;
 @property(readwrite, assign) PGRedBlackTreeNode *root;
 @property(readwrite, copy) NSComparator comparator;
 
-- (PGRedBlackTreeNode *)insertNodeWithObject:(id)object;
-- (void)fixPropertiesAfterInsertionWithNode:(PGRedBlackTreeNode *)node;
-- (void)fixPropertiesAfterRemovalWithNode:(PGRedBlackTreeNode *)node;
+- (id)initWithObjectsInTree:(PGRedBlackTree *)tree immutable:(BOOL)immutable;
+- (id)initWithComparator:(NSComparator)comparator pool:(PGRedBlackTreeNodePool *)pool root:(PGRedBlackTreeNode *)root count:(NSUInteger)count;
+- (PGRedBlackTreeNode *)createNodesWithObjectsInTree:(PGRedBlackTree *)tree;
+- (void)throwIfImmutable:(SEL)selector;
+- (void)makeImmutable;
+
+- (BOOL)nodeHashTableIsCurrent;
+- (void)updateNodeHashTable;
+
+- (BOOL)extremeNodesAreCurrent;
+- (PGRedBlackTreeNode *)firstNode;
+- (PGRedBlackTreeNode *)lastNode;
+- (void)evictObjectsOverMaximumCount;
+
+- (void)addObjectsFromSortedArray:(NSArray *)array;
+- (void)mergeObjectsFromSortedArray:(NSArray *)array;
 
 - (PGRedBlackTreeNode *)nodeForObject:(id)object;
+- (void)removeNode:(PGRedBlackTreeNode *)node;
+- (void)removeObjectsFromIndex:(NSUInteger)fromIndex toIndex:(NSUInteger)toIndex;
+- (void)removeObjectsAtIndexes:(NSUInteger *)indexes count:(NSUInteger)count;
 
-- (NSArray *)enumeratedObjectsWithSelector:(SEL)selector object:(id)object;
+- (unsigned long *)mutationCountPointer;
 
+- (PGRedBlackTreeNode *)firstNodeFromObject:(id)object inclusive:(BOOL)inclusive;
+- (PGRedBlackTreeNode *)lastNodeToObject:(id)object inclusive:(BOOL)inclusive;
+- (NSArray *)objectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive toObject:(id)toObject inclusive:(BOOL)toInclusive;
+
+@end
+
+
+@interface PGRedBlackTreeCursor (TreeAccessors)
+- (PGRedBlackTreeNode *)currentNode;
+- (id)seekToNode:(PGRedBlackTreeNode *)node;
+@end
+
+
+@interface PGFrozenSortedSet (TreeInitialization)
+- (id)initWithObjects:(id const *)objects count:(NSUInteger)count comparator:(NSComparator)comparator copyObjects:(BOOL)copyObjects;
 @end
 
 
@@ -81,339 +427,1141 @@
 }
 
 
-+ (PGRedBlackTree *)treeWithComparator:(NSComparator)comparator
-{
-    return [[[self alloc] initWithComparator:comparator] autorelease];
++ (PGRedBlackTree *)treeWithComparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithComparator:comparator] autorelease];
+}
+
+
++ (PGRedBlackTree *)treeWithNumericKeys
+{
+    return [[[self alloc] initWithNumericKeys] autorelease];
+}
+
+
++ (PGRedBlackTree *)treeWithStringKeysUsingOptions:(NSStringCompareOptions)options
+{
+    return [[[self alloc] initWithStringKeysUsingOptions:options] autorelease];
+}
+
+
++ (PGRedBlackTree *)treeWithMaximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction
+{
+    return [[[self alloc] initWithMaximumCount:maximumCount evict:eviction] autorelease];
+}
+
+
++ (PGRedBlackTree *)treeWithArray:(NSArray *)array
+{
+    PGRedBlackTree *tree = [[[self alloc] initWithCapacity:[array count]] autorelease];
+    [tree addObjectsFromArray:array];
+    return tree;
+}
+
+
++ (PGRedBlackTree *)treeWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    return [[[self alloc] initWithSortedArray:array comparator:comparator] autorelease];
+}
+
+
++ (PGRedBlackTree *)treeWithContentsOfFile:(NSString *)path comparator:(NSComparator)comparator error:(NSError **)error
+{
+    return [[[self alloc] initWithContentsOfFile:path comparator:comparator error:error] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithSelector:@selector(compare:)];
+}
+
+
+- (id)initWithCapacity:(NSUInteger)capacity
+{
+    return [self initWithComparator:PGComparatorWithSelector(@selector(compare:)) capacity:capacity];
+}
+
+
+- (id)initWithSelector:(SEL)selector
+{
+    if (!selector) {
+        [self release];
+        return nil;
+    }
+
+    return [self initWithComparator:PGComparatorWithSelector(selector)];
+}
+
+
+- (id)initWithNumericKeys
+{
+    return [self initWithComparator:PGNumericComparator()];
+}
+
+
+- (id)initWithStringKeysUsingOptions:(NSStringCompareOptions)options
+{
+    return [self initWithComparator:PGStringComparatorWithOptions(options)];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator
+{
+    return [self initWithComparator:comparator capacity:0];
+}
+
+
+- (id)initWithMaximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction
+{
+    return [self initWithComparator:PGComparatorWithSelector(@selector(compare:)) maximumCount:maximumCount evict:eviction];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator maximumCount:(NSUInteger)maximumCount evict:(PGRedBlackTreeEviction)eviction
+{
+    self = [self initWithComparator:comparator capacity:0];
+    if (self && eviction != PGRedBlackTreeEvictionNone) {
+        _maximumCount = maximumCount;
+        _eviction = eviction;
+    }
+
+    return self;
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator capacity:(NSUInteger)capacity
+{
+    if (!comparator) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        [self setComparator:comparator];
+        _core.pool = PGRedBlackTreeNodePoolCreate(sizeof(PGRedBlackTreeNode), capacity);
+        _maximumCount = NSUIntegerMax;
+#if PG_RED_BLACK_TREE_STATISTICS
+        _core.statistics = &_statistics;
+#endif
+    }
+    
+    return self;
+}
+
+
+- (id)initWithSortedArray:(NSArray *)array comparator:(NSComparator)comparator
+{
+    self = [self initWithComparator:comparator capacity:[array count]];
+    if (self) {
+        [self addObjectsFromSortedArray:array];
+    }
+
+    return self;
+}
+
+
+- (id)initWithContentsOfFile:(NSString *)path comparator:(NSComparator)comparator error:(NSError **)error
+{
+    self = [self initWithComparator:comparator];
+    if (!self) return nil;
+
+    int fileDescriptor = open([path fileSystemRepresentation], O_RDONLY);
+    struct stat fileStatus;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) < 0) {
+        if (error) *error = PGRedBlackTreeArchivePOSIXError(path);
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        [self release];
+        return nil;
+    }
+
+    // The mapping remains valid after the file is closed
+    size_t length = (size_t)fileStatus.st_size;
+    void *bytes = length > 0 ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) : NULL;
+    if (bytes == MAP_FAILED) {
+        if (error) *error = PGRedBlackTreeArchivePOSIXError(path);
+        close(fileDescriptor);
+        [self release];
+        return nil;
+    }
+
+    close(fileDescriptor);
+
+    id *objects = NULL;
+    NSUInteger count = 0;
+    BOOL isValid = NO;
+    if (bytes) {
+        posix_madvise(bytes, length, POSIX_MADV_SEQUENTIAL);
+        isValid = PGRedBlackTreeArchiveCreateObjects(bytes, length, &objects, &count);
+        munmap(bytes, length);
+    }
+
+    // The tree is built in the archive's order, so make sure the comparator agrees with it. A different comparator or a
+    // damaged file would otherwise leave the tree silently out of order.
+    for (NSUInteger i = 1; isValid && i < count; ++i) {
+        isValid = _comparator(objects[i - 1], objects[i]) != NSOrderedDescending;
+    }
+
+    if (!isValid) {
+        for (NSUInteger i = 0; i < count; ++i) {
+            [objects[i] release];
+        }
+
+        free(objects);
+
+        if (error) {
+            *error = [NSError errorWithDomain:PGErrorDomain code:PGRedBlackTreeArchiveErrorInvalidFile
+                                     userInfo:@{ NSFilePathErrorKey : path,
+                                                 NSLocalizedDescriptionKey : @"The file is not a valid red-black tree archive." }];
+        }
+
+        [self release];
+        return nil;
+    }
+
+    // The archive's objects are already sorted, so we can build the tree directly
+    if (count > 0) {
+        PGRedBlackTreeNodePoolReserveCapacity(_core.pool, count);
+        [self setRoot:PGRedBlackTreeNodeCreateWithSortedObjects(_core.pool, objects, count)];
+        [self setCount:count];
+    }
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        [objects[i] release];
+    }
+
+    free(objects);
+    return self;
+}
+
+
+- (id)initWithObjectsInTree:(PGRedBlackTree *)tree immutable:(BOOL)immutable
+{
+    self = [self initWithComparator:[tree comparator] capacity:[tree count]];
+    if (self) {
+        [self setRoot:[self createNodesWithObjectsInTree:tree]];
+        [self setCount:[tree count]];
+        _immutable = immutable;
+    }
+
+    return self;
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator pool:(PGRedBlackTreeNodePool *)pool root:(PGRedBlackTreeNode *)root count:(NSUInteger)count
+{
+    self = [super init];
+    if (self) {
+        [self setComparator:comparator];
+        _core.pool = PGRedBlackTreeNodePoolRetain(pool);
+        _core.root = root;
+        _maximumCount = NSUIntegerMax;
+#if PG_RED_BLACK_TREE_STATISTICS
+        _core.statistics = &_statistics;
+#endif
+        [self setCount:count];
+    }
+
+    return self;
+}
+
+
+- (PGRedBlackTreeNode *)createNodesWithObjectsInTree:(PGRedBlackTree *)tree
+{
+    NSUInteger count = [tree count];
+    if (count == 0) return NULL;
+
+    // The tree's objects are already copies that it owns and are already sorted, so we can share them and build the
+    // nodes directly without copying or comparing anything
+    id *objects = malloc(count * sizeof(id));
+    if (!objects) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                     userInfo:nil];
+    }
+
+    [tree getObjects:objects range:NSMakeRange(0, count)];
+    PGRedBlackTreeNodePoolReserveCapacity(_core.pool, count);
+    PGRedBlackTreeNode *root = PGRedBlackTreeNodeCreateWithSortedObjects(_core.pool, objects, count);
+    free(objects);
+    return root;
+}
+
+
+- (void)dealloc
+{
+    PGRedBlackTreeNodePoolRelease(_core.pool, _core.root);
+    PGRedBlackTreeNodeHashTableFree(_nodeHashTable);
+    [_comparator release];    
+#if PG_RED_BLACK_TREE_STATISTICS
+    [_originalComparator release];
+#endif
+    [super dealloc];
+}
+
+
+#if PG_RED_BLACK_TREE_STATISTICS
+- (NSComparator)comparator
+{
+    return _originalComparator;
+}
+
+
+- (void)setComparator:(NSComparator)comparator
+{
+    // The wrapper refers to our statistics directly, so it must never be handed to anything that might outlive us.
+    // -comparator returns the original instead.
+    [_originalComparator release];
+    _originalComparator = [comparator copy];
+
+    PGRedBlackTreeStatistics *statistics = &_statistics;
+    [_comparator release];
+    _comparator = [^NSComparisonResult(id object1, id object2) {
+        // Comparators are called from several threads at once by parallel set operations and concurrent readers
+        __atomic_fetch_add(&statistics->comparisonCount, 1, __ATOMIC_RELAXED);
+        return comparator(object1, object2);
+    } copy];
+}
+#endif
+
+
+- (PGRedBlackTreeNode *)root
+{
+    return _core.root;
+}
+
+
+- (void)setRoot:(PGRedBlackTreeNode *)root
+{
+    _core.root = root;
+}
+
+
+- (void)throwIfImmutable:(SEL)selector
+{
+    if (_immutable) {
+        @throw [NSException exceptionWithName:NSInternalInconsistencyException
+                                       reason:PGExceptionString(self, selector, @"Cannot mutate an immutable tree.")
+                                     userInfo:nil];
+    }
+}
+
+
+- (void)makeImmutable
+{
+    _immutable = YES;
+    if (_indexesObjects) [self updateNodeHashTable];
+}
+
+
+#pragma mark - Hash index
+
+- (BOOL)indexesObjects
+{
+    return _indexesObjects;
+}
+
+
+- (void)setIndexesObjects:(BOOL)indexesObjects
+{
+    _indexesObjects = indexesObjects;
+    if (!indexesObjects) {
+        PGRedBlackTreeNodeHashTableFree(_nodeHashTable);
+        _nodeHashTable = NULL;
+    } else if (_immutable) {
+        // Immutable trees may be read from several threads at once, so their index is built now rather than lazily
+        [self updateNodeHashTable];
+    }
+}
+
+
+- (BOOL)nodeHashTableIsCurrent
+{
+    return _nodeHashTable && _nodeHashTableMutationCount == _mutationCount;
+}
+
+
+- (void)updateNodeHashTable
+{
+    if ([self nodeHashTableIsCurrent]) return;
+
+    if (_nodeHashTable) {
+        PGRedBlackTreeNodeHashTableRemoveAllNodes(_nodeHashTable);
+    } else {
+        _nodeHashTable = PGRedBlackTreeNodeHashTableCreate(_count);
+    }
+
+    if (!_nodeHashTable || !PGRedBlackTreeNodeHashTableAddSubnodes(_nodeHashTable, _core.root)) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate object index for %lu objects.", (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    _nodeHashTableMutationCount = _mutationCount;
+}
+
+
+#pragma mark - First and last nodes
+
+- (BOOL)extremeNodesAreCurrent
+{
+    return _extremeNodesMutationCount == _mutationCount && (_firstNode || !_core.root);
+}
+
+
+- (PGRedBlackTreeNode *)firstNode
+{
+    if (!_core.root) return NULL;
+
+    // Immutable trees may be read from several threads at once, so they don't cache anything
+    if (_immutable) return PGRedBlackTreeNodeLeftmostSubnode(_core.root);
+    if (![self extremeNodesAreCurrent]) {
+        _firstNode = PGRedBlackTreeNodeLeftmostSubnode(_core.root);
+        _lastNode = PGRedBlackTreeNodeRightmostSubnode(_core.root);
+        _extremeNodesMutationCount = _mutationCount;
+    }
+
+    return _firstNode;
+}
+
+
+- (PGRedBlackTreeNode *)lastNode
+{
+    if (!_core.root) return NULL;
+    if (_immutable) return PGRedBlackTreeNodeRightmostSubnode(_core.root);
+    [self firstNode];
+    return _lastNode;
+}
+
+
+- (NSString *)debugDescription
+{
+    if (!_core.root) return @"<tree></tree>";
+    NSMutableString *description = [NSMutableString stringWithString:@"<tree>\n"];
+    PGRedBlackTreeNodeAppendDebugDescription(_core.root, description, 1);
+    [description appendString:@"</tree>\n"];
+    return description;
+}
+
+
+#pragma mark - Insertion
+
+- (void)addObject:(id)object
+{
+    [self throwIfImmutable:_cmd];
+    [self addObject:object hint:nil];
+}
+
+
+- (void)addObject:(id)object hint:(PGRedBlackTreeCursor *)hint
+{
+    [self throwIfImmutable:_cmd];
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    }
+    
+    // If we're full and the object would be the one we evict, there's no point in adding it. Equal objects are added
+    // after the ones already in the tree, so a new object equal to our first object still gets added.
+    if (_count >= _maximumCount) {
+        if (_maximumCount == 0) return;
+        if (_eviction == PGRedBlackTreeEvictionFirstObject && _comparator(object, [self firstNode]->object) < NSOrderedSame) return;
+        if (_eviction == PGRedBlackTreeEvictionLastObject && _comparator(object, [self lastNode]->object) >= NSOrderedSame) return;
+    }
+
+    BOOL updatesNodeHashTable = [self nodeHashTableIsCurrent];
+
+    // Start searching from the hint if it's still positioned in this tree. Otherwise, objects greater than or equal to
+    // our last object are appended after it with a single comparison, and anything else is inserted by searching from
+    // the root, which costs just that one comparison more than it would have.
+    if ([hint tree] != self) hint = nil;
+    PGRedBlackTreeNode *hintNode = [hint currentNode];
+    PGRedBlackTreeNode *lastNode = hintNode ? NULL : [self lastNode];
+    BOOL updatesExtremeNodes = [self extremeNodesAreCurrent];
+
+    object = [object copy];
+    PGRedBlackTreeNode *node = NULL;
+    if (lastNode && _comparator(object, lastNode->object) >= NSOrderedSame) {
+        node = PGRedBlackTreeNodeInsertObjectAfterNodeInTree(object, lastNode, &_core);
+    } else {
+        node = PGRedBlackTreeNodeInsertObjectNearNodeInTree(object, hintNode, &_core, _comparator);
+    }
+    [object release];
+
+    // Before rebalancing, a new first or last node is the left or right child of the old one
+    if (updatesExtremeNodes) {
+        if (!_firstNode || (node->parent == _firstNode && PGRedBlackTreeNodeIsLeftChild(node))) _firstNode = node;
+        if (!_lastNode || (node->parent == _lastNode && PGRedBlackTreeNodeIsRightChild(node))) _lastNode = node;
+    }
+
+    PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(node, &_core);
+    [self setCount:_count + 1];
+    ++_mutationCount;
+
+    // Rebalancing moves nodes, not objects, so node still holds the new object. If the index can't grow, we leave it
+    // out of date rather than throw with the insertion half done; the next lookup rebuilds it or throws.
+    if (updatesNodeHashTable && PGRedBlackTreeNodeHashTableAddNode(_nodeHashTable, node)) {
+        _nodeHashTableMutationCount = _mutationCount;
+    }
+
+    if (updatesExtremeNodes) _extremeNodesMutationCount = _mutationCount;
+    [self evictObjectsOverMaximumCount];
+
+    // Evicting one object never removes or moves the new one, so node still holds it
+    [hint seekToNode:node];
+}
+
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+    [self throwIfImmutable:_cmd];
+    [self addObjectsFromArray:array sorted:NO];
+}
+
+
+- (void)addObjectsFromArray:(NSArray *)array sorted:(BOOL)sorted
+{
+    [self throwIfImmutable:_cmd];
+    NSUInteger count = [array count];
+    if (count == 0) return;
+
+    // The sort must be stable so that equal objects end up in the same order they would have if they had been inserted
+    // one at a time
+    if (!sorted) {
+        array = [array sortedArrayWithOptions:NSSortStable usingComparator:_comparator];
+    }
+
+    // If we're empty, just build the tree directly. If the batch is at least as big as we are, merging our objects with
+    // the batch and rebuilding takes fewer comparisons than inserting each object.
+    if (!_core.root) {
+        [self addObjectsFromSortedArray:array];
+    } else if (count >= _count) {
+        [self mergeObjectsFromSortedArray:array];
+    } else {
+        // Otherwise, start each insertion from the node we inserted before it. Since the batch is sorted, the next
+        // insertion point is usually close by, so we rarely have to search from anywhere near the root.
+        PGRedBlackTreeNodePoolReserveCapacity(_core.pool, count);
+        PGRedBlackTreeNode *node = NULL;
+        for (id object in array) {
+            id copy = [object copy];
+            node = PGRedBlackTreeNodeInsertObjectNearNodeInTree(copy, node, &_core, _comparator);
+            PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(node, &_core);
+            [copy release];
+        }
+
+        [self setCount:_count + count];
+        ++_mutationCount;
+    }
+
+    [self evictObjectsOverMaximumCount];
+}
+
+
+- (void)addObjectsFromSortedArray:(NSArray *)array
+{
+    NSAssert(!_core.root, PGAssertionString(self, _cmd, @"Cannot build a tree that already has objects."));
+
+    NSUInteger count = [array count];
+    if (count == 0) return;
+
+    id *objects = malloc(count * sizeof(id));
+    if (!objects) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                     userInfo:nil];
+    }
+
+    // Like -addObject:, we store copies of the objects
+    [array getObjects:objects range:NSMakeRange(0, count)];
+    for (NSUInteger i = 0; i < count; ++i) {
+        objects[i] = [objects[i] copy];
+    }
+
+    PGRedBlackTreeNodePoolReserveCapacity(_core.pool, count);
+    [self setRoot:PGRedBlackTreeNodeCreateWithSortedObjects(_core.pool, objects, count)];
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        [objects[i] release];
+    }
+
+    free(objects);
+    [self setCount:count];
+    ++_mutationCount;
+}
+
+
+- (void)mergeObjectsFromSortedArray:(NSArray *)array
+{
+    NSUInteger count = [array count];
+    NSUInteger totalCount = _count + count;
+    id *objects = malloc(totalCount * sizeof(id));
+    id *treeObjects = malloc(_count * sizeof(id));
+    id *arrayObjects = malloc(count * sizeof(id));
+    if (!objects || !treeObjects || !arrayObjects) {
+        free(objects);
+        free(treeObjects);
+        free(arrayObjects);
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                     userInfo:nil];
+    }
+
+    [self getObjects:treeObjects range:NSMakeRange(0, _count)];
+    [array getObjects:arrayObjects range:NSMakeRange(0, count)];
+
+    // Merge the two sorted sequences. Our objects go before new objects they're equal to, just as if the new objects had
+    // been inserted one at a time. We retain everything we keep because removing our nodes releases our objects.
+    NSUInteger i = 0, j = 0, k = 0;
+    while (i < _count && j < count) {
+        if (_comparator(arrayObjects[j], treeObjects[i]) < NSOrderedSame) {
+            objects[k++] = [arrayObjects[j++] copy];
+        } else {
+            objects[k++] = [treeObjects[i++] retain];
+        }
+    }
+
+    while (i < _count) objects[k++] = [treeObjects[i++] retain];
+    while (j < count) objects[k++] = [arrayObjects[j++] copy];
+
+    PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+    PGRedBlackTreeNodePoolReserveCapacity(_core.pool, totalCount);
+    [self setRoot:PGRedBlackTreeNodeCreateWithSortedObjects(_core.pool, objects, totalCount)];
+
+    for (k = 0; k < totalCount; ++k) {
+        [objects[k] release];
+    }
+
+    free(objects);
+    free(treeObjects);
+    free(arrayObjects);
+    [self setCount:totalCount];
+    ++_mutationCount;
+}
+    
+
+#pragma mark - Membership
+
+- (BOOL)containsObject:(id)object
+{
+    return [self member:object] != nil;
+}
+
+
+- (id)member:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForObject:object];
+    return node ? PGRedBlackTreeNodeGetObject(node) : nil;
+}
+
+
+- (PGRedBlackTreeNode *)nodeForObject:(id)object
+{
+    if (!object || !_core.root) return NULL;
+    if (_indexesObjects) {
+        // An immutable tree's index was built when it was enabled or when the tree became immutable
+        if (!_immutable) [self updateNodeHashTable];
+        return PGRedBlackTreeNodeHashTableNodeForObject(_nodeHashTable, object);
+    }
+
+    __block PGRedBlackTreeNode *node = NULL;
+    
+    PGRedBlackTreeNodeTraverseSubnodesEqualToObject(_core.root, object, _comparator, ^(PGRedBlackTreeNode *candidateNode, BOOL *stop) {
+        if (object == candidateNode->object || ([object hash] == [candidateNode->object hash] && [object isEqual:candidateNode->object])) {
+            node = candidateNode;
+            *stop = YES;
+        }
+    });
+    
+    
+    return node;
+}
+
+#pragma mark - Order statistics
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    if (index >= _count) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Index %lu beyond bounds of tree with count %lu.",
+                                                                (unsigned long)index, (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    return PGRedBlackTreeNodeGetObject(PGRedBlackTreeNodeAtIndex(_core.root, index));
+}
+
+
+- (NSUInteger)indexOfObject:(id)object
+{
+    PGRedBlackTreeNode *node = [self nodeForObject:object];
+    return node ? PGRedBlackTreeNodeIndex(node) : NSNotFound;
+}
+
+
+- (NSArray *)objectsInRange:(NSRange)range
+{
+    if (range.location > _count || range.length > _count - range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of tree with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:range.length];
+    PGRedBlackTreeNode *node = range.length > 0 ? PGRedBlackTreeNodeAtIndex(_core.root, range.location) : NULL;
+    for (NSUInteger i = 0; i < range.length; ++i) {
+        [objects addObject:node->object];
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
+
+    return objects;
+}
+
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object
+{
+    if (!_core.root) return 0;
+    return PGRedBlackTreeNodeCountOfSubnodesLessThanObject(_core.root, object, _comparator);
+}
+
+
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object
+{
+    if (!_core.root) return 0;
+    return PGRedBlackTreeNodeCountOfSubnodesLessThanOrEqualToObject(_core.root, object, _comparator);
+}
+
+
+- (NSUInteger)countOfObjectsEqualToObject:(id)object
+{
+    if (!_core.root) return 0;
+    return [self countOfObjectsLessThanOrEqualToObject:object] - [self countOfObjectsLessThanObject:object];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object
+{
+    return _count - [self countOfObjectsLessThanObject:object];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object
+{
+    return _count - [self countOfObjectsLessThanOrEqualToObject:object];
+}
+
+
+#pragma mark - Removal
+
+- (void)removeObject:(id)object
+{
+    [self throwIfImmutable:_cmd];
+    PGRedBlackTreeNode *node = [self nodeForObject:object];
+    if (node) [self removeNode:node];
+}
+
+
+- (id)popFirstObject
+{
+    [self throwIfImmutable:_cmd];
+    PGRedBlackTreeNode *node = [self firstNode];
+    if (!node) return nil;
+
+    id object = [[node->object retain] autorelease];
+    [self removeNode:node];
+    return object;
+}
+
+
+- (id)popLastObject
+{
+    [self throwIfImmutable:_cmd];
+    PGRedBlackTreeNode *node = [self lastNode];
+    if (!node) return nil;
+
+    id object = [[node->object retain] autorelease];
+    [self removeNode:node];
+    return object;
+}
+
+
+- (void)removeNode:(PGRedBlackTreeNode *)node
+{
+    BOOL updatesNodeHashTable = [self nodeHashTableIsCurrent];
+    if (updatesNodeHashTable) PGRedBlackTreeNodeHashTableRemoveNode(_nodeHashTable, node);
+
+    // The first and last nodes have at most one child, so removing one of them unlinks that very node and its
+    // neighbor takes its place
+    BOOL updatesExtremeNodes = [self extremeNodesAreCurrent];
+    PGRedBlackTreeNode *firstNode = _firstNode;
+    PGRedBlackTreeNode *lastNode = _lastNode;
+    if (updatesExtremeNodes) {
+        if (node == firstNode) firstNode = PGRedBlackTreeNodeSuccessor(node);
+        if (node == lastNode) lastNode = PGRedBlackTreeNodePredecessor(node);
+    }
+
+    // If another node's object moved into node, the index and cached nodes have to follow it
+    PGRedBlackTreeNode *splicedNode = PGRedBlackTreeNodeRemoveFromTree(node, &_core);
+    [self setCount:_count - 1];
+    ++_mutationCount;
+
+    if (updatesNodeHashTable) {
+        if (splicedNode) PGRedBlackTreeNodeHashTableReplaceNode(_nodeHashTable, splicedNode, node);
+        _nodeHashTableMutationCount = _mutationCount;
+    }
+
+    if (updatesExtremeNodes) {
+        _firstNode = splicedNode && splicedNode == firstNode ? node : firstNode;
+        _lastNode = splicedNode && splicedNode == lastNode ? node : lastNode;
+        _extremeNodesMutationCount = _mutationCount;
+    }
+}
+
+
+- (void)evictObjectsOverMaximumCount
+{
+    if (_count <= _maximumCount) return;
+
+    // A single object is cheapest to pop. Larger overflows from batches are split off all at once.
+    NSUInteger overflowCount = _count - _maximumCount;
+    if (_eviction == PGRedBlackTreeEvictionFirstObject) {
+        if (overflowCount == 1) {
+            [self popFirstObject];
+        } else {
+            [self removeObjectsFromIndex:0 toIndex:overflowCount];
+        }
+    } else {
+        if (overflowCount == 1) {
+            [self popLastObject];
+        } else {
+            [self removeObjectsFromIndex:_maximumCount toIndex:_count];
+        }
+    }
+}
+
+
+- (void)removeObjectsInArray:(NSArray *)array
+{
+    [self throwIfImmutable:_cmd];
+    NSUInteger count = [array count];
+    if (count == 0 || !_core.root) return;
+
+    NSUInteger *indexes = malloc(count * sizeof(NSUInteger));
+    if (!indexes) {
+        @throw [NSException exceptionWithName:NSMallocException
+                                       reason:PGExceptionString(self, _cmd, @"Could not allocate index buffer.")
+                                     userInfo:nil];
+    }
+
+    // Find the node each object would remove in a single pass over the sorted batch. Each search starts from where the
+    // previous one ended instead of at the root. Objects that are equal according to the comparator form a run. The
+    // run's first node is found and indexed once, and a bitmap keyed by offset into the run records which nodes earlier
+    // objects in the run claimed. A cursor skips the run's claimed prefix, so a run of duplicates of the same object
+    // claims each node in turn instead of rescanning the ones before it.
+    NSArray *sortedArray = [array sortedArrayWithOptions:NSSortStable usingComparator:_comparator];
+    NSUInteger matchCount = 0;
+    PGRedBlackTreeNode *runNode = NULL;
+    NSUInteger runIndex = 0;
+    id runObject = nil;
+
+    PGRedBlackTreeNode *cursorNode = NULL;
+    NSUInteger cursorOffset = 0;
+    uint8_t *claimed = NULL;
+    NSUInteger claimedCapacity = 0;
+    NSUInteger claimedLength = 0;
+
+    for (id object in sortedArray) {
+        if (!runObject || _comparator(object, runObject) != NSOrderedSame) {
+            runNode = runNode ? PGRedBlackTreeNodeFirstNodeGreaterThanOrEqualToObjectNearNode(runNode, object, _comparator)
+                              : PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(_core.root, object, _comparator);
+            if (!runNode) break;
+
+            runObject = object;
+            runIndex = PGRedBlackTreeNodeIndex(runNode);
+            cursorNode = runNode;
+            cursorOffset = 0;
+            if (claimedLength > 0) memset(claimed, 0, claimedLength);
+            claimedLength = 0;
+        }
+
+        NSUInteger offset = cursorOffset;
+        for (PGRedBlackTreeNode *node = cursorNode; node && _comparator(node->object, object) == NSOrderedSame; node = PGRedBlackTreeNodeSuccessor(node), ++offset) {
+            if (offset < claimedLength && claimed[offset]) continue;
+            if (object != node->object && ([object hash] != [node->object hash] || ![object isEqual:node->object])) continue;
+
+            if (offset >= claimedCapacity) {
+                NSUInteger capacity = MAX(offset + 1, claimedCapacity * 2);
+                uint8_t *newClaimed = realloc(claimed, capacity);
+                if (!newClaimed) {
+                    free(claimed);
+                    free(indexes);
+                    @throw [NSException exceptionWithName:NSMallocException
+                                                   reason:PGExceptionString(self, _cmd, @"Could not allocate claimed node bitmap.")
+                                                 userInfo:nil];
+                }
+
+                memset(newClaimed + claimedCapacity, 0, capacity - claimedCapacity);
+                claimed = newClaimed;
+                claimedCapacity = capacity;
+            }
+
+            claimed[offset] = 1;
+            claimedLength = MAX(claimedLength, offset + 1);
+            indexes[matchCount++] = runIndex + offset;
+            break;
+        }
+
+        while (cursorNode && cursorOffset < claimedLength && claimed[cursorOffset]) {
+            cursorNode = PGRedBlackTreeNodeSuccessor(cursorNode);
+            ++cursorOffset;
+        }
+    }
+
+    free(claimed);
+    [self removeObjectsAtIndexes:indexes count:matchCount];
+    free(indexes);
+}
+
+
+- (void)removeObjectsAtIndexes:(NSUInteger *)indexes count:(NSUInteger)count
+{
+    if (count == 0) return;
+
+    // Objects in a run can claim nodes out of order, so sort the indexes before using them
+    qsort(indexes, count, sizeof(NSUInteger), PGCompareIndexes);
+
+    if (count * 4 < _count) {
+        // Remove from the back so that removing one node doesn't change the indexes of the ones we have yet to remove.
+        // Finding nodes by index doesn't use the comparator.
+        for (NSUInteger i = count; i > 0; --i) {
+            PGRedBlackTreeNodeRemoveFromTree(PGRedBlackTreeNodeAtIndex(_core.root, indexes[i - 1]), &_core);
+        }
+    } else {
+        // If we're removing a sizable fraction of the tree, it's cheaper to rebuild it from the objects that are left
+        NSUInteger remainingCount = _count - count;
+        id *objects = malloc(remainingCount * sizeof(id));
+        if (!objects && remainingCount > 0) {
+            @throw [NSException exceptionWithName:NSMallocException
+                                           reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                         userInfo:nil];
+        }
+
+        NSUInteger index = 0, i = 0, k = 0;
+        for (PGRedBlackTreeNode *node = PGRedBlackTreeNodeLeftmostSubnode(_core.root); node; node = PGRedBlackTreeNodeSuccessor(node), ++index) {
+            if (i < count && indexes[i] == index) {
+                ++i;
+            } else {
+                objects[k++] = [node->object retain];
+            }
+        }
+
+        PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+        [self setRoot:PGRedBlackTreeNodeCreateWithSortedObjects(_core.pool, objects, remainingCount)];
+        for (k = 0; k < remainingCount; ++k) {
+            [objects[k] release];
+        }
+
+        free(objects);
+    }
+
+    [self setCount:_count - count];
+    ++_mutationCount;
 }
 
 
-- (id)init
+- (void)removeAllObjects
 {
-    return [self initWithSelector:@selector(compare:)];
+    [self throwIfImmutable:_cmd];
+    if (!_core.root) return;
+    PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+    _core.root = NULL;
+    [self setCount:0];
+    ++_mutationCount;
+
+    if (_nodeHashTable) {
+        PGRedBlackTreeNodeHashTableRemoveAllNodes(_nodeHashTable);
+        _nodeHashTableMutationCount = _mutationCount;
+    }
 }
 
 
-- (id)initWithSelector:(SEL)selector
+- (void)removeObjectsLessThanObject:(id)object
 {
-    if (!selector) return nil;
-    return [self initWithComparator:^NSComparisonResult(id object1, id object2) {
-        return (NSComparisonResult)[object1 performSelector:selector withObject:object2];
-    }];
+    [self throwIfImmutable:_cmd];
+    if (!object) return;
+    [self removeObjectsFromIndex:0 toIndex:[self countOfObjectsLessThanObject:object]];
 }
 
 
-- (id)initWithComparator:(NSComparator)comparator
+- (void)removeObjectsInRangeFromObject:(id)fromObject toObject:(id)toObject
 {
-    if (!comparator) return nil;
-
-    self = [super init];
-    if (self) {
-        [self setComparator:comparator];
-    }
-    
-    return self;
+    [self throwIfImmutable:_cmd];
+    NSUInteger fromIndex = fromObject ? [self countOfObjectsLessThanObject:fromObject] : 0;
+    NSUInteger toIndex = toObject ? [self countOfObjectsLessThanObject:toObject] : _count;
+    [self removeObjectsFromIndex:fromIndex toIndex:toIndex];
 }
 
 
-- (void)dealloc
+- (void)removeObjectsFromIndex:(NSUInteger)fromIndex toIndex:(NSUInteger)toIndex
 {
-    if (_root) PGRedBlackTreeNodeFree(_root, YES);
-    [_comparator release];    
-    [super dealloc];
-}
+    if (fromIndex >= toIndex) return;
 
+    // Split the objects being removed out of the tree, free them, and join what's left back together
+    PGRedBlackTreeNode *less, *rest, *removed, *greater;
+    PGRedBlackTreeNodeSplitAtIndex(_core.root, fromIndex, &less, &rest);
+    PGRedBlackTreeNodeSplitAtIndex(rest, toIndex - fromIndex, &removed, &greater);
+    PGRedBlackTreeNodeFreeSubnodes(_core.pool, removed);
 
-- (NSString *)debugDescription
-{
-    if (!_root) return @"<tree></tree>";
-    NSMutableString *description = [NSMutableString stringWithString:@"<tree>\n"];
-    PGRedBlackTreeNodeAppendDebugDescription(_root, description, 1);
-    [description appendString:@"</tree>\n"];
-    return description;
+    [self setRoot:PGRedBlackTreeNodeConcatenate(less, greater)];
+    [self setCount:_count - (toIndex - fromIndex)];
+    ++_mutationCount;
 }
 
 
-#pragma mark - Insertion
+#pragma mark - Splitting and joining
 
-- (void)addObject:(id)object
+- (PGRedBlackTree *)splitAtObject:(id)object
 {
+    [self throwIfImmutable:_cmd];
     if (!object) {
         @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                       reason:PGExceptionString(self, _cmd, @"Cannot split at nil object.")
                                      userInfo:nil];
     }
-    
-    object = [object copy];
-    PGRedBlackTreeNode *node = [self insertNodeWithObject:object];
-    [object release];
 
-    [self fixPropertiesAfterInsertionWithNode:node];
-    [self setCount:_count + 1];
+    NSUInteger index = [self countOfObjectsLessThanObject:object];
+    PGRedBlackTree *tree = [[[self class] alloc] initWithComparator:[self comparator]];
+
+    if (index == 0 && _count > 0) {
+        // Everything is moving, so just trade nodes with the new tree rather than sharing our pool with it
+        PGRedBlackTreeNodePool *pool = _core.pool;
+        _core.pool = tree->_core.pool;
+        tree->_core.pool = pool;
+        tree->_core.root = _core.root;
+        _core.root = NULL;
+        [tree setCount:_count];
+        [self setCount:0];
+        ++_mutationCount;
+    } else if (index < _count) {
+        // The new tree's nodes come from our pool, so it has to share the pool with us
+        PGRedBlackTreeNode *less, *greaterOrEqual;
+        PGRedBlackTreeNodeSplitAtIndex(_core.root, index, &less, &greaterOrEqual);
+
+        [tree release];
+        tree = [[[self class] alloc] initWithComparator:[self comparator] pool:_core.pool root:greaterOrEqual count:_count - index];
+        [self setRoot:less];
+        [self setCount:index];
+        ++_mutationCount;
+    }
+
+    return [tree autorelease];
 }
 
 
-- (void)addObjectsFromArray:(NSArray *)array
+- (void)joinWithTree:(PGRedBlackTree *)tree
 {
-    if (!array) return;
-    for (id object in array) {
-        [self addObject:object];
+    [self throwIfImmutable:_cmd];
+    [tree throwIfImmutable:_cmd];
+    if (tree == self) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot join a tree with itself.")
+                                     userInfo:nil];
     }
-}
-    
 
-- (PGRedBlackTreeNode *)insertNodeWithObject:(id)object
-{
-    // If the tree has no root, just make the new node the root
-    if (!_root) {
-        PGRedBlackTreeNode *newNode = PGRedBlackTreeNodeCreate(NULL, object);
-        [self setRoot:newNode];
-        return newNode;
-    }
-    
-    // Otherwise, figure out where we're supposed to be based on the comparator
-    PGRedBlackTreeNode *node = _root;
-    while (true) {
-        if (_comparator(object, node->object) < NSOrderedSame) {
-            // If node has no left child, we've found where to insert our node
-            if (PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
-                PGRedBlackTreeNode *newNode = PGRedBlackTreeNodeCreate(node, object);
-                node->leftChild = newNode;
-                return newNode;
-            }
-            
-            node = node->leftChild;
-            continue;
-        }
-        
-        // If node has no right child, we've found where to insert our node
-        if (PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
-            PGRedBlackTreeNode *newNode = PGRedBlackTreeNodeCreate(node, object);
-            node->rightChild = newNode;
-            return newNode;
-        }
-        
-        node = node->rightChild;
-    }
-}
+    NSUInteger count = [tree count];
+    if (count == 0) return;
 
+    if (_core.root && _comparator(PGRedBlackTreeNodeRightmostSubnode(_core.root)->object,
+                                  PGRedBlackTreeNodeLeftmostSubnode(tree->_core.root)->object) > NSOrderedSame) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Tree's objects do not all follow the receiver's.")
+                                     userInfo:nil];
+    }
 
-- (void)fixPropertiesAfterInsertionWithNode:(PGRedBlackTreeNode *)node
-{
-    while (true) {
-        // Case 1: Node is the root, so make it black to fulfill Property 2 and we're done
-        if (!node->parent) {
-            node->isRed = NO;
-            return;
-        }
-        
-        // Case 2: If node's parent is black, we have inserted a red node between two blacks, and thus did not affect Property 5
-        if (!node->parent->isRed) return;
-        
-        // Case 3: Parent is red. If our uncle is also red, we can set our grandparent to red, our parent and uncle to black,
-        // and then fixup our grandparent
-        PGRedBlackTreeNode *grandparent = PGRedBlackTreeNodeGrandparent(node);
-        if (!grandparent) return;
-        PGRedBlackTreeNode *uncle = PGRedBlackTreeNodeUncle(node);
-        if (uncle && uncle->isRed) {
-            node->parent->isRed = NO;
-            uncle->isRed = NO;
-            grandparent->isRed = YES;
-            node = grandparent;
-            continue;
-        }
-        
-        // Case 4: Node and its parent are red; grandparent and uncle are black. If node is a right/left child and parent is
-        // a left/right child, then we need to do a rotation and reset node and grandparent before moving on to case 5
-        if (PGRedBlackTreeNodeIsRightChild(node) && PGRedBlackTreeNodeIsLeftChild(node->parent)) {
-            PGRedBlackTreeNodeRotateLeftInTree(node->parent, self);
-            node = node->leftChild;
-            grandparent = node->parent->parent;
-        } else if (PGRedBlackTreeNodeIsLeftChild(node) && PGRedBlackTreeNodeIsRightChild(node->parent)) {
-            PGRedBlackTreeNodeRotateRightInTree(node->parent, self);
-            node = node->rightChild;
-            grandparent = node->parent->parent;
-        }
-        
-        // Case 5: We are red, our parent is red, and our uncle is black. Make our parent black, make our grandparent red,
-        // and do a rotation. Now everything should be fine.
-        node->parent->isRed = NO;
-        grandparent->isRed = YES;
-        if (PGRedBlackTreeNodeIsLeftChild(node->parent)) {
-            PGRedBlackTreeNodeRotateRightInTree(grandparent, self);
-        } else {
-            PGRedBlackTreeNodeRotateLeftInTree(grandparent, self);
-        }
-        
-        return;
+    // If the tree's nodes came from our pool, we can take them directly. Otherwise, we have to copy them into our pool.
+    PGRedBlackTreeNode *otherRoot;
+    if (tree->_core.pool == _core.pool) {
+        otherRoot = tree->_core.root;
+        tree->_core.root = NULL;
+        [tree setCount:0];
+        ++tree->_mutationCount;
+    } else {
+        otherRoot = [self createNodesWithObjectsInTree:tree];
+        [tree removeAllObjects];
     }
+
+    [self setRoot:PGRedBlackTreeNodeConcatenate(_core.root, otherRoot)];
+    [self setCount:_count + count];
+    ++_mutationCount;
+    [self evictObjectsOverMaximumCount];
 }
 
 
-#pragma mark - Membership
+#pragma mark - Set operations
 
-- (BOOL)containsObject:(id)object
+- (void)unionWithTree:(PGRedBlackTree *)tree
 {
-    return [self member:object] != nil;
+    [self throwIfImmutable:_cmd];
+    if ([tree count] == 0 || tree == self) return;
+
+    // The other tree's nodes become part of ours, so copy them into our pool first
+    PGRedBlackTreeNodeUnionInTree([self createNodesWithObjectsInTree:tree], &_core, _comparator);
+    [self setCount:_core.root ? _core.root->count : 0];
+    ++_mutationCount;
+    [self evictObjectsOverMaximumCount];
 }
 
 
-- (id)member:(id)object
+- (void)intersectWithTree:(PGRedBlackTree *)tree
 {
-    PGRedBlackTreeNode *node = [self nodeForObject:object];
-    return node ? PGRedBlackTreeNodeGetObject(node) : nil;
-}
-
+    [self throwIfImmutable:_cmd];
+    if (!_core.root || tree == self) return;
 
-- (PGRedBlackTreeNode *)nodeForObject:(id)object
-{
-    if (!object || !_root) return NULL;
-    __block PGRedBlackTreeNode *node = NULL;
-    
-    PGRedBlackTreeNodeTraverseSubnodesEqualToObject(_root, object, _comparator, ^(PGRedBlackTreeNode *candidateNode, BOOL *stop) {
-        if (object == candidateNode->object || ([object hash] == [candidateNode->object hash] && [object isEqual:candidateNode->object])) {
-            node = candidateNode;
-            *stop = YES;
-        }
-    });
-    
-    
-    return node;
+    PGRedBlackTreeNodeIntersectInTree([tree root], &_core, _comparator);
+    [self setCount:_core.root ? _core.root->count : 0];
+    ++_mutationCount;
 }
 
-#pragma mark - Removal
 
-- (void)removeObject:(id)object
+- (void)minusTree:(PGRedBlackTree *)tree
 {
-    // Note: this code is adapted from the pseudocode in CLRS.
-    PGRedBlackTreeNode *node = [self nodeForObject:object];
-    if (!node) return;
-    
-    PGRedBlackTreeNode *nodeToSpliceOut = node;
-    
-    // If neither child is a sentinel, we'll splice out either the node's predecessor or successor
-    if (!PGRedBlackTreeNodeIsSentinel(node->leftChild) && !PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
-        // This fun bit of code simply changes up whether a predecessor or successor is the node we splice out. The reason
-        // we do this is because it supposedly leads to a more balanced tree as time goes on. If the node we're removing is
-        // the left child, we try to get the successor, and if that doesn't work, we get the predecessor. If it's the right
-        // child (or doesn't have a parent), we do the opposite.
-        if (PGRedBlackTreeNodeIsLeftChild(node)) {
-            nodeToSpliceOut = PGRedBlackTreeNodeSuccessor(node);
-            if (!nodeToSpliceOut) nodeToSpliceOut = PGRedBlackTreeNodePredecessor(node);
-        } else {
-            nodeToSpliceOut = PGRedBlackTreeNodePredecessor(node);
-            if (!nodeToSpliceOut) nodeToSpliceOut = PGRedBlackTreeNodeSuccessor(node);
-        }
+    [self throwIfImmutable:_cmd];
+    if (tree == self) {
+        [self removeAllObjects];
+        return;
     }
-    
-    // Pick the non-sentinel child of the node to splice out
-    PGRedBlackTreeNode *child = PGRedBlackTreeNodeIsSentinel(nodeToSpliceOut->leftChild) ? nodeToSpliceOut->rightChild : nodeToSpliceOut->leftChild;
 
-    // If the node we're splicing out has no non-sentinel children, fix properties with the node itself
-    // before removing it. If we do this later, our parent pointers will be messed up
-    if (!nodeToSpliceOut->isRed && PGRedBlackTreeNodeIsSentinel(child)) {
-        [self fixPropertiesAfterRemovalWithNode:nodeToSpliceOut];
-    }
+    if (!_core.root || [tree count] == 0) return;
 
-    // If the child of the node we're splicing out isn't a sentinel, set its parent to its grandparent
-    if (!PGRedBlackTreeNodeIsSentinel(child)) {
-        child->parent = nodeToSpliceOut->parent;
-    }
-    
-    // If the node we're removing is the root, set the root to the child
-    if (!nodeToSpliceOut->parent) {
-        _root = PGRedBlackTreeNodeIsSentinel(child) ? NULL : child;
-    } else if (PGRedBlackTreeNodeIsLeftChild(nodeToSpliceOut)) {
-        nodeToSpliceOut->parent->leftChild = child;
-    } else {
-        nodeToSpliceOut->parent->rightChild = child;
-    }
+    PGRedBlackTreeNodeMinusInTree([tree root], &_core, _comparator);
+    [self setCount:_core.root ? _core.root->count : 0];
+    ++_mutationCount;
+}
 
-    // If we're not the node to splice out, 
-    if (node != nodeToSpliceOut) {
-        PGRedBlackTreeNodeSetObject(node, nodeToSpliceOut->object);
-    }
-    
-    if (!nodeToSpliceOut->isRed && !PGRedBlackTreeNodeIsSentinel(child)) {
-        [self fixPropertiesAfterRemovalWithNode:child];
-    }
 
-    PGRedBlackTreeNodeFree(nodeToSpliceOut, NO);
-    [self setCount:_count - 1];
+- (PGRedBlackTree *)treeByUnioningWithTree:(PGRedBlackTree *)tree
+{
+    PGRedBlackTree *result = [[[[self class] alloc] initWithObjectsInTree:self immutable:NO] autorelease];
+    [result unionWithTree:tree];
+    return result;
 }
 
 
-- (void)fixPropertiesAfterRemovalWithNode:(PGRedBlackTreeNode *)node
+- (PGRedBlackTree *)treeByIntersectingWithTree:(PGRedBlackTree *)tree
 {
-    // Note: this code is adapted from the pseudocode in CLRS.
-    while (node != _root && !node->isRed) {
-        if (PGRedBlackTreeNodeIsLeftChild(node)) {
-            PGRedBlackTreeNode *sibling = node->parent->rightChild;
-            if (sibling->isRed) {
-                sibling->isRed = NO;
-                node->parent->isRed = YES;
-                PGRedBlackTreeNodeRotateLeftInTree(node->parent, self);
-                sibling = node->parent->rightChild;
-            }
-            
-            if (!sibling->leftChild->isRed && !sibling->rightChild->isRed) {
-                sibling->isRed = YES;
-                node = node->parent;
-                continue;
-            }
-            
-            if (!sibling->rightChild->isRed) {
-                sibling->leftChild->isRed = NO;
-                sibling->isRed = YES;
-                PGRedBlackTreeNodeRotateRightInTree(sibling, self);
-                sibling = node->parent->rightChild;
-            }
-            
-            sibling->isRed = node->parent->isRed;
-            node->parent->isRed = NO;
-            sibling->rightChild->isRed = NO;
-            PGRedBlackTreeNodeRotateLeftInTree(node->parent, self);
-            node = _root;
-        } else {
-            PGRedBlackTreeNode *sibling = node->parent->leftChild;
-            if (sibling->isRed) {
-                sibling->isRed = NO;
-                node->parent->isRed = YES;
-                PGRedBlackTreeNodeRotateRightInTree(node->parent, self);
-                sibling = node->parent->leftChild;
-            }
-            
-            if (!sibling->leftChild->isRed && !sibling->rightChild->isRed) {
-                sibling->isRed = YES;
-                node = node->parent;
-                continue;
-            }
-            
-            if (!sibling->leftChild->isRed) {
-                sibling->rightChild->isRed = NO;
-                sibling->isRed = YES;
-                PGRedBlackTreeNodeRotateLeftInTree(sibling, self);
-                sibling = node->parent->leftChild;
-            }
-            
-            sibling->isRed = node->parent->isRed;
-            node->parent->isRed = NO;
-            sibling->leftChild->isRed = NO;
-            PGRedBlackTreeNodeRotateRightInTree(node->parent, self);
-            node = _root;
-        }
-        
-    }
-
-    node->isRed = NO;
+    PGRedBlackTree *result = [[[[self class] alloc] initWithObjectsInTree:self immutable:NO] autorelease];
+    [result intersectWithTree:tree];
+    return result;
 }
 
 
-- (void)removeAllObjects
+- (PGRedBlackTree *)treeBySubtractingTree:(PGRedBlackTree *)tree
 {
-    if (!_root) return;
-    PGRedBlackTreeNodeFree(_root, YES);
-    _root = nil;
-    [self setCount:0];
+    PGRedBlackTree *result = [[[[self class] alloc] initWithObjectsInTree:self immutable:NO] autorelease];
+    [result minusTree:tree];
+    return result;
 }
 
 
@@ -427,12 +1575,15 @@
                                      userInfo:nil];
     }
     
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_root, ^(PGRedBlackTreeNode *node, BOOL *stop) { block(node->object, stop); });
+    if (!_core.root) return;
+    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_core.root, ^(PGRedBlackTreeNode *node, BOOL *stop) { block(node->object, stop); });
 }
 
 
-- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id, BOOL *))block
 {
     if (!block) {
         @throw [NSException exceptionWithName:NSInvalidArgumentException
@@ -440,75 +1591,78 @@
                                      userInfo:nil];
     }
 
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_root, ^(PGRedBlackTreeNode *node, BOOL *stop) {
-        NSComparisonResult result = _comparator(node->object, object);
-        if (result >= NSOrderedSame) {
-            *stop = YES;
-            return;
+    if (!_core.root) return;
+    BOOL stop = NO;
+
+    if (options & NSEnumerationReverse) {
+        // Seek to the last node that is within the upper bound and walk predecessors until we pass the lower bound
+        NSComparisonResult lowestResult = fromInclusive ? NSOrderedSame : NSOrderedDescending;
+        PGRedBlackTreeNode *node = [self lastNodeToObject:toObject inclusive:toInclusive];
+        while (node && (!fromObject || _comparator(node->object, fromObject) >= lowestResult)) {
+            block(node->object, &stop);
+            if (stop) return;
+            node = PGRedBlackTreeNodePredecessor(node);
         }
-        
-        block(node->object, stop);
-    });
+
+        return;
+    }
+
+    // Seek to the first node that is within the lower bound and walk successors until we pass the upper bound
+    NSComparisonResult highestResult = toInclusive ? NSOrderedSame : NSOrderedAscending;
+    PGRedBlackTreeNode *node = [self firstNodeFromObject:fromObject inclusive:fromInclusive];
+    while (node && (!toObject || _comparator(node->object, toObject) <= highestResult)) {
+        block(node->object, &stop);
+        if (stop) return;
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
 }
 
 
-- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+- (PGRedBlackTreeNode *)firstNodeFromObject:(id)object inclusive:(BOOL)inclusive
 {
-    if (!block) {
-        @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
-                                     userInfo:nil];
-    }
+    if (!_core.root) return NULL;
+    if (!object) return PGRedBlackTreeNodeLeftmostSubnode(_core.root);
+    return inclusive ? PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(_core.root, object, _comparator) :
+                       PGRedBlackTreeNodeFirstSubnodeGreaterThanObject(_core.root, object, _comparator);
+}
 
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesWithBlock(_root, ^(PGRedBlackTreeNode *node, BOOL *stop) {
-        if (_comparator(node->object, object) > NSOrderedSame) {
-            *stop = YES;
-            return;
-        }
-        
-        block(node->object, stop);
-    });
+
+- (PGRedBlackTreeNode *)lastNodeToObject:(id)object inclusive:(BOOL)inclusive
+{
+    if (!_core.root) return NULL;
+    if (!object) return PGRedBlackTreeNodeRightmostSubnode(_core.root);
+    return inclusive ? PGRedBlackTreeNodeLastSubnodeLessThanOrEqualToObject(_core.root, object, _comparator) :
+                       PGRedBlackTreeNodeLastSubnodeLessThanObject(_core.root, object, _comparator);
 }
 
 
-- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
 {
-    if (!block) {
-        @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
-                                     userInfo:nil];
-    }
+    [self enumerateObjectsFromObject:nil inclusive:NO toObject:object inclusive:NO options:0 usingBlock:block];
+}
 
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesEqualToObject(_root, object, _comparator, ^(PGRedBlackTreeNode *n, BOOL *s) { block(n->object, s); });
+
+- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:NO toObject:object inclusive:YES options:0 usingBlock:block];
 }
 
 
-- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
 {
-    if (!block) {
-        @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
-                                     userInfo:nil];
-    }
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:object inclusive:YES options:0 usingBlock:block];
+}
+
 
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(_root, object, _comparator, ^(PGRedBlackTreeNode *n, BOOL *s) { block(n->object, s); });
+- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:nil inclusive:NO options:0 usingBlock:block];
 }
 
 
 - (void)enumerateObjectsGreaterThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
 {
-    if (!block) {
-        @throw [NSException exceptionWithName:NSInvalidArgumentException
-                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
-                                     userInfo:nil];
-    }
-
-    if (!_root) return;
-    PGRedBlackTreeNodeTraverseSubnodesGreaterThanObject(_root, object, _comparator, ^(PGRedBlackTreeNode *n, BOOL *s) { block(n->object, s); });
+    [self enumerateObjectsFromObject:object inclusive:NO toObject:nil inclusive:NO options:0 usingBlock:block];
 }
 
 
@@ -536,83 +1690,275 @@
 
 - (id)firstObject
 {
-    if (!_root) return nil;
-    PGRedBlackTreeNode *node = _root;
-    while (!PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
-        node = node->leftChild;
-    }
-    
-    return PGRedBlackTreeNodeGetObject(node);
+    if (!_core.root) return nil;
+    return PGRedBlackTreeNodeGetObject([self firstNode]);
 }
 
 
 - (id)lastObject
 {
-    if (!_root) return nil;
-    PGRedBlackTreeNode *node = _root;
-    while (!PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
-        node = node->rightChild;
-    }
-    
-    return PGRedBlackTreeNodeGetObject(node);
+    if (!_core.root) return nil;
+    return PGRedBlackTreeNodeGetObject([self lastNode]);
 }
 
 
 - (NSArray *)allObjects
 {
-    __block NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:_count];
-    
-    [self enumerateObjectsUsingBlock:^(id object, BOOL *stop) {
-        [objects addObject:object];
-    }];
-    
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:_count];
+    for (PGRedBlackTreeNode *node = [self firstNodeFromObject:nil inclusive:NO]; node; node = PGRedBlackTreeNodeSuccessor(node)) {
+        [objects addObject:node->object];
+    }
+
     return objects;
 }
 
 
-- (NSArray *)enumeratedObjectsWithSelector:(SEL)selector object:(id)object
+- (NSArray *)objectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive toObject:(id)toObject inclusive:(BOOL)toInclusive
 {
-    __block NSMutableArray *objects = [NSMutableArray array];
-
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Warc-performSelector-leaks"
-    [self performSelector:selector withObject:object withObject:^(id object, BOOL *stop) {
-        [objects addObject:object];
-    }];
-#pragma clang diagnostic pop
+    NSMutableArray *objects = [NSMutableArray array];
+    NSComparisonResult highestResult = toInclusive ? NSOrderedSame : NSOrderedAscending;
+    PGRedBlackTreeNode *node = [self firstNodeFromObject:fromObject inclusive:fromInclusive];
+    while (node && (!toObject || _comparator(node->object, toObject) <= highestResult)) {
+        [objects addObject:node->object];
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
 
     return objects;
-
 }
 
 
 - (NSArray *)objectsLessThanObject:(id)object
 {
-    return [self enumeratedObjectsWithSelector:@selector(enumerateObjectsLessThanObject:usingBlock:) object:object];
+    return [self objectsFromObject:nil inclusive:NO toObject:object inclusive:NO];
 }
 
 
 - (NSArray *)objectsLessThanOrEqualToObject:(id)object
 {
-    return [self enumeratedObjectsWithSelector:@selector(enumerateObjectsLessThanOrEqualToObject:usingBlock:) object:object];
+    return [self objectsFromObject:nil inclusive:NO toObject:object inclusive:YES];
 }
 
 
 - (NSArray *)objectsEqualToObject:(id)object
 {
-    return [self enumeratedObjectsWithSelector:@selector(enumerateObjectsEqualToObject:usingBlock:) object:object];
+    return [self objectsFromObject:object inclusive:YES toObject:object inclusive:YES];
 }
 
 
 - (NSArray *)objectsGreaterThanOrEqualToObject:(id)object
 {
-    return [self enumeratedObjectsWithSelector:@selector(enumerateObjectsGreaterThanOrEqualToObject:usingBlock:) object:object];
+    return [self objectsFromObject:object inclusive:YES toObject:nil inclusive:NO];
 }
 
 
 - (NSArray *)objectsGreaterThanObject:(id)object
 {
-    return [self enumeratedObjectsWithSelector:@selector(enumerateObjectsGreaterThanObject:usingBlock:) object:object];
+    return [self objectsFromObject:object inclusive:NO toObject:nil inclusive:NO];
+}
+
+
+#pragma mark - Archiving
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error
+{
+    // Write to a temporary file in the same directory so that we can atomically replace path once we're done
+    char *temporaryPath = strdup([[path stringByAppendingString:@".XXXXXX"] fileSystemRepresentation]);
+    int fileDescriptor = temporaryPath ? mkstemp(temporaryPath) : -1;
+    if (fileDescriptor < 0) {
+        if (error) *error = PGRedBlackTreeArchivePOSIXError(path);
+        free(temporaryPath);
+        return NO;
+    }
+
+    fchmod(fileDescriptor, 0644);
+
+    PGRedBlackTreeArchiveWriter writer = { 0 };
+    writer.fileDescriptor = fileDescriptor;
+    writer.entries = malloc(PGRedBlackTreeArchiveBufferSize);
+    writer.entriesOffset = sizeof(PGRedBlackTreeArchiveHeader);
+    writer.payload = malloc(PGRedBlackTreeArchiveBufferSize);
+    writer.payloadOffset = writer.entriesOffset + (off_t)(_count * sizeof(PGRedBlackTreeArchiveEntry));
+
+    __block PGRedBlackTreeArchiveWriterStatus status = PGRedBlackTreeArchiveWriterStatusWriteFailed;
+    if (writer.entries && writer.payload) {
+        // Stream the objects out in order as we traverse the tree
+        status = PGRedBlackTreeArchiveWriterStatusSuccess;
+        PGRedBlackTreeArchiveWriter *writerPointer = &writer;
+        if (_core.root) {
+            PGRedBlackTreeNodeTraverseSubnodesWithBlock(_core.root, ^(PGRedBlackTreeNode *node, BOOL *stop) {
+                status = PGRedBlackTreeArchiveWriterAppendObject(writerPointer, node->object);
+                *stop = status != PGRedBlackTreeArchiveWriterStatusSuccess;
+            });
+        }
+    }
+
+    if (status == PGRedBlackTreeArchiveWriterStatusSuccess) {
+        PGRedBlackTreeArchiveHeader header;
+        memcpy(header.magic, PGRedBlackTreeArchiveMagic, sizeof(header.magic));
+        header.version = PGRedBlackTreeArchiveVersion;
+        header.byteOrderMark = PGRedBlackTreeArchiveByteOrderMark;
+        header.count = _count;
+        header.payloadLength = writer.payloadLength;
+
+        if (!PGRedBlackTreeArchiveWriterFlush(&writer) || !PGRedBlackTreeArchiveWrite(fileDescriptor, &header, sizeof(header), 0) ||
+            fsync(fileDescriptor) < 0) {
+            status = PGRedBlackTreeArchiveWriterStatusWriteFailed;
+        }
+    }
+
+    if (error && status == PGRedBlackTreeArchiveWriterStatusWriteFailed) *error = PGRedBlackTreeArchivePOSIXError(path);
+
+    free(writer.entries);
+    free(writer.payload);
+    if (close(fileDescriptor) < 0 && status == PGRedBlackTreeArchiveWriterStatusSuccess) {
+        status = PGRedBlackTreeArchiveWriterStatusWriteFailed;
+        if (error) *error = PGRedBlackTreeArchivePOSIXError(path);
+    }
+
+    if (status == PGRedBlackTreeArchiveWriterStatusSuccess && rename(temporaryPath, [path fileSystemRepresentation]) < 0) {
+        status = PGRedBlackTreeArchiveWriterStatusWriteFailed;
+        if (error) *error = PGRedBlackTreeArchivePOSIXError(path);
+    }
+
+    if (status != PGRedBlackTreeArchiveWriterStatusSuccess) unlink(temporaryPath);
+    free(temporaryPath);
+
+    if (error && status == PGRedBlackTreeArchiveWriterStatusUnsupportedObject) {
+        *error = [NSError errorWithDomain:PGErrorDomain code:PGRedBlackTreeArchiveErrorUnsupportedObject
+                                 userInfo:@{ NSFilePathErrorKey : path,
+                                             NSLocalizedDescriptionKey : @"The tree contains an object that cannot be archived." }];
+    }
+
+    return status == PGRedBlackTreeArchiveWriterStatusSuccess;
+}
+
+
+#pragma mark - Freezing
+
+- (PGFrozenSortedSet *)frozenCopy
+{
+    NSUInteger count = _count;
+    id *objects = NULL;
+    if (count > 0) {
+        objects = malloc(count * sizeof(id));
+        if (!objects) {
+            @throw [NSException exceptionWithName:NSMallocException
+                                           reason:PGExceptionString(self, _cmd, @"Could not allocate object buffer.")
+                                         userInfo:nil];
+        }
+
+        [self getObjects:objects range:NSMakeRange(0, count)];
+    }
+
+    // Our objects are already copies that we own, so the frozen set can share them instead of copying them again
+    PGFrozenSortedSet *set = [[PGFrozenSortedSet alloc] initWithObjects:objects count:count comparator:[self comparator] copyObjects:NO];
+    free(objects);
+    return [set autorelease];
+}
+
+
+#pragma mark - Fast enumeration
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // We keep the next node to visit in extra[0]. Because mutationsPtr points to our mutation count, the enumeration
+    // will throw before we're called again if the tree is mutated, so the node can't be freed out from under us.
+    PGRedBlackTreeNode *node = NULL;
+    if (state->state == 0) {
+        state->state = 1;
+        state->mutationsPtr = &_mutationCount;
+        node = [self firstNodeFromObject:nil inclusive:NO];
+    } else {
+        node = (PGRedBlackTreeNode *)state->extra[0];
+    }
+
+    NSUInteger count = 0;
+    while (node && count < length) {
+        buffer[count++] = node->object;
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
+
+    state->extra[0] = (unsigned long)node;
+    state->itemsPtr = buffer;
+    return count;
+}
+
+
+- (void)getObjects:(id *)objects range:(NSRange)range
+{
+    if (range.location > _count || range.length > _count - range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of tree with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    PGRedBlackTreeNode *node = range.length > 0 ? PGRedBlackTreeNodeAtIndex(_core.root, range.location) : NULL;
+    for (NSUInteger i = 0; i < range.length; ++i) {
+        objects[i] = node->object;
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
+}
+
+
+- (unsigned long *)mutationCountPointer
+{
+    return &_mutationCount;
+}
+
+
+- (PGRedBlackTreeCursor *)cursor
+{
+    return [[[PGRedBlackTreeCursor alloc] initWithTree:self] autorelease];
+}
+
+
+#pragma mark - Statistics
+
+- (NSDictionary *)statistics
+{
+    NSMutableDictionary *statistics = [NSMutableDictionary dictionary];
+
+    // A tree with n nodes is at most 2 log2(n + 1) high, so twice the number of bits in n is always enough
+    NSUInteger histogram[2 * sizeof(NSUInteger) * CHAR_BIT + 1] = { 0 };
+    if (_core.root) PGAddNodeDepthsToHistogram(_core.root, 0, histogram);
+
+    NSMutableArray *depthHistogram = [NSMutableArray array];
+    for (NSUInteger depth = 0; histogram[depth] > 0; ++depth) {
+        [depthHistogram addObject:@(histogram[depth])];
+    }
+
+    // Every path from the root to a leaf has the same number of black nodes, so the leftmost one will do
+    NSUInteger blackHeight = 0;
+    for (PGRedBlackTreeNode *node = _core.root; node && !PGRedBlackTreeNodeIsSentinel(node); node = node->leftChild) {
+        if (!node->isRed) ++blackHeight;
+    }
+
+    statistics[PGRedBlackTreeStatisticsHeightKey] = @([depthHistogram count]);
+    statistics[PGRedBlackTreeStatisticsBlackHeightKey] = @(blackHeight);
+    statistics[PGRedBlackTreeStatisticsDepthHistogramKey] = depthHistogram;
+
+#if PG_RED_BLACK_TREE_STATISTICS
+    unsigned long long allocationCount, freeCount;
+    PGRedBlackTreeNodePoolGetStatistics(_core.pool, &allocationCount, &freeCount);
+    statistics[PGRedBlackTreeStatisticsComparisonCountKey] = @(__atomic_load_n(&_statistics.comparisonCount, __ATOMIC_RELAXED));
+    statistics[PGRedBlackTreeStatisticsRotationCountKey] = @(_statistics.rotationCount);
+    statistics[PGRedBlackTreeStatisticsInsertionFixupIterationCountKey] = @(_statistics.insertionFixupIterationCount);
+    statistics[PGRedBlackTreeStatisticsRemovalFixupIterationCountKey] = @(_statistics.removalFixupIterationCount);
+    statistics[PGRedBlackTreeStatisticsNodeAllocationCountKey] = @(allocationCount);
+    statistics[PGRedBlackTreeStatisticsNodeFreeCountKey] = @(freeCount);
+#endif
+
+    return statistics;
+}
+
+
+- (void)resetStatistics
+{
+#if PG_RED_BLACK_TREE_STATISTICS
+    memset(&_statistics, 0, sizeof(_statistics));
+    PGRedBlackTreeNodePoolResetStatistics(_core.pool);
+#endif
 }
 
 @end
@@ -625,22 +1971,7 @@
 
 - (BOOL)fulfillsProperties
 {
-    PGRedBlackTreeNode *node = _root;
-    if (!node) return YES;
-    
-    // Keep going left until you find a leaf
-    while (!PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
-        node = node->leftChild;
-    }
-    
-    // If we didn't have a left child, check the right subtree for a leaf
-    if (node == _root) {
-        while (!PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
-            node = node->rightChild;
-        }
-    }
-    
-    return PGRedBlackTreeNodeFulfillsProperties(_root, _comparator, PGRedBlackTreeNodeBlackNodeCountInPathFromNodeToRoot(node));
+    return PGRedBlackTreeNodeFulfillsProperties(_core.root, _comparator);
 }
 
 @end
\ No newline at end of file
@@ -0,0 +1,109 @@
+//
+//  PGRedBlackTreeCursor.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+@class PGRedBlackTree;
+
+/*!
+ @abstract A PGRedBlackTreeCursor is a position in a red-black tree that can be moved forward and backward one object at
+     a time.
+ @discussion Cursors are meant for code that needs to step through one or more trees at its own pace, e.g., when merging
+     several trees. Moving a cursor does not allocate memory or invoke any blocks.
+
+     A cursor is positioned at the tree's first object when it is created. Once it moves past either end of the tree,
+     its object is nil and it stays that way until it is repositioned using one of the seek methods.
+
+     If the cursor's tree is mutated, the cursor's position is no longer valid. Until the cursor is repositioned using
+     one of the seek methods, -object, -nextObject, and -previousObject throw an NSGenericException.
+ */
+@interface PGRedBlackTreeCursor : NSObject
+
+/*!
+ @abstract The tree the cursor is positioned in.
+ */
+@property(readonly, retain) PGRedBlackTree *tree;
+
+/*!
+ @abstract Returns an initialized cursor positioned at the first object in the specified tree.
+ @param tree The tree to position the cursor in. May not be nil.
+ @result A newly initialized cursor or nil if tree is nil.
+ */
+- (id)initWithTree:(PGRedBlackTree *)tree;
+
+/*!
+ @abstract Returns the object at the cursor's current position.
+ @discussion The returned object is not retained and autoreleased. It is only guaranteed to be valid until the tree is
+     next mutated.
+ @throws NSGenericException if the tree has been mutated since the cursor was last positioned.
+ @result The object at the cursor's current position or nil if the cursor has moved past either end of the tree.
+ */
+- (id)object;
+
+/*!
+ @abstract Moves the cursor to the next object in the tree and returns that object.
+ @throws NSGenericException if the tree has been mutated since the cursor was last positioned.
+ @result The next object in the tree or nil if there are no more objects.
+ */
+- (id)nextObject;
+
+/*!
+ @abstract Moves the cursor to the previous object in the tree and returns that object.
+ @throws NSGenericException if the tree has been mutated since the cursor was last positioned.
+ @result The previous object in the tree or nil if there are no more objects.
+ */
+- (id)previousObject;
+
+/*!
+ @abstract Moves the cursor to the first object in the tree.
+ @result The first object in the tree or nil if the tree is empty.
+ */
+- (id)seekToFirstObject;
+
+/*!
+ @abstract Moves the cursor to the last object in the tree.
+ @result The last object in the tree or nil if the tree is empty.
+ */
+- (id)seekToLastObject;
+
+/*!
+ @abstract Moves the cursor to the first object in the tree that is greater than or equal to the specified object
+     according to the tree's comparator.
+ @discussion This takes O(log n) time.
+ @param object The object to seek to.
+ @result The object the cursor was moved to or nil if there is no such object.
+ */
+- (id)seekToObjectGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Moves the cursor to the last object in the tree that is less than or equal to the specified object
+     according to the tree's comparator.
+ @discussion This takes O(log n) time.
+ @param object The object to seek to.
+ @result The object the cursor was moved to or nil if there is no such object.
+ */
+- (id)seekToObjectLessThanOrEqualToObject:(id)object;
+
+@end
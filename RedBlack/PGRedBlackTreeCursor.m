@@ -0,0 +1,169 @@
+//
+//  PGRedBlackTreeCursor.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGRedBlackTreeCursor.h"
+
+#import "PGRedBlackTree.h"
+#import "PGRedBlackTreeNode.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Private interfaces for PGRedBlackTree
+
+@interface PGRedBlackTree (CursorAccessors)
+- (PGRedBlackTreeNode *)root;
+- (NSComparator)comparator;
+- (unsigned long *)mutationCountPointer;
+@end
+
+
+#pragma mark - Private interfaces
+
+@interface PGRedBlackTreeCursor () {
+    PGRedBlackTreeNode *_node;
+    NSComparator _comparator;
+    unsigned long *_mutationCountPointer;
+    unsigned long _mutationCount;
+}
+
+@property(readwrite, retain) PGRedBlackTree *tree;
+
+- (PGRedBlackTreeNode *)currentNode;
+- (id)seekToNode:(PGRedBlackTreeNode *)node;
+- (void)checkForMutationWithSelector:(SEL)selector;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGRedBlackTreeCursor
+
+- (id)initWithTree:(PGRedBlackTree *)tree
+{
+    if (!tree) return nil;
+
+    self = [super init];
+    if (self) {
+        [self setTree:tree];
+        _comparator = [[tree comparator] retain];
+        _mutationCountPointer = [tree mutationCountPointer];
+        [self seekToFirstObject];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_tree release];
+    [_comparator release];
+    [super dealloc];
+}
+
+
+- (void)checkForMutationWithSelector:(SEL)selector
+{
+    if (*_mutationCountPointer != _mutationCount) {
+        @throw [NSException exceptionWithName:NSGenericException
+                                       reason:PGExceptionString(self, selector, @"Tree was mutated since the cursor was positioned.")
+                                     userInfo:nil];
+    }
+}
+
+
+#pragma mark - Moving
+
+- (id)object
+{
+    [self checkForMutationWithSelector:_cmd];
+    return _node ? _node->object : nil;
+}
+
+
+- (id)nextObject
+{
+    [self checkForMutationWithSelector:_cmd];
+    if (!_node) return nil;
+    _node = PGRedBlackTreeNodeSuccessor(_node);
+    return _node ? _node->object : nil;
+}
+
+
+- (id)previousObject
+{
+    [self checkForMutationWithSelector:_cmd];
+    if (!_node) return nil;
+    _node = PGRedBlackTreeNodePredecessor(_node);
+    return _node ? _node->object : nil;
+}
+
+
+#pragma mark - Seeking
+
+- (PGRedBlackTreeNode *)currentNode
+{
+    // Once the tree is mutated, our node may have been freed
+    return *_mutationCountPointer == _mutationCount ? _node : NULL;
+}
+
+
+- (id)seekToNode:(PGRedBlackTreeNode *)node
+{
+    _node = node;
+    _mutationCount = *_mutationCountPointer;
+    return _node ? _node->object : nil;
+}
+
+
+- (id)seekToFirstObject
+{
+    PGRedBlackTreeNode *root = [_tree root];
+    return [self seekToNode:root ? PGRedBlackTreeNodeLeftmostSubnode(root) : NULL];
+}
+
+
+- (id)seekToLastObject
+{
+    PGRedBlackTreeNode *root = [_tree root];
+    return [self seekToNode:root ? PGRedBlackTreeNodeRightmostSubnode(root) : NULL];
+}
+
+
+- (id)seekToObjectGreaterThanOrEqualToObject:(id)object
+{
+    PGRedBlackTreeNode *root = [_tree root];
+    return [self seekToNode:root ? PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(root, object, _comparator) : NULL];
+}
+
+
+- (id)seekToObjectLessThanOrEqualToObject:(id)object
+{
+    PGRedBlackTreeNode *root = [_tree root];
+    return [self seekToNode:root ? PGRedBlackTreeNodeLastSubnodeLessThanOrEqualToObject(root, object, _comparator) : NULL];
+}
+
+@end
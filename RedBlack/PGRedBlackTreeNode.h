@@ -29,8 +29,6 @@
 
 #import <Foundation/Foundation.h>
 
-@class PGRedBlackTree;
-
 
 #pragma mark - Types and constants
 
@@ -41,15 +39,89 @@ struct _PGRedBlackTreeNode {
     PGRedBlackTreeNode *rightChild;
     BOOL isRed;
     id object;
+    NSUInteger count;
 };
 
 extern PGRedBlackTreeNode const * const PGRedBlackTreeNodeSentinel;
 
+// Nodes are allocated out of a per-tree pool of slabs. Nodes that are freed go onto the pool's free list and are recycled
+// by later allocations. Freeing the pool (or removing all of its nodes) releases every live node's object in a single
+// linear pass over the slabs and then frees the slabs themselves, so there's no need to walk the tree.
+//
+// A pool's nodes may be larger than PGRedBlackTreeNode. Trees that need to store more data per node, e.g., scalar keys,
+// define a struct whose first member is a PGRedBlackTreeNode and create their pool using the size of that struct. When
+// a node is removed from a tree, the extra data is moved along with the node's object.
+//
+// Pools are reference counted so that trees split from one another can keep sharing nodes. While a pool is shared, it
+// locks around allocation, and trees that release it or remove all their nodes free their own nodes individually.
+typedef struct _PGRedBlackTreeNodePool PGRedBlackTreeNodePool;
+
+// Define PG_RED_BLACK_TREE_STATISTICS to 1 to have trees count comparisons, rotations, fixup iterations, and node
+// allocations and frees. When it is 0, the counters are compiled out entirely.
+#ifndef PG_RED_BLACK_TREE_STATISTICS
+#define PG_RED_BLACK_TREE_STATISTICS 0
+#endif
+
+#if PG_RED_BLACK_TREE_STATISTICS
+typedef struct _PGRedBlackTreeStatistics {
+    unsigned long long comparisonCount;
+    unsigned long long rotationCount;
+    unsigned long long insertionFixupIterationCount;
+    unsigned long long removalFixupIterationCount;
+} PGRedBlackTreeStatistics;
+
+#define PGRedBlackTreeStatisticsIncrement(tree, counter) do { if ((tree)->statistics) ++(tree)->statistics->counter; } while (0)
+#else
+#define PGRedBlackTreeStatisticsIncrement(tree, counter) do { } while (0)
+#endif
+
+// Trees whose nodes store data derived from their subtrees, like an interval tree's largest endpoint, provide a function
+// that recomputes a node's derived data from its own data and its children's. Sentinels have no extra data, so the
+// function must check for them before reading a child's.
+typedef void (*PGRedBlackTreeNodeUpdateFunction)(PGRedBlackTreeNode *node);
+
+// The root of a tree and the pool its nodes are allocated from. The root is NULL when the tree is empty. Functions that
+// restructure the tree update its root as needed. When statistics are enabled, rebalancing functions update the tree's
+// statistics if it has any.
+//
+// If updateNode is not NULL, rotations and removal call it on every node whose subtree changes, bottom-up, just as they
+// maintain counts. Like counts, the derived data of a new node's ancestors must be updated by whoever inserts the node.
+// Other functions that restructure trees, i.e., joining, splitting, and set operations, don't support derived data.
+typedef struct _PGRedBlackTreeCore PGRedBlackTreeCore;
+struct _PGRedBlackTreeCore {
+    PGRedBlackTreeNode *root;
+    PGRedBlackTreeNodePool *pool;
+#if PG_RED_BLACK_TREE_STATISTICS
+    PGRedBlackTreeStatistics *statistics;
+#endif
+    PGRedBlackTreeNodeUpdateFunction updateNode;
+};
+
+
+#pragma mark - Node pools
+
+extern PGRedBlackTreeNodePool *PGRedBlackTreeNodePoolCreate(size_t nodeSize, NSUInteger capacity);
+extern PGRedBlackTreeNodePool *PGRedBlackTreeNodePoolRetain(PGRedBlackTreeNodePool *pool);
+extern void PGRedBlackTreeNodePoolRelease(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *root);
+extern BOOL PGRedBlackTreeNodePoolIsShared(PGRedBlackTreeNodePool *pool);
+extern void PGRedBlackTreeNodePoolReserveCapacity(PGRedBlackTreeNodePool *pool, NSUInteger capacity);
+extern void PGRedBlackTreeNodePoolRemoveAllNodes(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *root);
+extern size_t PGRedBlackTreeNodePoolNodeSize(PGRedBlackTreeNodePool *pool);
+
+#if PG_RED_BLACK_TREE_STATISTICS
+// Gets the number of nodes allocated from and freed to the pool since it was created or its statistics were last reset.
+// Nodes freed by removing all of a pool's nodes at once are counted.
+extern void PGRedBlackTreeNodePoolGetStatistics(PGRedBlackTreeNodePool *pool, unsigned long long *allocationCount, unsigned long long *freeCount);
+extern void PGRedBlackTreeNodePoolResetStatistics(PGRedBlackTreeNodePool *pool);
+#endif
+
 
 #pragma mark - Creation and Deletion
 
-extern PGRedBlackTreeNode *PGRedBlackTreeNodeCreate(PGRedBlackTreeNode *parent, id object);
-extern void PGRedBlackTreeNodeFree(PGRedBlackTreeNode *self, BOOL freeChildren);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeCreate(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *parent, id object);
+extern void PGRedBlackTreeNodeFree(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *self);
+extern void PGRedBlackTreeNodeFreeSubnodes(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *node);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeCreateWithSortedObjects(PGRedBlackTreeNodePool *pool, id const *objects, NSUInteger count);
 
 
 #pragma mark - Object accessors
@@ -116,14 +188,79 @@ NS_INLINE PGRedBlackTreeNode *PGRedBlackTreeNodeSibling(PGRedBlackTreeNode *node
     return PGRedBlackTreeNodeIsLeftChild(node) ? node->parent->rightChild : node->parent->leftChild;
 }
 
+NS_INLINE PGRedBlackTreeNode *PGRedBlackTreeNodeLeftmostSubnode(PGRedBlackTreeNode *node)
+{
+    while (!PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
+        node = node->leftChild;
+    }
+
+    return node;
+}
+
+
+NS_INLINE PGRedBlackTreeNode *PGRedBlackTreeNodeRightmostSubnode(PGRedBlackTreeNode *node)
+{
+    while (!PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+        node = node->rightChild;
+    }
+
+    return node;
+}
+
 extern PGRedBlackTreeNode *PGRedBlackTreeNodePredecessor(PGRedBlackTreeNode *node);
 extern PGRedBlackTreeNode *PGRedBlackTreeNodeSuccessor(PGRedBlackTreeNode *node);
 
 
-#pragma mark - Rotation
+#pragma mark - Rebalancing
+
+extern void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree);
+extern void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree);
+extern void PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree);
+
+// Creates a node for object and inserts it into the tree immediately after node without comparing it to anything. The
+// caller must know that object belongs there. Like PGRedBlackTreeNodeInsertObjectNearNodeInTree, counts are updated but
+// the red-black properties are not.
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeInsertObjectAfterNodeInTree(id object, PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree);
+
+// Creates a node for object and inserts it into the tree, starting the search for its position at hint instead of at the
+// root. hint may be NULL. The closer hint is to the insertion point, the fewer comparisons the insertion takes; inserting
+// next to hint takes at most two. Counts are updated, but the caller must fix the red-black properties up with
+// PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree, which lets it inspect where the new node landed first.
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeInsertObjectNearNodeInTree(id object, PGRedBlackTreeNode *hint, PGRedBlackTreeCore *tree, NSComparator cmp);
+
+// Removes node's object from the tree. If node has two children, its predecessor or successor is spliced out instead and
+// its object (and extra data) moves into node. In that case, the spliced out node is returned so that callers that track
+// nodes by object can follow the move. It has already been freed, so only its address may be used. Otherwise, node
+// itself is freed and NULL is returned.
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeRemoveFromTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree);
+
+
+#pragma mark - Order statistics
+
+NS_INLINE NSUInteger PGRedBlackTreeNodeCountOfSubnodes(PGRedBlackTreeNode *node)
+{
+    // Sentinels have a count of 0, so we don't need to special-case missing children
+    return node->leftChild->count + node->rightChild->count + 1;
+}
+
+
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeAtIndex(PGRedBlackTreeNode *node, NSUInteger index);
+extern NSUInteger PGRedBlackTreeNodeIndex(PGRedBlackTreeNode *node);
+extern NSUInteger PGRedBlackTreeNodeCountOfSubnodesLessThanObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
+extern NSUInteger PGRedBlackTreeNodeCountOfSubnodesLessThanOrEqualToObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
 
-extern void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *node, PGRedBlackTree *tree);
-extern void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *node, PGRedBlackTree *tree);
+
+#pragma mark - Searching
+
+// These return NULL if no node in the subtree satisfies the condition
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeFirstSubnodeGreaterThanObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeLastSubnodeLessThanOrEqualToObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeLastSubnodeLessThanObject(PGRedBlackTreeNode *node, id object, NSComparator cmp);
+
+// Like PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject, but searches the whole tree containing node, starting
+// from node rather than from the root
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeFirstNodeGreaterThanOrEqualToObjectNearNode(PGRedBlackTreeNode *node, id object, NSComparator cmp);
 
 
 #pragma mark - Traversal
@@ -132,15 +269,41 @@ extern BOOL PGRedBlackTreeNodeTraverseSubnodesWithBlock(PGRedBlackTreeNode *node
                                                         void (^block)(PGRedBlackTreeNode *n, BOOL *stop));
 extern BOOL PGRedBlackTreeNodeTraverseSubnodesEqualToObject(PGRedBlackTreeNode *node,
                                                             id object, NSComparator cmp, void (^block)(PGRedBlackTreeNode *n, BOOL *stop));
-extern BOOL PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(PGRedBlackTreeNode *node, id object,
-                                                                         NSComparator cmp, void (^block)(PGRedBlackTreeNode *n, BOOL *stop));
-extern BOOL PGRedBlackTreeNodeTraverseSubnodesGreaterThanObject(PGRedBlackTreeNode *node, id obj, NSComparator cmp,
-                                                                void (^block)(PGRedBlackTreeNode *n, BOOL *stop));
+
+
+#pragma mark - Joining and splitting
+
+// These functions take and return the roots of whole trees, which are NULL when the trees are empty. They run in
+// O(log n) time and don't invoke a comparator.
+//
+// Splitting moves the first index nodes of root's tree into *left and the rest into *right. Concatenating joins two trees
+// into one, where every node in left comes before every node in right, and returns its root.
+extern void PGRedBlackTreeNodeSplitAtIndex(PGRedBlackTreeNode *root, NSUInteger index, PGRedBlackTreeNode **left, PGRedBlackTreeNode **right);
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeConcatenate(PGRedBlackTreeNode *left, PGRedBlackTreeNode *right);
+
+
+#pragma mark - Set operations
+
+// These functions replace tree's nodes with the union, intersection, or difference of its nodes and those in the subtree
+// rooted at otherRoot, which may be NULL. Nodes are considered equal if comparator returns NSOrderedSame when comparing
+// their objects. Nodes removed from tree are freed into its pool.
+//
+// A union keeps all of tree's nodes and adds the other nodes whose objects aren't equal to any of tree's. The other
+// nodes must have been allocated from tree's pool and must not be part of any other tree, as they are either moved
+// into tree or freed. An intersection keeps tree's nodes whose objects are equal to one of the other nodes', and a
+// difference keeps those whose objects aren't. For these, the other nodes are only read.
+//
+// Large inputs are processed concurrently, so comparator must be safe to invoke from multiple threads at once.
+extern void PGRedBlackTreeNodeUnionInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator);
+extern void PGRedBlackTreeNodeIntersectInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator);
+extern void PGRedBlackTreeNodeMinusInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator);
 
 
 #pragma mark - Test helpers
 
-extern BOOL PGRedBlackTreeNodeFulfillsProperties(PGRedBlackTreeNode *node, NSComparator comparator, NSUInteger blackNodesOnPathToRoot);
-extern NSUInteger PGRedBlackTreeNodeBlackNodeCountInPathFromNodeToRoot(PGRedBlackTreeNode *node);
+// Checks every red-black property, the order statistic counts, and the parent pointers of the tree rooted at root,
+// comparing the black heights of both children of every node. If comparator is NULL, nodes' objects are not checked for
+// order or nil-ness. This is useful for trees whose nodes are ordered by something other than their objects.
+extern BOOL PGRedBlackTreeNodeFulfillsProperties(PGRedBlackTreeNode *root, NSComparator comparator);
 
 #endif
@@ -25,53 +25,355 @@
 //
 
 #import "PGRedBlackTreeNode.h"
-#import "PGRedBlackTree.h"
 
+#import <pthread.h>
 
-#pragma mark Private interfaces for PGRedBlackTree
 
-@interface PGRedBlackTree (PrivateAccessors)
-- (void)setRoot:(PGRedBlackTreeNode *)root;
-@end
+#pragma mark Constants
 
+const PGRedBlackTreeNode _PGRedBlackTreeNodeSentinel = { NULL, NULL, NULL, NO, NULL, 0 };
+PGRedBlackTreeNode const * const PGRedBlackTreeNodeSentinel = &_PGRedBlackTreeNodeSentinel;
 
-#pragma mark - Constants
 
-const PGRedBlackTreeNode _PGRedBlackTreeNodeSentinel = { NULL, NULL, NULL, NO, NULL };
-PGRedBlackTreeNode const * const PGRedBlackTreeNodeSentinel = &_PGRedBlackTreeNodeSentinel;
+#pragma mark - Node pools
+
+// The first slab in a pool holds this many nodes unless a larger capacity is requested. Each subsequent slab doubles
+// in size up to PGRedBlackTreeNodePoolMaximumSlabCapacity nodes.
+static const NSUInteger PGRedBlackTreeNodePoolMinimumSlabCapacity = 64;
+static const NSUInteger PGRedBlackTreeNodePoolMaximumSlabCapacity = 65536;
+
+typedef struct _PGRedBlackTreeNodeSlab PGRedBlackTreeNodeSlab;
+struct _PGRedBlackTreeNodeSlab {
+    PGRedBlackTreeNodeSlab *next;
+    NSUInteger capacity;
+    NSUInteger usedCount;
+    char nodes[];
+};
+
+struct _PGRedBlackTreeNodePool {
+    PGRedBlackTreeNodeSlab *slabs;
+    PGRedBlackTreeNode *freeNodes;
+    NSUInteger nextSlabCapacity;
+    size_t nodeSize;
+
+    // The number of trees using the pool. The lock is only used while more than one tree is.
+    volatile int32_t referenceCount;
+    pthread_mutex_t lock;
+
+#if PG_RED_BLACK_TREE_STATISTICS
+    unsigned long long allocationCount;
+    unsigned long long freeCount;
+#endif
+};
+
+
+NS_INLINE PGRedBlackTreeNode *PGRedBlackTreeNodeSlabNodeAtIndex(PGRedBlackTreeNodeSlab *slab, NSUInteger index, size_t nodeSize)
+{
+    return (PGRedBlackTreeNode *)(slab->nodes + index * nodeSize);
+}
+
+
+static void PGRedBlackTreeNodePoolAddSlab(PGRedBlackTreeNodePool *pool, NSUInteger capacity)
+{
+    PGRedBlackTreeNodeSlab *slab = malloc(sizeof(PGRedBlackTreeNodeSlab) + capacity * pool->nodeSize);
+    if (!slab) {
+        [NSException raise:NSMallocException format:@"Could not allocate a slab of %lu red-black tree nodes", (unsigned long)capacity];
+    }
+
+    // Before the current slab is replaced, move its unused nodes onto the free list so that they aren't wasted
+    PGRedBlackTreeNodeSlab *currentSlab = pool->slabs;
+    if (currentSlab) {
+        while (currentSlab->usedCount < currentSlab->capacity) {
+            PGRedBlackTreeNode *node = PGRedBlackTreeNodeSlabNodeAtIndex(currentSlab, currentSlab->usedCount++, pool->nodeSize);
+            node->object = nil;
+            node->parent = pool->freeNodes;
+            pool->freeNodes = node;
+        }
+    }
+
+    slab->next = currentSlab;
+    slab->capacity = capacity;
+    slab->usedCount = 0;
+    pool->slabs = slab;
+
+    if (capacity >= pool->nextSlabCapacity) {
+        pool->nextSlabCapacity = MIN(capacity * 2, PGRedBlackTreeNodePoolMaximumSlabCapacity);
+    }
+}
+
+
+PGRedBlackTreeNodePool *PGRedBlackTreeNodePoolCreate(size_t nodeSize, NSUInteger capacity)
+{
+    NSCAssert(nodeSize >= sizeof(PGRedBlackTreeNode), @"nodeSize is smaller than a node");
+
+    PGRedBlackTreeNodePool *pool = calloc(1, sizeof(PGRedBlackTreeNodePool));
+    if (pool) {
+        // Round the node size up so that every node in a slab is pointer-aligned
+        pool->nodeSize = (nodeSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+        pool->nextSlabCapacity = PGRedBlackTreeNodePoolMinimumSlabCapacity;
+        pool->referenceCount = 1;
+        pthread_mutex_init(&pool->lock, NULL);
+        if (capacity > 0) PGRedBlackTreeNodePoolAddSlab(pool, capacity);
+    }
+
+    return pool;
+}
+
+
+PGRedBlackTreeNodePool *PGRedBlackTreeNodePoolRetain(PGRedBlackTreeNodePool *pool)
+{
+    NSCAssert(pool, @"pool is NULL");
+    __sync_add_and_fetch(&pool->referenceCount, 1);
+    return pool;
+}
+
+
+void PGRedBlackTreeNodePoolRelease(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *root)
+{
+    if (!pool) return;
+
+    // If other trees are still using the pool, we can only free our own nodes. If another tree released the pool at the
+    // same time, one of us will still see the count drop to zero and free everything that's left.
+    if (PGRedBlackTreeNodePoolIsShared(pool)) {
+        PGRedBlackTreeNodeFreeSubnodes(pool, root);
+        if (__sync_sub_and_fetch(&pool->referenceCount, 1) > 0) return;
+    }
+
+    PGRedBlackTreeNodePoolRemoveAllNodes(pool, NULL);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+
+BOOL PGRedBlackTreeNodePoolIsShared(PGRedBlackTreeNodePool *pool)
+{
+    NSCAssert(pool, @"pool is NULL");
+    return __sync_fetch_and_add(&pool->referenceCount, 0) > 1;
+}
+
+
+void PGRedBlackTreeNodePoolReserveCapacity(PGRedBlackTreeNodePool *pool, NSUInteger capacity)
+{
+    NSCAssert(pool, @"pool is NULL");
+
+    BOOL shared = PGRedBlackTreeNodePoolIsShared(pool);
+    if (shared) pthread_mutex_lock(&pool->lock);
+
+    // We don't bother counting the free list. If the current slab can't satisfy the request, add one that can. Adding a
+    // slab moves the current slab's unused nodes onto the free list, so the new slab only has to cover the shortfall,
+    // but it's never smaller than the next slab would have been so that many small reservations still grow the pool
+    // geometrically instead of adding many tiny slabs.
+    PGRedBlackTreeNodeSlab *slab = pool->slabs;
+    NSUInteger availableCount = slab ? slab->capacity - slab->usedCount : 0;
+    if (availableCount < capacity) {
+        PGRedBlackTreeNodePoolAddSlab(pool, MAX(capacity - availableCount, pool->nextSlabCapacity));
+    }
+
+    if (shared) pthread_mutex_unlock(&pool->lock);
+}
+
+
+void PGRedBlackTreeNodePoolRemoveAllNodes(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *root)
+{
+    NSCAssert(pool, @"pool is NULL");
+
+    // If other trees are using the pool, some of its nodes aren't ours, so free ours individually
+    if (PGRedBlackTreeNodePoolIsShared(pool)) {
+        PGRedBlackTreeNodeFreeSubnodes(pool, root);
+        return;
+    }
+
+    // Free nodes always have a nil object, so we can just release every object in every slab's used nodes. Nodes may
+    // have nil objects in trees that don't require them, but releasing nil is harmless.
+    PGRedBlackTreeNodeSlab *slab = pool->slabs;
+    while (slab) {
+        PGRedBlackTreeNodeSlab *nextSlab = slab->next;
+        for (NSUInteger i = 0; i < slab->usedCount; ++i) {
+            [PGRedBlackTreeNodeSlabNodeAtIndex(slab, i, pool->nodeSize)->object release];
+        }
+
+        free(slab);
+        slab = nextSlab;
+    }
+
+    pool->slabs = NULL;
+    pool->freeNodes = NULL;
+    pool->nextSlabCapacity = PGRedBlackTreeNodePoolMinimumSlabCapacity;
+#if PG_RED_BLACK_TREE_STATISTICS
+    pool->freeCount = pool->allocationCount;
+#endif
+}
+
+
+size_t PGRedBlackTreeNodePoolNodeSize(PGRedBlackTreeNodePool *pool)
+{
+    NSCAssert(pool, @"pool is NULL");
+    return pool->nodeSize;
+}
+
+
+#if PG_RED_BLACK_TREE_STATISTICS
+void PGRedBlackTreeNodePoolGetStatistics(PGRedBlackTreeNodePool *pool, unsigned long long *allocationCount, unsigned long long *freeCount)
+{
+    NSCAssert(pool, @"pool is NULL");
+    *allocationCount = pool->allocationCount;
+    *freeCount = pool->freeCount;
+}
+
+
+void PGRedBlackTreeNodePoolResetStatistics(PGRedBlackTreeNodePool *pool)
+{
+    NSCAssert(pool, @"pool is NULL");
+    pool->allocationCount = 0;
+    pool->freeCount = 0;
+}
+#endif
 
 
 #pragma mark - Creation and deletion
 
-PGRedBlackTreeNode *PGRedBlackTreeNodeCreate(PGRedBlackTreeNode *parent, id object)
+PGRedBlackTreeNode *PGRedBlackTreeNodeCreate(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *parent, id object)
 {
+    NSCAssert(pool, @"pool is NULL");
     NSCAssert(!PGRedBlackTreeNodeIsSentinel(parent), @"parent is a sentinel");
 
-    PGRedBlackTreeNode *self = calloc(1, sizeof(struct _PGRedBlackTreeNode));
+    // Recycle a freed node if we have one. Otherwise, take the next unused node from the current slab, adding a new
+    // slab if the current one is full
+    BOOL shared = PGRedBlackTreeNodePoolIsShared(pool);
+    if (shared) pthread_mutex_lock(&pool->lock);
+
+    PGRedBlackTreeNode *self = pool->freeNodes;
     if (self) {
-        self->parent = parent;
-        self->leftChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
-        self->rightChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
-        self->object = [object retain];
-        self->isRed = YES;
+        pool->freeNodes = self->parent;
+    } else {
+        PGRedBlackTreeNodeSlab *slab = pool->slabs;
+        if (!slab || slab->usedCount == slab->capacity) {
+            PGRedBlackTreeNodePoolAddSlab(pool, pool->nextSlabCapacity);
+            slab = pool->slabs;
+        }
+
+        self = PGRedBlackTreeNodeSlabNodeAtIndex(slab, slab->usedCount++, pool->nodeSize);
     }
-    
+
+#if PG_RED_BLACK_TREE_STATISTICS
+    ++pool->allocationCount;
+#endif
+    if (shared) pthread_mutex_unlock(&pool->lock);
+
+    self->parent = parent;
+    self->leftChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+    self->rightChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+    self->object = [object retain];
+    self->isRed = YES;
+    self->count = 1;
+
     return self;
 }
 
 
-void PGRedBlackTreeNodeFree(PGRedBlackTreeNode *self, BOOL freeChildren)
+void PGRedBlackTreeNodeFree(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *self)
 {
+    NSCAssert(pool, @"pool is NULL");
     NSCAssert(self, @"self is NULL");
     NSCAssert(!PGRedBlackTreeNodeIsSentinel(self), @"self is a sentinel");
 
     [self->object release];
-    if (freeChildren) {
-        if (!PGRedBlackTreeNodeIsSentinel(self->leftChild)) PGRedBlackTreeNodeFree(self->leftChild, YES);
-        PGRedBlackTreeNode *rightChild = self->rightChild;
-        free(self);
-        if (!PGRedBlackTreeNodeIsSentinel(rightChild)) PGRedBlackTreeNodeFree(rightChild, YES);
+    self->object = nil;
+
+    BOOL shared = PGRedBlackTreeNodePoolIsShared(pool);
+    if (shared) pthread_mutex_lock(&pool->lock);
+    self->parent = pool->freeNodes;
+    pool->freeNodes = self;
+#if PG_RED_BLACK_TREE_STATISTICS
+    ++pool->freeCount;
+#endif
+    if (shared) pthread_mutex_unlock(&pool->lock);
+}
+
+
+// Releases the objects of node's subtree and links its nodes into a list through their parent pointers, returning the
+// list's tail. *head is set to the list's head.
+static PGRedBlackTreeNode *PGRedBlackTreeNodeUnlinkSubnodes(PGRedBlackTreeNode *node, PGRedBlackTreeNode **head)
+{
+    PGRedBlackTreeNode *leftChild = node->leftChild;
+    PGRedBlackTreeNode *rightChild = node->rightChild;
+
+    [node->object release];
+    node->object = nil;
+    node->parent = NULL;
+    *head = node;
+
+    PGRedBlackTreeNode *tail = node;
+    if (!PGRedBlackTreeNodeIsSentinel(leftChild)) {
+        tail = PGRedBlackTreeNodeUnlinkSubnodes(leftChild, &tail->parent);
+    }
+
+    if (!PGRedBlackTreeNodeIsSentinel(rightChild)) {
+        tail = PGRedBlackTreeNodeUnlinkSubnodes(rightChild, &tail->parent);
     }
+
+    return tail;
+}
+
+
+void PGRedBlackTreeNodeFreeSubnodes(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *node)
+{
+    NSCAssert(pool, @"pool is NULL");
+    if (!node || PGRedBlackTreeNodeIsSentinel(node)) return;
+
+    // Release the objects first so that we don't hold the lock while arbitrary objects are deallocated. Then put the
+    // whole list on the free list at once.
+#if PG_RED_BLACK_TREE_STATISTICS
+    NSUInteger freedCount = node->count;
+#endif
+    PGRedBlackTreeNode *head;
+    PGRedBlackTreeNode *tail = PGRedBlackTreeNodeUnlinkSubnodes(node, &head);
+
+    BOOL shared = PGRedBlackTreeNodePoolIsShared(pool);
+    if (shared) pthread_mutex_lock(&pool->lock);
+    tail->parent = pool->freeNodes;
+    pool->freeNodes = head;
+#if PG_RED_BLACK_TREE_STATISTICS
+    pool->freeCount += freedCount;
+#endif
+    if (shared) pthread_mutex_unlock(&pool->lock);
+}
+
+
+static PGRedBlackTreeNode *PGRedBlackTreeNodeCreateSubtreeWithSortedObjects(PGRedBlackTreeNodePool *pool, PGRedBlackTreeNode *parent,
+                                                                            id const *objects, NSUInteger count,
+                                                                            NSUInteger depth, NSUInteger redDepth)
+{
+    if (count == 0) return (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+
+    // Use the middle object as the subtree's root and build its subtrees out of the objects on either side of it
+    NSUInteger middle = count / 2;
+    PGRedBlackTreeNode *node = PGRedBlackTreeNodeCreate(pool, parent, objects[middle]);
+    node->isRed = depth == redDepth;
+    node->count = count;
+    node->leftChild = PGRedBlackTreeNodeCreateSubtreeWithSortedObjects(pool, node, objects, middle, depth + 1, redDepth);
+    node->rightChild = PGRedBlackTreeNodeCreateSubtreeWithSortedObjects(pool, node, objects + middle + 1, count - middle - 1,
+                                                                        depth + 1, redDepth);
+    return node;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeCreateWithSortedObjects(PGRedBlackTreeNodePool *pool, id const *objects, NSUInteger count)
+{
+    NSCAssert(pool, @"pool is NULL");
+    if (count == 0) return NULL;
+
+    // Splitting around the middle object at every level means that sibling subtrees differ in size by at most one, so
+    // every level of the tree is full except possibly the deepest. If all nodes on the deepest level are red and every
+    // other node is black, every path from the root to a leaf contains the same number of black nodes and no red node
+    // has a red child. A lone root is at the deepest level, but has to be black.
+    NSUInteger redDepth = 0;
+    while ((count >> (redDepth + 1)) > 0) {
+        ++redDepth;
+    }
+
+    if (redDepth == 0) redDepth = NSUIntegerMax;
+    return PGRedBlackTreeNodeCreateSubtreeWithSortedObjects(pool, NULL, objects, count, 0, redDepth);
 }
 
 
@@ -142,7 +444,7 @@ NSString *PGRedBlackTreeNodeAppendDebugDescription(PGRedBlackTreeNode *self, NSM
 PGRedBlackTreeNode *PGRedBlackTreeNodePredecessor(PGRedBlackTreeNode *node)
 {
     NSCAssert(node, @"node is NULL");
-    if (!PGRedBlackTreeNodeIsSentinel(node)) return NULL;
+    if (PGRedBlackTreeNodeIsSentinel(node)) return NULL;
     
     // If the node doesn't have a left child, keep going up and to the right
     if (PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
@@ -187,12 +489,13 @@ PGRedBlackTreeNode *PGRedBlackTreeNodeSuccessor(PGRedBlackTreeNode *node)
 }
 
 
-#pragma mark - Rotation
+#pragma mark - Rebalancing
 
-void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *self, PGRedBlackTree *tree)
+void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *self, PGRedBlackTreeCore *tree)
 {
     NSCAssert(self, @"self is NULL");
     NSCAssert(!PGRedBlackTreeNodeIsSentinel(self), @"self is a sentinel");
+    PGRedBlackTreeStatisticsIncrement(tree, rotationCount);
 
     // Other starts off as our right child. We will end up as its left child, and its left child will become our right one
     PGRedBlackTreeNode *other = self->rightChild;
@@ -211,7 +514,7 @@ void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *self, PGRedBlackTree
     // If we were the root of the tree, make other the root of the tree. Otherwise, if we were the right child, make other
     // the right child. If we were the left child, make it the left
     if (!self->parent) {
-        [tree setRoot:other];
+        tree->root = other;
     } else if (PGRedBlackTreeNodeIsLeftChild(self)) {
         self->parent->leftChild = other;
     } else {
@@ -223,13 +526,22 @@ void PGRedBlackTreeNodeRotateLeftInTree(PGRedBlackTreeNode *self, PGRedBlackTree
     if (!PGRedBlackTreeNodeIsSentinel(self)) {
         self->parent = other;
     }
+
+    // Other now roots the subtree we used to, so it has our old count. Ours has to be recomputed from our new children.
+    other->count = self->count;
+    self->count = PGRedBlackTreeNodeCountOfSubnodes(self);
+    if (tree->updateNode) {
+        tree->updateNode(self);
+        tree->updateNode(other);
+    }
 }
 
 
-void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *self, PGRedBlackTree *tree)
+void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *self, PGRedBlackTreeCore *tree)
 {
     NSCAssert(self, @"self is NULL");
     NSCAssert(!PGRedBlackTreeNodeIsSentinel(self), @"self is a sentinel");
+    PGRedBlackTreeStatisticsIncrement(tree, rotationCount);
 
     // Other starts off as our left child. We will end up as its right child, and its right child will become our left one
     PGRedBlackTreeNode *other = self->leftChild;
@@ -248,7 +560,7 @@ void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *self, PGRedBlackTre
     // If we were the root of the tree, make other the root of the tree. Otherwise, if we were the right child, make other
     // the right child. If we were the left child, make it the left
     if (!self->parent) {
-        [tree setRoot:other];
+        tree->root = other;
     } else if (PGRedBlackTreeNodeIsLeftChild(self)) {
         self->parent->leftChild = other;
     } else {
@@ -260,6 +572,482 @@ void PGRedBlackTreeNodeRotateRightInTree(PGRedBlackTreeNode *self, PGRedBlackTre
     if (!PGRedBlackTreeNodeIsSentinel(self)) {
         self->parent = other;
     }
+
+    // Other now roots the subtree we used to, so it has our old count. Ours has to be recomputed from our new children.
+    other->count = self->count;
+    self->count = PGRedBlackTreeNodeCountOfSubnodes(self);
+    if (tree->updateNode) {
+        tree->updateNode(self);
+        tree->updateNode(other);
+    }
+}
+
+
+void PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree)
+{
+    while (true) {
+        PGRedBlackTreeStatisticsIncrement(tree, insertionFixupIterationCount);
+
+        // Case 1: Node is the root, so make it black to fulfill Property 2 and we're done
+        if (!node->parent) {
+            node->isRed = NO;
+            return;
+        }
+        
+        // Case 2: If node's parent is black, we have inserted a red node between two blacks, and thus did not affect Property 5
+        if (!node->parent->isRed) return;
+        
+        // Case 3: Parent is red. If our uncle is also red, we can set our grandparent to red, our parent and uncle to black,
+        // and then fixup our grandparent
+        PGRedBlackTreeNode *grandparent = PGRedBlackTreeNodeGrandparent(node);
+        if (!grandparent) return;
+        PGRedBlackTreeNode *uncle = PGRedBlackTreeNodeUncle(node);
+        if (uncle && uncle->isRed) {
+            node->parent->isRed = NO;
+            uncle->isRed = NO;
+            grandparent->isRed = YES;
+            node = grandparent;
+            continue;
+        }
+        
+        // Case 4: Node and its parent are red; grandparent and uncle are black. If node is a right/left child and parent is
+        // a left/right child, then we need to do a rotation and reset node and grandparent before moving on to case 5
+        if (PGRedBlackTreeNodeIsRightChild(node) && PGRedBlackTreeNodeIsLeftChild(node->parent)) {
+            PGRedBlackTreeNodeRotateLeftInTree(node->parent, tree);
+            node = node->leftChild;
+            grandparent = node->parent->parent;
+        } else if (PGRedBlackTreeNodeIsLeftChild(node) && PGRedBlackTreeNodeIsRightChild(node->parent)) {
+            PGRedBlackTreeNodeRotateRightInTree(node->parent, tree);
+            node = node->rightChild;
+            grandparent = node->parent->parent;
+        }
+        
+        // Case 5: We are red, our parent is red, and our uncle is black. Make our parent black, make our grandparent red,
+        // and do a rotation. Now everything should be fine.
+        node->parent->isRed = NO;
+        grandparent->isRed = YES;
+        if (PGRedBlackTreeNodeIsLeftChild(node->parent)) {
+            PGRedBlackTreeNodeRotateRightInTree(grandparent, tree);
+        } else {
+            PGRedBlackTreeNodeRotateLeftInTree(grandparent, tree);
+        }
+        
+        return;
+    }
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeInsertObjectAfterNodeInTree(id object, PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree)
+{
+    // The new node goes between node and its successor: node's right child if it doesn't have one, and otherwise the
+    // successor's left child, since the successor is then the leftmost node in node's right subtree
+    PGRedBlackTreeNode *newNode = NULL;
+    if (PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+        newNode = PGRedBlackTreeNodeCreate(tree->pool, node, object);
+        node->rightChild = newNode;
+    } else {
+        PGRedBlackTreeNode *successor = PGRedBlackTreeNodeLeftmostSubnode(node->rightChild);
+        newNode = PGRedBlackTreeNodeCreate(tree->pool, successor, object);
+        successor->leftChild = newNode;
+    }
+
+    for (PGRedBlackTreeNode *ancestor = newNode->parent; ancestor; ancestor = ancestor->parent) {
+        ++ancestor->count;
+    }
+
+    return newNode;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeInsertObjectNearNodeInTree(id object, PGRedBlackTreeNode *hint, PGRedBlackTreeCore *tree, NSComparator comparator)
+{
+    if (!tree->root) {
+        tree->root = PGRedBlackTreeNodeCreate(tree->pool, NULL, object);
+        return tree->root;
+    }
+
+    PGRedBlackTreeNode *node = tree->root;
+    PGRedBlackTreeNode *newNode = NULL;
+    if (hint) {
+        node = hint;
+        if (comparator(object, hint->object) >= NSOrderedSame) {
+            // If the object comes before the hint's successor, it belongs between them. This makes inserting next to
+            // the last object inserted take two comparisons, and appending after the last object in the tree take one.
+            PGRedBlackTreeNode *successor = PGRedBlackTreeNodeSuccessor(hint);
+            if (!successor || comparator(object, successor->object) < NSOrderedSame) {
+                return PGRedBlackTreeNodeInsertObjectAfterNodeInTree(object, hint, tree);
+            }
+
+            // Otherwise, rather than starting at the root, climb from the hint to the smallest subtree that must contain
+            // the insertion point. Climbing past a right child can't take us past the insertion point when it's after
+            // the hint, so we only need to compare against parents we reach from the other side.
+            while (node->parent && (PGRedBlackTreeNodeIsRightChild(node) || comparator(object, node->parent->object) >= NSOrderedSame)) {
+                node = node->parent;
+            }
+        } else {
+            // Equal objects go after the ones already in the tree, so the object belongs between the hint and its
+            // predecessor if it comes at or after the predecessor
+            PGRedBlackTreeNode *predecessor = PGRedBlackTreeNodePredecessor(hint);
+            if (!predecessor || comparator(object, predecessor->object) >= NSOrderedSame) {
+                if (PGRedBlackTreeNodeIsSentinel(hint->leftChild)) {
+                    newNode = PGRedBlackTreeNodeCreate(tree->pool, hint, object);
+                    hint->leftChild = newNode;
+                } else {
+                    newNode = PGRedBlackTreeNodeCreate(tree->pool, predecessor, object);
+                    predecessor->rightChild = newNode;
+                }
+            }
+
+            while (!newNode && node->parent && (PGRedBlackTreeNodeIsLeftChild(node) || comparator(object, node->parent->object) < NSOrderedSame)) {
+                node = node->parent;
+            }
+        }
+    }
+
+    // Descend from there exactly as a normal insertion would
+    while (!newNode) {
+        if (comparator(object, node->object) < NSOrderedSame) {
+            if (PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
+                newNode = PGRedBlackTreeNodeCreate(tree->pool, node, object);
+                node->leftChild = newNode;
+            } else {
+                node = node->leftChild;
+            }
+        } else if (PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+            newNode = PGRedBlackTreeNodeCreate(tree->pool, node, object);
+            node->rightChild = newNode;
+        } else {
+            node = node->rightChild;
+        }
+    }
+
+    // We didn't pass the ancestors above where we started on the way down, so walk back up to update every count
+    for (PGRedBlackTreeNode *ancestor = newNode->parent; ancestor; ancestor = ancestor->parent) {
+        ++ancestor->count;
+    }
+
+    return newNode;
+}
+
+
+static void PGRedBlackTreeNodeFixPropertiesAfterRemovalInTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree)
+{
+    // Note: this code is adapted from the pseudocode in CLRS.
+    while (node != tree->root && !node->isRed) {
+        PGRedBlackTreeStatisticsIncrement(tree, removalFixupIterationCount);
+        if (PGRedBlackTreeNodeIsLeftChild(node)) {
+            PGRedBlackTreeNode *sibling = node->parent->rightChild;
+            if (sibling->isRed) {
+                sibling->isRed = NO;
+                node->parent->isRed = YES;
+                PGRedBlackTreeNodeRotateLeftInTree(node->parent, tree);
+                sibling = node->parent->rightChild;
+            }
+            
+            if (!sibling->leftChild->isRed && !sibling->rightChild->isRed) {
+                sibling->isRed = YES;
+                node = node->parent;
+                continue;
+            }
+            
+            if (!sibling->rightChild->isRed) {
+                sibling->leftChild->isRed = NO;
+                sibling->isRed = YES;
+                PGRedBlackTreeNodeRotateRightInTree(sibling, tree);
+                sibling = node->parent->rightChild;
+            }
+            
+            sibling->isRed = node->parent->isRed;
+            node->parent->isRed = NO;
+            sibling->rightChild->isRed = NO;
+            PGRedBlackTreeNodeRotateLeftInTree(node->parent, tree);
+            node = tree->root;
+        } else {
+            PGRedBlackTreeNode *sibling = node->parent->leftChild;
+            if (sibling->isRed) {
+                sibling->isRed = NO;
+                node->parent->isRed = YES;
+                PGRedBlackTreeNodeRotateRightInTree(node->parent, tree);
+                sibling = node->parent->leftChild;
+            }
+            
+            if (!sibling->leftChild->isRed && !sibling->rightChild->isRed) {
+                sibling->isRed = YES;
+                node = node->parent;
+                continue;
+            }
+            
+            if (!sibling->leftChild->isRed) {
+                sibling->rightChild->isRed = NO;
+                sibling->isRed = YES;
+                PGRedBlackTreeNodeRotateLeftInTree(sibling, tree);
+                sibling = node->parent->leftChild;
+            }
+            
+            sibling->isRed = node->parent->isRed;
+            node->parent->isRed = NO;
+            sibling->leftChild->isRed = NO;
+            PGRedBlackTreeNodeRotateRightInTree(node->parent, tree);
+            node = tree->root;
+        }
+        
+    }
+
+    node->isRed = NO;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeRemoveFromTree(PGRedBlackTreeNode *node, PGRedBlackTreeCore *tree)
+{
+    NSCAssert(node, @"node is NULL");
+    NSCAssert(!PGRedBlackTreeNodeIsSentinel(node), @"node is a sentinel");
+
+    // Note: this code is adapted from the pseudocode in CLRS.
+    PGRedBlackTreeNode *nodeToSpliceOut = node;
+    
+    // If neither child is a sentinel, we'll splice out either the node's predecessor or successor
+    if (!PGRedBlackTreeNodeIsSentinel(node->leftChild) && !PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+        // This fun bit of code simply changes up whether a predecessor or successor is the node we splice out. The reason
+        // we do this is because it supposedly leads to a more balanced tree as time goes on. If the node we're removing is
+        // the left child, we try to get the successor, and if that doesn't work, we get the predecessor. If it's the right
+        // child (or doesn't have a parent), we do the opposite.
+        if (PGRedBlackTreeNodeIsLeftChild(node)) {
+            nodeToSpliceOut = PGRedBlackTreeNodeSuccessor(node);
+            if (!nodeToSpliceOut) nodeToSpliceOut = PGRedBlackTreeNodePredecessor(node);
+        } else {
+            nodeToSpliceOut = PGRedBlackTreeNodePredecessor(node);
+            if (!nodeToSpliceOut) nodeToSpliceOut = PGRedBlackTreeNodeSuccessor(node);
+        }
+    }
+    
+    // Pick the non-sentinel child of the node to splice out
+    PGRedBlackTreeNode *child = PGRedBlackTreeNodeIsSentinel(nodeToSpliceOut->leftChild) ? nodeToSpliceOut->rightChild : nodeToSpliceOut->leftChild;
+
+    // If the node we're splicing out has no non-sentinel children, fix properties with the node itself
+    // before removing it. If we do this later, our parent pointers will be messed up
+    if (!nodeToSpliceOut->isRed && PGRedBlackTreeNodeIsSentinel(child)) {
+        PGRedBlackTreeNodeFixPropertiesAfterRemovalInTree(nodeToSpliceOut, tree);
+    }
+
+    // If the child of the node we're splicing out isn't a sentinel, set its parent to its grandparent
+    if (!PGRedBlackTreeNodeIsSentinel(child)) {
+        child->parent = nodeToSpliceOut->parent;
+    }
+    
+    // If the node we're removing is the root, set the root to the child
+    if (!nodeToSpliceOut->parent) {
+        tree->root = PGRedBlackTreeNodeIsSentinel(child) ? NULL : child;
+    } else if (PGRedBlackTreeNodeIsLeftChild(nodeToSpliceOut)) {
+        nodeToSpliceOut->parent->leftChild = child;
+    } else {
+        nodeToSpliceOut->parent->rightChild = child;
+    }
+
+    // Every ancestor of the node we spliced out now has one fewer node in its subtree
+    for (PGRedBlackTreeNode *ancestor = nodeToSpliceOut->parent; ancestor; ancestor = ancestor->parent) {
+        --ancestor->count;
+    }
+
+    // If we're not the node to splice out, take over the spliced out node's object and any extra data that follows the
+    // node in memory
+    if (node != nodeToSpliceOut) {
+        [node->object release];
+        node->object = nodeToSpliceOut->object;
+        nodeToSpliceOut->object = nil;
+
+        size_t extraSize = PGRedBlackTreeNodePoolNodeSize(tree->pool) - sizeof(PGRedBlackTreeNode);
+        if (extraSize > 0) memcpy(node + 1, nodeToSpliceOut + 1, extraSize);
+    }
+
+    // node is among the ancestors, so this has to wait until it has its new data
+    if (tree->updateNode) {
+        for (PGRedBlackTreeNode *ancestor = nodeToSpliceOut->parent; ancestor; ancestor = ancestor->parent) {
+            tree->updateNode(ancestor);
+        }
+    }
+    
+    if (!nodeToSpliceOut->isRed && !PGRedBlackTreeNodeIsSentinel(child)) {
+        PGRedBlackTreeNodeFixPropertiesAfterRemovalInTree(child, tree);
+    }
+
+    PGRedBlackTreeNodeFree(tree->pool, nodeToSpliceOut);
+    return node != nodeToSpliceOut ? nodeToSpliceOut : NULL;
+}
+
+
+#pragma mark - Order statistics
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeAtIndex(PGRedBlackTreeNode *self, NSUInteger index)
+{
+    if (PGRedBlackTreeNodeIsSentinel(self) || index >= self->count) return NULL;
+
+    PGRedBlackTreeNode *node = self;
+    while (true) {
+        NSUInteger leftCount = node->leftChild->count;
+        if (index == leftCount) return node;
+
+        if (index < leftCount) {
+            node = node->leftChild;
+        } else {
+            index -= leftCount + 1;
+            node = node->rightChild;
+        }
+    }
+}
+
+
+NSUInteger PGRedBlackTreeNodeIndex(PGRedBlackTreeNode *self)
+{
+    NSCAssert(self, @"self is NULL");
+    NSCAssert(!PGRedBlackTreeNodeIsSentinel(self), @"self is a sentinel");
+
+    // Everything in our left subtree precedes us. As we go up, every time we're a right child, our parent and its left
+    // subtree precede us too.
+    NSUInteger index = self->leftChild->count;
+    PGRedBlackTreeNode *node = self;
+    while (node->parent) {
+        if (PGRedBlackTreeNodeIsRightChild(node)) {
+            index += node->parent->leftChild->count + 1;
+        }
+
+        node = node->parent;
+    }
+
+    return index;
+}
+
+
+NSUInteger PGRedBlackTreeNodeCountOfSubnodesLessThanObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    NSUInteger count = 0;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) < NSOrderedSame) {
+            // node->object < object, so it and its entire left subtree count
+            count += node->leftChild->count + 1;
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return count;
+}
+
+
+NSUInteger PGRedBlackTreeNodeCountOfSubnodesLessThanOrEqualToObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    NSUInteger count = 0;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) <= NSOrderedSame) {
+            // node->object <= object, so it and its entire left subtree count
+            count += node->leftChild->count + 1;
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return count;
+}
+
+
+#pragma mark - Searching
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    // Every time we go left, node is the best candidate we've seen so far
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) >= NSOrderedSame) {
+            candidate = node;
+            node = node->leftChild;
+        } else {
+            node = node->rightChild;
+        }
+    }
+
+    return candidate;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeFirstNodeGreaterThanOrEqualToObjectNearNode(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    // Climb from self to the smallest subtree that must contain the node we're looking for. If there is no such subtree,
+    // candidate is the nearest ancestor that is greater than or equal to object.
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = self;
+    if (comparator(self->object, object) < NSOrderedSame) {
+        while (node->parent) {
+            if (PGRedBlackTreeNodeIsLeftChild(node) && comparator(node->parent->object, object) >= NSOrderedSame) {
+                candidate = node->parent;
+                break;
+            }
+
+            node = node->parent;
+        }
+    } else {
+        while (node->parent && (PGRedBlackTreeNodeIsLeftChild(node) || comparator(node->parent->object, object) >= NSOrderedSame)) {
+            node = node->parent;
+        }
+    }
+
+    PGRedBlackTreeNode *found = PGRedBlackTreeNodeFirstSubnodeGreaterThanOrEqualToObject(node, object, comparator);
+    return found ? found : candidate;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeFirstSubnodeGreaterThanObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) > NSOrderedSame) {
+            candidate = node;
+            node = node->leftChild;
+        } else {
+            node = node->rightChild;
+        }
+    }
+
+    return candidate;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeLastSubnodeLessThanOrEqualToObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    // Every time we go right, node is the best candidate we've seen so far
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) <= NSOrderedSame) {
+            candidate = node;
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return candidate;
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeLastSubnodeLessThanObject(PGRedBlackTreeNode *self, id object, NSComparator comparator)
+{
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = self;
+    while (!PGRedBlackTreeNodeIsSentinel(node)) {
+        if (comparator(node->object, object) < NSOrderedSame) {
+            candidate = node;
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return candidate;
 }
 
 
@@ -338,79 +1126,453 @@ BOOL PGRedBlackTreeNodeTraverseSubnodesEqualToObject(PGRedBlackTreeNode *self, i
 }
 
 
-BOOL PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(PGRedBlackTreeNode *self, id object, NSComparator comparator,
-                                                                  void (^block)(PGRedBlackTreeNode *, BOOL *))
+#pragma mark - Joining and splitting
+
+// These functions operate on detached subtrees, i.e., subtrees whose roots have no parent. Empty subtrees are
+// represented by the sentinel rather than NULL. Each subtree is passed along with its black height, which is the number
+// of black nodes on any path from its root to a leaf, including the root itself. Knowing the black heights up front is
+// what lets a join run in time proportional to the difference of the heights rather than the heights themselves.
+
+static NSUInteger PGRedBlackTreeNodeBlackHeight(PGRedBlackTreeNode *node)
 {
-    if (PGRedBlackTreeNodeIsSentinel(self)) return NO;
+    NSUInteger blackHeight = 0;
+    for (; !PGRedBlackTreeNodeIsSentinel(node); node = node->leftChild) {
+        if (!node->isRed) ++blackHeight;
+    }
 
-    BOOL stop = NO;
-    NSComparisonResult result = comparator(self->object, object);
+    return blackHeight;
+}
 
-    // self->object < object, so we only need to check the right subtree
-    if (result < NSOrderedSame) {
-        return PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(self->rightChild, object, comparator, block);
+
+// Joins left, middle, and right into a single subtree, where every node in left comes before middle and every node in
+// right comes after it. Returns the new subtree's root and sets *blackHeight to its black height.
+static PGRedBlackTreeNode *PGRedBlackTreeNodeJoinSubtrees(PGRedBlackTreeNode *left, NSUInteger leftBlackHeight, PGRedBlackTreeNode *middle,
+                                                         PGRedBlackTreeNode *right, NSUInteger rightBlackHeight, NSUInteger *blackHeight)
+{
+    // Make both roots black so that middle can be red wherever it ends up without violating Property 4 from below
+    if (left->isRed) {
+        left->isRed = NO;
+        ++leftBlackHeight;
     }
-    
-    // self->object == object, so we have to check both directions
-    if (result == NSOrderedSame) {
-        if (!PGRedBlackTreeNodeIsSentinel(self->leftChild)) {
-            stop = PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(self->leftChild, object, comparator, block);
-            if (stop) return YES;
-        }
 
-        block(self, &stop);
-        if (stop) return YES;
+    if (right->isRed) {
+        right->isRed = NO;
+        ++rightBlackHeight;
+    }
 
-        return PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(self->rightChild, object, comparator, block);
+    // If the subtrees have the same black height, middle can simply become their parent
+    if (leftBlackHeight == rightBlackHeight) {
+        middle->parent = NULL;
+        middle->leftChild = left;
+        middle->rightChild = right;
+        middle->isRed = NO;
+        middle->count = left->count + right->count + 1;
+        if (!PGRedBlackTreeNodeIsSentinel(left)) left->parent = middle;
+        if (!PGRedBlackTreeNodeIsSentinel(right)) right->parent = middle;
+
+        *blackHeight = leftBlackHeight + 1;
+        return middle;
     }
-    
-    // self->object > object, so we need to check the left subtree, but we and our right subtree need to be traversed no matter what
-    if (!PGRedBlackTreeNodeIsSentinel(self->leftChild)) {
-        stop = PGRedBlackTreeNodeTraverseSubnodesGreaterThanOrEqualToObject(self->leftChild, object, comparator, block);
-        if (stop) return YES;
+
+    // Otherwise, walk down the inner spine of the taller subtree until we find a black node whose black height matches
+    // the shorter subtree's. That node and the shorter subtree become middle's children, and middle takes the black
+    // node's place as a red node. Every node we pass on the way down gains the shorter subtree and middle as descendants.
+    BOOL leftIsTaller = leftBlackHeight > rightBlackHeight;
+    PGRedBlackTreeNode *tallerRoot = leftIsTaller ? left : right;
+    PGRedBlackTreeNode *shorterRoot = leftIsTaller ? right : left;
+    NSUInteger shorterBlackHeight = leftIsTaller ? rightBlackHeight : leftBlackHeight;
+    NSUInteger addedCount = shorterRoot->count + 1;
+
+    PGRedBlackTreeNode *parent = NULL;
+    PGRedBlackTreeNode *node = tallerRoot;
+    NSUInteger nodeBlackHeight = leftIsTaller ? leftBlackHeight : rightBlackHeight;
+    while (node->isRed || nodeBlackHeight != shorterBlackHeight) {
+        if (!node->isRed) --nodeBlackHeight;
+        node->count += addedCount;
+        parent = node;
+        node = leftIsTaller ? node->rightChild : node->leftChild;
     }
-    
-    block(self, &stop);
-    if (stop) return YES;
-    
-    return !PGRedBlackTreeNodeIsSentinel(self->rightChild) ? PGRedBlackTreeNodeTraverseSubnodesWithBlock(self->rightChild, block) : NO;
+
+    middle->parent = parent;
+    middle->isRed = YES;
+    middle->count = node->count + addedCount;
+    if (leftIsTaller) {
+        parent->rightChild = middle;
+        middle->leftChild = node;
+        middle->rightChild = shorterRoot;
+    } else {
+        parent->leftChild = middle;
+        middle->leftChild = shorterRoot;
+        middle->rightChild = node;
+    }
+
+    if (!PGRedBlackTreeNodeIsSentinel(node)) node->parent = middle;
+    if (!PGRedBlackTreeNodeIsSentinel(shorterRoot)) shorterRoot->parent = middle;
+
+    // Middle may now be a red child of a red node, which is exactly the situation after an insertion. Fixing it never
+    // changes the black height of a tree with a black root.
+    PGRedBlackTreeCore core = { tallerRoot, NULL };
+    PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(middle, &core);
+
+    *blackHeight = leftIsTaller ? leftBlackHeight : rightBlackHeight;
+    return core.root;
 }
 
 
-BOOL PGRedBlackTreeNodeTraverseSubnodesGreaterThanObject(PGRedBlackTreeNode *self, id object, NSComparator comparator,
-                                                         void (^block)(PGRedBlackTreeNode *, BOOL *))
+// Splits node's subtree into two subtrees, the left of which contains the first index nodes of the subtree and the
+// right of which contains the rest.
+static void PGRedBlackTreeNodeSplitSubtreeAtIndex(PGRedBlackTreeNode *node, NSUInteger blackHeight, NSUInteger index,
+                                                  PGRedBlackTreeNode **left, NSUInteger *leftBlackHeight,
+                                                  PGRedBlackTreeNode **right, NSUInteger *rightBlackHeight)
 {
-    if (PGRedBlackTreeNodeIsSentinel(self)) return NO;
+    if (index == 0 || index >= node->count) {
+        PGRedBlackTreeNode *sentinel = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+        *left = index == 0 ? sentinel : node;
+        *leftBlackHeight = index == 0 ? 0 : blackHeight;
+        *right = index == 0 ? node : sentinel;
+        *rightBlackHeight = index == 0 ? blackHeight : 0;
+        return;
+    }
 
-    BOOL stop = NO;
-    NSComparisonResult result = comparator(self->object, object);
-    if (result <= NSOrderedSame) {
-        // self->object < object, so we only need to check the right subtree
-        return PGRedBlackTreeNodeTraverseSubnodesGreaterThanObject(self->rightChild, object, comparator, block);
+    // Detach node's children and split whichever one contains the split point. Node is then joined back together with
+    // its other child and the near half of the split child.
+    PGRedBlackTreeNode *leftChild = node->leftChild;
+    PGRedBlackTreeNode *rightChild = node->rightChild;
+    NSUInteger childBlackHeight = node->isRed ? blackHeight : blackHeight - 1;
+    if (!PGRedBlackTreeNodeIsSentinel(leftChild)) leftChild->parent = NULL;
+    if (!PGRedBlackTreeNodeIsSentinel(rightChild)) rightChild->parent = NULL;
+
+    if (index <= leftChild->count) {
+        PGRedBlackTreeNode *splitRight;
+        NSUInteger splitRightBlackHeight;
+        PGRedBlackTreeNodeSplitSubtreeAtIndex(leftChild, childBlackHeight, index, left, leftBlackHeight, &splitRight, &splitRightBlackHeight);
+        *right = PGRedBlackTreeNodeJoinSubtrees(splitRight, splitRightBlackHeight, node, rightChild, childBlackHeight, rightBlackHeight);
+    } else {
+        PGRedBlackTreeNode *splitLeft;
+        NSUInteger splitLeftBlackHeight;
+        PGRedBlackTreeNodeSplitSubtreeAtIndex(rightChild, childBlackHeight, index - leftChild->count - 1, &splitLeft, &splitLeftBlackHeight,
+                                              right, rightBlackHeight);
+        *left = PGRedBlackTreeNodeJoinSubtrees(leftChild, childBlackHeight, node, splitLeft, splitLeftBlackHeight, leftBlackHeight);
     }
-    
-    
-    // self.object > object, so we need to check the left subtree, but we and our right subtree need to be traversed no matter what
-    if (!PGRedBlackTreeNodeIsSentinel(self->leftChild)) {
-        stop = PGRedBlackTreeNodeTraverseSubnodesGreaterThanObject(self->leftChild, object, comparator, block);
-        if (stop) return YES;
+}
+
+
+// Splits node's subtree into the nodes whose objects are less than, equal to, and greater than object
+static void PGRedBlackTreeNodeSplitSubtreeAtObject(PGRedBlackTreeNode *node, NSUInteger blackHeight, id object, NSComparator comparator,
+                                                   PGRedBlackTreeNode **less, NSUInteger *lessBlackHeight,
+                                                   PGRedBlackTreeNode **equal, NSUInteger *equalBlackHeight,
+                                                   PGRedBlackTreeNode **greater, NSUInteger *greaterBlackHeight)
+{
+    NSUInteger lessCount = PGRedBlackTreeNodeCountOfSubnodesLessThanObject(node, object, comparator);
+    NSUInteger lessOrEqualCount = PGRedBlackTreeNodeCountOfSubnodesLessThanOrEqualToObject(node, object, comparator);
+
+    PGRedBlackTreeNode *rest;
+    NSUInteger restBlackHeight;
+    PGRedBlackTreeNodeSplitSubtreeAtIndex(node, blackHeight, lessCount, less, lessBlackHeight, &rest, &restBlackHeight);
+    PGRedBlackTreeNodeSplitSubtreeAtIndex(rest, restBlackHeight, lessOrEqualCount - lessCount, equal, equalBlackHeight, greater, greaterBlackHeight);
+}
+
+
+// Joins left and right into a single subtree, where every node in left comes before every node in right
+static PGRedBlackTreeNode *PGRedBlackTreeNodeConcatenateSubtrees(PGRedBlackTreeNode *left, NSUInteger leftBlackHeight,
+                                                                PGRedBlackTreeNode *right, NSUInteger rightBlackHeight,
+                                                                NSUInteger *blackHeight)
+{
+    if (PGRedBlackTreeNodeIsSentinel(left) || PGRedBlackTreeNodeIsSentinel(right)) {
+        *blackHeight = PGRedBlackTreeNodeIsSentinel(left) ? rightBlackHeight : leftBlackHeight;
+        return PGRedBlackTreeNodeIsSentinel(left) ? right : left;
     }
-    
-    block(self, &stop);
-    if (stop) return YES;
-    
-    return !PGRedBlackTreeNodeIsSentinel(self->rightChild) ? PGRedBlackTreeNodeTraverseSubnodesWithBlock(self->rightChild, block) : NO;
+
+    // Split off left's last node and use it to join the rest of left with right
+    PGRedBlackTreeNode *rest, *last;
+    NSUInteger restBlackHeight, lastBlackHeight;
+    PGRedBlackTreeNodeSplitSubtreeAtIndex(left, leftBlackHeight, left->count - 1, &rest, &restBlackHeight, &last, &lastBlackHeight);
+    return PGRedBlackTreeNodeJoinSubtrees(rest, restBlackHeight, last, right, rightBlackHeight, blackHeight);
+}
+
+
+// Turns a subtree into a tree by making its root black, or returns NULL if the subtree is empty
+static PGRedBlackTreeNode *PGRedBlackTreeNodeMakeRoot(PGRedBlackTreeNode *node)
+{
+    if (PGRedBlackTreeNodeIsSentinel(node)) return NULL;
+    node->isRed = NO;
+    node->parent = NULL;
+    return node;
+}
+
+
+void PGRedBlackTreeNodeSplitAtIndex(PGRedBlackTreeNode *root, NSUInteger index, PGRedBlackTreeNode **left, PGRedBlackTreeNode **right)
+{
+    NSCAssert(left && right, @"left or right is NULL");
+    if (!root) root = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+
+    PGRedBlackTreeNode *leftRoot, *rightRoot;
+    NSUInteger leftBlackHeight, rightBlackHeight;
+    PGRedBlackTreeNodeSplitSubtreeAtIndex(root, PGRedBlackTreeNodeBlackHeight(root), index, &leftRoot, &leftBlackHeight,
+                                          &rightRoot, &rightBlackHeight);
+    *left = PGRedBlackTreeNodeMakeRoot(leftRoot);
+    *right = PGRedBlackTreeNodeMakeRoot(rightRoot);
+}
+
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeConcatenate(PGRedBlackTreeNode *left, PGRedBlackTreeNode *right)
+{
+    if (!left) return right;
+    if (!right) return left;
+
+    NSUInteger blackHeight;
+    PGRedBlackTreeNode *root = PGRedBlackTreeNodeConcatenateSubtrees(left, PGRedBlackTreeNodeBlackHeight(left),
+                                                                     right, PGRedBlackTreeNodeBlackHeight(right), &blackHeight);
+    return PGRedBlackTreeNodeMakeRoot(root);
+}
+
+
+#pragma mark - Set operations
+
+// Set operations on subtrees that are large enough are performed concurrently. Below this many nodes, the overhead of
+// dispatching isn't worth it.
+static const NSUInteger PGRedBlackTreeNodeConcurrentSetOperationMinimumCount = 4096;
+
+typedef enum {
+    PGRedBlackTreeNodeSetOperationUnion,
+    PGRedBlackTreeNodeSetOperationIntersection,
+    PGRedBlackTreeNodeSetOperationDifference
+} PGRedBlackTreeNodeSetOperation;
+
+// A list of nodes that have been removed by a set operation, linked through their parent pointers. Because the node pool
+// isn't thread-safe, removed nodes are collected while the operation runs and freed once it's done.
+typedef struct _PGRedBlackTreeNodeList {
+    PGRedBlackTreeNode *head;
+    PGRedBlackTreeNode *tail;
+} PGRedBlackTreeNodeList;
+
+// The input and output of one step of a set operation. The operation combines node's subtree with other's, leaving the
+// result in node and blackHeight and adding any nodes that were removed to removedNodes.
+typedef struct _PGRedBlackTreeNodeSetOperationTask {
+    PGRedBlackTreeNode *node;
+    NSUInteger blackHeight;
+    PGRedBlackTreeNode *other;
+    NSUInteger otherBlackHeight;
+    PGRedBlackTreeNodeList removedNodes;
+} PGRedBlackTreeNodeSetOperationTask;
+
+
+static void PGRedBlackTreeNodeListAppendList(PGRedBlackTreeNodeList *list, PGRedBlackTreeNodeList *otherList)
+{
+    if (!otherList->head) return;
+
+    if (list->tail) {
+        list->tail->parent = otherList->head;
+    } else {
+        list->head = otherList->head;
+    }
+
+    list->tail = otherList->tail;
+}
+
+
+static void PGRedBlackTreeNodeListAppendSubnodes(PGRedBlackTreeNodeList *list, PGRedBlackTreeNode *node)
+{
+    if (PGRedBlackTreeNodeIsSentinel(node)) return;
+
+    PGRedBlackTreeNodeListAppendSubnodes(list, node->leftChild);
+    PGRedBlackTreeNodeListAppendSubnodes(list, node->rightChild);
+
+    node->parent = NULL;
+    PGRedBlackTreeNodeList nodeList = { node, node };
+    PGRedBlackTreeNodeListAppendList(list, &nodeList);
+}
+
+
+static void PGRedBlackTreeNodeListFree(PGRedBlackTreeNodeList *list, PGRedBlackTreeNodePool *pool)
+{
+    PGRedBlackTreeNode *node = list->head;
+    while (node) {
+        PGRedBlackTreeNode *next = node->parent;
+        PGRedBlackTreeNodeFree(pool, node);
+        node = next;
+    }
+
+    list->head = NULL;
+    list->tail = NULL;
+}
+
+
+// Note: these algorithms are adapted from Blelloch, Ferizovic, and Sun's "Just Join for Parallel Ordered Sets." Each
+// step splits the task's subtree around the object at the root of the other subtree, recursively combines the pieces
+// with the other root's children, and joins the results back together. The two recursive steps touch disjoint nodes,
+// so they can run concurrently. The other subtree's nodes only become part of the result for unions, so for the other
+// operations it is only read and may be shared between threads.
+static void PGRedBlackTreeNodePerformSetOperation(PGRedBlackTreeNodeSetOperation operation, PGRedBlackTreeNodeSetOperationTask *task,
+                                                  NSComparator comparator)
+{
+    PGRedBlackTreeNode *node = task->node;
+    PGRedBlackTreeNode *other = task->other;
+
+    // Handle the cases where either subtree is empty
+    if (PGRedBlackTreeNodeIsSentinel(other)) {
+        if (operation == PGRedBlackTreeNodeSetOperationIntersection) {
+            PGRedBlackTreeNodeListAppendSubnodes(&task->removedNodes, node);
+            task->node = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+            task->blackHeight = 0;
+        }
+
+        return;
+    }
+
+    if (PGRedBlackTreeNodeIsSentinel(node)) {
+        if (operation == PGRedBlackTreeNodeSetOperationUnion) {
+            task->node = other;
+            task->blackHeight = task->otherBlackHeight;
+        }
+
+        return;
+    }
+
+    BOOL concurrent = node->count + other->count >= PGRedBlackTreeNodeConcurrentSetOperationMinimumCount;
+
+    // Split our subtree around other's object
+    PGRedBlackTreeNode *less, *equal, *greater;
+    NSUInteger lessBlackHeight, equalBlackHeight, greaterBlackHeight;
+    PGRedBlackTreeNodeSplitSubtreeAtObject(node, task->blackHeight, other->object, comparator, &less, &lessBlackHeight,
+                                           &equal, &equalBlackHeight, &greater, &greaterBlackHeight);
+
+    PGRedBlackTreeNode *otherLeftChild = other->leftChild;
+    PGRedBlackTreeNode *otherRightChild = other->rightChild;
+    NSUInteger otherLeftChildBlackHeight = other->isRed ? task->otherBlackHeight : task->otherBlackHeight - 1;
+    NSUInteger otherRightChildBlackHeight = otherLeftChildBlackHeight;
+
+    // If middle is set below, it's used to join the two halves of the result. Otherwise, whatever is left of equal is.
+    PGRedBlackTreeNode *middle = NULL;
+
+    switch (operation) {
+        case PGRedBlackTreeNodeSetOperationUnion:
+            // Other's nodes are being merged into ours, so detach its children
+            if (!PGRedBlackTreeNodeIsSentinel(otherLeftChild)) otherLeftChild->parent = NULL;
+            if (!PGRedBlackTreeNodeIsSentinel(otherRightChild)) otherRightChild->parent = NULL;
+
+            if (PGRedBlackTreeNodeIsSentinel(equal)) {
+                middle = other;
+            } else {
+                // We already have objects equal to other's, so other and any equal objects in its subtree are redundant.
+                // Those are at the end of its left subtree and the start of its right.
+                PGRedBlackTreeNode *redundant;
+                NSUInteger redundantBlackHeight;
+                NSUInteger index = PGRedBlackTreeNodeCountOfSubnodesLessThanObject(otherLeftChild, other->object, comparator);
+                PGRedBlackTreeNodeSplitSubtreeAtIndex(otherLeftChild, otherLeftChildBlackHeight, index, &otherLeftChild,
+                                                      &otherLeftChildBlackHeight, &redundant, &redundantBlackHeight);
+                PGRedBlackTreeNodeListAppendSubnodes(&task->removedNodes, redundant);
+
+                index = PGRedBlackTreeNodeCountOfSubnodesLessThanOrEqualToObject(otherRightChild, other->object, comparator);
+                PGRedBlackTreeNodeSplitSubtreeAtIndex(otherRightChild, otherRightChildBlackHeight, index, &redundant,
+                                                      &redundantBlackHeight, &otherRightChild, &otherRightChildBlackHeight);
+                PGRedBlackTreeNodeListAppendSubnodes(&task->removedNodes, redundant);
+
+                other->leftChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+                other->rightChild = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+                PGRedBlackTreeNodeListAppendSubnodes(&task->removedNodes, other);
+            }
+
+            break;
+        case PGRedBlackTreeNodeSetOperationIntersection:
+            // Our objects that are equal to other's are kept
+            break;
+        case PGRedBlackTreeNodeSetOperationDifference:
+            // Our objects that are equal to other's are removed
+            PGRedBlackTreeNodeListAppendSubnodes(&task->removedNodes, equal);
+            equal = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+            equalBlackHeight = 0;
+            break;
+    }
+
+    // Combine the pieces of our subtree with the corresponding children of other
+    PGRedBlackTreeNodeSetOperationTask subtasks[2] = {
+        { less, lessBlackHeight, otherLeftChild, otherLeftChildBlackHeight, { NULL, NULL } },
+        { greater, greaterBlackHeight, otherRightChild, otherRightChildBlackHeight, { NULL, NULL } }
+    };
+
+    if (concurrent) {
+        PGRedBlackTreeNodeSetOperationTask *subtasksPointer = subtasks;
+        dispatch_apply(2, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            @autoreleasepool {
+                PGRedBlackTreeNodePerformSetOperation(operation, &subtasksPointer[i], comparator);
+            }
+        });
+    } else {
+        PGRedBlackTreeNodePerformSetOperation(operation, &subtasks[0], comparator);
+        PGRedBlackTreeNodePerformSetOperation(operation, &subtasks[1], comparator);
+    }
+
+    PGRedBlackTreeNodeListAppendList(&task->removedNodes, &subtasks[0].removedNodes);
+    PGRedBlackTreeNodeListAppendList(&task->removedNodes, &subtasks[1].removedNodes);
+
+    // Join the results back together
+    if (middle) {
+        task->node = PGRedBlackTreeNodeJoinSubtrees(subtasks[0].node, subtasks[0].blackHeight, middle,
+                                                    subtasks[1].node, subtasks[1].blackHeight, &task->blackHeight);
+    } else {
+        NSUInteger blackHeight;
+        PGRedBlackTreeNode *joined = PGRedBlackTreeNodeConcatenateSubtrees(subtasks[0].node, subtasks[0].blackHeight,
+                                                                           equal, equalBlackHeight, &blackHeight);
+        task->node = PGRedBlackTreeNodeConcatenateSubtrees(joined, blackHeight, subtasks[1].node, subtasks[1].blackHeight,
+                                                           &task->blackHeight);
+    }
+}
+
+
+static void PGRedBlackTreeNodePerformSetOperationInTree(PGRedBlackTreeNodeSetOperation operation, PGRedBlackTreeNode *otherRoot,
+                                                        PGRedBlackTreeCore *tree, NSComparator comparator)
+{
+    PGRedBlackTreeNode *sentinel = (PGRedBlackTreeNode *)PGRedBlackTreeNodeSentinel;
+    PGRedBlackTreeNode *root = tree->root ? tree->root : sentinel;
+    if (!otherRoot) otherRoot = sentinel;
+
+    PGRedBlackTreeNodeSetOperationTask task = {
+        root, PGRedBlackTreeNodeBlackHeight(root), otherRoot, PGRedBlackTreeNodeBlackHeight(otherRoot), { NULL, NULL }
+    };
+
+    PGRedBlackTreeNodePerformSetOperation(operation, &task, comparator);
+    PGRedBlackTreeNodeListFree(&task.removedNodes, tree->pool);
+
+    tree->root = PGRedBlackTreeNodeMakeRoot(task.node);
+}
+
+
+void PGRedBlackTreeNodeUnionInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator)
+{
+    NSCAssert(tree, @"tree is NULL");
+    PGRedBlackTreeNodePerformSetOperationInTree(PGRedBlackTreeNodeSetOperationUnion, otherRoot, tree, comparator);
+}
+
+
+void PGRedBlackTreeNodeIntersectInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator)
+{
+    NSCAssert(tree, @"tree is NULL");
+    PGRedBlackTreeNodePerformSetOperationInTree(PGRedBlackTreeNodeSetOperationIntersection, otherRoot, tree, comparator);
+}
+
+
+void PGRedBlackTreeNodeMinusInTree(PGRedBlackTreeNode *otherRoot, PGRedBlackTreeCore *tree, NSComparator comparator)
+{
+    NSCAssert(tree, @"tree is NULL");
+    PGRedBlackTreeNodePerformSetOperationInTree(PGRedBlackTreeNodeSetOperationDifference, otherRoot, tree, comparator);
 }
 
 
 #pragma mark - Test helpers
 
-BOOL PGRedBlackTreeNodeFulfillsProperties(PGRedBlackTreeNode *node, NSComparator comparator, NSUInteger blackNodeCount)
+// Checks the subtree rooted at node and sets *blackHeight to the number of black nodes on each path from node down to a
+// sentinel, not counting the sentinel. previousNode is the last node checked in order, which each node's object must
+// not be less than.
+static BOOL PGRedBlackTreeNodeSubtreeFulfillsProperties(PGRedBlackTreeNode *node, NSComparator comparator,
+                                                        PGRedBlackTreeNode **previousNode, NSUInteger *blackHeight)
 {
     // Note: Most of the return statements in this code are on their own line to aid in debugging
-    
-    // If we're a sentinel node, we're at the end of the recursion, so just run these first
+
+    // If we're a sentinel node, we're at the end of the recursion
     if (PGRedBlackTreeNodeIsSentinel(node)) {
+        *blackHeight = 0;
+
         // Property 3
         if (!node->isRed && !node->object) {
             return YES;
@@ -418,47 +1580,62 @@ BOOL PGRedBlackTreeNodeFulfillsProperties(PGRedBlackTreeNode *node, NSComparator
             return NO;
         }
     }
-    
-    if (!node->object) {
+
+    if (comparator && !node->object) {
         return NO;
     }
-    
-    // Check the left child
-    if (!PGRedBlackTreeNodeFulfillsProperties(node->leftChild, comparator, blackNodeCount)) return NO;
-    
-    // Properties 2 and 4
-    if (node->isRed && (!node->parent || node->leftChild->isRed || node->leftChild->isRed)) {
+
+    // Order statistic counts
+    if (node->count != PGRedBlackTreeNodeCountOfSubnodes(node)) {
         return NO;
     }
-    
-    if (PGRedBlackTreeNodeIsSentinel(node->leftChild) && PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
-        // Property 5
-        if (blackNodeCount != PGRedBlackTreeNodeBlackNodeCountInPathFromNodeToRoot(node)) {
-            return NO;
-        }
-    } else {
-        // Basic BST test
-        if (!PGRedBlackTreeNodeIsSentinel(node->leftChild) && comparator(node->leftChild->object, node->object) > NSOrderedSame) {
-            return NO;
-        }
-        
-        if (!PGRedBlackTreeNodeIsSentinel(node->rightChild) && comparator(node->rightChild->object, node->object) < NSOrderedSame) {
-            return NO;
-        }
+
+    // Parent pointers
+    if ((!PGRedBlackTreeNodeIsSentinel(node->leftChild) && node->leftChild->parent != node) ||
+        (!PGRedBlackTreeNodeIsSentinel(node->rightChild) && node->rightChild->parent != node)) {
+        return NO;
     }
-    
-    // Check the right child
-    return PGRedBlackTreeNodeFulfillsProperties(node->rightChild, comparator, blackNodeCount);
+
+    // Property 4: both of a red node's children are black
+    if (node->isRed && (node->leftChild->isRed || node->rightChild->isRed)) {
+        return NO;
+    }
+
+    // Check the left subtree, then that we're not less than the objects before us, then the right subtree
+    NSUInteger leftBlackHeight, rightBlackHeight;
+    if (!PGRedBlackTreeNodeSubtreeFulfillsProperties(node->leftChild, comparator, previousNode, &leftBlackHeight)) {
+        return NO;
+    }
+
+    if (comparator && *previousNode && comparator((*previousNode)->object, node->object) > NSOrderedSame) {
+        return NO;
+    }
+
+    *previousNode = node;
+    if (!PGRedBlackTreeNodeSubtreeFulfillsProperties(node->rightChild, comparator, previousNode, &rightBlackHeight)) {
+        return NO;
+    }
+
+    // Property 5, checked for every subtree rather than only for the paths from leaves to the root
+    if (leftBlackHeight != rightBlackHeight) {
+        return NO;
+    }
+
+    *blackHeight = leftBlackHeight + (node->isRed ? 0 : 1);
+    return YES;
 }
 
 
-NSUInteger PGRedBlackTreeNodeBlackNodeCountInPathFromNodeToRoot(PGRedBlackTreeNode *node)
+BOOL PGRedBlackTreeNodeFulfillsProperties(PGRedBlackTreeNode *root, NSComparator comparator)
 {
-    NSUInteger blackNodeCount = 0;
-    while (node) {
-        if (!node->isRed) ++blackNodeCount;
-        node = node->parent;
+    if (!root) return YES;
+
+    // Property 2
+    if (root->isRed || root->parent) {
+        return NO;
     }
-    
-    return blackNodeCount;
-}
\ No newline at end of file
+
+    PGRedBlackTreeNode *previousNode = NULL;
+    NSUInteger blackHeight;
+    return PGRedBlackTreeNodeSubtreeFulfillsProperties(root, comparator, &previousNode, &blackHeight);
+}
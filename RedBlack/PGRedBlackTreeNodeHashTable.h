@@ -0,0 +1,74 @@
+//
+//  PGRedBlackTreeNodeHashTable.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#ifndef PGREDBLACKTREENODEHASHTABLE_H
+#define PGREDBLACKTREENODEHASHTABLE_H
+
+#import "PGRedBlackTreeNode.h"
+
+
+#pragma mark - Types
+
+// A hash table from objects to the tree nodes that hold them. Objects are hashed with -hash and compared with -isEqual:.
+// The table uses open addressing with linear probing, and each slot caches its object's hash so that probing and
+// growing the table never have to message an object. If several nodes hold equal objects, lookups return any of them.
+//
+// The table doesn't retain objects or nodes. It is up to the tree to add and remove nodes as they enter and leave the
+// tree, and to tell the table when a node's object moves to another node.
+typedef struct _PGRedBlackTreeNodeHashTable PGRedBlackTreeNodeHashTable;
+
+
+#pragma mark - Creation and Deletion
+
+// The functions that allocate memory don't throw. Create returns NULL if the table could not be allocated, and the
+// functions that add nodes return NO and leave the table unchanged if it could not grow, so that the tree can throw
+// an exception on its own behalf.
+extern PGRedBlackTreeNodeHashTable *PGRedBlackTreeNodeHashTableCreate(NSUInteger capacity);
+extern void PGRedBlackTreeNodeHashTableFree(PGRedBlackTreeNodeHashTable *table);
+
+
+#pragma mark - Adding and removing nodes
+
+extern BOOL PGRedBlackTreeNodeHashTableAddNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node);
+
+// Adds every node in the subtree rooted at node, which may be NULL
+extern BOOL PGRedBlackTreeNodeHashTableAddSubnodes(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node);
+
+// node must be in the table and still hold the object it was added with
+extern void PGRedBlackTreeNodeHashTableRemoveNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node);
+
+// Makes the entry for oldNode refer to node instead. node must now hold the object that oldNode held when it was added.
+// oldNode is never dereferenced, so it may already have been freed.
+extern void PGRedBlackTreeNodeHashTableReplaceNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *oldNode, PGRedBlackTreeNode *node);
+
+extern void PGRedBlackTreeNodeHashTableRemoveAllNodes(PGRedBlackTreeNodeHashTable *table);
+
+
+#pragma mark - Lookup
+
+// Returns NULL if no node's object is equal to object
+extern PGRedBlackTreeNode *PGRedBlackTreeNodeHashTableNodeForObject(PGRedBlackTreeNodeHashTable *table, id object);
+
+#endif
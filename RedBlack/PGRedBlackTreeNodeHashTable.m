@@ -0,0 +1,248 @@
+//
+//  PGRedBlackTreeNodeHashTable.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGRedBlackTreeNodeHashTable.h"
+
+
+#pragma mark Constants
+
+static const NSUInteger PGRedBlackTreeNodeHashTableMinimumCapacity = 16;
+
+// Multiplying by 2^64 / phi and keeping the high bits spreads out hashes like NSNumber's, whose low bits are often
+// sequential or all the same
+static const NSUInteger PGRedBlackTreeNodeHashTableHashMultiplier = (NSUInteger)0x9E3779B97F4A7C15ULL;
+
+
+#pragma mark - Types
+
+typedef struct _PGRedBlackTreeNodeHashTableSlot {
+    NSUInteger hash;
+    PGRedBlackTreeNode *node;
+} PGRedBlackTreeNodeHashTableSlot;
+
+struct _PGRedBlackTreeNodeHashTable {
+    PGRedBlackTreeNodeHashTableSlot *slots;
+    NSUInteger capacity;
+    NSUInteger count;
+
+    // The number of bits to shift a multiplied hash right by to get its home slot
+    NSUInteger shift;
+};
+
+
+#pragma mark - Private functions
+
+NS_INLINE NSUInteger PGRedBlackTreeNodeHashTableHomeIndex(PGRedBlackTreeNodeHashTable *table, NSUInteger hash)
+{
+    return (hash * PGRedBlackTreeNodeHashTableHashMultiplier) >> table->shift;
+}
+
+
+// Returns NO and leaves the table unchanged if the slots could not be allocated
+static BOOL PGRedBlackTreeNodeHashTableAllocateSlots(PGRedBlackTreeNodeHashTable *table, NSUInteger capacity)
+{
+    PGRedBlackTreeNodeHashTableSlot *slots = calloc(capacity, sizeof(PGRedBlackTreeNodeHashTableSlot));
+    if (!slots) return NO;
+
+    NSUInteger shift = sizeof(NSUInteger) * CHAR_BIT;
+    for (NSUInteger i = capacity; i > 1; i >>= 1) {
+        --shift;
+    }
+
+    table->slots = slots;
+    table->capacity = capacity;
+    table->shift = shift;
+    return YES;
+}
+
+
+static void PGRedBlackTreeNodeHashTableInsertSlot(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNodeHashTableSlot slot)
+{
+    NSUInteger mask = table->capacity - 1;
+    NSUInteger index = PGRedBlackTreeNodeHashTableHomeIndex(table, slot.hash);
+    while (table->slots[index].node) {
+        index = (index + 1) & mask;
+    }
+
+    table->slots[index] = slot;
+}
+
+
+// Makes sure the table can hold count nodes while staying no more than half full, which keeps linear probe sequences short.
+// Returns NO and leaves the table unchanged if it could not grow.
+static BOOL PGRedBlackTreeNodeHashTableReserveCapacity(PGRedBlackTreeNodeHashTable *table, NSUInteger count)
+{
+    NSUInteger capacity = table->capacity;
+    while (count > capacity / 2) {
+        capacity *= 2;
+    }
+
+    if (capacity == table->capacity) return YES;
+
+    PGRedBlackTreeNodeHashTableSlot *oldSlots = table->slots;
+    NSUInteger oldCapacity = table->capacity;
+    if (!PGRedBlackTreeNodeHashTableAllocateSlots(table, capacity)) return NO;
+
+    // Slots cache their hashes, so rehashing doesn't message any objects
+    for (NSUInteger i = 0; i < oldCapacity; ++i) {
+        if (oldSlots[i].node) PGRedBlackTreeNodeHashTableInsertSlot(table, oldSlots[i]);
+    }
+
+    free(oldSlots);
+    return YES;
+}
+
+
+// Empties the slot at index. Rather than leaving a tombstone, later slots in the same probe sequence are shifted back
+// into the gap so that lookups can always stop at the first empty slot.
+static void PGRedBlackTreeNodeHashTableRemoveSlotAtIndex(PGRedBlackTreeNodeHashTable *table, NSUInteger index)
+{
+    NSUInteger mask = table->capacity - 1;
+    NSUInteger gap = index;
+    for (NSUInteger i = (gap + 1) & mask; table->slots[i].node; i = (i + 1) & mask) {
+        // The slot can only move back if the gap lies between its home index and where it is now
+        NSUInteger home = PGRedBlackTreeNodeHashTableHomeIndex(table, table->slots[i].hash);
+        BOOL staysPut = gap <= i ? (gap < home && home <= i) : (gap < home || home <= i);
+        if (!staysPut) {
+            table->slots[gap] = table->slots[i];
+            gap = i;
+        }
+    }
+
+    table->slots[gap].node = NULL;
+    --table->count;
+}
+
+
+// Returns the index of the slot for node, which is probed for using hash
+static NSUInteger PGRedBlackTreeNodeHashTableIndexOfNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node, NSUInteger hash)
+{
+    NSUInteger mask = table->capacity - 1;
+    NSUInteger index = PGRedBlackTreeNodeHashTableHomeIndex(table, hash);
+    while (table->slots[index].node != node) {
+        NSCAssert(table->slots[index].node, @"node is not in the hash table");
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+
+static void PGRedBlackTreeNodeHashTableAddSubnodesRecursively(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node)
+{
+    if (PGRedBlackTreeNodeIsSentinel(node)) return;
+    PGRedBlackTreeNodeHashTableInsertSlot(table, (PGRedBlackTreeNodeHashTableSlot){ [node->object hash], node });
+    PGRedBlackTreeNodeHashTableAddSubnodesRecursively(table, node->leftChild);
+    PGRedBlackTreeNodeHashTableAddSubnodesRecursively(table, node->rightChild);
+}
+
+
+#pragma mark - Creation and Deletion
+
+PGRedBlackTreeNodeHashTable *PGRedBlackTreeNodeHashTableCreate(NSUInteger capacity)
+{
+    PGRedBlackTreeNodeHashTable *table = calloc(1, sizeof(PGRedBlackTreeNodeHashTable));
+    if (!table) return NULL;
+
+    if (!PGRedBlackTreeNodeHashTableAllocateSlots(table, PGRedBlackTreeNodeHashTableMinimumCapacity) ||
+        !PGRedBlackTreeNodeHashTableReserveCapacity(table, capacity)) {
+        PGRedBlackTreeNodeHashTableFree(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+
+void PGRedBlackTreeNodeHashTableFree(PGRedBlackTreeNodeHashTable *table)
+{
+    if (!table) return;
+    free(table->slots);
+    free(table);
+}
+
+
+#pragma mark - Adding and removing nodes
+
+BOOL PGRedBlackTreeNodeHashTableAddNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node)
+{
+    NSCAssert(node && !PGRedBlackTreeNodeIsSentinel(node), @"node is NULL or a sentinel");
+    if (!PGRedBlackTreeNodeHashTableReserveCapacity(table, table->count + 1)) return NO;
+    PGRedBlackTreeNodeHashTableInsertSlot(table, (PGRedBlackTreeNodeHashTableSlot){ [node->object hash], node });
+    ++table->count;
+    return YES;
+}
+
+
+BOOL PGRedBlackTreeNodeHashTableAddSubnodes(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node)
+{
+    if (!node) return YES;
+
+    // Node counts are subtree sizes, so we can make room for every node up front
+    if (!PGRedBlackTreeNodeHashTableReserveCapacity(table, table->count + node->count)) return NO;
+    PGRedBlackTreeNodeHashTableAddSubnodesRecursively(table, node);
+    table->count += node->count;
+    return YES;
+}
+
+
+void PGRedBlackTreeNodeHashTableRemoveNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *node)
+{
+    NSCAssert(node && !PGRedBlackTreeNodeIsSentinel(node), @"node is NULL or a sentinel");
+    PGRedBlackTreeNodeHashTableRemoveSlotAtIndex(table, PGRedBlackTreeNodeHashTableIndexOfNode(table, node, [node->object hash]));
+}
+
+
+void PGRedBlackTreeNodeHashTableReplaceNode(PGRedBlackTreeNodeHashTable *table, PGRedBlackTreeNode *oldNode, PGRedBlackTreeNode *node)
+{
+    NSCAssert(node && !PGRedBlackTreeNodeIsSentinel(node), @"node is NULL or a sentinel");
+
+    // node has oldNode's object, so hashing it leads us to oldNode's slot
+    table->slots[PGRedBlackTreeNodeHashTableIndexOfNode(table, oldNode, [node->object hash])].node = node;
+}
+
+
+void PGRedBlackTreeNodeHashTableRemoveAllNodes(PGRedBlackTreeNodeHashTable *table)
+{
+    memset(table->slots, 0, table->capacity * sizeof(PGRedBlackTreeNodeHashTableSlot));
+    table->count = 0;
+}
+
+
+#pragma mark - Lookup
+
+PGRedBlackTreeNode *PGRedBlackTreeNodeHashTableNodeForObject(PGRedBlackTreeNodeHashTable *table, id object)
+{
+    if (!object) return NULL;
+
+    NSUInteger hash = [object hash];
+    NSUInteger mask = table->capacity - 1;
+    for (NSUInteger index = PGRedBlackTreeNodeHashTableHomeIndex(table, hash); table->slots[index].node; index = (index + 1) & mask) {
+        PGRedBlackTreeNode *node = table->slots[index].node;
+        if (table->slots[index].hash == hash && (object == node->object || [object isEqual:node->object])) return node;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,249 @@
+//
+//  PGScalarRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract Constants that indicate how the keys in a scalar tree are compared.
+ @constant PGScalarKeyTypeInt64 Keys are compared as signed 64-bit integers using their int64Value.
+ @constant PGScalarKeyTypeUInt64 Keys are compared as unsigned 64-bit integers using their uint64Value.
+ @constant PGScalarKeyTypeDouble Keys are compared as doubles using their doubleValue. NaN keys are not supported.
+ @constant PGScalarKeyTypeCustom Keys are compared using a C comparison function.
+ */
+typedef NS_ENUM(NSUInteger, PGScalarKeyType) {
+    PGScalarKeyTypeInt64,
+    PGScalarKeyTypeUInt64,
+    PGScalarKeyTypeDouble,
+    PGScalarKeyTypeCustom
+};
+
+/*!
+ @abstract A key in a scalar tree.
+ @discussion Which member is meaningful depends on the tree's key type.
+ */
+typedef union {
+    int64_t int64Value;
+    uint64_t uint64Value;
+    double doubleValue;
+} PGScalarKey;
+
+/*!
+ @abstract The type of C function used to compare keys in trees whose key type is PGScalarKeyTypeCustom.
+ @discussion The function should return NSOrderedAscending if key1 is less than key2, NSOrderedDescending if key1 is
+     greater than key2, and NSOrderedSame otherwise.
+ */
+typedef NSComparisonResult (*PGScalarKeyComparisonFunction)(PGScalarKey key1, PGScalarKey key2);
+
+NS_INLINE PGScalarKey PGScalarKeyMakeInt64(int64_t value)
+{
+    PGScalarKey key;
+    key.int64Value = value;
+    return key;
+}
+
+
+NS_INLINE PGScalarKey PGScalarKeyMakeUInt64(uint64_t value)
+{
+    PGScalarKey key;
+    key.uint64Value = value;
+    return key;
+}
+
+
+NS_INLINE PGScalarKey PGScalarKeyMakeDouble(double value)
+{
+    PGScalarKey key;
+    key.doubleValue = value;
+    return key;
+}
+
+
+/*!
+ @abstract PGScalarRedBlackTree is a red-black tree whose entries are ordered by scalar keys stored inline in the tree's
+     nodes.
+ @discussion Each entry in the tree has a key and an optional object. Keys are compared directly as integers or doubles
+     or using a C function, so searching, counting, and enumerating never send a message or invoke a block other than the
+     one passed in. Objects are retained, not copied, and never affect the order of the tree. Entries with equal keys
+     are kept in the order they were added.
+ 
+     The tree shares its node, rebalancing, and allocation code with PGRedBlackTree.
+ */
+@interface PGScalarRedBlackTree : NSObject
+
+/*!
+ @abstract The number of entries in the tree.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract How the tree compares its keys.
+ */
+@property(readonly, assign) PGScalarKeyType keyType;
+
+/*!
+ @abstract Creates and returns a tree that compares its keys according to the specified key type.
+ @param keyType The key type of the new tree. May not be PGScalarKeyTypeCustom.
+ @result A new empty tree or nil if keyType is PGScalarKeyTypeCustom.
+ */
++ (PGScalarRedBlackTree *)treeWithKeyType:(PGScalarKeyType)keyType;
+
+/*!
+ @abstract Creates and returns a tree that compares its keys using the specified function.
+ @param function The function used to compare keys in the new tree. May not be NULL.
+ @result A new empty tree or nil if function is NULL.
+ */
++ (PGScalarRedBlackTree *)treeWithKeyComparisonFunction:(PGScalarKeyComparisonFunction)function;
+
+/*!
+ @abstract Returns an initialized tree whose keys are signed 64-bit integers.
+ @result A newly initialized tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized tree that compares its keys according to the specified key type.
+ @param keyType The key type of the new tree. May not be PGScalarKeyTypeCustom.
+ @result A newly initialized tree or nil if keyType is PGScalarKeyTypeCustom.
+ */
+- (id)initWithKeyType:(PGScalarKeyType)keyType;
+
+/*!
+ @abstract Returns an initialized tree that compares its keys using the specified function.
+ @param function The function used to compare keys in the new tree. May not be NULL.
+ @result A newly initialized tree or nil if function is NULL.
+ */
+- (id)initWithKeyComparisonFunction:(PGScalarKeyComparisonFunction)function;
+
+/*!
+ @abstract Returns an initialized tree that compares its keys according to the specified key type and has room for the
+     specified number of entries.
+ @discussion This is the designated initializer.
+ @param keyType The key type of the new tree.
+ @param function The function used to compare keys when keyType is PGScalarKeyTypeCustom. Must be NULL for any other
+     key type and may not be NULL for PGScalarKeyTypeCustom.
+ @param capacity The number of entries for which space should be reserved.
+ @result A newly initialized tree or nil if keyType and function are inconsistent.
+ */
+- (id)initWithKeyType:(PGScalarKeyType)keyType
+   comparisonFunction:(PGScalarKeyComparisonFunction)function
+             capacity:(NSUInteger)capacity;
+
+/*!
+ @abstract Adds an entry with the specified key and object to the tree.
+ @discussion If the tree already has entries with the same key, the new entry is placed after them.
+ @param key The key of the new entry.
+ @param object The object associated with the key. This object is retained by the tree. May be nil.
+ */
+- (void)addKey:(PGScalarKey)key object:(id)object;
+
+/*!
+ @abstract Returns whether the tree has an entry with the specified key.
+ @param key The key being searched for.
+ @result YES if an entry with the specified key is in the tree and NO otherwise.
+ */
+- (BOOL)containsKey:(PGScalarKey)key;
+
+/*!
+ @abstract Returns the object of the first entry with the specified key.
+ @param key The key being searched for.
+ @result The object of the first entry with the specified key, or nil if there is no such entry.
+ */
+- (id)objectForKey:(PGScalarKey)key;
+
+/*!
+ @abstract Removes the first entry with the specified key from the tree.
+ @param key The key of the entry to remove.
+ @result YES if an entry was removed and NO otherwise.
+ */
+- (BOOL)removeKey:(PGScalarKey)key;
+
+/*!
+ @abstract Removes all entries from the tree.
+ */
+- (void)removeAllKeys;
+
+/*!
+ @abstract Gets the key and object of the entry at the specified index.
+ @discussion Entries are indexed in sorted order starting at 0. This takes O(log n) time.
+ @param key On return, the key of the entry. May be NULL.
+ @param object On return, the object of the entry. May be NULL.
+ @param index The index of the entry.
+ @throws NSRangeException if index is greater than or equal to the number of entries in the tree.
+ */
+- (void)getKey:(PGScalarKey *)key object:(id *)object atIndex:(NSUInteger)index;
+
+/*!
+ @abstract Returns the number of entries whose keys are less than the specified key.
+ @discussion This is also the index of the first entry whose key is greater than or equal to the specified key. This
+     takes O(log n) time.
+ @param key The key to compare against.
+ @result The number of entries whose keys are less than key.
+ */
+- (NSUInteger)countOfKeysLessThanKey:(PGScalarKey)key;
+
+/*!
+ @abstract Returns the number of entries whose keys are less than or equal to the specified key.
+ @discussion This takes O(log n) time.
+ @param key The key to compare against.
+ @result The number of entries whose keys are less than or equal to key.
+ */
+- (NSUInteger)countOfKeysLessThanOrEqualToKey:(PGScalarKey)key;
+
+/*!
+ @abstract Copies the keys and objects of the entries in the specified range into the specified buffers.
+ @discussion The objects are not retained.
+ @param keys A buffer large enough to hold range.length keys. May be NULL.
+ @param objects A buffer large enough to hold range.length objects. May be NULL.
+ @param range The range of indexes whose entries should be copied.
+ @throws NSRangeException if any part of range lies beyond the end of the tree.
+ */
+- (void)getKeys:(PGScalarKey *)keys objects:(id *)objects range:(NSRange)range;
+
+/*!
+ @abstract Executes the specified block for every entry in the tree in sorted order.
+ @param block The block to apply to the entries. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(PGScalarKey key, id object, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block for every entry whose key lies between the specified bounds.
+ @discussion The tree seeks directly to the first entry within the bounds and walks from there, so this takes
+     O(log n + m) time, where m is the number of entries enumerated.
+ @param fromKey The lower bound.
+ @param fromInclusive Whether entries whose keys are equal to fromKey are included.
+ @param toKey The upper bound.
+ @param toInclusive Whether entries whose keys are equal to toKey are included.
+ @param options Enumeration options. If NSEnumerationReverse is set, entries are enumerated from the upper bound down.
+     NSEnumerationConcurrent is ignored.
+ @param block The block to apply to the entries. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateKeysAndObjectsFromKey:(PGScalarKey)fromKey inclusive:(BOOL)fromInclusive
+                                 toKey:(PGScalarKey)toKey inclusive:(BOOL)toInclusive
+                               options:(NSEnumerationOptions)options
+                            usingBlock:(void (^)(PGScalarKey key, id object, BOOL *stop))block;
+
+@end
@@ -0,0 +1,414 @@
+//
+//  PGScalarRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGScalarRedBlackTree.h"
+
+#import "PGRedBlackTreeNode.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Scalar nodes
+
+// Scalar nodes are ordinary nodes followed by a key. Because the node is the struct's first member, a pointer to a
+// scalar node can be used anywhere a node pointer can, and all rebalancing is done by the shared node functions.
+typedef struct _PGScalarRedBlackTreeNode {
+    PGRedBlackTreeNode node;
+    PGScalarKey key;
+} PGScalarRedBlackTreeNode;
+
+
+NS_INLINE PGScalarKey PGScalarRedBlackTreeNodeGetKey(PGRedBlackTreeNode *node)
+{
+    return ((PGScalarRedBlackTreeNode *)node)->key;
+}
+
+
+NS_INLINE NSComparisonResult PGScalarKeyCompare(PGScalarKeyType keyType, PGScalarKeyComparisonFunction function,
+                                                PGScalarKey key1, PGScalarKey key2)
+{
+    switch (keyType) {
+        case PGScalarKeyTypeInt64:
+            if (key1.int64Value < key2.int64Value) return NSOrderedAscending;
+            return key1.int64Value > key2.int64Value ? NSOrderedDescending : NSOrderedSame;
+        case PGScalarKeyTypeUInt64:
+            if (key1.uint64Value < key2.uint64Value) return NSOrderedAscending;
+            return key1.uint64Value > key2.uint64Value ? NSOrderedDescending : NSOrderedSame;
+        case PGScalarKeyTypeDouble:
+            if (key1.doubleValue < key2.doubleValue) return NSOrderedAscending;
+            return key1.doubleValue > key2.doubleValue ? NSOrderedDescending : NSOrderedSame;
+        default:
+            return function(key1, key2);
+    }
+}
+
+
+#pragma mark - Private interfaces
+
+@interface PGScalarRedBlackTree () {
+    PGRedBlackTreeCore _core;
+    PGScalarKeyComparisonFunction _comparisonFunction;
+}
+
+@property(readwrite, assign) NSUInteger count;
+@property(readwrite, assign) PGScalarKeyType keyType;
+
+- (PGRedBlackTreeNode *)firstNodeFromKey:(PGScalarKey)key inclusive:(BOOL)inclusive;
+- (PGRedBlackTreeNode *)lastNodeToKey:(PGScalarKey)key inclusive:(BOOL)inclusive;
+
+@end
+
+
+@interface PGScalarRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGScalarRedBlackTree
+
++ (PGScalarRedBlackTree *)treeWithKeyType:(PGScalarKeyType)keyType
+{
+    return [[[self alloc] initWithKeyType:keyType] autorelease];
+}
+
+
++ (PGScalarRedBlackTree *)treeWithKeyComparisonFunction:(PGScalarKeyComparisonFunction)function
+{
+    return [[[self alloc] initWithKeyComparisonFunction:function] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithKeyType:PGScalarKeyTypeInt64];
+}
+
+
+- (id)initWithKeyType:(PGScalarKeyType)keyType
+{
+    return [self initWithKeyType:keyType comparisonFunction:NULL capacity:0];
+}
+
+
+- (id)initWithKeyComparisonFunction:(PGScalarKeyComparisonFunction)function
+{
+    return [self initWithKeyType:PGScalarKeyTypeCustom comparisonFunction:function capacity:0];
+}
+
+
+- (id)initWithKeyType:(PGScalarKeyType)keyType
+   comparisonFunction:(PGScalarKeyComparisonFunction)function
+             capacity:(NSUInteger)capacity
+{
+    if (keyType > PGScalarKeyTypeCustom || (keyType == PGScalarKeyTypeCustom) != (function != NULL)) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        _keyType = keyType;
+        _comparisonFunction = function;
+        _core.pool = PGRedBlackTreeNodePoolCreate(sizeof(PGScalarRedBlackTreeNode), capacity);
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    PGRedBlackTreeNodePoolRelease(_core.pool, _core.root);
+    [super dealloc];
+}
+
+
+#pragma mark - Adding and removing entries
+
+- (void)addKey:(PGScalarKey)key object:(id)object
+{
+    PGRedBlackTreeNode *newNode;
+
+    if (!_core.root) {
+        newNode = PGRedBlackTreeNodeCreate(_core.pool, NULL, object);
+        _core.root = newNode;
+    } else {
+        // Equal keys go to the right so that entries with the same key stay in the order they were added. The new node
+        // will be in the subtree of every node we pass on the way down, so increment their counts as we go.
+        PGRedBlackTreeNode *node = _core.root;
+        while (true) {
+            ++node->count;
+            if (PGScalarKeyCompare(_keyType, _comparisonFunction, key, PGScalarRedBlackTreeNodeGetKey(node)) < NSOrderedSame) {
+                if (PGRedBlackTreeNodeIsSentinel(node->leftChild)) {
+                    newNode = PGRedBlackTreeNodeCreate(_core.pool, node, object);
+                    node->leftChild = newNode;
+                    break;
+                }
+
+                node = node->leftChild;
+            } else {
+                if (PGRedBlackTreeNodeIsSentinel(node->rightChild)) {
+                    newNode = PGRedBlackTreeNodeCreate(_core.pool, node, object);
+                    node->rightChild = newNode;
+                    break;
+                }
+
+                node = node->rightChild;
+            }
+        }
+    }
+
+    ((PGScalarRedBlackTreeNode *)newNode)->key = key;
+    PGRedBlackTreeNodeFixPropertiesAfterInsertionInTree(newNode, &_core);
+    ++_count;
+}
+
+
+- (BOOL)removeKey:(PGScalarKey)key
+{
+    PGRedBlackTreeNode *node = [self firstNodeFromKey:key inclusive:YES];
+    if (!node || PGScalarKeyCompare(_keyType, _comparisonFunction, PGScalarRedBlackTreeNodeGetKey(node), key) != NSOrderedSame) {
+        return NO;
+    }
+
+    PGRedBlackTreeNodeRemoveFromTree(node, &_core);
+    --_count;
+    return YES;
+}
+
+
+- (void)removeAllKeys
+{
+    if (!_core.root) return;
+    PGRedBlackTreeNodePoolRemoveAllNodes(_core.pool, _core.root);
+    _core.root = NULL;
+    _count = 0;
+}
+
+
+#pragma mark - Searching
+
+- (BOOL)containsKey:(PGScalarKey)key
+{
+    PGRedBlackTreeNode *node = _core.root;
+    while (node && !PGRedBlackTreeNodeIsSentinel(node)) {
+        NSComparisonResult result = PGScalarKeyCompare(_keyType, _comparisonFunction, key, PGScalarRedBlackTreeNodeGetKey(node));
+        if (result == NSOrderedSame) return YES;
+        node = result < NSOrderedSame ? node->leftChild : node->rightChild;
+    }
+
+    return NO;
+}
+
+
+- (id)objectForKey:(PGScalarKey)key
+{
+    PGRedBlackTreeNode *node = [self firstNodeFromKey:key inclusive:YES];
+    if (!node || PGScalarKeyCompare(_keyType, _comparisonFunction, PGScalarRedBlackTreeNodeGetKey(node), key) != NSOrderedSame) {
+        return nil;
+    }
+
+    return node->object;
+}
+
+
+- (PGRedBlackTreeNode *)firstNodeFromKey:(PGScalarKey)key inclusive:(BOOL)inclusive
+{
+    // Every time we go left, node is the best candidate we've seen so far
+    NSComparisonResult lowestResult = inclusive ? NSOrderedSame : NSOrderedDescending;
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = _core.root;
+    while (node && !PGRedBlackTreeNodeIsSentinel(node)) {
+        if (PGScalarKeyCompare(_keyType, _comparisonFunction, PGScalarRedBlackTreeNodeGetKey(node), key) >= lowestResult) {
+            candidate = node;
+            node = node->leftChild;
+        } else {
+            node = node->rightChild;
+        }
+    }
+
+    return candidate;
+}
+
+
+- (PGRedBlackTreeNode *)lastNodeToKey:(PGScalarKey)key inclusive:(BOOL)inclusive
+{
+    // Every time we go right, node is the best candidate we've seen so far
+    NSComparisonResult highestResult = inclusive ? NSOrderedSame : NSOrderedAscending;
+    PGRedBlackTreeNode *candidate = NULL;
+    PGRedBlackTreeNode *node = _core.root;
+    while (node && !PGRedBlackTreeNodeIsSentinel(node)) {
+        if (PGScalarKeyCompare(_keyType, _comparisonFunction, PGScalarRedBlackTreeNodeGetKey(node), key) <= highestResult) {
+            candidate = node;
+            node = node->rightChild;
+        } else {
+            node = node->leftChild;
+        }
+    }
+
+    return candidate;
+}
+
+
+#pragma mark - Order statistics
+
+- (void)getKey:(PGScalarKey *)key object:(id *)object atIndex:(NSUInteger)index
+{
+    if (index >= _count) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Index %lu beyond bounds of tree with count %lu.",
+                                                                (unsigned long)index, (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    PGRedBlackTreeNode *node = PGRedBlackTreeNodeAtIndex(_core.root, index);
+    if (key) *key = PGScalarRedBlackTreeNodeGetKey(node);
+    if (object) *object = node->object;
+}
+
+
+- (NSUInteger)countOfKeysLessThanKey:(PGScalarKey)key
+{
+    PGRedBlackTreeNode *node = [self firstNodeFromKey:key inclusive:YES];
+    return node ? PGRedBlackTreeNodeIndex(node) : _count;
+}
+
+
+- (NSUInteger)countOfKeysLessThanOrEqualToKey:(PGScalarKey)key
+{
+    PGRedBlackTreeNode *node = [self firstNodeFromKey:key inclusive:NO];
+    return node ? PGRedBlackTreeNodeIndex(node) : _count;
+}
+
+
+- (void)getKeys:(PGScalarKey *)keys objects:(id *)objects range:(NSRange)range
+{
+    if (range.location > _count || range.length > _count - range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of tree with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)_count)
+                                     userInfo:nil];
+    }
+
+    PGRedBlackTreeNode *node = range.length > 0 ? PGRedBlackTreeNodeAtIndex(_core.root, range.location) : NULL;
+    for (NSUInteger i = 0; i < range.length; ++i) {
+        if (keys) keys[i] = PGScalarRedBlackTreeNodeGetKey(node);
+        if (objects) objects[i] = node->object;
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
+}
+
+
+#pragma mark - Enumeration
+
+- (void)enumerateKeysAndObjectsUsingBlock:(void (^)(PGScalarKey, id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    if (!_core.root) return;
+    BOOL stop = NO;
+    for (PGRedBlackTreeNode *node = PGRedBlackTreeNodeLeftmostSubnode(_core.root); node; node = PGRedBlackTreeNodeSuccessor(node)) {
+        block(PGScalarRedBlackTreeNodeGetKey(node), node->object, &stop);
+        if (stop) return;
+    }
+}
+
+
+- (void)enumerateKeysAndObjectsFromKey:(PGScalarKey)fromKey inclusive:(BOOL)fromInclusive
+                                 toKey:(PGScalarKey)toKey inclusive:(BOOL)toInclusive
+                               options:(NSEnumerationOptions)options
+                            usingBlock:(void (^)(PGScalarKey, id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    if (!_core.root) return;
+    BOOL stop = NO;
+
+    if (options & NSEnumerationReverse) {
+        // Seek to the last node that is within the upper bound and walk predecessors until we pass the lower bound
+        NSComparisonResult lowestResult = fromInclusive ? NSOrderedSame : NSOrderedDescending;
+        PGRedBlackTreeNode *node = [self lastNodeToKey:toKey inclusive:toInclusive];
+        while (node) {
+            PGScalarKey key = PGScalarRedBlackTreeNodeGetKey(node);
+            if (PGScalarKeyCompare(_keyType, _comparisonFunction, key, fromKey) < lowestResult) return;
+            block(key, node->object, &stop);
+            if (stop) return;
+            node = PGRedBlackTreeNodePredecessor(node);
+        }
+
+        return;
+    }
+
+    // Seek to the first node that is within the lower bound and walk successors until we pass the upper bound
+    NSComparisonResult highestResult = toInclusive ? NSOrderedSame : NSOrderedAscending;
+    PGRedBlackTreeNode *node = [self firstNodeFromKey:fromKey inclusive:fromInclusive];
+    while (node) {
+        PGScalarKey key = PGScalarRedBlackTreeNodeGetKey(node);
+        if (PGScalarKeyCompare(_keyType, _comparisonFunction, key, toKey) > highestResult) return;
+        block(key, node->object, &stop);
+        if (stop) return;
+        node = PGRedBlackTreeNodeSuccessor(node);
+    }
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation PGScalarRedBlackTree (PropertyVerification)
+
+- (BOOL)fulfillsProperties
+{
+    if (!_core.root) return YES;
+
+    // Our objects don't determine the tree's order, so check the structure with the shared function and then check
+    // that the keys are in order ourselves
+    if (!PGRedBlackTreeNodeFulfillsProperties(_core.root, NULL)) {
+        return NO;
+    }
+
+    PGRedBlackTreeNode *node = PGRedBlackTreeNodeLeftmostSubnode(_core.root);
+    for (PGRedBlackTreeNode *successor = PGRedBlackTreeNodeSuccessor(node); successor; successor = PGRedBlackTreeNodeSuccessor(successor)) {
+        if (PGScalarKeyCompare(_keyType, _comparisonFunction, PGScalarRedBlackTreeNodeGetKey(node), PGScalarRedBlackTreeNodeGetKey(successor)) > NSOrderedSame) {
+            return NO;
+        }
+
+        node = successor;
+    }
+
+    return YES;
+}
+
+@end
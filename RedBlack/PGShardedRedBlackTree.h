@@ -0,0 +1,424 @@
+//
+//  PGShardedRedBlackTree.h
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/*!
+ @abstract PGShardedRedBlackTree is a sorted collection that many threads can mutate at once.
+ @discussion The tree partitions its objects by range into a fixed number of shards, each of which is a PGRedBlackTree
+     with its own lock. Shard i holds the objects that are greater than or equal to split object i - 1 and less than
+     split object i. Adding, removing, and finding an object takes O(log s) comparisons to pick its shard, where s is
+     the number of shards, and then locks only that shard, so threads working in different parts of the key space do
+     not wait for each other. Equal objects are always in the same shard.
+
+     Split objects may be given up front or chosen by the tree. Trees that choose their own split objects rebalance
+     automatically: once a shard holds more than twice its share of the tree's objects, the tree locks every shard and
+     picks new split objects that divide its objects evenly. Split objects are chosen by rank using the shards' order
+     statistics, which takes O(s log n) time, and objects only move between neighboring shards, so rebalancing takes
+     time proportional to the number of objects that cross a shard boundary rather than to the size of the tree.
+
+     Ordered queries stitch the shards together. Enumeration and range queries visit the shards in order, copying out
+     each shard's objects while it is locked and invoking the block with no locks held, so the block may use the tree.
+     Each shard is read atomically, but the tree may be mutated between shards, so the objects seen do not necessarily
+     form a snapshot of the whole tree. Use PGConcurrentRedBlackTree when readers need consistent snapshots. Order
+     statistics and range removals lock every shard they depend on at once, so their results are consistent.
+
+     All of the tree's methods are thread-safe. Because the comparator is invoked from multiple threads at once, it must
+     be safe to do so. The tree supports PGRedBlackTree's membership, removal, order statistic, and enumeration methods.
+     It does not support -getObjects:range: or cursors, which hand out unretained objects and node positions that other
+     threads could invalidate at any time, or splitting, joining, set operations, archiving, hinted insertion, and
+     maximum counts, which are defined in terms of a single tree's nodes.
+ */
+@interface PGShardedRedBlackTree : NSObject <NSFastEnumeration>
+
+/*!
+ @abstract The number of objects in the tree.
+ @discussion The count is the sum of the shards' counts, each read while that shard is locked.
+ */
+@property(readonly, assign) NSUInteger count;
+
+/*!
+ @abstract The number of shards the tree's objects are partitioned into.
+ */
+@property(readonly, assign) NSUInteger shardCount;
+
+/*!
+ @abstract Whether the tree picks new split objects when its shards become unbalanced.
+ @discussion This is YES for trees created with -initWithComparator:shardCount: and NO for trees created with
+     explicit split objects.
+ */
+@property(readonly, assign) BOOL rebalancesAutomatically;
+
+/*!
+ @abstract Creates and returns a sharded tree that uses compare: to compare its objects and chooses its own split
+     objects.
+ @param shardCount The number of shards. Must be greater than 0.
+ @result A new sharded tree or nil if shardCount is 0.
+ */
++ (PGShardedRedBlackTree *)treeWithShardCount:(NSUInteger)shardCount;
+
+/*!
+ @abstract Returns an initialized sharded tree that uses compare: to compare its objects and has one automatically
+     rebalanced shard per active processor.
+ @result A newly initialized sharded tree.
+ */
+- (id)init;
+
+/*!
+ @abstract Returns an initialized sharded tree that uses the specified block to compare its objects and chooses its
+     own split objects.
+ @discussion Until the tree first rebalances, all of its objects are in one shard.
+ @param comparator The block used to compare objects in the new tree. It must be safe to invoke from multiple threads
+     at once. May not be nil.
+ @param shardCount The number of shards. Must be greater than 0.
+ @result A newly initialized sharded tree or nil if comparator is nil or shardCount is 0.
+ */
+- (id)initWithComparator:(NSComparator)comparator shardCount:(NSUInteger)shardCount;
+
+/*!
+ @abstract Returns an initialized sharded tree that uses the specified block to compare its objects and partitions
+     them at the specified split objects.
+ @discussion The tree has one more shard than there are split objects. It does not rebalance automatically, so split
+     objects should be chosen to spread the expected objects and writes evenly.
+ @param comparator The block used to compare objects in the new tree. It must be safe to invoke from multiple threads
+     at once. May not be nil.
+ @param splitObjects The objects that divide the shards. Copies of them are sorted using comparator. If nil or empty,
+     the tree has a single shard.
+ @result A newly initialized sharded tree or nil if comparator is nil.
+ */
+- (id)initWithComparator:(NSComparator)comparator splitObjects:(NSArray *)splitObjects;
+
+/*!
+ @abstract Returns the objects that currently divide the tree's shards in ascending order.
+ @discussion A tree that rebalances automatically has no split objects until it first rebalances.
+ @result The tree's split objects.
+ */
+- (NSArray *)splitObjects;
+
+/*!
+ @abstract Chooses new split objects that divide the tree's objects evenly among its shards and moves the objects into
+     their new shards.
+ @discussion This locks every shard. It takes O(s log n) time to choose the split objects plus O(log n) time for each
+     object that has to move into a neighboring shard. It replaces the split objects of trees created with explicit
+     split objects, too.
+ */
+- (void)rebalance;
+
+/*!
+ @abstract Adds a copy of the specified object to the tree.
+ @discussion See -[PGRedBlackTree addObject:]. Only the shard the object belongs in is locked.
+ @param object The object whose copy will be added. May not be nil.
+ @throws NSInvalidArgumentException if object is nil
+ */
+- (void)addObject:(id <NSCopying>)object;
+
+/*!
+ @abstract Adds a copy of each object in the specified array to the tree.
+ @discussion The objects are grouped by shard and each group is added to its shard as a single batch.
+ @param array The array to add objects from.
+ */
+- (void)addObjectsFromArray:(NSArray *)array;
+
+/*!
+ @abstract Removes the specified object from the tree.
+ @discussion See -[PGRedBlackTree removeObject:]. Only the shard the object belongs in is locked.
+ @param object The object to remove.
+ */
+- (void)removeObject:(id)object;
+
+/*!
+ @abstract Removes the objects in the specified array from the tree.
+ @discussion See -[PGRedBlackTree removeObjectsInArray:]. The objects are grouped by shard and each group is removed
+     from its shard as a single batch.
+ @param array The array of objects to remove.
+ */
+- (void)removeObjectsInArray:(NSArray *)array;
+
+/*!
+ @abstract Removes the objects in the tree that are less than the specified object.
+ @discussion See -removeObjectsInRangeFromObject:toObject:.
+ @param object The object to compare against. If nil, this method does nothing.
+ */
+- (void)removeObjectsLessThanObject:(id)object;
+
+/*!
+ @abstract Removes the objects in the tree that are greater than or equal to one object and less than another.
+ @discussion Every shard that holds objects in the range is locked at once, so the objects are removed atomically.
+     Shards entirely within the range are emptied, and the shards at either end remove their part of the range in
+     O(log n) time.
+ @param fromObject The lower bound, which is inclusive. If nil, there is no lower bound.
+ @param toObject The upper bound, which is exclusive. If nil, there is no upper bound.
+ */
+- (void)removeObjectsInRangeFromObject:(id)fromObject toObject:(id)toObject;
+
+/*!
+ @abstract Removes and returns the first object in the tree.
+ @discussion Like -firstObject, this locks one shard at a time, so if another thread adds an object to an earlier shard
+     while this is looking for the first object, the new object may not be the one removed.
+ @result The object that was removed, or nil if the tree is empty.
+ */
+- (id)popFirstObject;
+
+/*!
+ @abstract Removes and returns the last object in the tree.
+ @discussion See -popFirstObject.
+ @result The object that was removed, or nil if the tree is empty.
+ */
+- (id)popLastObject;
+
+/*!
+ @abstract Removes all objects from the tree.
+ @discussion The tree's split objects are kept.
+ */
+- (void)removeAllObjects;
+
+/*!
+ @abstract Returns whether an object equivalent to the one specified is in the tree.
+ @param object The object being checked for membership.
+ @result Whether an equivalent object is in the tree.
+ */
+- (BOOL)containsObject:(id)object;
+
+/*!
+ @abstract Returns an object in the tree that is equivalent to the one specified.
+ @param object The object for which an equivalent object is being sought.
+ @result An object in the tree that is equivalent to the one specified or nil if no such object exists.
+ */
+- (id)member:(id)object;
+
+/*!
+ @abstract Returns the smallest object in the tree.
+ @result The smallest object in the tree or nil if the tree is empty.
+ */
+- (id)firstObject;
+
+/*!
+ @abstract Returns the largest object in the tree.
+ @result The largest object in the tree or nil if the tree is empty.
+ */
+- (id)lastObject;
+
+/*!
+ @abstract Returns the object at the specified index in the tree's ascending order.
+ @discussion The shards before the one that holds the object are locked while the index is found, so this takes O(s +
+     log n) time.
+ @param index An index within the bounds of the tree.
+ @throws NSRangeException if index is greater than or equal to the tree's count.
+ @result The object at index.
+ */
+- (id)objectAtIndex:(NSUInteger)index;
+
+/*!
+ @abstract Returns the index of the object returned by -member: in the tree's ascending order.
+ @param object The object whose index is being requested.
+ @result The index of the tree's object that is equivalent to the one specified, or NSNotFound if there is no such
+     object.
+ */
+- (NSUInteger)indexOfObject:(id)object;
+
+/*!
+ @abstract Returns the objects whose indexes are in the specified range in ascending order.
+ @param range A range within the bounds of the tree.
+ @throws NSRangeException if range is not within the bounds of the tree.
+ @result The objects in the specified range.
+ */
+- (NSArray *)objectsInRange:(NSRange)range;
+
+/*!
+ @abstract Returns the number of objects in the tree that are less than the specified object.
+ @discussion Every object in a shard before the object's shard is less than it, so this adds their counts to the
+     object's shard's count in O(s + log n) time.
+ @result The number of objects in the tree that are less than the specified object.
+ */
+- (NSUInteger)countOfObjectsLessThanObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are less than or equal to the specified object.
+ @discussion See -countOfObjectsLessThanObject:.
+ @result The number of objects in the tree that are less than or equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are equal to the specified object.
+ @discussion Equal objects are always in the same shard, so this locks only that shard.
+ @result The number of objects in the tree that are equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are greater than or equal to the specified object.
+ @discussion See -countOfObjectsLessThanObject:.
+ @result The number of objects in the tree that are greater than or equal to the specified object.
+ */
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the number of objects in the tree that are greater than the specified object.
+ @discussion See -countOfObjectsLessThanObject:.
+ @result The number of objects in the tree that are greater than the specified object.
+ */
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object;
+
+/*!
+ @abstract Returns the tree's objects in ascending order.
+ @discussion Each shard is read atomically, but the tree may be mutated between shards.
+ @result An array containing the tree's objects.
+ */
+- (NSArray *)allObjects;
+
+/*!
+ @abstract Executes the specified block using each object in the tree in ascending order.
+ @discussion Equivalent to -enumerateObjectsFromObject:inclusive:toObject:inclusive:usingBlock: with no bounds.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsUsingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that lies between two bounds in ascending order.
+ @discussion Only the shards whose ranges overlap the bounds are visited. Each shard's objects within the bounds are
+     copied out while the shard is locked, and the block is invoked with no locks held, so it may use the tree. Objects
+     added to a shard after the enumeration has moved past it are not visited.
+ @param fromObject The lower bound. If nil, there is no lower bound.
+ @param fromInclusive Whether objects equal to fromObject according to the tree's comparator should be visited.
+ @param toObject The upper bound. If nil, there is no upper bound.
+ @param toInclusive Whether objects equal to toObject according to the tree's comparator should be visited.
+ @param block The block to apply to the objects in the tree. May not be nil. The block takes two arguments:
+ @param obj The element in the tree.
+ @param stop A reference to a Boolean value. The block can set the value to YES to stop further processing of the tree. The
+     stop argument is an out-only argument. You should only ever set this Boolean to YES within the block.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                        usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that lies between two bounds.
+ @discussion Objects are visited in ascending order unless options includes NSEnumerationReverse, in which case the
+     shards are visited from last to first and each shard's objects are visited in descending order. Otherwise, this
+     behaves like -enumerateObjectsFromObject:inclusive:toObject:inclusive:usingBlock:.
+ @param fromObject The lower bound. If nil, there is no lower bound.
+ @param fromInclusive Whether objects equal to fromObject according to the tree's comparator should be visited.
+ @param toObject The upper bound. If nil, there is no upper bound.
+ @param toInclusive Whether objects equal to toObject according to the tree's comparator should be visited.
+ @param options A bitmask that specifies the options for the enumeration. Only NSEnumerationReverse is supported.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is less than the specified object in
+     ascending order.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is less than or equal to the specified
+     object in ascending order.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is equal to the specified object in
+     ascending order.
+ @discussion Equal objects are always in the same shard, so this visits only that shard.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is greater than or equal to the specified
+     object in ascending order.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Executes the specified block using each object in the tree that is greater than the specified object in
+     ascending order.
+ @param block The block to apply to the objects in the tree. May not be nil.
+ @throws NSInvalidArgumentException if block is nil.
+ */
+- (void)enumerateObjectsGreaterThanObject:(id)object usingBlock:(void (^)(id obj, BOOL *stop))block;
+
+/*!
+ @abstract Returns the objects in the tree that lie between two bounds in ascending order.
+ @discussion See -enumerateObjectsFromObject:inclusive:toObject:inclusive:usingBlock:.
+ @param fromObject The lower bound. If nil, there is no lower bound.
+ @param fromInclusive Whether objects equal to fromObject according to the tree's comparator should be included.
+ @param toObject The upper bound. If nil, there is no upper bound.
+ @param toInclusive Whether objects equal to toObject according to the tree's comparator should be included.
+ @result An array of the objects between the bounds.
+ */
+- (NSArray *)objectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive toObject:(id)toObject inclusive:(BOOL)toInclusive;
+
+/*!
+ @abstract Returns the objects in the tree that pass the test specified by the predicate block in ascending order.
+ @param predicate The block to apply to the objects in the tree. The block takes two arguments:
+ @param obj The element in the tree.
+ @param stop A reference to a Boolean value. The block can set the value to YES to stop further processing of the tree. The
+     stop argument is an out-only argument. You should only ever set this Boolean to YES within the block.
+ @result An array of the objects that passed the predicate block's test.
+ */
+- (NSArray *)objectsPassingTest:(BOOL (^)(id obj, BOOL *stop))predicate;
+
+/*!
+ @abstract Returns the objects in the tree that are less than the specified object in ascending order.
+ */
+- (NSArray *)objectsLessThanObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the tree that are less than or equal to the specified object in ascending order.
+ */
+- (NSArray *)objectsLessThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the tree that are equal to the specified object in ascending order.
+ */
+- (NSArray *)objectsEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the tree that are greater than or equal to the specified object in ascending order.
+ */
+- (NSArray *)objectsGreaterThanOrEqualToObject:(id)object;
+
+/*!
+ @abstract Returns the objects in the tree that are greater than the specified object in ascending order.
+ */
+- (NSArray *)objectsGreaterThanObject:(id)object;
+
+@end
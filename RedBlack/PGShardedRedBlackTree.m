@@ -0,0 +1,1047 @@
+//
+//  PGShardedRedBlackTree.m
+//  RedBlack
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "PGShardedRedBlackTree.h"
+
+#import <pthread.h>
+
+#import "PGRedBlackTree.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Constants
+
+// Trees that rebalance automatically don't bother until some shard has at least this many objects
+static const NSUInteger PGShardedRedBlackTreeMinimumRebalanceCount = 1024;
+
+// Shards are padded to this size so that threads locking neighboring shards don't contend for the same cache line
+static const size_t PGShardAlignment = 64;
+
+
+#pragma mark - Shards
+
+typedef struct _PGShard {
+    pthread_mutex_t lock;
+    PGRedBlackTree *tree;
+} __attribute__((aligned(64))) PGShard;
+
+
+#pragma mark - Private interfaces
+
+@interface PGShardedRedBlackTree () {
+    NSComparator _comparator;
+    PGShard *_shards;
+
+    // The split objects and rebalancing threshold can only change while _splitLock is write-locked. Everything else
+    // read-locks it before locking a shard, so rebalancing has the whole tree to itself.
+    pthread_rwlock_t _splitLock;
+    id *_splitObjects;
+    NSUInteger _splitCount;
+    NSUInteger _rebalanceCount;
+}
+
+@property(readwrite, assign) NSUInteger shardCount;
+@property(readwrite, assign) BOOL rebalancesAutomatically;
+
+- (id)initWithComparator:(NSComparator)comparator shardCount:(NSUInteger)shardCount splitObjects:(NSArray *)splitObjects;
+
+// Returns the index of the shard that object belongs in. Must be called with _splitLock locked.
+- (NSUInteger)shardIndexForObject:(id)object;
+
+// Returns the index of the last shard that can hold objects less than object. Must be called with _splitLock locked.
+- (NSUInteger)shardIndexForObjectsLessThanObject:(id)object;
+
+// Lock and unlock the shards whose indexes are in the specified range in ascending order. Every method that holds more
+// than one shard lock at a time acquires them in ascending order, so they can't deadlock. Must be called with
+// _splitLock read-locked.
+- (void)lockShardsInRange:(NSRange)range;
+- (void)unlockShardsInRange:(NSRange)range;
+
+// Returns the objects within the bounds in one shard, in ascending order or, if reverse is YES, descending order.
+// Enumerating forward, that is the shard that holds fromObject, and *nextBound is set to the split object that ends the
+// shard, which is the inclusive lower bound of the next shard to visit. Enumerating in reverse, it is the shard that
+// holds the objects nearest toObject, and *nextBound is set to the split object that starts the shard, which is the
+// exclusive upper bound of the next shard to visit. *nextBound is set to nil if no other shard can hold objects within
+// the bounds.
+- (NSArray *)objectsInShardFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                             toObject:(id)toObject inclusive:(BOOL)toInclusive
+                              reverse:(BOOL)reverse
+                            nextBound:(id *)nextBound;
+
+// Read-locks _splitLock and locks the shard that object belongs in. -unlockShard: undoes both.
+- (PGShard *)lockShardForObject:(id)object;
+- (void)unlockShard:(PGShard *)shard;
+
+// Returns whether a shard with the specified count should trigger rebalancing. Must be called with _splitLock locked.
+- (BOOL)shouldRebalanceShardWithCount:(NSUInteger)count;
+- (void)rebalanceIfNeeded;
+
+// Must be called with _splitLock write-locked
+- (void)rebalanceWithSplitLockHeld;
+
+// Move the objects that are greater than or equal to, or less than, splitObject into the neighboring shard. Must be
+// called with _splitLock write-locked.
+- (void)moveObjectsGreaterThanOrEqualToObject:(id)splitObject fromShardAtIndex:(NSUInteger)index;
+- (void)moveObjectsLessThanObject:(id)splitObject fromShardAtIndex:(NSUInteger)index;
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object inclusive:(BOOL)inclusive;
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object inclusive:(BOOL)inclusive;
+
+@end
+
+
+#pragma mark - Implementation
+
+@implementation PGShardedRedBlackTree
+
++ (PGShardedRedBlackTree *)treeWithShardCount:(NSUInteger)shardCount
+{
+    return [[[self alloc] initWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    } shardCount:shardCount] autorelease];
+}
+
+
+- (id)init
+{
+    return [self initWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    } shardCount:[[NSProcessInfo processInfo] activeProcessorCount]];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator shardCount:(NSUInteger)shardCount
+{
+    self = [self initWithComparator:comparator shardCount:shardCount splitObjects:nil];
+    if (self) {
+        [self setRebalancesAutomatically:shardCount > 1];
+    }
+
+    return self;
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator splitObjects:(NSArray *)splitObjects
+{
+    return [self initWithComparator:comparator shardCount:[splitObjects count] + 1 splitObjects:splitObjects];
+}
+
+
+- (id)initWithComparator:(NSComparator)comparator shardCount:(NSUInteger)shardCount splitObjects:(NSArray *)splitObjects
+{
+    if (!comparator || shardCount == 0) {
+        [self release];
+        return nil;
+    }
+
+    self = [super init];
+    if (self) {
+        _comparator = [comparator copy];
+        [self setShardCount:shardCount];
+        _rebalanceCount = PGShardedRedBlackTreeMinimumRebalanceCount;
+
+        void *shards = NULL;
+        _splitObjects = calloc(shardCount, sizeof(id));
+        if (posix_memalign(&shards, PGShardAlignment, shardCount * sizeof(PGShard)) != 0 || !_splitObjects) {
+            // Create the exception first, since its reason describes self
+            NSException *exception = [NSException exceptionWithName:NSMallocException
+                                                             reason:PGExceptionString(self, _cmd, @"Could not allocate shards.")
+                                                           userInfo:nil];
+            free(shards);
+            [self release];
+            @throw exception;
+        }
+
+        _shards = shards;
+        for (NSUInteger i = 0; i < shardCount; ++i) {
+            pthread_mutex_init(&_shards[i].lock, NULL);
+            _shards[i].tree = [[PGRedBlackTree alloc] initWithComparator:comparator];
+        }
+
+        pthread_rwlock_init(&_splitLock, NULL);
+
+        // Like the shards themselves, we keep copies of the split objects so that they can't change out from under us
+        for (id object in [splitObjects sortedArrayWithOptions:NSSortStable usingComparator:comparator]) {
+            _splitObjects[_splitCount++] = [object copy];
+        }
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    // If allocation failed during initialization, there are no shards or locks to tear down
+    if (_shards) {
+        for (NSUInteger i = 0; i < _shardCount; ++i) {
+            pthread_mutex_destroy(&_shards[i].lock);
+            [_shards[i].tree release];
+        }
+
+        free(_shards);
+        pthread_rwlock_destroy(&_splitLock);
+    }
+
+    for (NSUInteger i = 0; i < _splitCount; ++i) {
+        [_splitObjects[i] release];
+    }
+
+    free(_splitObjects);
+    [_comparator release];
+    [super dealloc];
+}
+
+
+- (NSUInteger)count
+{
+    NSUInteger count = 0;
+    pthread_rwlock_rdlock(&_splitLock);
+    for (NSUInteger i = 0; i < _shardCount; ++i) {
+        pthread_mutex_lock(&_shards[i].lock);
+        count += [_shards[i].tree count];
+        pthread_mutex_unlock(&_shards[i].lock);
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    return count;
+}
+
+
+#pragma mark - Shards
+
+- (NSUInteger)shardIndexForObject:(id)object
+{
+    // Find the number of split objects that are less than or equal to object
+    NSUInteger low = 0;
+    NSUInteger high = _splitCount;
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (_comparator(object, _splitObjects[middle]) < NSOrderedSame) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    return low;
+}
+
+
+- (NSUInteger)shardIndexForObjectsLessThanObject:(id)object
+{
+    // Find the number of split objects that are less than object
+    NSUInteger low = 0;
+    NSUInteger high = _splitCount;
+    while (low < high) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (_comparator(_splitObjects[middle], object) < NSOrderedSame) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+
+- (void)lockShardsInRange:(NSRange)range
+{
+    for (NSUInteger i = range.location; i < NSMaxRange(range); ++i) {
+        pthread_mutex_lock(&_shards[i].lock);
+    }
+}
+
+
+- (void)unlockShardsInRange:(NSRange)range
+{
+    for (NSUInteger i = range.location; i < NSMaxRange(range); ++i) {
+        pthread_mutex_unlock(&_shards[i].lock);
+    }
+}
+
+
+- (PGShard *)lockShardForObject:(id)object
+{
+    pthread_rwlock_rdlock(&_splitLock);
+    PGShard *shard = &_shards[[self shardIndexForObject:object]];
+    pthread_mutex_lock(&shard->lock);
+    return shard;
+}
+
+
+- (void)unlockShard:(PGShard *)shard
+{
+    pthread_mutex_unlock(&shard->lock);
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+- (NSArray *)splitObjects
+{
+    pthread_rwlock_rdlock(&_splitLock);
+    NSArray *splitObjects = [NSArray arrayWithObjects:_splitObjects count:_splitCount];
+    pthread_rwlock_unlock(&_splitLock);
+    return splitObjects;
+}
+
+
+#pragma mark - Rebalancing
+
+- (BOOL)shouldRebalanceShardWithCount:(NSUInteger)count
+{
+    return _rebalancesAutomatically && count > _rebalanceCount;
+}
+
+
+- (void)rebalance
+{
+    pthread_rwlock_wrlock(&_splitLock);
+    [self rebalanceWithSplitLockHeld];
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+- (void)rebalanceIfNeeded
+{
+    pthread_rwlock_wrlock(&_splitLock);
+
+    // Another thread may have rebalanced while we were waiting for the lock
+    for (NSUInteger i = 0; i < _shardCount; ++i) {
+        if ([self shouldRebalanceShardWithCount:[_shards[i].tree count]]) {
+            [self rebalanceWithSplitLockHeld];
+            break;
+        }
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+- (void)rebalanceWithSplitLockHeld
+{
+    NSUInteger count = 0;
+    for (NSUInteger i = 0; i < _shardCount; ++i) {
+        count += [_shards[i].tree count];
+    }
+
+    if (count == 0 || _shardCount == 1) return;
+
+    @autoreleasepool {
+        // Split at evenly spaced ranks. The shards are in order, so we find the object at each rank by walking their
+        // counts to the shard that holds it and asking that shard, which takes O(log n) time. If there are fewer objects
+        // than shards, some split objects will be equal and the shards between them will be empty.
+        NSMutableArray *splitObjects = [NSMutableArray arrayWithCapacity:_shardCount - 1];
+        NSUInteger shardIndex = 0;
+        NSUInteger shardStart = 0;
+        for (NSUInteger i = 1; i < _shardCount; ++i) {
+            NSUInteger rank = i * count / _shardCount;
+            while (rank >= shardStart + [_shards[shardIndex].tree count]) {
+                shardStart += [_shards[shardIndex].tree count];
+                ++shardIndex;
+            }
+
+            [splitObjects addObject:[_shards[shardIndex].tree objectAtIndex:rank - shardStart]];
+        }
+
+        for (NSUInteger i = 0; i < _splitCount; ++i) {
+            [_splitObjects[i] release];
+        }
+
+        _splitCount = _shardCount - 1;
+        for (NSUInteger i = 0; i < _splitCount; ++i) {
+            _splitObjects[i] = [splitObjects[i] retain];
+        }
+
+        // Objects only move between neighboring shards. First, sweep forward, pushing each shard's objects that belong
+        // after its new split object into the next shard, and then sweep backward, pushing each shard's objects that
+        // belong before its new lower bound into the previous shard. Each object crosses each boundary at most once,
+        // so this takes time proportional to how far the boundaries moved rather than to the size of the tree.
+        for (NSUInteger i = 0; i < _splitCount; ++i) {
+            [self moveObjectsGreaterThanOrEqualToObject:_splitObjects[i] fromShardAtIndex:i];
+        }
+
+        for (NSUInteger i = _splitCount; i > 0; --i) {
+            [self moveObjectsLessThanObject:_splitObjects[i - 1] fromShardAtIndex:i];
+        }
+
+        // Don't rebalance again until some shard has twice its share of the objects
+        _rebalanceCount = MAX(PGShardedRedBlackTreeMinimumRebalanceCount, 2 * count / _shardCount);
+    }
+}
+
+
+- (void)moveObjectsGreaterThanOrEqualToObject:(id)splitObject fromShardAtIndex:(NSUInteger)index
+{
+    PGRedBlackTree *tree = _shards[index].tree;
+    NSArray *objects = [tree objectsGreaterThanOrEqualToObject:splitObject];
+    if ([objects count] == 0) return;
+
+    // Everything in the next shard is greater than everything in this one, so the objects go at its start
+    [tree removeObjectsInRangeFromObject:splitObject toObject:nil];
+    [_shards[index + 1].tree addObjectsFromArray:objects sorted:YES];
+}
+
+
+- (void)moveObjectsLessThanObject:(id)splitObject fromShardAtIndex:(NSUInteger)index
+{
+    PGRedBlackTree *tree = _shards[index].tree;
+    NSArray *objects = [tree objectsLessThanObject:splitObject];
+    if ([objects count] == 0) return;
+
+    [tree removeObjectsLessThanObject:splitObject];
+    [_shards[index - 1].tree addObjectsFromArray:objects sorted:YES];
+}
+
+
+#pragma mark - Mutation
+
+- (void)addObject:(id)object
+{
+    // Check before locking so that the exception doesn't leave a shard locked
+    if (!object) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot add nil object.")
+                                     userInfo:nil];
+    }
+
+    PGShard *shard = [self lockShardForObject:object];
+    [shard->tree addObject:object];
+    BOOL shouldRebalance = [self shouldRebalanceShardWithCount:[shard->tree count]];
+    [self unlockShard:shard];
+
+    if (shouldRebalance) [self rebalanceIfNeeded];
+}
+
+
+- (void)addObjectsFromArray:(NSArray *)array
+{
+    if ([array count] == 0) return;
+
+    BOOL shouldRebalance = NO;
+    pthread_rwlock_rdlock(&_splitLock);
+    @autoreleasepool {
+        NSMutableArray *batches = [NSMutableArray arrayWithCapacity:_shardCount];
+        for (NSUInteger i = 0; i < _shardCount; ++i) {
+            [batches addObject:[NSMutableArray array]];
+        }
+
+        for (id object in array) {
+            [batches[[self shardIndexForObject:object]] addObject:object];
+        }
+
+        for (NSUInteger i = 0; i < _shardCount; ++i) {
+            if ([batches[i] count] == 0) continue;
+
+            pthread_mutex_lock(&_shards[i].lock);
+            [_shards[i].tree addObjectsFromArray:batches[i]];
+            shouldRebalance = shouldRebalance || [self shouldRebalanceShardWithCount:[_shards[i].tree count]];
+            pthread_mutex_unlock(&_shards[i].lock);
+        }
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    if (shouldRebalance) [self rebalanceIfNeeded];
+}
+
+
+- (void)removeObject:(id)object
+{
+    if (!object) return;
+
+    PGShard *shard = [self lockShardForObject:object];
+    [shard->tree removeObject:object];
+    [self unlockShard:shard];
+}
+
+
+- (void)removeObjectsInArray:(NSArray *)array
+{
+    if ([array count] == 0) return;
+
+    pthread_rwlock_rdlock(&_splitLock);
+    @autoreleasepool {
+        NSMutableArray *batches = [NSMutableArray arrayWithCapacity:_shardCount];
+        for (NSUInteger i = 0; i < _shardCount; ++i) {
+            [batches addObject:[NSMutableArray array]];
+        }
+
+        for (id object in array) {
+            [batches[[self shardIndexForObject:object]] addObject:object];
+        }
+
+        for (NSUInteger i = 0; i < _shardCount; ++i) {
+            if ([batches[i] count] == 0) continue;
+
+            pthread_mutex_lock(&_shards[i].lock);
+            [_shards[i].tree removeObjectsInArray:batches[i]];
+            pthread_mutex_unlock(&_shards[i].lock);
+        }
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+- (void)removeObjectsLessThanObject:(id)object
+{
+    if (!object) return;
+    [self removeObjectsInRangeFromObject:nil toObject:object];
+}
+
+
+- (void)removeObjectsInRangeFromObject:(id)fromObject toObject:(id)toObject
+{
+    pthread_rwlock_rdlock(&_splitLock);
+    NSUInteger first = fromObject ? [self shardIndexForObject:fromObject] : 0;
+    NSUInteger last = toObject ? [self shardIndexForObjectsLessThanObject:toObject] : _splitCount;
+    if (first <= last) {
+        // Lock every affected shard first so that the whole range is removed at once. The shards strictly between the
+        // first and last are entirely within the range.
+        NSRange range = NSMakeRange(first, last - first + 1);
+        [self lockShardsInRange:range];
+        if (first == last) {
+            [_shards[first].tree removeObjectsInRangeFromObject:fromObject toObject:toObject];
+        } else {
+            [_shards[first].tree removeObjectsInRangeFromObject:fromObject toObject:nil];
+            for (NSUInteger i = first + 1; i < last; ++i) {
+                [_shards[i].tree removeAllObjects];
+            }
+
+            [_shards[last].tree removeObjectsInRangeFromObject:nil toObject:toObject];
+        }
+
+        [self unlockShardsInRange:range];
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+- (id)popFirstObject
+{
+    // Like -firstObject, this locks one shard at a time, so an object added to an earlier shard after we've passed it
+    // may be smaller than the one we pop
+    id object = nil;
+    pthread_rwlock_rdlock(&_splitLock);
+    for (NSUInteger i = 0; i <= _splitCount && !object; ++i) {
+        pthread_mutex_lock(&_shards[i].lock);
+        object = [[_shards[i].tree popFirstObject] retain];
+        pthread_mutex_unlock(&_shards[i].lock);
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    return [object autorelease];
+}
+
+
+- (id)popLastObject
+{
+    id object = nil;
+    pthread_rwlock_rdlock(&_splitLock);
+    for (NSUInteger i = _splitCount + 1; i > 0 && !object; --i) {
+        pthread_mutex_lock(&_shards[i - 1].lock);
+        object = [[_shards[i - 1].tree popLastObject] retain];
+        pthread_mutex_unlock(&_shards[i - 1].lock);
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    return [object autorelease];
+}
+
+
+- (void)removeAllObjects
+{
+    pthread_rwlock_wrlock(&_splitLock);
+    for (NSUInteger i = 0; i < _shardCount; ++i) {
+        [_shards[i].tree removeAllObjects];
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+}
+
+
+#pragma mark - Membership
+
+- (BOOL)containsObject:(id)object
+{
+    return [self member:object] != nil;
+}
+
+
+- (id)member:(id)object
+{
+    if (!object) return nil;
+
+    // Retain the member before unlocking so that another thread can't deallocate it by removing it
+    PGShard *shard = [self lockShardForObject:object];
+    id member = [[shard->tree member:object] retain];
+    [self unlockShard:shard];
+    return [member autorelease];
+}
+
+
+- (id)firstObject
+{
+    id object = nil;
+    pthread_rwlock_rdlock(&_splitLock);
+    for (NSUInteger i = 0; i < _shardCount && !object; ++i) {
+        pthread_mutex_lock(&_shards[i].lock);
+        object = [[_shards[i].tree firstObject] retain];
+        pthread_mutex_unlock(&_shards[i].lock);
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    return [object autorelease];
+}
+
+
+- (id)lastObject
+{
+    id object = nil;
+    pthread_rwlock_rdlock(&_splitLock);
+    for (NSUInteger i = _shardCount; i > 0 && !object; --i) {
+        pthread_mutex_lock(&_shards[i - 1].lock);
+        object = [[_shards[i - 1].tree lastObject] retain];
+        pthread_mutex_unlock(&_shards[i - 1].lock);
+    }
+
+    pthread_rwlock_unlock(&_splitLock);
+    return [object autorelease];
+}
+
+
+#pragma mark - Order statistics
+
+// Order statistics lock every shard before the one they need in ascending order and hold the locks until they're done,
+// so their results reflect a single moment even though other threads are writing to the tree
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+    id object = nil;
+    NSUInteger count = 0;
+    NSUInteger lockedCount = 0;
+    pthread_rwlock_rdlock(&_splitLock);
+    while (lockedCount < _shardCount && !object) {
+        PGRedBlackTree *tree = _shards[lockedCount].tree;
+        pthread_mutex_lock(&_shards[lockedCount++].lock);
+        if (index - count < [tree count]) {
+            object = [[tree objectAtIndex:index - count] retain];
+        } else {
+            count += [tree count];
+        }
+    }
+
+    [self unlockShardsInRange:NSMakeRange(0, lockedCount)];
+    pthread_rwlock_unlock(&_splitLock);
+
+    if (!object) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Index %lu beyond bounds of tree with count %lu.",
+                                                                (unsigned long)index, (unsigned long)count)
+                                     userInfo:nil];
+    }
+
+    return [object autorelease];
+}
+
+
+- (NSUInteger)indexOfObject:(id)object
+{
+    if (!object) return NSNotFound;
+
+    pthread_rwlock_rdlock(&_splitLock);
+    NSUInteger shardIndex = [self shardIndexForObject:object];
+    NSRange range = NSMakeRange(0, shardIndex + 1);
+    [self lockShardsInRange:range];
+
+    NSUInteger index = [_shards[shardIndex].tree indexOfObject:object];
+    if (index != NSNotFound) {
+        for (NSUInteger i = 0; i < shardIndex; ++i) {
+            index += [_shards[i].tree count];
+        }
+    }
+
+    [self unlockShardsInRange:range];
+    pthread_rwlock_unlock(&_splitLock);
+    return index;
+}
+
+
+- (NSArray *)objectsInRange:(NSRange)range
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:range.length];
+    NSUInteger count = 0;
+    NSUInteger lockedCount = 0;
+    pthread_rwlock_rdlock(&_splitLock);
+    while (lockedCount < _shardCount && ([objects count] < range.length || count < range.location)) {
+        PGRedBlackTree *tree = _shards[lockedCount].tree;
+        pthread_mutex_lock(&_shards[lockedCount++].lock);
+
+        // Take the part of the range that falls in this shard
+        NSUInteger treeCount = [tree count];
+        NSUInteger location = range.location + [objects count];
+        if (location < count + treeCount) {
+            NSUInteger length = MIN(range.length - [objects count], count + treeCount - location);
+            [objects addObjectsFromArray:[tree objectsInRange:NSMakeRange(location - count, length)]];
+        }
+
+        count += treeCount;
+    }
+
+    [self unlockShardsInRange:NSMakeRange(0, lockedCount)];
+    pthread_rwlock_unlock(&_splitLock);
+
+    if ([objects count] < range.length || count < range.location) {
+        @throw [NSException exceptionWithName:NSRangeException
+                                       reason:PGExceptionString(self, _cmd, @"Range %@ beyond bounds of tree with count %lu.",
+                                                                NSStringFromRange(range), (unsigned long)count)
+                                     userInfo:nil];
+    }
+
+    return objects;
+}
+
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object
+{
+    return [self countOfObjectsLessThanObject:object inclusive:NO];
+}
+
+
+- (NSUInteger)countOfObjectsLessThanOrEqualToObject:(id)object
+{
+    return [self countOfObjectsLessThanObject:object inclusive:YES];
+}
+
+
+- (NSUInteger)countOfObjectsLessThanObject:(id)object inclusive:(BOOL)inclusive
+{
+    if (!object) return 0;
+
+    // Every object in an earlier shard is less than object, and every object in a later one is greater
+    pthread_rwlock_rdlock(&_splitLock);
+    NSUInteger shardIndex = [self shardIndexForObject:object];
+    NSRange range = NSMakeRange(0, shardIndex + 1);
+    [self lockShardsInRange:range];
+
+    PGRedBlackTree *tree = _shards[shardIndex].tree;
+    NSUInteger count = inclusive ? [tree countOfObjectsLessThanOrEqualToObject:object] : [tree countOfObjectsLessThanObject:object];
+    for (NSUInteger i = 0; i < shardIndex; ++i) {
+        count += [_shards[i].tree count];
+    }
+
+    [self unlockShardsInRange:range];
+    pthread_rwlock_unlock(&_splitLock);
+    return count;
+}
+
+
+- (NSUInteger)countOfObjectsEqualToObject:(id)object
+{
+    if (!object) return 0;
+
+    // Equal objects are always in the same shard
+    PGShard *shard = [self lockShardForObject:object];
+    NSUInteger count = [shard->tree countOfObjectsEqualToObject:object];
+    [self unlockShard:shard];
+    return count;
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanOrEqualToObject:(id)object
+{
+    return [self countOfObjectsGreaterThanObject:object inclusive:YES];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object
+{
+    return [self countOfObjectsGreaterThanObject:object inclusive:NO];
+}
+
+
+- (NSUInteger)countOfObjectsGreaterThanObject:(id)object inclusive:(BOOL)inclusive
+{
+    if (!object) return 0;
+
+    pthread_rwlock_rdlock(&_splitLock);
+    NSUInteger shardIndex = [self shardIndexForObject:object];
+    NSRange range = NSMakeRange(shardIndex, _shardCount - shardIndex);
+    [self lockShardsInRange:range];
+
+    PGRedBlackTree *tree = _shards[shardIndex].tree;
+    NSUInteger count = inclusive ? [tree countOfObjectsGreaterThanOrEqualToObject:object] : [tree countOfObjectsGreaterThanObject:object];
+    for (NSUInteger i = shardIndex + 1; i < _shardCount; ++i) {
+        count += [_shards[i].tree count];
+    }
+
+    [self unlockShardsInRange:range];
+    pthread_rwlock_unlock(&_splitLock);
+    return count;
+}
+
+
+#pragma mark - Enumeration
+
+- (NSArray *)allObjects
+{
+    return [self objectsFromObject:nil inclusive:NO toObject:nil inclusive:NO];
+}
+
+
+- (void)enumerateObjectsUsingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:NO toObject:nil inclusive:NO options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                        usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:fromObject inclusive:fromInclusive toObject:toObject inclusive:toInclusive options:0 usingBlock:block];
+}
+
+
+- (void)enumerateObjectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                          toObject:(id)toObject inclusive:(BOOL)toInclusive
+                           options:(NSEnumerationOptions)options
+                        usingBlock:(void (^)(id, BOOL *))block
+{
+    if (!block) {
+        @throw [NSException exceptionWithName:NSInvalidArgumentException
+                                       reason:PGExceptionString(self, _cmd, @"Cannot enumerate using nil block.")
+                                     userInfo:nil];
+    }
+
+    // Rather than remembering shard indexes, which change when the tree rebalances, we find each shard by the bound
+    // we've reached. After visiting a shard, the next bound is the split object at its far end. Going forward, that is
+    // greater than every object in the shard, and going backward, it is an exclusive bound that is less than or equal
+    // to every object in the shard, so we never visit an object twice.
+    BOOL reverse = (options & NSEnumerationReverse) != 0;
+    id bound = [(reverse ? toObject : fromObject) retain];
+    BOOL boundIsInclusive = reverse ? toInclusive : fromInclusive;
+    BOOL stop = NO;
+    while (!stop) {
+        @autoreleasepool {
+            id nextBound = nil;
+            NSArray *objects = nil;
+            if (reverse) {
+                objects = [self objectsInShardFromObject:fromObject inclusive:fromInclusive toObject:bound inclusive:boundIsInclusive
+                                                 reverse:YES nextBound:&nextBound];
+            } else {
+                objects = [self objectsInShardFromObject:bound inclusive:boundIsInclusive toObject:toObject inclusive:toInclusive
+                                                 reverse:NO nextBound:&nextBound];
+            }
+
+            for (id object in objects) {
+                block(object, &stop);
+                if (stop) break;
+            }
+
+            if (!nextBound) break;
+
+            // The autorelease pool is about to drain, so keep the next bound alive until the next iteration
+            [bound release];
+            bound = [nextBound retain];
+            boundIsInclusive = !reverse;
+        }
+    }
+
+    [bound release];
+}
+
+
+- (NSArray *)objectsInShardFromObject:(id)fromObject inclusive:(BOOL)fromInclusive
+                             toObject:(id)toObject inclusive:(BOOL)toInclusive
+                              reverse:(BOOL)reverse
+                            nextBound:(id *)nextBound
+{
+    NSMutableArray *objects = [NSMutableArray array];
+    pthread_rwlock_rdlock(&_splitLock);
+
+    // Only the first _splitCount + 1 shards can hold objects
+    NSUInteger index = 0;
+    if (!reverse) {
+        index = fromObject ? [self shardIndexForObject:fromObject] : 0;
+    } else if (!toObject) {
+        index = _splitCount;
+    } else {
+        index = toInclusive ? [self shardIndexForObject:toObject] : [self shardIndexForObjectsLessThanObject:toObject];
+    }
+
+    pthread_mutex_lock(&_shards[index].lock);
+    [_shards[index].tree enumerateObjectsFromObject:fromObject inclusive:fromInclusive
+                                           toObject:toObject inclusive:toInclusive
+                                            options:reverse ? NSEnumerationReverse : 0
+                                         usingBlock:^(id obj, BOOL *stop) {
+        [objects addObject:obj];
+    }];
+    pthread_mutex_unlock(&_shards[index].lock);
+
+    // We're done once the next shard starts past the upper bound or ends before the lower bound
+    id splitObject = nil;
+    if (!reverse && index < _splitCount) {
+        splitObject = _splitObjects[index];
+        if (toObject) {
+            NSComparisonResult result = _comparator(splitObject, toObject);
+            if (result == NSOrderedDescending || (result == NSOrderedSame && !toInclusive)) splitObject = nil;
+        }
+    } else if (reverse && index > 0) {
+        splitObject = _splitObjects[index - 1];
+        if (fromObject && _comparator(splitObject, fromObject) <= NSOrderedSame) splitObject = nil;
+    }
+
+    *nextBound = [[splitObject retain] autorelease];
+    pthread_rwlock_unlock(&_splitLock);
+    return objects;
+}
+
+
+- (void)enumerateObjectsLessThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:NO toObject:object inclusive:NO usingBlock:block];
+}
+
+
+- (void)enumerateObjectsLessThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:nil inclusive:NO toObject:object inclusive:YES usingBlock:block];
+}
+
+
+- (void)enumerateObjectsEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:object inclusive:YES usingBlock:block];
+}
+
+
+- (void)enumerateObjectsGreaterThanOrEqualToObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:YES toObject:nil inclusive:NO usingBlock:block];
+}
+
+
+- (void)enumerateObjectsGreaterThanObject:(id)object usingBlock:(void (^)(id, BOOL *))block
+{
+    [self enumerateObjectsFromObject:object inclusive:NO toObject:nil inclusive:NO usingBlock:block];
+}
+
+
+- (NSArray *)objectsFromObject:(id)fromObject inclusive:(BOOL)fromInclusive toObject:(id)toObject inclusive:(BOOL)toInclusive
+{
+    NSMutableArray *objects = [NSMutableArray array];
+    [self enumerateObjectsFromObject:fromObject inclusive:fromInclusive toObject:toObject inclusive:toInclusive usingBlock:^(id obj, BOOL *stop) {
+        [objects addObject:obj];
+    }];
+
+    return objects;
+}
+
+
+- (NSArray *)objectsPassingTest:(BOOL (^)(id, BOOL *))predicate
+{
+    NSMutableArray *objects = [NSMutableArray array];
+    [self enumerateObjectsUsingBlock:^(id obj, BOOL *stop) {
+        if (predicate(obj, stop)) [objects addObject:obj];
+    }];
+
+    return objects;
+}
+
+
+- (NSArray *)objectsLessThanObject:(id)object
+{
+    return [self objectsFromObject:nil inclusive:NO toObject:object inclusive:NO];
+}
+
+
+- (NSArray *)objectsLessThanOrEqualToObject:(id)object
+{
+    return [self objectsFromObject:nil inclusive:NO toObject:object inclusive:YES];
+}
+
+
+- (NSArray *)objectsEqualToObject:(id)object
+{
+    return [self objectsFromObject:object inclusive:YES toObject:object inclusive:YES];
+}
+
+
+- (NSArray *)objectsGreaterThanOrEqualToObject:(id)object
+{
+    return [self objectsFromObject:object inclusive:YES toObject:nil inclusive:NO];
+}
+
+
+- (NSArray *)objectsGreaterThanObject:(id)object
+{
+    return [self objectsFromObject:object inclusive:NO toObject:nil inclusive:NO];
+}
+
+
+#pragma mark - Fast enumeration
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)buffer count:(NSUInteger)length
+{
+    // Like block-based enumeration, we copy out one shard at a time. extra[0] holds the lower bound of the next shard
+    // and extra[1] is set once there are no more shards. The bound and each shard's objects are autoreleased, so they
+    // live as long as the enumeration needs them and nothing leaks if it stops early. Other threads may mutate the tree
+    // while we enumerate it, so mutationsPtr points at a value that never changes.
+    if (state->state == 0) {
+        state->state = 1;
+        state->mutationsPtr = &state->extra[2];
+        state->extra[0] = 0;
+        state->extra[1] = NO;
+    }
+
+    NSArray *objects = nil;
+    id bound = (id)state->extra[0];
+    while (!state->extra[1] && [objects count] == 0) {
+        id nextBound = nil;
+        objects = [self objectsInShardFromObject:bound inclusive:YES toObject:nil inclusive:NO reverse:NO nextBound:&nextBound];
+        bound = nextBound;
+        if (!bound) state->extra[1] = YES;
+    }
+
+    state->extra[0] = (unsigned long)bound;
+
+    NSUInteger count = [objects count];
+    if (count == 0) return 0;
+
+    // If the shard's objects don't fit in the buffer, copy them into an autoreleased one that does
+    id *items = buffer;
+    if (count > length) {
+        items = [[NSMutableData dataWithLength:count * sizeof(id)] mutableBytes];
+    }
+
+    [objects getObjects:items range:NSMakeRange(0, count)];
+    state->itemsPtr = items;
+    return count;
+}
+
+@end
@@ -24,13 +24,1428 @@
 //  THE SOFTWARE.
 //
 
+// This is a benchmark driver for PGRedBlackTree. It runs configurable workloads against the tree and against two
+// baselines, an NSMutableArray kept sorted using binary search and an NSMutableSet, and writes one CSV or JSON record per
+// run. Run with -help for a list of options.
+
 #import <Foundation/Foundation.h>
 
+#include <math.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#import "PGComparators.h"
+#import "PGCompactRedBlackTree.h"
+#import "PGFrozenSortedSet.h"
+#import "PGIntervalRedBlackTree.h"
+#import "PGRedBlackTree.h"
+#import "PGRedBlackTreeCursor.h"
+#import "PGShardedRedBlackTree.h"
+#import "PGUtilities.h"
+
+
+#pragma mark Measurement
+
+// Counts comparisons made by PGCountingComparator. Every structure that uses a comparator uses this one, except the
+// selector and numeric subjects, which measure PGComparators.h's comparators and don't report comparisons. The count is
+// per thread so that multithreaded runs don't race on it; those runs don't report comparisons.
+static __thread unsigned long long PGComparisonCount = 0;
+
+static NSComparator PGCountingComparator = ^NSComparisonResult(id object1, id object2) {
+    ++PGComparisonCount;
+    return [object1 compare:object2];
+};
+
+
+static uint64_t PGNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+
+// Returns the peak resident set size of the process so far in bytes
+static uint64_t PGPeakResidentSetSize(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+
+static int PGCompareLatencies(const void *a, const void *b)
+{
+    uint64_t latency1 = *(const uint64_t *)a;
+    uint64_t latency2 = *(const uint64_t *)b;
+    return latency1 < latency2 ? -1 : (latency1 > latency2 ? 1 : 0);
+}
+
+
+// Returns the nearest-rank percentile of an array of latencies that has already been sorted
+static uint64_t PGPercentile(const uint64_t *sortedLatencies, NSUInteger count, double percentile)
+{
+    NSUInteger rank = (NSUInteger)ceil(percentile * count);
+    return sortedLatencies[rank > 0 ? rank - 1 : 0];
+}
+
+
+#pragma mark - Keys
+
+typedef NS_ENUM(NSUInteger, PGKeyDistribution) {
+    PGKeyDistributionRandom,
+    PGKeyDistributionSequential,
+    PGKeyDistributionReverse,
+    PGKeyDistributionDuplicates,
+    PGKeyDistributionCount
+};
+
+static NSString *const PGKeyDistributionNames[] = { @"random", @"sequential", @"reverse", @"duplicates" };
+
+
+// Returns the key at the specified position in the distribution's key stream. The first size keys in the stream fill
+// the structure before a run starts; keys after those are inserted during the run.
+static NSNumber *PGKeyAtPosition(PGKeyDistribution distribution, NSUInteger position, NSUInteger size)
+{
+    switch (distribution) {
+        case PGKeyDistributionSequential:
+            return @((long long)position);
+        case PGKeyDistributionReverse:
+            return @(-(long long)position);
+        case PGKeyDistributionDuplicates:
+            // About 100 copies of each key
+            return @(random() % (long)MAX(size / 100, 1));
+        default:
+            return @(random());
+    }
+}
+
+
+// Interval workloads treat each key k as the interval [k, k + PGIntervalLength). The length is chosen before each run so
+// that a typical point is contained in the number of intervals the workload asks for.
+static double PGIntervalLength = 1;
+
+
+// Returns the index of the initial key that the specified operation should read or remove. Sequential and reverse
+// workloads walk the keys in the order they were inserted; the others pick keys at random.
+static NSUInteger PGInitialKeyIndex(PGKeyDistribution distribution, NSUInteger operation, NSUInteger size)
+{
+    switch (distribution) {
+        case PGKeyDistributionSequential:
+            return operation % size;
+        case PGKeyDistributionReverse:
+            return size - 1 - operation % size;
+        default:
+            return random() % size;
+    }
+}
+
+
+#pragma mark - Benchmark subjects
+
+typedef NS_ENUM(NSUInteger, PGSetOperation) {
+    PGSetOperationUnion,
+    PGSetOperationIntersection,
+    PGSetOperationDifference
+};
+
+
+// Each structure being measured is wrapped in a subject so that every workload drives them identically. Subjects that
+// don't implement an optional method are skipped for workloads that need it.
+@protocol PGBenchmarkSubject <NSObject>
+
++ (NSString *)name;
++ (BOOL)hasFastWrites;
+
+- (id)initWithSortedKeys:(NSArray *)keys;
+- (void)insertKey:(id)key;
+- (BOOL)containsKey:(id)key;
+- (void)removeKey:(id)key;
+- (void)insertKeys:(NSArray *)keys;
+- (void)removeKeys:(NSArray *)keys;
+
+@optional
++ (BOOL)isReadOnly;
++ (BOOL)isThreadSafe;
++ (BOOL)countsComparisons;
++ (BOOL)onlyPerformsSetOperations;
+- (NSUInteger)scanFromKey:(id)key count:(NSUInteger)count;
+- (id)operandWithSortedKeys:(NSArray *)keys;
+- (void)performSetOperation:(PGSetOperation)operation withOperand:(id)operand;
+- (NSUInteger)countOfIntervalsContainingPoint:(double)point;
+
+@end
+
+
+@interface PGTreeBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGRedBlackTree *_tree;
+}
+
+// The comparator the tree uses. Subclasses override this to measure other comparators.
++ (NSComparator)comparator;
+
+@end
+
+
+@implementation PGTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGRedBlackTree";
+}
+
+
++ (NSComparator)comparator
+{
+    return PGCountingComparator;
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _tree = [[PGRedBlackTree alloc] initWithSortedArray:keys comparator:[[self class] comparator]];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_tree release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_tree addObject:key];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_tree containsObject:key];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [_tree removeObject:key];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [_tree addObjectsFromArray:keys sorted:NO];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    [_tree removeObjectsInArray:keys];
+}
+
+
+- (NSUInteger)scanFromKey:(id)key count:(NSUInteger)count
+{
+    PGRedBlackTreeCursor *cursor = [[PGRedBlackTreeCursor alloc] initWithTree:_tree];
+    NSUInteger scannedCount = 0;
+    for (id object = [cursor seekToObjectGreaterThanOrEqualToObject:key]; object && scannedCount < count; object = [cursor nextObject]) {
+        ++scannedCount;
+    }
+
+    [cursor release];
+    return scannedCount;
+}
+
+
+- (id)operandWithSortedKeys:(NSArray *)keys
+{
+    return [PGRedBlackTree treeWithSortedArray:keys comparator:[[self class] comparator]];
+}
+
+
+- (void)performSetOperation:(PGSetOperation)operation withOperand:(id)operand
+{
+    switch (operation) {
+        case PGSetOperationUnion:
+            [_tree treeByUnioningWithTree:operand];
+            break;
+        case PGSetOperationIntersection:
+            [_tree treeByIntersectingWithTree:operand];
+            break;
+        case PGSetOperationDifference:
+            [_tree treeBySubtractingTree:operand];
+            break;
+    }
+}
+
+
+- (NSUInteger)countOfIntervalsContainingPoint:(double)point
+{
+    // Without an interval tree, every interval that starts at or before the point has to be checked
+    __block NSUInteger count = 0;
+    [_tree enumerateObjectsLessThanOrEqualToObject:@(point) usingBlock:^(id key, BOOL *stop) {
+        if ([key doubleValue] + PGIntervalLength > point) ++count;
+    }];
+
+    return count;
+}
+
+@end
+
+
+// Trees with PGComparators.h's comparators. Comparing their times with the "tree" subject's, whose comparator sends
+// -compare: from a block, shows how much of each operation is spent comparing.
+@interface PGSelectorTreeBenchmarkSubject : PGTreeBenchmarkSubject
+@end
+
+
+@implementation PGSelectorTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGRedBlackTree+selector";
+}
+
+
++ (NSComparator)comparator
+{
+    static NSComparator comparator = nil;
+    if (!comparator) comparator = [PGComparatorWithSelector(@selector(compare:)) retain];
+    return comparator;
+}
+
+
++ (BOOL)countsComparisons
+{
+    return NO;
+}
+
+@end
+
+
+@interface PGNumericTreeBenchmarkSubject : PGTreeBenchmarkSubject
+@end
+
+
+@implementation PGNumericTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGRedBlackTree+numeric";
+}
+
+
++ (NSComparator)comparator
+{
+    static NSComparator comparator = nil;
+    if (!comparator) comparator = [PGNumericComparator() retain];
+    return comparator;
+}
+
+
++ (BOOL)countsComparisons
+{
+    return NO;
+}
+
+@end
+
+
+// Set operations done an object at a time with -containsObject:, -addObject:, and -removeObject:, which is the
+// baseline for the split- and join-based set operations. Other workloads would be the same as the "tree" subject's.
+@interface PGLoopTreeBenchmarkSubject : PGTreeBenchmarkSubject
+@end
+
+
+@implementation PGLoopTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGRedBlackTree+loop";
+}
+
+
++ (BOOL)onlyPerformsSetOperations
+{
+    return YES;
+}
+
+
+- (void)performSetOperation:(PGSetOperation)operation withOperand:(id)operand
+{
+    PGRedBlackTree *result = [[PGRedBlackTree alloc] initWithComparator:[[self class] comparator]];
+    switch (operation) {
+        case PGSetOperationUnion:
+            [result addObjectsFromArray:[_tree allObjects]];
+            for (id object in operand) {
+                if (![_tree containsObject:object]) [result addObject:object];
+            }
+            break;
+        case PGSetOperationIntersection:
+            for (id object in _tree) {
+                if ([operand containsObject:object]) [result addObject:object];
+            }
+            break;
+        case PGSetOperationDifference:
+            [result addObjectsFromArray:[_tree allObjects]];
+            for (id object in operand) {
+                [result removeObject:object];
+            }
+            break;
+    }
+
+    [result release];
+}
+
+@end
+
+
+// A single tree behind a single lock is the baseline for multithreaded runs
+@interface PGLockedTreeBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGRedBlackTree *_tree;
+    pthread_mutex_t _lock;
+}
+
+@end
+
+
+@implementation PGLockedTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGRedBlackTree+lock";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
++ (BOOL)isThreadSafe
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _tree = [[PGRedBlackTree alloc] initWithSortedArray:keys comparator:PGCountingComparator];
+        pthread_mutex_init(&_lock, NULL);
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+    [_tree release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    pthread_mutex_lock(&_lock);
+    [_tree addObject:key];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    pthread_mutex_lock(&_lock);
+    BOOL containsKey = [_tree containsObject:key];
+    pthread_mutex_unlock(&_lock);
+    return containsKey;
+}
+
+
+- (void)removeKey:(id)key
+{
+    pthread_mutex_lock(&_lock);
+    [_tree removeObject:key];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    pthread_mutex_lock(&_lock);
+    [_tree addObjectsFromArray:keys sorted:NO];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    pthread_mutex_lock(&_lock);
+    [_tree removeObjectsInArray:keys];
+    pthread_mutex_unlock(&_lock);
+}
+
+@end
+
+
+@interface PGShardedTreeBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGShardedRedBlackTree *_tree;
+}
+
+@end
+
+
+@implementation PGShardedTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGShardedRedBlackTree";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
++ (BOOL)isThreadSafe
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        // A few shards per processor keeps the chance that two threads want the same shard low
+        NSUInteger shardCount = 4 * [[NSProcessInfo processInfo] activeProcessorCount];
+        _tree = [[PGShardedRedBlackTree alloc] initWithComparator:PGCountingComparator shardCount:shardCount];
+        [_tree addObjectsFromArray:keys];
+        [_tree rebalance];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_tree release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_tree addObject:key];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_tree containsObject:key];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [_tree removeObject:key];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [_tree addObjectsFromArray:keys];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [_tree removeObject:key];
+    }
+}
+
+@end
+
+
+@interface PGArrayBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    NSMutableArray *_array;
+}
+
+@end
+
+
+@implementation PGArrayBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"NSMutableArray";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    // Every insertion and removal moves half of the array on average
+    return NO;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _array = [keys mutableCopy];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_array release];
+    [super dealloc];
+}
+
+
+- (NSUInteger)indexOfKey:(id)key options:(NSBinarySearchingOptions)options
+{
+    return [_array indexOfObject:key inSortedRange:NSMakeRange(0, [_array count]) options:options usingComparator:PGCountingComparator];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_array insertObject:key atIndex:[self indexOfKey:key options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual]];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [self indexOfKey:key options:0] != NSNotFound;
+}
+
+
+- (void)removeKey:(id)key
+{
+    NSUInteger index = [self indexOfKey:key options:NSBinarySearchingFirstEqual];
+    if (index != NSNotFound) [_array removeObjectAtIndex:index];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [_array addObjectsFromArray:keys];
+    [_array sortUsingComparator:PGCountingComparator];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [self removeKey:key];
+    }
+}
+
+
+- (NSUInteger)scanFromKey:(id)key count:(NSUInteger)count
+{
+    NSUInteger arrayCount = [_array count];
+    NSUInteger index = [self indexOfKey:key options:NSBinarySearchingInsertionIndex | NSBinarySearchingFirstEqual];
+    NSUInteger scannedCount = 0;
+    for (; index < arrayCount && scannedCount < count; ++index) {
+        [_array objectAtIndex:index];
+        ++scannedCount;
+    }
+
+    return scannedCount;
+}
+
+@end
+
+
+@interface PGSetBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    NSMutableSet *_set;
+}
+
+@end
+
+
+@implementation PGSetBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"NSMutableSet";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _set = [[NSMutableSet alloc] initWithArray:keys];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_set release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_set addObject:key];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_set containsObject:key];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [_set removeObject:key];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [_set addObjectsFromArray:keys];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [_set removeObject:key];
+    }
+}
+
+
+- (id)operandWithSortedKeys:(NSArray *)keys
+{
+    return [NSSet setWithArray:keys];
+}
+
+
+- (void)performSetOperation:(PGSetOperation)operation withOperand:(id)operand
+{
+    NSMutableSet *result = [_set mutableCopy];
+    switch (operation) {
+        case PGSetOperationUnion:
+            [result unionSet:operand];
+            break;
+        case PGSetOperationIntersection:
+            [result intersectSet:operand];
+            break;
+        case PGSetOperationDifference:
+            [result minusSet:operand];
+            break;
+    }
+
+    [result release];
+}
+
+@end
+
+
+@interface PGCompactTreeBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGCompactRedBlackTree *_tree;
+}
+
+@end
+
+
+@implementation PGCompactTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGCompactRedBlackTree";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _tree = [[PGCompactRedBlackTree alloc] initWithSortedArray:keys comparator:PGCountingComparator];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_tree release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_tree addObject:key];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_tree containsObject:key];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [_tree removeObject:key];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [_tree addObjectsFromArray:keys];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [_tree removeObject:key];
+    }
+}
+
+@end
+
+
+@interface PGIntervalTreeBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGIntervalRedBlackTree *_tree;
+}
+
+@end
+
+
+@implementation PGIntervalTreeBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGIntervalRedBlackTree";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _tree = [[PGIntervalRedBlackTree alloc] initWithCapacity:[keys count]];
+        for (id key in keys) {
+            [self insertKey:key];
+        }
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_tree release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [_tree addInterval:PGIntervalMake([key doubleValue], [key doubleValue] + PGIntervalLength) object:key];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_tree containsInterval:PGIntervalMake([key doubleValue], [key doubleValue] + PGIntervalLength)];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [_tree removeInterval:PGIntervalMake([key doubleValue], [key doubleValue] + PGIntervalLength) object:key];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [self insertKey:key];
+    }
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    for (id key in keys) {
+        [self removeKey:key];
+    }
+}
+
+
+- (NSUInteger)countOfIntervalsContainingPoint:(double)point
+{
+    __block NSUInteger count = 0;
+    [_tree enumerateObjectsContainingPoint:point usingBlock:^(PGInterval interval, id object, BOOL *stop) {
+        ++count;
+    }];
+
+    return count;
+}
+
+@end
+
+
+@interface PGFrozenSetBenchmarkSubject : NSObject <PGBenchmarkSubject> {
+    PGFrozenSortedSet *_set;
+}
+
+@end
+
+
+@implementation PGFrozenSetBenchmarkSubject
+
++ (NSString *)name
+{
+    return @"PGFrozenSortedSet";
+}
+
+
++ (BOOL)hasFastWrites
+{
+    return NO;
+}
+
+
++ (BOOL)isReadOnly
+{
+    return YES;
+}
+
+
+- (id)initWithSortedKeys:(NSArray *)keys
+{
+    self = [super init];
+    if (self) {
+        _set = [[PGFrozenSortedSet alloc] initWithSortedArray:keys comparator:PGCountingComparator];
+    }
+
+    return self;
+}
+
+
+- (void)dealloc
+{
+    [_set release];
+    [super dealloc];
+}
+
+
+- (void)insertKey:(id)key
+{
+    [self doesNotRecognizeSelector:_cmd];
+}
+
+
+- (BOOL)containsKey:(id)key
+{
+    return [_set containsObject:key];
+}
+
+
+- (void)removeKey:(id)key
+{
+    [self doesNotRecognizeSelector:_cmd];
+}
+
+
+- (void)insertKeys:(NSArray *)keys
+{
+    [self doesNotRecognizeSelector:_cmd];
+}
+
+
+- (void)removeKeys:(NSArray *)keys
+{
+    [self doesNotRecognizeSelector:_cmd];
+}
+
+
+- (NSUInteger)scanFromKey:(id)key count:(NSUInteger)count
+{
+    __block NSUInteger scannedCount = 0;
+    [_set enumerateObjectsFromObject:key inclusive:YES toObject:nil inclusive:NO options:0 usingBlock:^(id obj, BOOL *stop) {
+        *stop = ++scannedCount >= count;
+    }];
+
+    return scannedCount;
+}
+
+@end
+
+
+#pragma mark - Workloads
+
+typedef NS_ENUM(NSUInteger, PGWorkloadType) {
+    PGWorkloadTypeInsert,
+    PGWorkloadTypeLookup,
+    PGWorkloadTypeRemove,
+    PGWorkloadTypeMix,
+    PGWorkloadTypeScan,
+    PGWorkloadTypeBatchInsert,
+    PGWorkloadTypeBatchRemove,
+    PGWorkloadTypeUnion,
+    PGWorkloadTypeIntersection,
+    PGWorkloadTypeDifference,
+    PGWorkloadTypeStab,
+    PGWorkloadTypeInvalid
+};
+
+
+// Workloads are specified as a name with an optional parameter, e.g., mix:90 for 90% reads, scan:100 for scans of 100
+// objects, or stab:10 for finding the intervals containing points that are each in about 10 intervals. Returns PGWorkloadTypeInvalid if the workload isn't recognized.
+static PGWorkloadType PGParseWorkload(NSString *workload, NSUInteger *parameter)
+{
+    NSArray *components = [workload componentsSeparatedByString:@":"];
+    NSString *name = components[0];
+    *parameter = [components count] > 1 ? (NSUInteger)[components[1] integerValue] : 0;
+
+    if ([name isEqualToString:@"insert"]) return PGWorkloadTypeInsert;
+    if ([name isEqualToString:@"lookup"]) return PGWorkloadTypeLookup;
+    if ([name isEqualToString:@"remove"]) return PGWorkloadTypeRemove;
+    if ([name isEqualToString:@"batchinsert"]) return PGWorkloadTypeBatchInsert;
+    if ([name isEqualToString:@"batchremove"]) return PGWorkloadTypeBatchRemove;
+    if ([name isEqualToString:@"union"]) return PGWorkloadTypeUnion;
+    if ([name isEqualToString:@"intersection"]) return PGWorkloadTypeIntersection;
+    if ([name isEqualToString:@"difference"]) return PGWorkloadTypeDifference;
+
+    if ([name isEqualToString:@"mix"]) {
+        if ([components count] == 1) *parameter = 90;
+        return *parameter <= 100 ? PGWorkloadTypeMix : PGWorkloadTypeInvalid;
+    } else if ([name isEqualToString:@"scan"]) {
+        if ([components count] == 1) *parameter = 100;
+        return *parameter > 0 ? PGWorkloadTypeScan : PGWorkloadTypeInvalid;
+    } else if ([name isEqualToString:@"stab"]) {
+        if ([components count] == 1) *parameter = 10;
+        return *parameter > 0 ? PGWorkloadTypeStab : PGWorkloadTypeInvalid;
+    }
+
+    return PGWorkloadTypeInvalid;
+}
+
+
+// Runs one workload against a new subject filled with keys and returns a record of the results, or nil if the subject
+// doesn't support the workload. keys must be sorted and have been generated using distribution.
+static NSDictionary *PGRunWorkload(Class subjectClass, NSString *workload, PGKeyDistribution distribution, NSArray *keys,
+                                   NSUInteger operationCount, NSUInteger threadCount)
+{
+    NSUInteger parameter = 0;
+    PGWorkloadType type = PGParseWorkload(workload, &parameter);
+    NSUInteger size = [keys count];
+
+    BOOL isScan = type == PGWorkloadTypeScan;
+    BOOL isStab = type == PGWorkloadTypeStab;
+    BOOL isSetOperation = type == PGWorkloadTypeUnion || type == PGWorkloadTypeIntersection || type == PGWorkloadTypeDifference;
+    if ((isScan && ![subjectClass instancesRespondToSelector:@selector(scanFromKey:count:)]) ||
+        (isStab && ![subjectClass instancesRespondToSelector:@selector(countOfIntervalsContainingPoint:)]) ||
+        (isSetOperation && ![subjectClass instancesRespondToSelector:@selector(performSetOperation:withOperand:)])) {
+        return nil;
+    }
+
+    BOOL onlyPerformsSetOperations = [subjectClass respondsToSelector:@selector(onlyPerformsSetOperations)] &&
+                                     [subjectClass onlyPerformsSetOperations];
+    if (onlyPerformsSetOperations && !isSetOperation) return nil;
+
+    // Only individual insertions, lookups, and removals are spread across threads, and only for thread-safe subjects
+    BOOL isThreadSafe = [subjectClass respondsToSelector:@selector(isThreadSafe)] && [subjectClass isThreadSafe];
+    BOOL isIndividualOperation = type == PGWorkloadTypeInsert || type == PGWorkloadTypeLookup || type == PGWorkloadTypeRemove ||
+                                 type == PGWorkloadTypeMix;
+    if (threadCount > 1 && (!isThreadSafe || !isIndividualOperation)) return nil;
+
+    // Make intervals long enough that each point is covered by about as many intervals as a stab workload asks for,
+    // assuming the keys are spread evenly. Other workloads use intervals about as long as the gaps between keys.
+    double keySpan = size > 0 ? [[keys lastObject] doubleValue] - [keys[0] doubleValue] : 0;
+    PGIntervalLength = MAX(1.0, (isStab ? parameter : 1) * keySpan / MAX(size, 1));
+
+    if (type == PGWorkloadTypeRemove || type == PGWorkloadTypeBatchRemove) {
+        operationCount = MIN(operationCount, size);
+    }
+
+    // Choose every key and operation before we start timing. Operations in a mix are 0 for lookups, 1 for insertions, and
+    // 2 for removals. Insertions and removals alternate so that the structure stays about the same size.
+    NSMutableArray *operationKeys = [NSMutableArray arrayWithCapacity:operationCount];
+    uint8_t *operations = calloc(operationCount, sizeof(uint8_t));
+    NSUInteger insertedCount = 0;
+    for (NSUInteger i = 0; i < operationCount; ++i) {
+        BOOL isInsertion = type == PGWorkloadTypeInsert || type == PGWorkloadTypeBatchInsert;
+        if (type == PGWorkloadTypeMix && (NSUInteger)(random() % 100) >= parameter) {
+            operations[i] = i % 2 == 0 ? 1 : 2;
+            isInsertion = operations[i] == 1;
+        } else if (isSetOperation) {
+            // Set operation operands share about half of their keys with the subject
+            isInsertion = i % 2 == 0;
+        }
+
+        NSNumber *key = isInsertion ? PGKeyAtPosition(distribution, size + insertedCount++, size)
+                                    : keys[PGInitialKeyIndex(distribution, i, size)];
+        [operationKeys addObject:key];
+    }
+
+    id <PGBenchmarkSubject> subject = [[subjectClass alloc] initWithSortedKeys:keys];
+    id operand = nil;
+    if (isSetOperation) {
+        operand = [[subject operandWithSortedKeys:[operationKeys sortedArrayUsingSelector:@selector(compare:)]] retain];
+    }
+
+    // Individual operations are timed so that we can report latency percentiles. Batch and set operations are a single
+    // call, so only their total time is meaningful.
+    uint64_t *latencies = malloc(MAX(operationCount, 1) * sizeof(uint64_t));
+    BOOL hasLatencies = NO;
+    PGComparisonCount = 0;
+    uint64_t startTime = PGNanoseconds();
+
+    switch (type) {
+        case PGWorkloadTypeBatchInsert:
+            @autoreleasepool {
+                [subject insertKeys:operationKeys];
+            }
+            break;
+        case PGWorkloadTypeBatchRemove:
+            @autoreleasepool {
+                [subject removeKeys:operationKeys];
+            }
+            break;
+        case PGWorkloadTypeUnion:
+        case PGWorkloadTypeIntersection:
+        case PGWorkloadTypeDifference:
+            @autoreleasepool {
+                PGSetOperation operation = type == PGWorkloadTypeUnion ? PGSetOperationUnion :
+                                           (type == PGWorkloadTypeIntersection ? PGSetOperationIntersection : PGSetOperationDifference);
+                [subject performSetOperation:operation withOperand:operand];
+            }
+            operationCount += size;
+            break;
+        default:
+            hasLatencies = YES;
+
+            // Each thread takes every threadCount-th operation so that they all see the same mix of keys and operations.
+            // With one thread, dispatch_apply runs the block on this thread, so its comparisons are still counted.
+            dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+                @autoreleasepool {
+                    for (NSUInteger i = thread; i < operationCount; i += threadCount) {
+                        id key = operationKeys[i];
+                        uint64_t operationStartTime = PGNanoseconds();
+                        if (type == PGWorkloadTypeInsert || operations[i] == 1) {
+                            [subject insertKey:key];
+                        } else if (type == PGWorkloadTypeRemove || operations[i] == 2) {
+                            [subject removeKey:key];
+                        } else if (isScan) {
+                            [subject scanFromKey:key count:parameter];
+                        } else if (isStab) {
+                            [subject countOfIntervalsContainingPoint:[key doubleValue]];
+                        } else {
+                            [subject containsKey:key];
+                        }
+
+                        latencies[i] = PGNanoseconds() - operationStartTime;
+                    }
+                }
+            });
+            break;
+    }
+
+    double seconds = (PGNanoseconds() - startTime) / 1e9;
+    unsigned long long comparisonCount = PGComparisonCount;
+
+    NSMutableDictionary *record = [NSMutableDictionary dictionary];
+    record[@"structure"] = [subjectClass name];
+    record[@"workload"] = workload;
+    record[@"keys"] = PGKeyDistributionNames[distribution];
+    record[@"size"] = @(size);
+    record[@"threads"] = @(threadCount);
+    record[@"operations"] = @(operationCount);
+    record[@"seconds"] = @(seconds);
+    record[@"opsPerSecond"] = @(seconds > 0 ? operationCount / seconds : 0);
+    BOOL countsComparisons = ![subjectClass respondsToSelector:@selector(countsComparisons)] || [subjectClass countsComparisons];
+    if (threadCount == 1 && countsComparisons) {
+        record[@"comparisonsPerOp"] = @(operationCount > 0 ? (double)comparisonCount / operationCount : 0);
+    }
+
+    if (hasLatencies && operationCount > 0) {
+        qsort(latencies, operationCount, sizeof(uint64_t), PGCompareLatencies);
+        record[@"p50Nanoseconds"] = @(PGPercentile(latencies, operationCount, 0.5));
+        record[@"p99Nanoseconds"] = @(PGPercentile(latencies, operationCount, 0.99));
+        record[@"p999Nanoseconds"] = @(PGPercentile(latencies, operationCount, 0.999));
+    }
+
+    // Measure peak memory before releasing the subject so that it reflects the structure at its largest
+    record[@"peakRSSBytes"] = @(PGPeakResidentSetSize());
+
+    [operand release];
+    [subject release];
+    free(latencies);
+    free(operations);
+    return record;
+}
+
+
+#pragma mark - Output
+
+static NSArray *PGRecordFields(void)
+{
+    return @[ @"structure", @"workload", @"keys", @"size", @"threads", @"operations", @"seconds", @"opsPerSecond",
+              @"p50Nanoseconds", @"p99Nanoseconds", @"p999Nanoseconds", @"comparisonsPerOp", @"peakRSSBytes" ];
+}
+
+
+static void PGPrintCSVRecord(NSDictionary *record)
+{
+    NSMutableArray *values = [NSMutableArray array];
+    for (NSString *field in PGRecordFields()) {
+        id value = record[field];
+        [values addObject:value ? [value description] : @""];
+    }
+
+    printf("%s\n", [[values componentsJoinedByString:@","] UTF8String]);
+    fflush(stdout);
+}
+
+
+static void PGPrintJSONRecords(NSArray *records)
+{
+    // Missing latencies are written as null so that every record has the same fields
+    NSMutableArray *completeRecords = [NSMutableArray arrayWithCapacity:[records count]];
+    for (NSDictionary *record in records) {
+        NSMutableDictionary *completeRecord = [[record mutableCopy] autorelease];
+        for (NSString *field in PGRecordFields()) {
+            if (!completeRecord[field]) completeRecord[field] = [NSNull null];
+        }
+
+        [completeRecords addObject:completeRecord];
+    }
+
+    NSData *data = [NSJSONSerialization dataWithJSONObject:completeRecords options:NSJSONWritingPrettyPrinted error:NULL];
+    fwrite([data bytes], 1, [data length], stdout);
+    printf("\n");
+}
+
+
+#pragma mark - Main
+
+static void PGPrintUsage(void)
+{
+    printf("Usage: RedBlack [options]\n"
+           "  -sizes 1000,10000,...       structure sizes to test (default 1000 through 10000000 by powers of 10)\n"
+           "  -operations N               operations per run (default 100000)\n"
+           "  -keys random,...            key distributions: random, sequential, reverse, duplicates (default all)\n"
+           "  -workloads insert,...       workloads: insert, lookup, remove, mix:<read %%>, scan:<width>, batchinsert,\n"
+           "                              batchremove, union, intersection, difference, stab:<intervals per point>\n"
+           "                              (default all, with mix:90, mix:50, scan:10, scan:100, scan:1000, and stab:10)\n"
+           "  -structures tree,...        structures: tree, selector, numeric, loop, compact, frozen, interval,\n"
+           "                              locked, sharded, array, set (default all); loop only runs set operations\n"
+           "  -threads 1,2,4,...          thread counts; runs with more than one thread only use insert, lookup,\n"
+           "                              remove, and mix workloads on locked and sharded (default 1)\n"
+           "  -arrayWriteLimit N          largest size at which NSMutableArray runs write workloads (default 100000)\n"
+           "  -format csv|json            output format (default csv)\n"
+           "  -seed N                     random seed (default 1)\n"
+           "\n"
+           "peakRSSBytes is the process's high-water mark so far, so run a single size per process to isolate it.\n");
+}
+
+
 int main(int argc, const char * argv[])
 {
     @autoreleasepool {
+        NSMutableDictionary *options = [NSMutableDictionary dictionaryWithDictionary:@{
+            @"sizes" : @"1000,10000,100000,1000000,10000000",
+            @"operations" : @"100000",
+            @"keys" : @"random,sequential,reverse,duplicates",
+            @"workloads" : @"insert,lookup,remove,mix:90,mix:50,scan:10,scan:100,scan:1000,batchinsert,batchremove,union,intersection,difference,stab:10",
+            @"structures" : @"tree,selector,numeric,loop,compact,frozen,interval,locked,sharded,array,set",
+            @"threads" : @"1",
+            @"arrayWriteLimit" : @"100000",
+            @"format" : @"csv",
+            @"seed" : @"1"
+        }];
+
+        NSArray *arguments = PGCommandLineArgumentsAsStrings(argc, argv);
+        for (NSUInteger i = 1; i < [arguments count]; i += 2) {
+            NSString *option = [arguments[i] hasPrefix:@"-"] ? [arguments[i] substringFromIndex:1] : nil;
+            if (!option || !options[option] || i + 1 >= [arguments count]) {
+                PGPrintUsage();
+                return [arguments[i] isEqualToString:@"-help"] ? 0 : 1;
+            }
+
+            options[option] = arguments[i + 1];
+        }
+
+        NSDictionary *subjectClasses = @{ @"tree" : [PGTreeBenchmarkSubject class],
+                                          @"selector" : [PGSelectorTreeBenchmarkSubject class],
+                                          @"numeric" : [PGNumericTreeBenchmarkSubject class],
+                                          @"loop" : [PGLoopTreeBenchmarkSubject class],
+                                          @"compact" : [PGCompactTreeBenchmarkSubject class],
+                                          @"frozen" : [PGFrozenSetBenchmarkSubject class],
+                                          @"interval" : [PGIntervalTreeBenchmarkSubject class],
+                                          @"locked" : [PGLockedTreeBenchmarkSubject class],
+                                          @"sharded" : [PGShardedTreeBenchmarkSubject class],
+                                          @"array" : [PGArrayBenchmarkSubject class],
+                                          @"set" : [PGSetBenchmarkSubject class] };
+
+        // Validate everything up front so that a typo doesn't surface hours into a run
+        NSArray *workloads = [options[@"workloads"] componentsSeparatedByString:@","];
+        for (NSString *workload in workloads) {
+            NSUInteger parameter;
+            if (PGParseWorkload(workload, &parameter) == PGWorkloadTypeInvalid) {
+                fprintf(stderr, "Unknown workload %s\n", [workload UTF8String]);
+                return 1;
+            }
+        }
+
+        NSMutableArray *subjects = [NSMutableArray array];
+        for (NSString *structure in [options[@"structures"] componentsSeparatedByString:@","]) {
+            if (!subjectClasses[structure]) {
+                fprintf(stderr, "Unknown structure %s\n", [structure UTF8String]);
+                return 1;
+            }
+
+            [subjects addObject:subjectClasses[structure]];
+        }
+
+        NSMutableArray *distributions = [NSMutableArray array];
+        for (NSString *name in [options[@"keys"] componentsSeparatedByString:@","]) {
+            NSUInteger distribution = 0;
+            while (distribution < PGKeyDistributionCount && ![PGKeyDistributionNames[distribution] isEqualToString:name]) {
+                ++distribution;
+            }
+
+            if (distribution == PGKeyDistributionCount) {
+                fprintf(stderr, "Unknown key distribution %s\n", [name UTF8String]);
+                return 1;
+            }
+
+            [distributions addObject:@(distribution)];
+        }
+
+        NSMutableArray *threadCounts = [NSMutableArray array];
+        for (NSString *threadCountString in [options[@"threads"] componentsSeparatedByString:@","]) {
+            NSInteger threadCount = [threadCountString integerValue];
+            if (threadCount <= 0) {
+                fprintf(stderr, "Invalid thread count %s\n", [threadCountString UTF8String]);
+                return 1;
+            }
+
+            [threadCounts addObject:@(threadCount)];
+        }
+
+        NSUInteger operationCount = (NSUInteger)[options[@"operations"] integerValue];
+        NSUInteger arrayWriteLimit = (NSUInteger)[options[@"arrayWriteLimit"] integerValue];
+        BOOL isJSON = [options[@"format"] isEqualToString:@"json"];
+        NSMutableArray *records = [NSMutableArray array];
+
+        if (!isJSON) {
+            printf("%s\n", [[PGRecordFields() componentsJoinedByString:@","] UTF8String]);
+        }
+
+        for (NSString *sizeString in [options[@"sizes"] componentsSeparatedByString:@","]) {
+            NSUInteger size = (NSUInteger)[sizeString integerValue];
+            if (size == 0) continue;
+
+            for (NSNumber *distributionNumber in distributions) {
+                @autoreleasepool {
+                    PGKeyDistribution distribution = [distributionNumber unsignedIntegerValue];
+
+                    // Every run with this size and distribution starts from the same keys
+                    srandom((unsigned)[options[@"seed"] integerValue]);
+                    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:size];
+                    for (NSUInteger i = 0; i < size; ++i) {
+                        [keys addObject:PGKeyAtPosition(distribution, i, size)];
+                    }
+
+                    [keys sortUsingSelector:@selector(compare:)];
+
+                    for (NSString *workload in workloads) {
+                        for (Class subjectClass in subjects) {
+                            NSUInteger parameter;
+                            PGWorkloadType type = PGParseWorkload(workload, &parameter);
+                            BOOL isWrite = type != PGWorkloadTypeLookup && type != PGWorkloadTypeScan && type != PGWorkloadTypeStab &&
+                                           !(type == PGWorkloadTypeMix && parameter == 100);
+                            if (isWrite && ![subjectClass hasFastWrites] && size > arrayWriteLimit) continue;
+                            if (isWrite && [subjectClass respondsToSelector:@selector(isReadOnly)] && [subjectClass isReadOnly]) continue;
+
+                            for (NSNumber *threadCount in threadCounts) {
+                                @autoreleasepool {
+                                    NSDictionary *record = PGRunWorkload(subjectClass, workload, distribution, keys, operationCount,
+                                                                         [threadCount unsignedIntegerValue]);
+                                    if (!record) continue;
+
+                                    if (isJSON) {
+                                        [records addObject:record];
+                                    } else {
+                                        PGPrintCSVRecord(record);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if (isJSON) {
+            PGPrintJSONRecords(records);
+        }
     }
     
     return 0;
 }
-
@@ -0,0 +1,202 @@
+//
+//  CompactRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "CompactRedBlackTreeTests.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGCompactRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+@implementation CompactRedBlackTreeTests
+
+- (void)testInit
+{
+    PGCompactRedBlackTree *tree = [[PGCompactRedBlackTree alloc] init];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    XCTAssertNil([tree firstObject], @"empty tree has a first object.");
+    XCTAssertNil([tree lastObject], @"empty tree has a last object.");
+    XCTAssertTrue([tree fulfillsProperties], @"empty tree does not fulfill red-black properties.");
+    [tree release];
+
+    XCTAssertNil([PGCompactRedBlackTree treeWithComparator:nil], @"+treeWithComparator: does not return nil when comparator is nil.");
+    XCTAssertThrowsSpecificNamed([[PGCompactRedBlackTree tree] addObject:nil], NSException, NSInvalidArgumentException,
+                                 @"-addObject: does not throw an NSInvalidArgumentException when object is nil.");
+}
+
+
+- (void)testAddAndRemoveWithManyObjects
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Use a small range of objects so that there are plenty of duplicates
+    PGCompactRedBlackTree *tree = [[PGCompactRedBlackTree alloc] init];
+    NSMutableArray *expectedObjects = [[NSMutableArray alloc] initWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *object = @(random() % (PGLargeTreeSize / 4));
+        [tree addObject:object];
+        [expectedObjects addObject:object];
+    }
+
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqual([tree count], PGLargeTreeSize, @"tree's count was not correctly set after adding objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"objects are not in sorted order after adding objects.");
+
+    NSUInteger index = 0;
+    for (id object in tree) {
+        XCTAssertEqualObjects(object, expectedObjects[index], @"fast enumeration does not visit objects in sorted order.");
+        ++index;
+    }
+
+    XCTAssertEqual(index, PGLargeTreeSize, @"fast enumeration did not visit every object.");
+
+    // Remove objects in random order, adding a new one every so often so that freed nodes get reused
+    while ([expectedObjects count] > 0) {
+        NSUInteger removalIndex = random() % [expectedObjects count];
+        NSNumber *object = expectedObjects[removalIndex];
+        XCTAssertTrue([tree containsObject:object], @"tree does not contain an object that was added.");
+        [tree removeObject:object];
+        [expectedObjects removeObjectAtIndex:removalIndex];
+
+        if (random() % 8 == 0) {
+            NSNumber *newObject = @(random() % (PGLargeTreeSize / 4));
+            [tree addObject:newObject];
+            [expectedObjects addObject:newObject];
+            [expectedObjects sortUsingSelector:@selector(compare:)];
+        }
+
+        XCTAssertEqual([tree count], [expectedObjects count], @"tree's count was not correctly set after removing an object.");
+        if ([expectedObjects count] % 97 == 0) {
+            XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing objects.");
+            XCTAssertEqualObjects([tree allObjects], expectedObjects, @"objects are incorrect after removing objects.");
+        }
+    }
+
+    [tree removeObject:@0];
+    XCTAssertEqual([tree count], 0lu, @"-removeObject: changed the count of an empty tree.");
+    [expectedObjects release];
+    [tree release];
+}
+
+
+- (void)testInitWithSortedArray
+{
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    };
+
+    for (NSUInteger count = 0; count < 300; ++count) {
+        NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:count];
+        for (NSUInteger i = 0; i < count; ++i) {
+            [objects addObject:@(i / 2)];
+        }
+
+        PGCompactRedBlackTree *tree = [PGCompactRedBlackTree treeWithSortedArray:objects comparator:comparator];
+        XCTAssertEqual([tree count], count, @"tree's count was not correctly set after initializing with a sorted array.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after initializing with a sorted array.");
+        XCTAssertEqualObjects([tree allObjects], objects, @"objects are incorrect after initializing with a sorted array.");
+
+        tree = [PGCompactRedBlackTree tree];
+        [tree addObjectsFromArray:[[objects reverseObjectEnumerator] allObjects]];
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects to an empty tree.");
+        XCTAssertEqualObjects([tree allObjects], objects, @"objects are incorrect after adding objects to an empty tree.");
+
+        [tree addObjectsFromArray:objects];
+        XCTAssertEqual([tree count], count * 2, @"tree's count was not correctly set after adding objects to a non-empty tree.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects to a non-empty tree.");
+        [objects release];
+    }
+}
+
+
+- (void)testOrderStatistics
+{
+    PGCompactRedBlackTree *tree = [PGCompactRedBlackTree tree];
+    for (NSUInteger i = PGLargeTreeSize; i > 0; --i) {
+        [tree addObject:@(i - 1)];
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        XCTAssertEqualObjects([tree objectAtIndex:i], @(i), @"-objectAtIndex: returned the wrong object.");
+    }
+
+    XCTAssertEqualObjects([tree firstObject], @0, @"-firstObject returned the wrong object.");
+    XCTAssertEqualObjects([tree lastObject], @(PGLargeTreeSize - 1), @"-lastObject returned the wrong object.");
+    XCTAssertThrowsSpecificNamed([tree objectAtIndex:PGLargeTreeSize], NSException, NSRangeException,
+                                 @"-objectAtIndex: does not throw an NSRangeException when index is out of bounds.");
+}
+
+
+- (void)testOptimizeLayout
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGCompactRedBlackTree *tree = [PGCompactRedBlackTree tree];
+    [tree optimizeLayout];
+    XCTAssertTrue([tree fulfillsProperties], @"empty tree does not fulfill red-black properties after optimizing its layout.");
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:@(random())];
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        [tree removeObject:[tree objectAtIndex:random() % [tree count]]];
+    }
+
+    NSArray *objects = [tree allObjects];
+    [tree optimizeLayout];
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after optimizing its layout.");
+    XCTAssertEqualObjects([tree allObjects], objects, @"objects changed after optimizing the tree's layout.");
+
+    // Make sure the tree still works after it's been laid out again
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        [tree addObject:@(random())];
+        [tree removeObject:[tree objectAtIndex:random() % [tree count]]];
+    }
+
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after mutating an optimized tree.");
+
+    BOOL threw = NO;
+    @try {
+        for (id object in tree) {
+            [tree removeObject:object];
+        }
+    } @catch (NSException *exception) {
+        threw = YES;
+    }
+
+    XCTAssertTrue(threw, @"mutating the tree during fast enumeration did not throw an exception.");
+}
+
+@end
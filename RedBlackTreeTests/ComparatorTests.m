@@ -0,0 +1,158 @@
+//
+//  ComparatorTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "ComparatorTests.h"
+
+#import "PGRedBlackTree.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+@implementation ComparatorTests
+
+- (void)testSelectorComparator
+{
+    XCTAssertNil(PGComparatorWithSelector(NULL), @"PGComparatorWithSelector does not return nil for a NULL selector.");
+
+    // The first class compared is cached, so make sure objects of other classes still use their own implementations
+    NSComparator comparator = PGComparatorWithSelector(@selector(compare:));
+    XCTAssertEqual(comparator(@1, @2), NSOrderedAscending, @"selector comparator ordered numbers incorrectly.");
+    XCTAssertEqual(comparator(@2, @1), NSOrderedDescending, @"selector comparator ordered numbers incorrectly.");
+    XCTAssertEqual(comparator(@"b", @"a"), NSOrderedDescending, @"selector comparator ordered strings incorrectly.");
+    XCTAssertEqual(comparator(@"a", @"a"), NSOrderedSame, @"selector comparator ordered strings incorrectly.");
+    XCTAssertEqual(comparator(@1.5, @1.5), NSOrderedSame, @"selector comparator ordered numbers incorrectly.");
+
+    NSComparator caseInsensitiveComparator = PGComparatorWithSelector(@selector(caseInsensitiveCompare:));
+    XCTAssertEqual(caseInsensitiveComparator(@"ABC", @"abc"), NSOrderedSame, @"selector comparator did not use its selector.");
+}
+
+
+- (void)testNumericComparator
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Mix every kind of number, including ones that need care: large unsigned values, negative values, NaNs, and
+    // decimal numbers
+    NSMutableArray *numbers = [NSMutableArray arrayWithObjects:@(ULLONG_MAX), @(LLONG_MIN), @(LLONG_MAX), @(NAN), @(-INFINITY),
+                               @(INFINITY), @YES, @NO, @((unsigned char)200), @((short)-3), @0.1f, [NSDecimalNumber decimalNumberWithString:@"0.1"],
+                               [NSDecimalNumber decimalNumberWithString:@"12345678901234567890.5"], nil];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        [numbers addObject:@(random() % 100 - 50)];
+        [numbers addObject:@((unsigned long long)random())];
+        [numbers addObject:@((double)(random() % 1000) / 10.0)];
+    }
+
+    NSComparator comparator = PGNumericComparator();
+    for (NSNumber *number1 in numbers) {
+        for (NSNumber *number2 in numbers) {
+            XCTAssertEqual(comparator(number1, number2), [number1 compare:number2],
+                           @"numeric comparator ordered %@ and %@ differently than -compare:.", number1, number2);
+        }
+    }
+}
+
+
+- (void)testStringComparator
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSComparator comparator = PGStringComparatorWithOptions(NSLiteralSearch);
+    XCTAssertEqual(comparator(@"abc", @"abd"), NSOrderedAscending, @"literal comparator ordered ASCII strings incorrectly.");
+    XCTAssertEqual(comparator(@"abc", @"ab"), NSOrderedDescending, @"literal comparator ordered a string before its prefix.");
+    XCTAssertEqual(comparator(@"", @""), NSOrderedSame, @"literal comparator did not find empty strings equal.");
+    unichar characters1[] = { 'a', 0, 'b' };
+    unichar characters2[] = { 'a', 0, 'c' };
+    XCTAssertEqual(comparator([NSString stringWithCharacters:characters1 length:3], [NSString stringWithCharacters:characters2 length:3]),
+                   NSOrderedAscending, @"literal comparator stopped at a null character.");
+    XCTAssertEqual(comparator(@"Z", @"a"), NSOrderedAscending, @"literal comparator did not order by code point.");
+
+    // Code points above U+FFFF are encoded as surrogates, but must still sort after U+E000 through U+FFFF
+    NSString *emoji = @"\U0001F600";
+    NSString *privateUse = @"\uE000";
+    XCTAssertEqual(comparator(privateUse, emoji), NSOrderedAscending, @"literal comparator did not order by code point.");
+    XCTAssertEqual(comparator(emoji, privateUse), NSOrderedDescending, @"literal comparator did not order by code point.");
+
+    // Long strings are compared a buffer at a time, so make them differ at various positions past the first buffer
+    NSString *prefix = [@"" stringByPaddingToLength:200 withString:@"\u00E9" startingAtIndex:0];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        NSUInteger length = random() % 200;
+        NSString *string1 = [[prefix substringToIndex:length] stringByAppendingFormat:@"%c", (char)('a' + random() % 26)];
+        NSString *string2 = [[prefix substringToIndex:length] stringByAppendingFormat:@"%c", (char)('a' + random() % 26)];
+        XCTAssertEqual(comparator(string1, string2), [string1 compare:string2 options:NSLiteralSearch],
+                       @"literal comparator ordered %@ and %@ incorrectly.", string1, string2);
+    }
+
+    NSComparator caseInsensitiveComparator = PGStringComparatorWithOptions(NSCaseInsensitiveSearch);
+    XCTAssertEqual(caseInsensitiveComparator(@"ABC", @"abc"), NSOrderedSame, @"string comparator did not use its options.");
+}
+
+
+- (void)testTreesWithBuiltInComparators
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *numericTree = [PGRedBlackTree treeWithNumericKeys];
+    PGRedBlackTree *stringTree = [PGRedBlackTree treeWithStringKeysUsingOptions:NSLiteralSearch];
+    PGRedBlackTree *selectorTree = [PGRedBlackTree treeWithSelector:@selector(compare:)];
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    NSMutableArray *strings = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        NSString *string = [NSString stringWithFormat:@"key-%@", number];
+        [numericTree addObject:number];
+        [selectorTree addObject:number];
+        [stringTree addObject:string];
+        [numbers addObject:number];
+        [strings addObject:string];
+    }
+
+    [numbers sortUsingSelector:@selector(compare:)];
+    [strings sortUsingComparator:^NSComparisonResult(NSString *string1, NSString *string2) {
+        return [string1 compare:string2 options:NSLiteralSearch];
+    }];
+
+    XCTAssertEqualObjects([numericTree allObjects], numbers, @"numeric tree's objects are incorrect.");
+    XCTAssertEqualObjects([selectorTree allObjects], numbers, @"selector tree's objects are incorrect.");
+    XCTAssertEqualObjects([stringTree allObjects], strings, @"string tree's objects are incorrect.");
+    XCTAssertTrue([numericTree fulfillsProperties], @"numeric tree does not fulfill red-black properties.");
+    XCTAssertTrue([stringTree fulfillsProperties], @"string tree does not fulfill red-black properties.");
+    XCTAssertTrue([stringTree containsObject:strings[0]], @"string tree does not contain an object that was added.");
+    XCTAssertNil([PGRedBlackTree treeWithSelector:NULL], @"+treeWithSelector: does not return nil for a NULL selector.");
+}
+
+@end
@@ -0,0 +1,248 @@
+//
+//  ConcurrentRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "ConcurrentRedBlackTreeTests.h"
+
+#import <libkern/OSAtomic.h>
+
+#import "PGRedBlackTree.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+@implementation ConcurrentRedBlackTreeTests
+
+- (void)testSnapshot
+{
+    XCTAssertNil([PGConcurrentRedBlackTree treeWithComparator:nil], @"+treeWithComparator: does not return nil when comparator is nil.");
+
+    PGConcurrentRedBlackTree *tree = [[PGConcurrentRedBlackTree alloc] init];
+    PGRedBlackTree *emptySnapshot = [tree snapshot];
+    XCTAssertEqual([emptySnapshot count], 0lu, @"snapshot of empty tree is not empty.");
+
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@(i)];
+    }
+
+    [tree addObjectsFromArray:numbers];
+    PGRedBlackTree *snapshot = [tree snapshot];
+    XCTAssertEqual([emptySnapshot count], 0lu, @"old snapshot changed when tree was mutated.");
+    XCTAssertEqualObjects([snapshot allObjects], numbers, @"snapshot does not contain the tree's objects.");
+    XCTAssertTrue([snapshot fulfillsProperties], @"snapshot does not fulfill red-black properties.");
+    XCTAssertEqual([tree snapshot], snapshot, @"snapshot was not reused when the tree was not mutated.");
+
+    [tree removeObject:@(PGLargeTreeSize)];
+    XCTAssertEqual([tree snapshot], snapshot, @"snapshot was not reused after removing an object that was not in the tree.");
+
+    [tree removeObject:@0];
+    [tree addObject:@(PGLargeTreeSize)];
+    XCTAssertEqual([snapshot count], PGLargeTreeSize, @"old snapshot changed when tree was mutated.");
+    XCTAssertTrue([snapshot containsObject:@0], @"old snapshot changed when tree was mutated.");
+    XCTAssertFalse([[tree snapshot] containsObject:@0], @"new snapshot does not reflect mutation.");
+    XCTAssertTrue([[tree snapshot] containsObject:@(PGLargeTreeSize)], @"new snapshot does not reflect mutation.");
+
+    XCTAssertThrowsSpecificNamed([snapshot addObject:@1], NSException, NSInternalInconsistencyException,
+                                 @"snapshot does not throw when an object is added.");
+    XCTAssertThrowsSpecificNamed([snapshot removeObject:@1], NSException, NSInternalInconsistencyException,
+                                 @"snapshot does not throw when an object is removed.");
+    XCTAssertThrowsSpecificNamed([snapshot removeAllObjects], NSException, NSInternalInconsistencyException,
+                                 @"snapshot does not throw when all objects are removed.");
+
+    [tree removeAllObjects];
+    XCTAssertEqual([tree count], 0lu, @"tree's count was not correctly set after removing all objects.");
+    XCTAssertEqual([[tree snapshot] count], 0lu, @"snapshot does not reflect removing all objects.");
+    [tree release];
+
+    // Snapshots are built by replaying logged mutations, so changing an object after removing it must not change what
+    // the replay removes
+    PGConcurrentRedBlackTree *stringTree = [[PGConcurrentRedBlackTree alloc] init];
+    [stringTree addObjectsFromArray:@[ @"a", @"b", @"c" ]];
+    [stringTree snapshot];
+
+    NSMutableString *string = [NSMutableString stringWithString:@"b"];
+    [stringTree removeObject:string];
+    [string setString:@"c"];
+    XCTAssertEqualObjects([[stringTree snapshot] allObjects], (@[ @"a", @"c" ]), @"snapshot replayed a removal of a mutated object.");
+    [stringTree release];
+}
+
+
+- (void)testConcurrentReaders
+{
+    PGConcurrentRedBlackTree *tree = [[PGConcurrentRedBlackTree alloc] init];
+    [tree addObject:@0];
+
+    // One writer adds increasing numbers while readers check that every snapshot they see is a consistent prefix
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_group_t group = dispatch_group_create();
+    dispatch_group_async(group, queue, ^{
+        for (NSUInteger i = 1; i < PGLargeTreeSize / 10; ++i) {
+            [tree addObject:@(i)];
+        }
+    });
+
+    __block volatile int32_t inconsistentSnapshotCount = 0;
+    dispatch_apply(8, queue, ^(size_t reader) {
+        for (NSUInteger i = 0; i < 200; ++i) {
+            @autoreleasepool {
+                PGRedBlackTree *snapshot = [tree snapshot];
+                NSUInteger count = [snapshot count];
+                if (count == 0 || ![[snapshot lastObject] isEqual:@(count - 1)] || ![snapshot containsObject:@(count / 2)]) {
+                    OSAtomicIncrement32(&inconsistentSnapshotCount);
+                }
+            }
+        }
+    });
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+
+    XCTAssertEqual(inconsistentSnapshotCount, 0, @"readers saw inconsistent snapshots.");
+    XCTAssertEqual([[tree snapshot] count], PGLargeTreeSize / 10, @"snapshot does not contain every object added.");
+    [tree release];
+}
+
+
+- (void)testIndexedSnapshot
+{
+    PGConcurrentRedBlackTree *tree = [[PGConcurrentRedBlackTree alloc] init];
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@(i)];
+    }
+
+    [tree addObjectsFromArray:numbers];
+
+    // Snapshots build their index as soon as it is enabled, so concurrent lookups only read it
+    PGRedBlackTree *snapshot = [tree snapshot];
+    [snapshot setIndexesObjects:YES];
+
+    __block volatile int32_t missingObjectCount = 0;
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_apply(8, queue, ^(size_t reader) {
+        for (NSUInteger i = reader; i < PGLargeTreeSize; i += 8) {
+            if (![[snapshot member:@(i)] isEqual:@(i)] || [snapshot containsObject:@(PGLargeTreeSize + i)]) {
+                OSAtomicIncrement32(&missingObjectCount);
+            }
+        }
+    });
+
+    XCTAssertEqual(missingObjectCount, 0, @"concurrent lookups in an indexed snapshot were incorrect.");
+    XCTAssertEqual([snapshot indexOfObject:@(PGLargeTreeSize / 2)], PGLargeTreeSize / 2, @"-indexOfObject: was incorrect in an indexed snapshot.");
+    [tree release];
+}
+
+
+- (void)testConcurrentComparisonCounting
+{
+    PGConcurrentRedBlackTree *tree = [[PGConcurrentRedBlackTree alloc] init];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:@(i)];
+    }
+
+    // Looking up the same object always takes the same comparisons, so lookups on many threads at once should count
+    // exactly as many comparisons as the same lookups on one thread
+    PGRedBlackTree *snapshot = [tree snapshot];
+    [snapshot resetStatistics];
+    [snapshot containsObject:@(PGLargeTreeSize / 3)];
+    unsigned long long comparisonCount = [[snapshot statistics][PGRedBlackTreeStatisticsComparisonCountKey] unsignedLongLongValue];
+    XCTAssertTrue(comparisonCount > 0, @"comparisons were not counted.");
+
+    NSUInteger lookupCount = PGLargeTreeSize;
+    [snapshot resetStatistics];
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t reader) {
+        for (NSUInteger i = reader; i < lookupCount; i += 8) {
+            [snapshot containsObject:@(PGLargeTreeSize / 3)];
+        }
+    });
+
+    XCTAssertEqualObjects([snapshot statistics][PGRedBlackTreeStatisticsComparisonCountKey], @(comparisonCount * lookupCount),
+                          @"comparisons made on several threads at once were not all counted.");
+    [tree release];
+}
+
+
+- (void)testConcurrentReadersWithRemovingWriter
+{
+    PGConcurrentRedBlackTree *tree = [[PGConcurrentRedBlackTree alloc] init];
+
+    // The writer keeps a sliding window of consecutive numbers in the tree, so every consistent snapshot holds a run of
+    // consecutive numbers no longer than the window. The window is larger than the minimum log capacity, so snapshots
+    // are built by replaying additions and removals, and readers that fall behind make the log overflow.
+    NSUInteger windowSize = 2000;
+    NSUInteger mutationCount = PGLargeTreeSize * 4;
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_group_t group = dispatch_group_create();
+    __block volatile int32_t writerFinished = 0;
+    dispatch_group_async(group, queue, ^{
+        for (NSUInteger i = 0; i < mutationCount; ++i) {
+            [tree addObject:@(i)];
+            if (i >= windowSize) [tree removeObject:@(i - windowSize)];
+        }
+
+        OSAtomicIncrement32Barrier(&writerFinished);
+    });
+
+    __block volatile int32_t snapshotCount = 0;
+    __block volatile int32_t inconsistentSnapshotCount = 0;
+    dispatch_apply(8, queue, ^(size_t reader) {
+        do {
+            @autoreleasepool {
+                PGRedBlackTree *snapshot = [tree snapshot];
+                NSUInteger count = [snapshot count];
+                if (count == 0) continue;
+
+                NSUInteger first = [[snapshot firstObject] unsignedIntegerValue];
+                NSUInteger last = [[snapshot lastObject] unsignedIntegerValue];
+                if (count > windowSize || last - first + 1 != count ||
+                    ![[snapshot objectAtIndex:count / 2] isEqual:@(first + count / 2)]) {
+                    OSAtomicIncrement32(&inconsistentSnapshotCount);
+                }
+
+                OSAtomicIncrement32(&snapshotCount);
+            }
+        } while (!writerFinished);
+    });
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+
+    XCTAssertEqual(inconsistentSnapshotCount, 0, @"readers saw inconsistent snapshots.");
+    XCTAssertTrue(snapshotCount > 0, @"readers did not take any snapshots while the writer was running.");
+
+    PGRedBlackTree *snapshot = [tree snapshot];
+    XCTAssertEqual([snapshot count], windowSize, @"final snapshot has the wrong number of objects.");
+    XCTAssertEqualObjects([snapshot firstObject], @(mutationCount - windowSize), @"final snapshot has the wrong objects.");
+    XCTAssertEqualObjects([snapshot lastObject], @(mutationCount - 1), @"final snapshot has the wrong objects.");
+    XCTAssertTrue([snapshot fulfillsProperties], @"final snapshot does not fulfill red-black properties.");
+    [tree release];
+}
+
+@end
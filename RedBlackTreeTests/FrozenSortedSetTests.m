@@ -0,0 +1,210 @@
+//
+//  FrozenSortedSetTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "FrozenSortedSetTests.h"
+
+#import "PGRedBlackTree.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+
+@interface FrozenSortedSetTests ()
+- (void)verifySet:(PGFrozenSortedSet *)set matchesTree:(PGRedBlackTree *)tree withProbes:(NSArray *)probes;
+@end
+
+
+@implementation FrozenSortedSetTests
+
+- (void)testInit
+{
+    PGFrozenSortedSet *set = [[PGFrozenSortedSet alloc] init];
+    XCTAssertEqual([set count], 0lu, @"set's initial count is not 0");
+    XCTAssertNil([set firstObject], @"empty set has a first object.");
+    XCTAssertNil([set member:@1], @"empty set has a member.");
+    XCTAssertEqual([set countOfObjectsLessThanObject:@1], 0lu, @"empty set has objects less than an object.");
+    XCTAssertEqualObjects([set allObjects], @[], @"empty set has objects.");
+    XCTAssertEqual([set copy], set, @"-copy does not return the receiver.");
+    [set release];
+    [set release];
+
+    XCTAssertNil([PGFrozenSortedSet frozenSetWithSortedArray:@[ @1 ] comparator:nil], @"+frozenSetWithSortedArray:comparator: does not return nil when comparator is nil.");
+    XCTAssertThrowsSpecificNamed([[[PGFrozenSortedSet new] autorelease] objectAtIndex:0], NSException, NSRangeException,
+                                 @"-objectAtIndex: does not throw an NSRangeException when index is out of bounds.");
+}
+
+
+- (void)testFrozenCopyWithIntegerKeys
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Use a small range of objects so that there are plenty of duplicates. Probes include integers outside the range and
+    // values that aren't integers, which can't use the set's integer keys. Only the numeric comparator enables keys.
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithNumericKeys];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:@((NSInteger)(random() % (PGLargeTreeSize / 4)) - (NSInteger)(PGLargeTreeSize / 8))];
+    }
+
+    NSMutableArray *probes = [NSMutableArray array];
+    for (NSInteger i = -(NSInteger)(PGLargeTreeSize / 8) - 2; i < (NSInteger)(PGLargeTreeSize / 8) + 2; i += 7) {
+        [probes addObject:@(i)];
+        [probes addObject:@(i + 0.5)];
+    }
+
+    [self verifySet:[tree frozenCopy] matchesTree:tree withProbes:probes];
+
+    for (NSUInteger count = 0; count < 100; ++count) {
+        PGRedBlackTree *smallTree = [PGRedBlackTree treeWithNumericKeys];
+        for (NSUInteger i = 0; i < count; ++i) {
+            [smallTree addObject:@(i * 2)];
+        }
+
+        NSMutableArray *smallProbes = [NSMutableArray array];
+        for (NSUInteger i = 0; i <= count * 2; ++i) {
+            [smallProbes addObject:@(i)];
+        }
+
+        [self verifySet:[smallTree frozenCopy] matchesTree:smallTree withProbes:smallProbes];
+    }
+}
+
+
+- (void)testFrozenCopyWithComparator
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Numbers in descending order don't agree with integer order, so searches have to use the comparator
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithComparator:^NSComparisonResult(id object1, id object2) {
+        return [object2 compare:object1];
+    }];
+
+    NSMutableArray *probes = [NSMutableArray array];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *object = @(random() % PGLargeTreeSize);
+        [tree addObject:object];
+        if (i % 13 == 0) [probes addObject:object];
+    }
+
+    [probes addObject:@(-1)];
+    [probes addObject:@(PGLargeTreeSize)];
+    [self verifySet:[tree frozenCopy] matchesTree:tree withProbes:probes];
+
+    // Sets with a single object or only equal objects agree with integer order whatever their comparator is, but probes
+    // still have to be ordered by the comparator
+    NSComparator descendingComparator = ^NSComparisonResult(id object1, id object2) {
+        return [object2 compare:object1];
+    };
+
+    PGFrozenSortedSet *singletonSet = [PGFrozenSortedSet frozenSetWithSortedArray:@[ @5 ] comparator:descendingComparator];
+    XCTAssertEqual([singletonSet countOfObjectsLessThanObject:@3], 1lu, @"set with a descending comparator used integer order.");
+    XCTAssertEqual([singletonSet countOfObjectsGreaterThanObject:@3], 0lu, @"set with a descending comparator used integer order.");
+    XCTAssertEqualObjects([singletonSet objectsGreaterThanObject:@7], @[ @5 ], @"set with a descending comparator used integer order.");
+
+    PGRedBlackTree *smallTree = [PGRedBlackTree treeWithComparator:descendingComparator];
+    [smallTree addObjectsFromArray:@[ @5, @5, @5 ]];
+    [self verifySet:[smallTree frozenCopy] matchesTree:smallTree withProbes:@[ @3, @5, @7 ]];
+
+    // Strings aren't numbers at all
+    PGRedBlackTree *stringTree = [PGRedBlackTree tree];
+    NSMutableArray *stringProbes = [NSMutableArray array];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSString *object = [NSString stringWithFormat:@"%ld", random() % PGLargeTreeSize];
+        [stringTree addObject:object];
+        if (i % 13 == 0) [stringProbes addObject:[object stringByAppendingString:@"5"]];
+        if (i % 17 == 0) [stringProbes addObject:object];
+    }
+
+    [self verifySet:[stringTree frozenCopy] matchesTree:stringTree withProbes:stringProbes];
+}
+
+
+- (void)testFrozenCopyIsIndependentOfTree
+{
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        [tree addObject:@(i)];
+    }
+
+    PGFrozenSortedSet *set = [tree frozenCopy];
+    NSArray *objects = [tree allObjects];
+    [tree removeAllObjects];
+    [tree addObject:@1000];
+
+    XCTAssertEqual([set count], [objects count], @"set's count changed when the tree was mutated.");
+    XCTAssertEqualObjects([set allObjects], objects, @"set's objects changed when the tree was mutated.");
+    XCTAssertNil([set member:@1000], @"set contains an object added to the tree after it was frozen.");
+}
+
+
+- (void)verifySet:(PGFrozenSortedSet *)set matchesTree:(PGRedBlackTree *)tree withProbes:(NSArray *)probes
+{
+    XCTAssertEqual([set count], [tree count], @"set's count does not match tree's.");
+    XCTAssertEqualObjects([set allObjects], [tree allObjects], @"set's objects do not match tree's.");
+    XCTAssertEqualObjects([set firstObject], [tree firstObject], @"set's first object does not match tree's.");
+    XCTAssertEqualObjects([set lastObject], [tree lastObject], @"set's last object does not match tree's.");
+
+    NSUInteger index = 0;
+    for (id object in set) {
+        XCTAssertEqualObjects(object, [tree objectAtIndex:index], @"fast enumeration does not visit objects in order.");
+        ++index;
+    }
+
+    XCTAssertEqual(index, [tree count], @"fast enumeration did not visit every object.");
+
+    for (id probe in probes) {
+        XCTAssertEqualObjects([set member:probe], [tree member:probe], @"-member: does not match tree's.");
+        XCTAssertEqual([set indexOfObject:probe], [tree indexOfObject:probe], @"-indexOfObject: does not match tree's.");
+        XCTAssertEqual([set countOfObjectsLessThanObject:probe], [tree countOfObjectsLessThanObject:probe],
+                       @"-countOfObjectsLessThanObject: does not match tree's.");
+        XCTAssertEqual([set countOfObjectsEqualToObject:probe], [tree countOfObjectsEqualToObject:probe],
+                       @"-countOfObjectsEqualToObject: does not match tree's.");
+        XCTAssertEqual([set countOfObjectsGreaterThanObject:probe], [tree countOfObjectsGreaterThanObject:probe],
+                       @"-countOfObjectsGreaterThanObject: does not match tree's.");
+        XCTAssertEqualObjects([set objectsLessThanOrEqualToObject:probe], [tree objectsLessThanOrEqualToObject:probe],
+                              @"-objectsLessThanOrEqualToObject: does not match tree's.");
+        XCTAssertEqualObjects([set objectsGreaterThanOrEqualToObject:probe], [tree objectsGreaterThanOrEqualToObject:probe],
+                              @"-objectsGreaterThanOrEqualToObject: does not match tree's.");
+
+        // Enumerate backwards from the probe to the first object
+        NSMutableArray *setObjects = [NSMutableArray array];
+        NSMutableArray *treeObjects = [NSMutableArray array];
+        [set enumerateObjectsFromObject:[set firstObject] inclusive:NO toObject:probe inclusive:YES options:NSEnumerationReverse usingBlock:^(id obj, BOOL *stop) {
+            [setObjects addObject:obj];
+        }];
+
+        [tree enumerateObjectsFromObject:[tree firstObject] inclusive:NO toObject:probe inclusive:YES options:NSEnumerationReverse usingBlock:^(id obj, BOOL *stop) {
+            [treeObjects addObject:obj];
+        }];
+
+        XCTAssertEqualObjects(setObjects, treeObjects, @"range enumeration does not match tree's.");
+    }
+}
+
+@end
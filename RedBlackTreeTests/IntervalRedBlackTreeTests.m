@@ -0,0 +1,172 @@
+//
+//  IntervalRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "IntervalRedBlackTreeTests.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGIntervalRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+@interface IntervalRedBlackTreeTests ()
+- (PGIntervalRedBlackTree *)treeWithRandomIntervalCount:(NSUInteger)count entries:(NSMutableArray *)entries;
+@end
+
+
+@implementation IntervalRedBlackTreeTests
+
+- (void)testInit
+{
+    PGIntervalRedBlackTree *tree = [[PGIntervalRedBlackTree alloc] init];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    XCTAssertEqualObjects([tree objectsContainingPoint:0], @[ ], @"empty tree has an interval containing a point.");
+    XCTAssertTrue([tree fulfillsProperties], @"empty tree does not fulfill red-black properties.");
+    [tree release];
+
+    tree = [PGIntervalRedBlackTree tree];
+    XCTAssertThrowsSpecificNamed([tree addInterval:PGIntervalMake(0, 1) object:nil], NSException, NSInvalidArgumentException,
+                                 @"-addInterval:object: does not throw an NSInvalidArgumentException when object is nil.");
+    XCTAssertThrowsSpecificNamed([tree addInterval:PGIntervalMake(1, 0) object:@0], NSException, NSInvalidArgumentException,
+                                 @"-addInterval:object: does not throw an NSInvalidArgumentException when the interval is reversed.");
+    XCTAssertThrowsSpecificNamed([tree addInterval:PGIntervalMake(NAN, 0) object:@0], NSException, NSInvalidArgumentException,
+                                 @"-addInterval:object: does not throw an NSInvalidArgumentException when the interval is NaN.");
+    XCTAssertThrowsSpecificNamed([tree enumerateObjectsContainingPoint:0 usingBlock:nil], NSException, NSInvalidArgumentException,
+                                 @"-enumerateObjectsContainingPoint:usingBlock: does not throw an NSInvalidArgumentException when block is nil.");
+}
+
+
+// Adds count random intervals to a new tree. Each entry in entries is an array of the interval's start, end, and the
+// order in which it was added, which is also the entry's object in the tree.
+- (PGIntervalRedBlackTree *)treeWithRandomIntervalCount:(NSUInteger)count entries:(NSMutableArray *)entries
+{
+    PGIntervalRedBlackTree *tree = [PGIntervalRedBlackTree tree];
+    for (NSUInteger i = 0; i < count; ++i) {
+        double start = random() % (PGLargeTreeSize * 4);
+        double end = start + random() % (random() % 10 == 0 ? PGLargeTreeSize : 50);
+        [tree addInterval:PGIntervalMake(start, end) object:@(i)];
+        [entries addObject:@[ @(start), @(end), @(i) ]];
+    }
+
+    return tree;
+}
+
+
+- (void)testAddAndRemoveWithManyIntervals
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSMutableArray *entries = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    PGIntervalRedBlackTree *tree = [self treeWithRandomIntervalCount:PGLargeTreeSize entries:entries];
+    XCTAssertEqual([tree count], PGLargeTreeSize, @"tree's count was not correctly set after adding intervals.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill interval tree properties after adding intervals.");
+
+    // Entries with equal starts are kept in the order they were added
+    [entries sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSArray *entry1, NSArray *entry2) {
+        return [entry1[0] compare:entry2[0]];
+    }];
+
+    __block NSUInteger index = 0;
+    [tree enumerateIntervalsAndObjectsUsingBlock:^(PGInterval interval, id object, BOOL *stop) {
+        XCTAssertEqualObjects(object, entries[index][2], @"entries are not in sorted, stable order.");
+        XCTAssertEqual(interval.end, [entries[index][1] doubleValue], @"entry's interval does not match its object.");
+        ++index;
+    }];
+
+    XCTAssertEqual(index, PGLargeTreeSize, @"enumeration did not visit every entry.");
+
+    // Removal moves intervals between nodes, so check that the largest ends are still correct as we go
+    while ([entries count] > 0) {
+        NSUInteger entryIndex = random() % [entries count];
+        NSArray *entry = entries[entryIndex];
+        PGInterval interval = PGIntervalMake([entry[0] doubleValue], [entry[1] doubleValue]);
+        XCTAssertTrue([tree containsInterval:interval], @"tree does not contain an interval that was added.");
+        XCTAssertFalse([tree removeInterval:interval object:@(-1)], @"-removeInterval:object: removed an entry with the wrong object.");
+        XCTAssertTrue([tree removeInterval:interval object:entry[2]], @"-removeInterval:object: did not remove an interval that was added.");
+        [entries removeObjectAtIndex:entryIndex];
+
+        XCTAssertEqual([tree count], [entries count], @"tree's count was not correctly set after removing an interval.");
+        if ([entries count] % 97 == 0) {
+            XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill interval tree properties after removing intervals.");
+        }
+    }
+
+    [tree addInterval:PGIntervalMake(0, 1) object:@0];
+    [tree removeAllIntervals];
+    XCTAssertEqual([tree count], 0lu, @"-removeAllIntervals did not empty the tree.");
+    XCTAssertEqualObjects([tree objectsOverlappingStart:-INFINITY end:INFINITY], @[ ], @"-removeAllIntervals left intervals in the tree.");
+}
+
+
+- (void)testOverlapAndPointQueries
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSMutableArray *entries = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    PGIntervalRedBlackTree *tree = [self treeWithRandomIntervalCount:PGLargeTreeSize entries:entries];
+    [tree addInterval:PGIntervalMake(100, 100) object:@(-1)];
+    [entries sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSArray *entry1, NSArray *entry2) {
+        return [entry1[0] compare:entry2[0]];
+    }];
+
+    // Compare queries against a linear scan. Queries with integral bounds land exactly on interval endpoints often.
+    for (NSUInteger i = 0; i < 200; ++i) {
+        double start = random() % (PGLargeTreeSize * 4);
+        double end = start + random() % 200;
+        double point = random() % 2 == 0 ? start : start + 0.5;
+
+        NSMutableArray *expectedOverlapping = [NSMutableArray array];
+        NSMutableArray *expectedContaining = [NSMutableArray array];
+        for (NSArray *entry in entries) {
+            double entryStart = [entry[0] doubleValue], entryEnd = [entry[1] doubleValue];
+            if (entryStart < end && entryEnd > start && entryStart < entryEnd) [expectedOverlapping addObject:entry[2]];
+            if (entryStart <= point && point < entryEnd) [expectedContaining addObject:entry[2]];
+        }
+
+        XCTAssertEqualObjects([tree objectsOverlappingStart:start end:end], expectedOverlapping,
+                              @"-objectsOverlappingStart:end: returned the wrong objects for [%g, %g).", start, end);
+        XCTAssertEqualObjects([tree objectsContainingPoint:point], expectedContaining,
+                              @"-objectsContainingPoint: returned the wrong objects for %g.", point);
+    }
+
+    XCTAssertFalse([[tree objectsContainingPoint:100] containsObject:@(-1)], @"an empty interval contains a point.");
+    XCTAssertEqualObjects([tree objectsOverlappingStart:10 end:10], @[ ], @"an empty query interval overlaps intervals.");
+
+    __block NSUInteger visitedCount = 0;
+    [tree enumerateObjectsOverlappingStart:-INFINITY end:INFINITY usingBlock:^(PGInterval interval, id object, BOOL *stop) {
+        *stop = ++visitedCount == 10;
+    }];
+
+    XCTAssertEqual(visitedCount, 10lu, @"-enumerateObjectsOverlappingStart:end:usingBlock: did not stop.");
+}
+
+@end
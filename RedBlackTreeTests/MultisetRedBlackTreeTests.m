@@ -0,0 +1,175 @@
+//
+//  MultisetRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "MultisetRedBlackTreeTests.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGMultisetRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+@interface MultisetRedBlackTreeTests ()
+- (void)verifyAddAndRemoveWithIndexedBuckets:(BOOL)indexesBuckets;
+@end
+
+
+// Entries are [key, serial number] pairs. Entries with the same key are equal according to the comparator, but only
+// entries with the same key and serial number are equal according to -isEqual:.
+static NSComparator PGEntryComparator = ^NSComparisonResult(NSArray *entry1, NSArray *entry2) {
+    return [entry1[0] compare:entry2[0]];
+};
+
+
+@implementation MultisetRedBlackTreeTests
+
+- (void)testInit
+{
+    PGMultisetRedBlackTree *tree = [[PGMultisetRedBlackTree alloc] init];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    XCTAssertEqual([tree keyCount], 0lu, @"tree's initial key count is not 0");
+    XCTAssertNil([tree firstObject], @"empty tree has a first object.");
+    XCTAssertTrue([tree fulfillsProperties], @"empty tree does not fulfill red-black properties.");
+    [tree release];
+
+    XCTAssertNil([PGMultisetRedBlackTree treeWithComparator:nil], @"+treeWithComparator: does not return nil when comparator is nil.");
+    XCTAssertThrowsSpecificNamed([[PGMultisetRedBlackTree tree] addObject:nil], NSException, NSInvalidArgumentException,
+                                 @"-addObject: does not throw an NSInvalidArgumentException when object is nil.");
+}
+
+
+- (void)testAddAndRemoveWithManyDuplicates
+{
+    [self verifyAddAndRemoveWithIndexedBuckets:NO];
+}
+
+
+- (void)testAddAndRemoveWithIndexedBuckets
+{
+    [self verifyAddAndRemoveWithIndexedBuckets:YES];
+}
+
+
+- (void)verifyAddAndRemoveWithIndexedBuckets:(BOOL)indexesBuckets
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Use very few keys so that buckets get large, and repeat some serial numbers so that buckets contain objects that
+    // are equal according to -isEqual:
+    PGMultisetRedBlackTree *tree = [[PGMultisetRedBlackTree alloc] initWithComparator:PGEntryComparator indexesBuckets:indexesBuckets];
+    NSMutableArray *expectedEntries = [[NSMutableArray alloc] initWithCapacity:PGLargeTreeSize];
+    NSUInteger keyRange = PGLargeTreeSize / 100;
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSArray *entry = @[ @(random() % keyRange), @(random() % (PGLargeTreeSize / 2)) ];
+        [tree addObject:entry];
+        [expectedEntries addObject:entry];
+    }
+
+    [expectedEntries sortWithOptions:NSSortStable usingComparator:PGEntryComparator];
+    XCTAssertEqual([tree count], PGLargeTreeSize, @"tree's count was not correctly set after adding objects.");
+    XCTAssertTrue([tree keyCount] <= keyRange, @"tree has more keys than were added.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects.");
+    XCTAssertEqualObjects([tree allObjects], expectedEntries, @"objects are not in sorted, stable order after adding objects.");
+
+    NSUInteger index = 0;
+    for (id entry in tree) {
+        XCTAssertEqualObjects(entry, expectedEntries[index], @"fast enumeration does not visit objects in sorted, stable order.");
+        ++index;
+    }
+
+    XCTAssertEqual(index, PGLargeTreeSize, @"fast enumeration did not visit every object.");
+
+    // Remove entries in random order. Each removal takes out the first entry that is equal to the one being removed.
+    while ([expectedEntries count] > 0) {
+        NSArray *entry = expectedEntries[random() % [expectedEntries count]];
+        XCTAssertEqualObjects([tree member:entry], entry, @"-member: did not return an entry that was added.");
+
+        [tree removeObject:entry];
+        [expectedEntries removeObjectAtIndex:[expectedEntries indexOfObject:entry]];
+        XCTAssertEqual([tree count], [expectedEntries count], @"tree's count was not correctly set after removing an object.");
+
+        if ([expectedEntries count] % 97 == 0) {
+            XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing objects.");
+            XCTAssertEqualObjects([tree allObjects], expectedEntries, @"objects are incorrect after removing objects.");
+
+            // Removed objects leave tombstones in their buckets, which enumeration has to skip
+            index = 0;
+            for (id remainingEntry in tree) {
+                XCTAssertEqualObjects(remainingEntry, expectedEntries[index], @"fast enumeration is incorrect after removing objects.");
+                ++index;
+            }
+
+            XCTAssertEqual(index, [expectedEntries count], @"fast enumeration did not visit every object after removing objects.");
+            XCTAssertEqualObjects([tree firstObject], [expectedEntries firstObject], @"first object is incorrect after removing objects.");
+            XCTAssertEqualObjects([tree lastObject], [expectedEntries lastObject], @"last object is incorrect after removing objects.");
+        }
+    }
+
+    XCTAssertEqual([tree keyCount], 0lu, @"tree has keys after removing every object.");
+    XCTAssertNil([tree member:@[ @0, @0 ]], @"empty tree has a member.");
+    [expectedEntries release];
+    [tree release];
+}
+
+
+- (void)testObjectsEqualToObject
+{
+    PGMultisetRedBlackTree *tree = [[PGMultisetRedBlackTree alloc] initWithComparator:PGEntryComparator indexesBuckets:YES];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        [tree addObject:@[ @(i % 10), @(i) ]];
+    }
+
+    XCTAssertEqual([tree keyCount], 10lu, @"tree's key count is incorrect.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@[ @3 ]], 10lu, @"-countOfObjectsEqualToObject: returned the wrong count.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@[ @10 ]], 0lu, @"-countOfObjectsEqualToObject: counted a missing key.");
+
+    NSMutableArray *expectedEntries = [NSMutableArray array];
+    for (NSUInteger i = 3; i < 100; i += 10) {
+        [expectedEntries addObject:@[ @3, @(i) ]];
+    }
+
+    XCTAssertEqualObjects([tree objectsEqualToObject:@[ @3 ]], expectedEntries, @"-objectsEqualToObject: returned the wrong objects.");
+
+    __block NSUInteger visitedCount = 0;
+    [tree enumerateObjectsEqualToObject:@[ @3 ] usingBlock:^(id obj, BOOL *stop) {
+        XCTAssertEqualObjects(obj, expectedEntries[visitedCount], @"-enumerateObjectsEqualToObject:usingBlock: visited the wrong object.");
+        *stop = ++visitedCount == 5;
+    }];
+
+    XCTAssertEqual(visitedCount, 5lu, @"-enumerateObjectsEqualToObject:usingBlock: did not stop.");
+
+    [tree removeObjectsEqualToObject:@[ @3 ]];
+    XCTAssertEqual([tree count], 90lu, @"-removeObjectsEqualToObject: did not remove the whole bucket.");
+    XCTAssertEqual([tree keyCount], 9lu, @"-removeObjectsEqualToObject: did not remove the key.");
+    XCTAssertFalse([tree containsObject:@[ @3, @3 ]], @"tree contains an object that was removed with its bucket.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing a bucket.");
+    [tree release];
+}
+
+@end
@@ -30,11 +30,32 @@
 @interface RedBlackTreeTests : XCTestCase
 
 - (void)testInit;
+- (void)testInitWithCapacity;
+- (void)testInitWithSortedArray;
 
 - (void)testAdd;
 - (void)testAddWithManyObjects;
 
 - (void)testRemove;
 - (void)testRemoveWithManyObjects;
+- (void)testRemoveAndReaddWithManyObjects;
+- (void)testRemoveObjectsInRange;
+- (void)testBatchAddAndRemove;
+- (void)testStatistics;
+- (void)testArchiving;
+- (void)testObjectIndex;
+- (void)testPop;
+- (void)testMaximumCount;
+- (void)testAddWithHint;
+- (void)testAddComparisonCount;
+
+- (void)testOrderStatistics;
+
+- (void)testEnumerateObjectsInRange;
+- (void)testFastEnumeration;
+- (void)testCursor;
+
+- (void)testSetOperations;
+- (void)testSplitAndJoin;
 
 @end
@@ -25,7 +25,9 @@
 //
 
 #import "RedBlackTreeTests.h"
+#import "PGRedBlackTreeCursor.h"
 #import "PGRedBlackTreeNode.h"
+#import "PGUtilities.h"
 
 static const NSUInteger PGLargeTreeSize = 10000;
 
@@ -88,6 +90,71 @@ static const NSUInteger PGLargeTreeSize = 10000;
 }
 
 
+- (void)testInitWithCapacity
+{
+    NSArray *array = @[ @"B", @"a", @"2", @"1", @"10"];
+    NSArray *sortedArray = [array sortedArrayUsingSelector:@selector(compare:)];
+
+    PGRedBlackTree *tree = [[PGRedBlackTree alloc] initWithCapacity:2];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    [tree addObjectsFromArray:array];
+    XCTAssertEqualObjects([tree allObjects], sortedArray, @"-initWithCapacity: is not using compare: as its selector.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects.");
+    [tree release];
+
+    XCTAssertNil([[PGRedBlackTree alloc] initWithComparator:NULL capacity:10], @"-initWithComparator:capacity: does not return nil when comparator is NULL.");
+
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) { return [object2 compare:object1]; };
+    tree = [[PGRedBlackTree alloc] initWithComparator:comparator capacity:[array count]];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    [tree addObjectsFromArray:array];
+    XCTAssertEqualObjects([tree allObjects], [array sortedArrayUsingComparator:comparator], @"-initWithComparator:capacity: is not using the correct comparator.");
+    [tree release];
+}
+
+
+- (void)testInitWithSortedArray
+{
+    __block NSUInteger comparisonCount = 0;
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) {
+        ++comparisonCount;
+        return [object1 compare:object2];
+    };
+
+    // Build trees of every size up to a few complete levels to exercise the coloring of partially filled levels
+    NSMutableArray *sortedArray = [NSMutableArray array];
+    for (NSUInteger count = 0; count < 130; ++count) {
+        comparisonCount = 0;
+        PGRedBlackTree *tree = [[PGRedBlackTree alloc] initWithSortedArray:sortedArray comparator:comparator];
+        XCTAssertEqual(comparisonCount, 0lu, @"-initWithSortedArray:comparator: invoked the comparator.");
+        XCTAssertEqual([tree count], count, @"tree's count is not correct after initializing with a sorted array.");
+        XCTAssertEqualObjects([tree allObjects], sortedArray, @"tree's objects are incorrect after initializing with a sorted array.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after initializing with a sorted array.");
+
+        for (NSNumber *number in sortedArray) {
+            XCTAssertTrue([tree containsObject:number], @"tree does not contain an object from its sorted array.");
+        }
+
+        [tree addObject:@(count / 2)];
+        [tree removeObject:@(count / 2)];
+        XCTAssertEqualObjects([tree allObjects], sortedArray, @"tree's objects are incorrect after adding and removing an object.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding and removing an object.");
+        [tree release];
+
+        [sortedArray addObject:@(count)];
+    }
+
+    NSArray *array = @[ @"B", @"a", @"2", @"1", @"10", @"a"];
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithArray:array];
+    XCTAssertEqualObjects([tree allObjects], [array sortedArrayUsingSelector:@selector(compare:)], @"+treeWithArray: is not using compare: as its selector.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after +treeWithArray:.");
+
+    tree = [PGRedBlackTree treeWithSortedArray:@[] comparator:comparator];
+    XCTAssertEqual([tree count], 0lu, @"tree's count is not correct after initializing with an empty array.");
+    XCTAssertNil([PGRedBlackTree treeWithSortedArray:array comparator:NULL], @"+treeWithSortedArray:comparator: does not return nil when comparator is NULL.");
+}
+
+
 - (void)testAdd
 {
     // Basic additions and handling duplicates, etc.
@@ -278,5 +345,928 @@ static const NSUInteger PGLargeTreeSize = 10000;
     }
 }
 
-@end
 
+
+- (void)testRemoveAndReaddWithManyObjects
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *tree = [[PGRedBlackTree alloc] initWithCapacity:PGLargeTreeSize / 2];
+    NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [objects addObject:@(random() % PGLargeTreeSize)];
+    }
+
+    [tree addObjectsFromArray:objects];
+
+    // Remove and re-add a random half of the objects so that freed nodes get recycled
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        NSNumber *number = objects[random() % [objects count]];
+        [tree removeObject:number];
+        [tree addObject:@([number integerValue])];
+    }
+
+    XCTAssertEqual([tree count], [objects count], @"tree's count is not correct after removing and re-adding objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing and re-adding objects.");
+
+    @autoreleasepool {
+        XCTAssertEqualObjects([tree allObjects], [objects sortedArrayUsingSelector:@selector(compare:)], @"tree's objects are incorrect after removing and re-adding objects.");
+    }
+
+    [tree removeAllObjects];
+    XCTAssertEqual([tree count], 0lu, @"tree's count is not 0 after removing all objects.");
+    [tree addObjectsFromArray:objects];
+    XCTAssertEqual([tree count], [objects count], @"tree's count is not correct after re-adding all objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after re-adding all objects.");
+
+    [objects release];
+    [tree release];
+}
+
+
+
+- (void)testOrderStatistics
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    XCTAssertThrowsSpecificNamed([tree objectAtIndex:0], NSException, NSRangeException, @"-objectAtIndex: does not throw on an empty tree.");
+    XCTAssertEqual([tree indexOfObject:@1], (NSUInteger)NSNotFound, @"-indexOfObject: found an object in an empty tree.");
+    XCTAssertEqual([tree countOfObjectsLessThanObject:@1], 0lu, @"-countOfObjectsLessThanObject: is not 0 for an empty tree.");
+    XCTAssertEqualObjects([tree objectsInRange:NSMakeRange(0, 0)], @[], @"-objectsInRange: is not empty for an empty tree.");
+
+    // Use a small range of values so that there are lots of duplicates
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % (PGLargeTreeSize / 10));
+        [numbers addObject:number];
+        [tree addObject:number];
+    }
+
+    // Remove some so that the counts have to be maintained through removal too
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 4; ++i) {
+        NSUInteger index = random() % [numbers count];
+        [tree removeObject:numbers[index]];
+        [numbers removeObjectAtIndex:index];
+    }
+
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding and removing objects.");
+    [numbers sortUsingSelector:@selector(compare:)];
+
+    NSUInteger count = [numbers count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        XCTAssertEqualObjects([tree objectAtIndex:i], numbers[i], @"-objectAtIndex: returned the wrong object.");
+    }
+
+    XCTAssertThrowsSpecificNamed([tree objectAtIndex:count], NSException, NSRangeException, @"-objectAtIndex: does not throw for an out-of-bounds index.");
+
+    for (NSUInteger i = 0; i < 100; ++i) {
+        NSNumber *number = numbers[random() % count];
+        NSUInteger index = [tree indexOfObject:number];
+        XCTAssertEqualObjects([tree objectAtIndex:index], number, @"-indexOfObject: returned the wrong index.");
+
+        NSUInteger lessThanCount = [numbers indexOfObject:number];
+        NSUInteger equalCount = [[numbers indexesOfObjectsPassingTest:^BOOL(id obj, NSUInteger idx, BOOL *stop) {
+            return [obj isEqual:number];
+        }] count];
+
+        XCTAssertEqual([tree countOfObjectsLessThanObject:number], lessThanCount, @"-countOfObjectsLessThanObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsLessThanOrEqualToObject:number], lessThanCount + equalCount, @"-countOfObjectsLessThanOrEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsEqualToObject:number], equalCount, @"-countOfObjectsEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsGreaterThanOrEqualToObject:number], count - lessThanCount, @"-countOfObjectsGreaterThanOrEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsGreaterThanObject:number], count - lessThanCount - equalCount, @"-countOfObjectsGreaterThanObject: is incorrect.");
+
+        NSRange range = NSMakeRange(random() % count, 0);
+        range.length = random() % (count - range.location + 1);
+        XCTAssertEqualObjects([tree objectsInRange:range], [numbers subarrayWithRange:range], @"-objectsInRange: returned the wrong objects.");
+    }
+
+    XCTAssertEqual([tree indexOfObject:@(PGLargeTreeSize)], (NSUInteger)NSNotFound, @"-indexOfObject: found an object not in the tree.");
+    XCTAssertThrowsSpecificNamed([tree objectsInRange:NSMakeRange(count, 1)], NSException, NSRangeException, @"-objectsInRange: does not throw for an out-of-bounds range.");
+}
+
+
+
+- (void)testEnumerateObjectsInRange
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@(random() % (PGLargeTreeSize / 10))];
+    }
+
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    for (NSNumber *number in numbers) {
+        [tree addObject:number];
+    }
+
+    [numbers sortUsingSelector:@selector(compare:)];
+
+    for (NSUInteger i = 0; i < 100; ++i) {
+        NSNumber *from = (i % 10 == 0) ? nil : @(random() % (PGLargeTreeSize / 10));
+        NSNumber *to = (i % 10 == 1) ? nil : @(random() % (PGLargeTreeSize / 10));
+        BOOL fromInclusive = random() % 2;
+        BOOL toInclusive = random() % 2;
+
+        NSMutableArray *expectedObjects = [NSMutableArray array];
+        for (NSNumber *number in numbers) {
+            if (from && ([number compare:from] < NSOrderedSame || (!fromInclusive && [number isEqual:from]))) continue;
+            if (to && ([number compare:to] > NSOrderedSame || (!toInclusive && [number isEqual:to]))) continue;
+            [expectedObjects addObject:number];
+        }
+
+        NSMutableArray *objects = [NSMutableArray array];
+        [tree enumerateObjectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive options:0 usingBlock:^(id obj, BOOL *stop) {
+            [objects addObject:obj];
+        }];
+
+        XCTAssertEqualObjects(objects, expectedObjects, @"range enumeration visited the wrong objects.");
+
+        [objects removeAllObjects];
+        [tree enumerateObjectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive options:NSEnumerationReverse usingBlock:^(id obj, BOOL *stop) {
+            [objects addObject:obj];
+        }];
+
+        XCTAssertEqualObjects(objects, [[expectedObjects reverseObjectEnumerator] allObjects], @"reverse range enumeration visited the wrong objects.");
+
+        // Stop after a few objects
+        [objects removeAllObjects];
+        [tree enumerateObjectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive options:NSEnumerationReverse usingBlock:^(id obj, BOOL *stop) {
+            [objects addObject:obj];
+            *stop = [objects count] == 3;
+        }];
+
+        NSUInteger expectedCount = MIN([expectedObjects count], 3lu);
+        NSArray *lastObjects = [[expectedObjects subarrayWithRange:NSMakeRange([expectedObjects count] - expectedCount, expectedCount)] reverseObjectEnumerator].allObjects;
+        XCTAssertEqualObjects(objects, lastObjects, @"reverse range enumeration did not stop correctly.");
+
+        if (!from) continue;
+        NSPredicate *predicate = [NSPredicate predicateWithFormat:@"SELF < %@", from];
+        XCTAssertEqualObjects([tree objectsLessThanObject:from], [numbers filteredArrayUsingPredicate:predicate], @"-objectsLessThanObject: returned the wrong objects.");
+        predicate = [NSPredicate predicateWithFormat:@"SELF <= %@", from];
+        XCTAssertEqualObjects([tree objectsLessThanOrEqualToObject:from], [numbers filteredArrayUsingPredicate:predicate], @"-objectsLessThanOrEqualToObject: returned the wrong objects.");
+        predicate = [NSPredicate predicateWithFormat:@"SELF == %@", from];
+        XCTAssertEqualObjects([tree objectsEqualToObject:from], [numbers filteredArrayUsingPredicate:predicate], @"-objectsEqualToObject: returned the wrong objects.");
+        predicate = [NSPredicate predicateWithFormat:@"SELF >= %@", from];
+        XCTAssertEqualObjects([tree objectsGreaterThanOrEqualToObject:from], [numbers filteredArrayUsingPredicate:predicate], @"-objectsGreaterThanOrEqualToObject: returned the wrong objects.");
+        predicate = [NSPredicate predicateWithFormat:@"SELF > %@", from];
+        XCTAssertEqualObjects([tree objectsGreaterThanObject:from], [numbers filteredArrayUsingPredicate:predicate], @"-objectsGreaterThanObject: returned the wrong objects.");
+    }
+}
+
+
+
+- (void)testFastEnumeration
+{
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    for (id object in tree) {
+        XCTFail(@"fast enumeration of an empty tree produced an object.");
+    }
+
+    // Use more objects than fit in a single batch
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@((i * 7919) % PGLargeTreeSize)];
+    }
+
+    [tree addObjectsFromArray:numbers];
+    [numbers sortUsingSelector:@selector(compare:)];
+
+    NSMutableArray *enumeratedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (id object in tree) {
+        [enumeratedObjects addObject:object];
+    }
+
+    XCTAssertEqualObjects(enumeratedObjects, numbers, @"fast enumeration did not visit objects in the correct order.");
+
+    BOOL detectedMutation = NO;
+    @try {
+        for (id object in tree) {
+            [tree removeObject:object];
+        }
+    } @catch (NSException *exception) {
+        detectedMutation = YES;
+    }
+
+    XCTAssertTrue(detectedMutation, @"fast enumeration did not detect mutation.");
+
+    [tree removeAllObjects];
+    [tree addObjectsFromArray:numbers];
+
+    id *objects = calloc(PGLargeTreeSize, sizeof(id));
+    [tree getObjects:objects range:NSMakeRange(0, PGLargeTreeSize)];
+    XCTAssertEqualObjects([NSArray arrayWithObjects:objects count:PGLargeTreeSize], numbers, @"-getObjects:range: returned the wrong objects.");
+
+    NSRange range = NSMakeRange(PGLargeTreeSize / 3, PGLargeTreeSize / 2);
+    [tree getObjects:objects range:range];
+    XCTAssertEqualObjects([NSArray arrayWithObjects:objects count:range.length], [numbers subarrayWithRange:range], @"-getObjects:range: returned the wrong objects.");
+    XCTAssertThrowsSpecificNamed([tree getObjects:objects range:NSMakeRange(PGLargeTreeSize, 1)], NSException, NSRangeException, @"-getObjects:range: does not throw for an out-of-bounds range.");
+    free(objects);
+}
+
+
+- (void)testCursor
+{
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    PGRedBlackTreeCursor *cursor = [tree cursor];
+    XCTAssertNil([cursor object], @"cursor for an empty tree has an object.");
+    XCTAssertNil([cursor nextObject], @"cursor for an empty tree has a next object.");
+    XCTAssertNil([cursor seekToLastObject], @"cursor for an empty tree has a last object.");
+
+    NSArray *objects = @[ @1, @3, @3, @5, @7, @9 ];
+    [tree addObjectsFromArray:objects];
+    XCTAssertThrowsSpecificNamed([cursor object], NSException, NSGenericException, @"cursor did not detect mutation.");
+    XCTAssertThrowsSpecificNamed([cursor nextObject], NSException, NSGenericException, @"cursor did not detect mutation.");
+
+    XCTAssertEqualObjects([cursor seekToFirstObject], @1, @"cursor did not seek to the first object.");
+    NSMutableArray *cursorObjects = [NSMutableArray arrayWithObject:[cursor object]];
+    for (id object = [cursor nextObject]; object; object = [cursor nextObject]) {
+        [cursorObjects addObject:object];
+    }
+
+    XCTAssertEqualObjects(cursorObjects, objects, @"cursor did not visit objects in the correct order.");
+    XCTAssertNil([cursor object], @"cursor has an object after moving past the end of the tree.");
+    XCTAssertNil([cursor previousObject], @"cursor has a previous object after moving past the end of the tree.");
+
+    XCTAssertEqualObjects([cursor seekToLastObject], @9, @"cursor did not seek to the last object.");
+    [cursorObjects removeAllObjects];
+    [cursorObjects addObject:[cursor object]];
+    for (id object = [cursor previousObject]; object; object = [cursor previousObject]) {
+        [cursorObjects addObject:object];
+    }
+
+    XCTAssertEqualObjects(cursorObjects, [[objects reverseObjectEnumerator] allObjects], @"cursor did not visit objects in the correct order.");
+
+    XCTAssertEqualObjects([cursor seekToObjectGreaterThanOrEqualToObject:@3], @3, @"cursor did not seek to the correct object.");
+    XCTAssertEqualObjects([cursor previousObject], @1, @"cursor did not move to the correct previous object.");
+    XCTAssertEqualObjects([cursor seekToObjectGreaterThanOrEqualToObject:@4], @5, @"cursor did not seek to the correct object.");
+    XCTAssertNil([cursor seekToObjectGreaterThanOrEqualToObject:@10], @"cursor found an object greater than the last object.");
+    XCTAssertEqualObjects([cursor seekToObjectLessThanOrEqualToObject:@4], @3, @"cursor did not seek to the correct object.");
+    XCTAssertEqualObjects([cursor nextObject], @5, @"cursor did not move to the correct next object.");
+    XCTAssertNil([cursor seekToObjectLessThanOrEqualToObject:@0], @"cursor found an object less than the first object.");
+    XCTAssertEqual([cursor tree], tree, @"cursor's tree is incorrect.");
+}
+
+
+- (void)testSetOperations
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Try a few size combinations, including ones large enough to be processed concurrently. Numbers are drawn from a
+    // range small enough that both trees have plenty of duplicates and plenty of objects in common.
+    NSUInteger sizes[][2] = { { 0, 10 }, { 10, 0 }, { 1, PGLargeTreeSize }, { PGLargeTreeSize, 50 }, { PGLargeTreeSize, PGLargeTreeSize } };
+    for (NSUInteger i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        NSMutableArray *objects = [NSMutableArray arrayWithCapacity:sizes[i][0]];
+        for (NSUInteger j = 0; j < sizes[i][0]; ++j) {
+            [objects addObject:@(random() % PGLargeTreeSize)];
+        }
+
+        NSMutableArray *otherObjects = [NSMutableArray arrayWithCapacity:sizes[i][1]];
+        for (NSUInteger j = 0; j < sizes[i][1]; ++j) {
+            [otherObjects addObject:@(random() % PGLargeTreeSize)];
+        }
+
+        NSSet *objectSet = [NSSet setWithArray:objects];
+        NSSet *otherObjectSet = [NSSet setWithArray:otherObjects];
+
+        NSMutableArray *expectedUnion = [NSMutableArray arrayWithArray:objects];
+        NSMutableArray *expectedIntersection = [NSMutableArray array];
+        NSMutableArray *expectedDifference = [NSMutableArray array];
+        for (id object in otherObjects) {
+            if (![objectSet containsObject:object]) [expectedUnion addObject:object];
+        }
+
+        for (id object in objects) {
+            [([otherObjectSet containsObject:object] ? expectedIntersection : expectedDifference) addObject:object];
+        }
+
+        [expectedUnion sortUsingSelector:@selector(compare:)];
+        [expectedIntersection sortUsingSelector:@selector(compare:)];
+        [expectedDifference sortUsingSelector:@selector(compare:)];
+
+        PGRedBlackTree *tree = [PGRedBlackTree treeWithArray:objects];
+        PGRedBlackTree *otherTree = [PGRedBlackTree treeWithArray:otherObjects];
+
+        PGRedBlackTree *result = [tree treeByUnioningWithTree:otherTree];
+        XCTAssertEqualObjects([result allObjects], expectedUnion, @"union is incorrect.");
+        XCTAssertEqual([result count], [expectedUnion count], @"union's count is incorrect.");
+        XCTAssertTrue([result fulfillsProperties], @"union does not fulfill red-black properties.");
+
+        result = [tree treeByIntersectingWithTree:otherTree];
+        XCTAssertEqualObjects([result allObjects], expectedIntersection, @"intersection is incorrect.");
+        XCTAssertEqual([result count], [expectedIntersection count], @"intersection's count is incorrect.");
+        XCTAssertTrue([result fulfillsProperties], @"intersection does not fulfill red-black properties.");
+
+        result = [tree treeBySubtractingTree:otherTree];
+        XCTAssertEqualObjects([result allObjects], expectedDifference, @"difference is incorrect.");
+        XCTAssertEqual([result count], [expectedDifference count], @"difference's count is incorrect.");
+        XCTAssertTrue([result fulfillsProperties], @"difference does not fulfill red-black properties.");
+
+        // The receiver and other tree should be unchanged by the non-mutating variants
+        XCTAssertEqualObjects([tree allObjects], [objects sortedArrayUsingSelector:@selector(compare:)], @"receiver was modified.");
+        XCTAssertEqualObjects([otherTree allObjects], [otherObjects sortedArrayUsingSelector:@selector(compare:)], @"other tree was modified.");
+
+        // The mutating variants should produce the same results and leave the tree usable
+        [tree minusTree:otherTree];
+        XCTAssertEqualObjects([tree allObjects], expectedDifference, @"-minusTree: is incorrect.");
+        [tree unionWithTree:otherTree];
+        XCTAssertTrue([tree fulfillsProperties], @"-unionWithTree: does not fulfill red-black properties.");
+        [tree intersectWithTree:otherTree];
+        XCTAssertEqualObjects([NSSet setWithArray:[tree allObjects]], otherObjectSet, @"-intersectWithTree: is incorrect.");
+        XCTAssertTrue([tree fulfillsProperties], @"-intersectWithTree: does not fulfill red-black properties.");
+
+        [tree addObject:@(PGLargeTreeSize)];
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after set operations and insertion.");
+    }
+
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithArray:@[ @1, @2, @3 ]];
+    [tree intersectWithTree:nil];
+    XCTAssertEqual([tree count], 0lu, @"intersecting with nil did not remove all objects.");
+}
+
+
+- (void)testSplitAndJoin
+{
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@(i / 2)];
+    }
+
+    // Split in the middle of a run of equal objects. Equal objects should all end up in the second tree.
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithArray:numbers];
+    PGRedBlackTree *greaterTree = [tree splitAtObject:@(PGLargeTreeSize / 4)];
+    XCTAssertEqualObjects([tree allObjects], [numbers subarrayWithRange:NSMakeRange(0, PGLargeTreeSize / 2)], @"split tree has wrong objects.");
+    XCTAssertEqualObjects([greaterTree allObjects], [numbers subarrayWithRange:NSMakeRange(PGLargeTreeSize / 2, PGLargeTreeSize / 2)],
+                          @"new tree has wrong objects.");
+    XCTAssertEqual([tree count], PGLargeTreeSize / 2, @"split tree's count is incorrect.");
+    XCTAssertEqual([greaterTree count], PGLargeTreeSize / 2, @"new tree's count is incorrect.");
+    XCTAssertTrue([tree fulfillsProperties], @"split tree does not fulfill red-black properties.");
+    XCTAssertTrue([greaterTree fulfillsProperties], @"new tree does not fulfill red-black properties.");
+
+    // Both trees should be independently mutable
+    [tree addObject:@(-1)];
+    [greaterTree removeObject:@(PGLargeTreeSize / 4)];
+    XCTAssertTrue([tree fulfillsProperties], @"split tree does not fulfill red-black properties after mutation.");
+    XCTAssertTrue([greaterTree fulfillsProperties], @"new tree does not fulfill red-black properties after mutation.");
+
+    // Joining the trees back together should restore the original objects
+    XCTAssertThrowsSpecificNamed([greaterTree joinWithTree:tree], NSException, NSInvalidArgumentException,
+                                 @"joining trees out of order does not throw.");
+    [tree removeObject:@(-1)];
+    [greaterTree addObject:@(PGLargeTreeSize / 4)];
+    [tree joinWithTree:greaterTree];
+    XCTAssertEqualObjects([tree allObjects], numbers, @"joined tree has wrong objects.");
+    XCTAssertEqual([tree count], PGLargeTreeSize, @"joined tree's count is incorrect.");
+    XCTAssertEqual([greaterTree count], 0lu, @"joined tree was not emptied.");
+    XCTAssertTrue([tree fulfillsProperties], @"joined tree does not fulfill red-black properties.");
+
+    // Splits that move everything or nothing
+    PGRedBlackTree *emptyTree = [tree splitAtObject:@(PGLargeTreeSize)];
+    XCTAssertEqual([emptyTree count], 0lu, @"splitting after the last object did not produce an empty tree.");
+    PGRedBlackTree *fullTree = [tree splitAtObject:@(-1)];
+    XCTAssertEqual([tree count], 0lu, @"splitting before the first object did not empty the tree.");
+    XCTAssertEqualObjects([fullTree allObjects], numbers, @"splitting before the first object did not move every object.");
+
+    // Joining trees that don't share storage
+    PGRedBlackTree *otherTree = [PGRedBlackTree treeWithArray:@[ @(PGLargeTreeSize), @(PGLargeTreeSize + 1) ]];
+    [fullTree joinWithTree:otherTree];
+    XCTAssertEqual([fullTree count], PGLargeTreeSize + 2, @"joined tree's count is incorrect.");
+    XCTAssertEqualObjects([fullTree lastObject], @(PGLargeTreeSize + 1), @"joined tree has wrong objects.");
+    XCTAssertEqual([otherTree count], 0lu, @"joined tree was not emptied.");
+    XCTAssertTrue([fullTree fulfillsProperties], @"joined tree does not fulfill red-black properties.");
+
+    // Repeatedly split off and discard small trees so that some trees outlive the others they share storage with
+    for (NSUInteger i = PGLargeTreeSize; i > 0; i -= 1000) {
+        @autoreleasepool {
+            [fullTree splitAtObject:@(i / 2)];
+            XCTAssertTrue([fullTree fulfillsProperties], @"tree does not fulfill red-black properties after repeated splits.");
+        }
+    }
+
+    XCTAssertThrowsSpecificNamed([fullTree splitAtObject:nil], NSException, NSInvalidArgumentException, @"splitting at nil does not throw.");
+}
+
+
+- (void)testRemoveObjectsInRange
+{
+    NSMutableArray *numbers = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [numbers addObject:@(i / 2)];
+    }
+
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithArray:numbers];
+    [tree removeObjectsLessThanObject:@100];
+    XCTAssertEqualObjects([tree firstObject], @100, @"-removeObjectsLessThanObject: removed the wrong objects.");
+    XCTAssertEqual([tree count], PGLargeTreeSize - 200, @"tree's count is incorrect after removing objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing objects.");
+
+    [tree removeObjectsInRangeFromObject:@1000 toObject:@2000];
+    XCTAssertEqual([tree count], PGLargeTreeSize - 2200, @"tree's count is incorrect after removing objects.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@999], 2lu, @"-removeObjectsInRangeFromObject:toObject: removed its lower bound's predecessor.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@1000], 0lu, @"-removeObjectsInRangeFromObject:toObject: did not remove its lower bound.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@1999], 0lu, @"-removeObjectsInRangeFromObject:toObject: did not remove objects in range.");
+    XCTAssertEqual([tree countOfObjectsEqualToObject:@2000], 2lu, @"-removeObjectsInRangeFromObject:toObject: removed its upper bound.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing objects.");
+
+    [tree removeObjectsInRangeFromObject:@3000 toObject:nil];
+    XCTAssertEqualObjects([tree lastObject], @2999, @"unbounded range removal removed the wrong objects.");
+    [tree removeObjectsInRangeFromObject:@500 toObject:@400];
+    XCTAssertEqual([tree count], PGLargeTreeSize - 2200 - (PGLargeTreeSize - 6000), @"empty range removed objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing objects.");
+
+    [tree removeObjectsInRangeFromObject:nil toObject:nil];
+    XCTAssertEqual([tree count], 0lu, @"removing an unbounded range did not remove all objects.");
+}
+
+
+
+- (void)testBatchAddAndRemove
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    NSMutableArray *expectedObjects = [NSMutableArray array];
+
+    // Batches smaller than the tree insert each object near the previous one, while larger ones are merged into it
+    NSUInteger batchCounts[] = { PGLargeTreeSize, 10, 100, 1000, PGLargeTreeSize * 2 };
+    for (NSUInteger batchIndex = 0; batchIndex < sizeof(batchCounts) / sizeof(batchCounts[0]); ++batchIndex) {
+        NSUInteger batchCount = batchCounts[batchIndex];
+        NSMutableArray *batch = [NSMutableArray arrayWithCapacity:batchCount];
+        for (NSUInteger i = 0; i < batchCount; ++i) {
+            [batch addObject:@(random() % PGLargeTreeSize)];
+        }
+
+        [tree addObjectsFromArray:batch sorted:NO];
+        [expectedObjects addObjectsFromArray:batch];
+        [expectedObjects sortUsingSelector:@selector(compare:)];
+        XCTAssertEqualObjects([tree allObjects], expectedObjects, @"-addObjectsFromArray:sorted: added the wrong objects.");
+        XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after batch add.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after batch add.");
+    }
+
+    [tree addObjectsFromArray:@[ @-2, @-1, @-1, @0 ] sorted:YES];
+    [expectedObjects addObjectsFromArray:@[ @-2, @-1, @-1, @0 ]];
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"-addObjectsFromArray:sorted: added the wrong objects.");
+
+    // Removal batches include duplicates and objects that aren't in the tree
+    for (NSUInteger batchCount = 10; batchCount <= PGLargeTreeSize; batchCount *= 10) {
+        NSMutableArray *batch = [NSMutableArray arrayWithCapacity:batchCount];
+        for (NSUInteger i = 0; i < batchCount; ++i) {
+            [batch addObject:@((NSInteger)(random() % (PGLargeTreeSize + 100)) - 50)];
+        }
+
+        [tree removeObjectsInArray:batch];
+        for (id object in batch) {
+            NSUInteger index = [expectedObjects indexOfObject:object];
+            if (index != NSNotFound) [expectedObjects removeObjectAtIndex:index];
+        }
+
+        XCTAssertEqualObjects([tree allObjects], expectedObjects, @"-removeObjectsInArray: removed the wrong objects.");
+        XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after batch remove.");
+        XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after batch remove.");
+    }
+
+    [tree removeObjectsInArray:[tree allObjects]];
+    XCTAssertEqual([tree count], 0lu, @"removing every object did not empty the tree.");
+
+    // Runs of objects that the comparator considers equal may interleave objects that aren't equal to one another, so
+    // each object has to skip the nodes claimed by earlier objects in its run
+    PGRedBlackTree *lengthTree = [[[PGRedBlackTree alloc] initWithComparator:^NSComparisonResult(NSString *string1, NSString *string2) {
+        return [@([string1 length]) compare:@([string2 length])];
+    }] autorelease];
+
+    NSMutableArray *strings = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [strings addObject:i % 3 == 0 ? @"a" : @"b"];
+    }
+
+    [lengthTree addObjectsFromArray:strings];
+    [lengthTree addObject:@"cc"];
+    [lengthTree removeObjectsInArray:[strings subarrayWithRange:NSMakeRange(0, PGLargeTreeSize - 3)]];
+    XCTAssertEqual([lengthTree count], 4lu, @"-removeObjectsInArray: did not remove one node per duplicate.");
+    XCTAssertEqual([lengthTree countOfObjectsEqualToObject:@"cc"], 1lu, @"-removeObjectsInArray: removed an object not in the batch.");
+    XCTAssertTrue([lengthTree fulfillsProperties], @"tree does not fulfill red-black properties after removing duplicates.");
+}
+
+
+- (void)testStatistics
+{
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    NSDictionary *statistics = [tree statistics];
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsHeightKey], @0, @"empty tree has non-zero height.");
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsDepthHistogramKey], @[ ], @"empty tree has non-empty depth histogram.");
+
+    // Adding objects in order forces plenty of rotations
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:@(i)];
+    }
+
+    statistics = [tree statistics];
+    NSUInteger height = [statistics[PGRedBlackTreeStatisticsHeightKey] unsignedIntegerValue];
+    XCTAssertTrue(height > 0 && height <= 2 * log2(PGLargeTreeSize + 1), @"tree's height is incorrect.");
+    XCTAssertTrue([statistics[PGRedBlackTreeStatisticsBlackHeightKey] unsignedIntegerValue] > 0, @"tree's black height is incorrect.");
+
+    NSArray *depthHistogram = statistics[PGRedBlackTreeStatisticsDepthHistogramKey];
+    XCTAssertEqual([depthHistogram count], height, @"depth histogram does not match the tree's height.");
+    XCTAssertEqualObjects([depthHistogram valueForKeyPath:@"@sum.self"], @(PGLargeTreeSize), @"depth histogram does not account for every node.");
+
+    // The test target defines PG_RED_BLACK_TREE_STATISTICS to 1 so that the counters are compiled in
+    XCTAssertNotNil(statistics[PGRedBlackTreeStatisticsComparisonCountKey], @"statistics counters were not compiled in.");
+
+    XCTAssertTrue([statistics[PGRedBlackTreeStatisticsComparisonCountKey] unsignedLongLongValue] > 0, @"comparisons were not counted.");
+    XCTAssertTrue([statistics[PGRedBlackTreeStatisticsRotationCountKey] unsignedLongLongValue] > 0, @"rotations were not counted.");
+    XCTAssertTrue([statistics[PGRedBlackTreeStatisticsInsertionFixupIterationCountKey] unsignedLongLongValue] >= PGLargeTreeSize, @"insertion fixup iterations were not counted.");
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsNodeAllocationCountKey], @(PGLargeTreeSize), @"node allocations were not counted.");
+
+    [tree resetStatistics];
+    statistics = [tree statistics];
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsComparisonCountKey], @0, @"-resetStatistics did not reset comparisons.");
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsRotationCountKey], @0, @"-resetStatistics did not reset rotations.");
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        [tree removeObject:@(i)];
+    }
+
+    statistics = [tree statistics];
+    XCTAssertTrue([statistics[PGRedBlackTreeStatisticsRemovalFixupIterationCountKey] unsignedLongLongValue] > 0, @"removal fixup iterations were not counted.");
+    XCTAssertEqualObjects(statistics[PGRedBlackTreeStatisticsNodeFreeCountKey], @(PGLargeTreeSize / 2), @"node frees were not counted.");
+}
+
+
+
+- (void)testArchiving
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"RedBlackTreeTests-%d.archive", getpid()]];
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    };
+
+    // Numbers of every archived kind, with duplicates
+    PGRedBlackTree *tree = [PGRedBlackTree treeWithComparator:comparator];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        switch (random() % 3) {
+            case 0:
+                [tree addObject:@((long long)(random() % 1000) - 500)];
+                break;
+            case 1:
+                [tree addObject:@((double)(random() % 1000) / 7.0)];
+                break;
+            default:
+                [tree addObject:@((unsigned long long)INT64_MAX + (unsigned long long)(random() % 1000))];
+                break;
+        }
+    }
+
+    NSError *error = nil;
+    XCTAssertTrue([tree writeToFile:path error:&error], @"-writeToFile:error: failed with error %@.", error);
+    PGRedBlackTree *loadedTree = [PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:&error];
+    XCTAssertNotNil(loadedTree, @"+treeWithContentsOfFile:comparator:error: failed with error %@.", error);
+    XCTAssertTrue([loadedTree fulfillsProperties], @"loaded tree does not fulfill red-black properties.");
+    XCTAssertEqualObjects([loadedTree allObjects], [tree allObjects], @"loaded tree's objects do not match the archived tree's.");
+
+    // Strings, including non-ASCII ones
+    tree = [PGRedBlackTree treeWithComparator:comparator];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:[NSString stringWithFormat:@"%ld é漢 %lu", random() % 1000, (unsigned long)i]];
+    }
+
+    [tree addObject:@""];
+    XCTAssertTrue([tree writeToFile:path error:&error], @"-writeToFile:error: failed with error %@.", error);
+    loadedTree = [PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:&error];
+    XCTAssertEqualObjects([loadedTree allObjects], [tree allObjects], @"loaded tree's strings do not match the archived tree's.");
+    XCTAssertNotNil([loadedTree member:[tree objectAtIndex:PGLargeTreeSize / 2]], @"loaded tree does not contain an archived string.");
+
+    // Data, ordered by length so that we don't need a comparator that NSData doesn't have
+    NSComparator lengthComparator = ^NSComparisonResult(id object1, id object2) {
+        return [@([object1 length]) compare:@([object2 length])];
+    };
+
+    tree = [PGRedBlackTree treeWithComparator:lengthComparator];
+    for (NSUInteger length = 0; length < 100; ++length) {
+        NSMutableData *data = [NSMutableData dataWithLength:length];
+        memset([data mutableBytes], (int)length, length);
+        [tree addObject:data];
+    }
+
+    XCTAssertTrue([tree writeToFile:path error:&error], @"-writeToFile:error: failed with error %@.", error);
+    loadedTree = [PGRedBlackTree treeWithContentsOfFile:path comparator:lengthComparator error:&error];
+    XCTAssertEqualObjects([loadedTree allObjects], [tree allObjects], @"loaded tree's data do not match the archived tree's.");
+
+    // Empty trees
+    tree = [PGRedBlackTree treeWithComparator:comparator];
+    XCTAssertTrue([tree writeToFile:path error:&error], @"-writeToFile:error: failed with error %@.", error);
+    loadedTree = [PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:&error];
+    XCTAssertNotNil(loadedTree, @"+treeWithContentsOfFile:comparator:error: failed to load an empty tree with error %@.", error);
+    XCTAssertEqual([loadedTree count], 0lu, @"loaded empty tree is not empty.");
+
+    // Failures
+    tree = [PGRedBlackTree treeWithComparator:lengthComparator];
+    [tree addObject:@[ @1 ]];
+    error = nil;
+    XCTAssertFalse([tree writeToFile:path error:&error], @"-writeToFile:error: archived an unsupported object.");
+    XCTAssertEqualObjects([error domain], PGErrorDomain, @"error for an unsupported object has the wrong domain.");
+    XCTAssertEqual([error code], (NSInteger)PGRedBlackTreeArchiveErrorUnsupportedObject, @"error for an unsupported object has the wrong code.");
+    XCTAssertNotNil([PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:NULL],
+                    @"failing to write an archive replaced the previous one.");
+
+    // Reading an archive with a comparator that orders its objects differently must fail rather than build a tree
+    // that is out of order
+    tree = [PGRedBlackTree treeWithComparator:comparator];
+    [tree addObjectsFromArray:@[ @1, @2, @3 ]];
+    XCTAssertTrue([tree writeToFile:path error:&error], @"-writeToFile:error: failed with error %@.", error);
+    error = nil;
+    NSComparator descendingComparator = ^NSComparisonResult(id object1, id object2) {
+        return [object2 compare:object1];
+    };
+
+    XCTAssertNil([PGRedBlackTree treeWithContentsOfFile:path comparator:descendingComparator error:&error],
+                 @"an archive was loaded with a comparator that disagrees with its order.");
+    XCTAssertEqual([error code], (NSInteger)PGRedBlackTreeArchiveErrorInvalidFile, @"error for an out-of-order archive has the wrong code.");
+
+    [[@"not an archive" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:path atomically:YES];
+    error = nil;
+    XCTAssertNil([PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:&error], @"an invalid archive was loaded.");
+    XCTAssertEqual([error code], (NSInteger)PGRedBlackTreeArchiveErrorInvalidFile, @"error for an invalid archive has the wrong code.");
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    XCTAssertNil([PGRedBlackTree treeWithContentsOfFile:path comparator:comparator error:&error], @"a missing archive was loaded.");
+    XCTAssertEqualObjects([error domain], NSPOSIXErrorDomain, @"error for a missing archive has the wrong domain.");
+}
+
+
+- (void)testObjectIndex
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    XCTAssertFalse([tree indexesObjects], @"tree indexes its objects by default.");
+    [tree setIndexesObjects:YES];
+    XCTAssertNil([tree member:@0], @"empty indexed tree has a member.");
+
+    // Values are drawn from a small range so that the tree has duplicates and removals often move objects between nodes
+    NSMutableArray *expectedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % (PGLargeTreeSize / 4));
+        [tree addObject:number];
+        [expectedObjects addObject:number];
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % (PGLargeTreeSize / 2));
+        XCTAssertEqual([tree containsObject:number], [expectedObjects containsObject:number], @"indexed tree's membership is incorrect.");
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        NSNumber *number = expectedObjects[random() % [expectedObjects count]];
+        XCTAssertEqualObjects([tree member:number], number, @"-member: did not find an object in an indexed tree.");
+        [tree removeObject:number];
+        [expectedObjects removeObjectAtIndex:[expectedObjects indexOfObject:number]];
+    }
+
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"indexed tree's objects are incorrect after removing objects.");
+    XCTAssertTrue([tree fulfillsProperties], @"indexed tree does not fulfill red-black properties after removing objects.");
+
+    // Mutations that don't update the index directly must not leave it stale
+    [tree removeObjectsLessThanObject:@(PGLargeTreeSize / 8)];
+    XCTAssertFalse([tree containsObject:@(PGLargeTreeSize / 8 - 1)], @"indexed tree contains an object removed in a range.");
+    [tree addObjectsFromArray:@[ @-3, @-2, @-1 ]];
+    XCTAssertTrue([tree containsObject:@-2], @"indexed tree does not contain an object added in a batch.");
+    XCTAssertEqual([tree indexOfObject:@-1], 2lu, @"-indexOfObject: returned the wrong index in an indexed tree.");
+
+    for (NSNumber *number in [tree allObjects]) {
+        XCTAssertEqualObjects([tree member:number], number, @"-member: did not find an object in an indexed tree.");
+    }
+
+    [tree removeAllObjects];
+    XCTAssertFalse([tree containsObject:@-2], @"indexed tree contains an object after removing all objects.");
+    [tree addObject:@42];
+    XCTAssertTrue([tree containsObject:@42], @"indexed tree does not contain an object added after removing all objects.");
+
+    [tree setIndexesObjects:NO];
+    XCTAssertTrue([tree containsObject:@42], @"tree does not contain an object after its index was turned off.");
+}
+
+
+- (void)testPop
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGRedBlackTree *tree = [PGRedBlackTree tree];
+    XCTAssertNil([tree popFirstObject], @"-popFirstObject returned an object from an empty tree.");
+    XCTAssertNil([tree popLastObject], @"-popLastObject returned an object from an empty tree.");
+
+    // Interleave every kind of mutation so that the first and last objects are checked after each of them
+    NSMutableArray *expectedObjects = [NSMutableArray array];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        long operation = random() % 8;
+        if (operation < 4 || [expectedObjects count] == 0) {
+            NSNumber *number = @(random() % PGLargeTreeSize);
+            [tree addObject:number];
+            [expectedObjects addObject:number];
+            [expectedObjects sortUsingSelector:@selector(compare:)];
+        } else if (operation == 4) {
+            XCTAssertEqualObjects([tree popFirstObject], expectedObjects[0], @"-popFirstObject returned the wrong object.");
+            [expectedObjects removeObjectAtIndex:0];
+        } else if (operation == 5) {
+            XCTAssertEqualObjects([tree popLastObject], [expectedObjects lastObject], @"-popLastObject returned the wrong object.");
+            [expectedObjects removeLastObject];
+        } else if (operation == 6) {
+            NSUInteger index = random() % [expectedObjects count];
+            [tree removeObject:expectedObjects[index]];
+            [expectedObjects removeObjectAtIndex:index];
+        } else {
+            NSNumber *number = @(random() % PGLargeTreeSize);
+            [tree removeObjectsLessThanObject:number];
+            [expectedObjects filterUsingPredicate:[NSPredicate predicateWithFormat:@"SELF >= %@", number]];
+        }
+
+        XCTAssertEqualObjects([tree firstObject], [expectedObjects firstObject], @"-firstObject is incorrect after a mutation.");
+        XCTAssertEqualObjects([tree lastObject], [expectedObjects lastObject], @"-lastObject is incorrect after a mutation.");
+        XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after a mutation.");
+    }
+
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after popping objects.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after popping objects.");
+}
+
+
+- (void)testMaximumCount
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    XCTAssertEqual([[PGRedBlackTree tree] maximumCount], (NSUInteger)NSUIntegerMax, @"tree has a maximum count by default.");
+    XCTAssertEqual([[PGRedBlackTree tree] eviction], PGRedBlackTreeEvictionNone, @"tree evicts objects by default.");
+
+    // Keep the 100 largest and smallest numbers from a stream
+    NSUInteger maximumCount = 100;
+    PGRedBlackTree *largestTree = [PGRedBlackTree treeWithMaximumCount:maximumCount evict:PGRedBlackTreeEvictionFirstObject];
+    PGRedBlackTree *smallestTree = [PGRedBlackTree treeWithMaximumCount:maximumCount evict:PGRedBlackTreeEvictionLastObject];
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        [largestTree addObject:number];
+        [smallestTree addObject:number];
+        [objects addObject:number];
+        XCTAssertEqual([largestTree count], MIN(i + 1, maximumCount), @"bounded tree's count is incorrect.");
+    }
+
+    [objects sortUsingSelector:@selector(compare:)];
+    NSArray *smallestObjects = [objects subarrayWithRange:NSMakeRange(0, maximumCount)];
+    NSArray *largestObjects = [objects subarrayWithRange:NSMakeRange(PGLargeTreeSize - maximumCount, maximumCount)];
+    XCTAssertEqualObjects([largestTree allObjects], largestObjects, @"tree did not keep the largest objects.");
+    XCTAssertEqualObjects([smallestTree allObjects], smallestObjects, @"tree did not keep the smallest objects.");
+    XCTAssertTrue([largestTree fulfillsProperties], @"bounded tree does not fulfill red-black properties.");
+
+    // Batches evict everything over the maximum at once
+    [largestTree addObjectsFromArray:@[ @(PGLargeTreeSize), @(PGLargeTreeSize + 1), @-1 ]];
+    XCTAssertEqual([largestTree count], maximumCount, @"batch add took bounded tree over its maximum count.");
+    XCTAssertEqualObjects([largestTree lastObject], @(PGLargeTreeSize + 1), @"batch add did not keep the largest object.");
+    XCTAssertFalse([largestTree containsObject:@-1], @"batch add kept an object smaller than every other.");
+
+    PGRedBlackTree *emptyTree = [PGRedBlackTree treeWithMaximumCount:0 evict:PGRedBlackTreeEvictionLastObject];
+    [emptyTree addObject:@1];
+    [emptyTree addObjectsFromArray:@[ @2, @3 ]];
+    XCTAssertEqual([emptyTree count], 0lu, @"tree with a maximum count of 0 kept objects.");
+}
+
+
+
+- (void)testAddWithHint
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    __block NSUInteger comparisonCount = 0;
+    PGRedBlackTree *tree = [[[PGRedBlackTree alloc] initWithComparator:^NSComparisonResult(id object1, id object2) {
+        ++comparisonCount;
+        return [object1 compare:object2];
+    }] autorelease];
+
+    // Appending to the end of the tree should take one comparison per object, even without a hint
+    for (NSUInteger i = 0; i < PGLargeTreeSize; i += 2) {
+        [tree addObject:@(i)];
+    }
+
+    XCTAssertTrue(comparisonCount <= PGLargeTreeSize / 2, @"appending objects took %lu comparisons.", (unsigned long)comparisonCount);
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after appending objects.");
+
+    // Filling in the gaps in order with a cursor should take at most two comparisons per object
+    comparisonCount = 0;
+    PGRedBlackTreeCursor *cursor = [tree cursor];
+    for (NSUInteger i = 1; i < PGLargeTreeSize; i += 2) {
+        [tree addObject:@(i) hint:cursor];
+        XCTAssertEqualObjects([cursor object], @(i), @"cursor was not positioned at the added object.");
+    }
+
+    XCTAssertTrue(comparisonCount <= PGLargeTreeSize, @"adding objects near a hint took %lu comparisons.", (unsigned long)comparisonCount);
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects with a hint.");
+
+    NSMutableArray *expectedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize * 2];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [expectedObjects addObject:@(i)];
+    }
+
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after adding objects with a hint.");
+
+    // Hints anywhere in the tree, including stale ones and ones from other trees, must still put objects in order
+    PGRedBlackTree *otherTree = [PGRedBlackTree tree];
+    [otherTree addObjectsFromArray:@[ @1, @2, @3 ]];
+    PGRedBlackTreeCursor *otherCursor = [otherTree cursor];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        long operation = random() % 4;
+        if (operation == 0) {
+            [cursor seekToObjectGreaterThanOrEqualToObject:@(random() % PGLargeTreeSize)];
+        } else if (operation == 1) {
+            [tree removeObject:expectedObjects[0]];
+            [expectedObjects removeObjectAtIndex:0];
+        }
+
+        [tree addObject:number hint:operation == 3 ? otherCursor : cursor];
+        [expectedObjects addObject:number];
+    }
+
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after adding objects with hints.");
+    XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after adding objects with hints.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding objects with hints.");
+    XCTAssertEqual([otherTree count], 3lu, @"adding an object with another tree's cursor changed that tree.");
+}
+
+
+- (void)testAddComparisonCount
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    __block NSUInteger comparisonCount = 0;
+    PGRedBlackTree *tree = [[[PGRedBlackTree alloc] initWithComparator:^NSComparisonResult(id object1, id object2) {
+        ++comparisonCount;
+        return [object1 compare:object2];
+    }] autorelease];
+
+    // Counting the objects less than or equal to an object descends from the root along the same path that inserting it
+    // without the append fast path would, so it tells us how many comparisons that insertion would have taken. Adding
+    // an object should take one comparison if it goes after the last object, and only one more than the descent if not.
+    NSUInteger appendCount = 0;
+    NSUInteger descentComparisonCount = 0;
+    NSUInteger additionComparisonCount = 0;
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        BOOL appends = [tree count] == 0 || [number compare:[tree lastObject]] != NSOrderedAscending;
+
+        comparisonCount = 0;
+        [tree countOfObjectsLessThanOrEqualToObject:number];
+        NSUInteger expectedComparisonCount = appends ? MIN(comparisonCount, 1lu) : comparisonCount + 1;
+        descentComparisonCount += comparisonCount;
+
+        comparisonCount = 0;
+        [tree addObject:number];
+        XCTAssertEqual(comparisonCount, expectedComparisonCount, @"adding %@ took the wrong number of comparisons.", number);
+        additionComparisonCount += comparisonCount;
+        if (appends) ++appendCount;
+    }
+
+    XCTAssertTrue(additionComparisonCount <= descentComparisonCount + PGLargeTreeSize - appendCount,
+                  @"adding random objects took %lu comparisons; searching from the root takes %lu.",
+                  (unsigned long)additionComparisonCount, (unsigned long)descentComparisonCount);
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding random objects.");
+}
+
+@end
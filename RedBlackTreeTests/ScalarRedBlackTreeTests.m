@@ -0,0 +1,235 @@
+//
+//  ScalarRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "ScalarRedBlackTreeTests.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+@interface PGScalarRedBlackTree (PropertyVerification)
+- (BOOL)fulfillsProperties;
+@end
+
+
+static NSComparisonResult PGReverseInt64Compare(PGScalarKey key1, PGScalarKey key2)
+{
+    if (key1.int64Value > key2.int64Value) return NSOrderedAscending;
+    return key1.int64Value < key2.int64Value ? NSOrderedDescending : NSOrderedSame;
+}
+
+
+@implementation ScalarRedBlackTreeTests
+
+- (void)testInit
+{
+    PGScalarRedBlackTree *tree = [[PGScalarRedBlackTree alloc] init];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    XCTAssertEqual([tree keyType], PGScalarKeyTypeInt64, @"-init does not use int64 keys.");
+    [tree release];
+
+    tree = [PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeDouble];
+    XCTAssertEqual([tree count], 0lu, @"tree's initial count is not 0");
+    XCTAssertEqual([tree keyType], PGScalarKeyTypeDouble, @"+treeWithKeyType: does not use the specified key type.");
+
+    XCTAssertNil([PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeCustom], @"+treeWithKeyType: does not return nil for custom keys.");
+    XCTAssertNil([PGScalarRedBlackTree treeWithKeyComparisonFunction:NULL], @"+treeWithKeyComparisonFunction: does not return nil when function is NULL.");
+    XCTAssertNil([[PGScalarRedBlackTree alloc] initWithKeyType:PGScalarKeyTypeInt64 comparisonFunction:PGReverseInt64Compare capacity:0],
+                 @"-initWithKeyType:comparisonFunction:capacity: does not return nil when a function is given for a built-in key type.");
+
+    tree = [PGScalarRedBlackTree treeWithKeyComparisonFunction:PGReverseInt64Compare];
+    XCTAssertEqual([tree keyType], PGScalarKeyTypeCustom, @"+treeWithKeyComparisonFunction: does not use custom keys.");
+}
+
+
+- (void)testAddAndRemoveWithManyKeys
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Use a small range of keys so that there are plenty of duplicates. Each entry's object records its key and the order
+    // in which it was added, which lets us check that equal keys stay in insertion order and that objects stay with their
+    // keys as nodes are spliced out.
+    PGScalarRedBlackTree *tree = [[PGScalarRedBlackTree alloc] init];
+    NSMutableArray *expectedEntries = [[NSMutableArray alloc] initWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        int64_t key = (int64_t)(random() % (PGLargeTreeSize / 4)) - (int64_t)(PGLargeTreeSize / 8);
+        NSArray *entry = @[ @(key), @(i) ];
+        [tree addKey:PGScalarKeyMakeInt64(key) object:entry];
+        [expectedEntries addObject:entry];
+    }
+
+    [expectedEntries sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSArray *entry1, NSArray *entry2) {
+        return [entry1[0] compare:entry2[0]];
+    }];
+
+    XCTAssertEqual([tree count], PGLargeTreeSize, @"tree's count was not correctly set after adding keys.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after adding keys.");
+
+    __block NSUInteger index = 0;
+    [tree enumerateKeysAndObjectsUsingBlock:^(PGScalarKey key, id object, BOOL *stop) {
+        XCTAssertEqualObjects(object, expectedEntries[index], @"entries are not in sorted, stable order.");
+        XCTAssertEqual(key.int64Value, [object[0] longLongValue], @"entry's object does not match its key.");
+        ++index;
+    }];
+
+    XCTAssertEqual(index, PGLargeTreeSize, @"enumeration did not visit every entry.");
+
+    // Remove keys in random order. Each removal takes out the first entry with the key.
+    while ([expectedEntries count] > 0) {
+        NSArray *entry = expectedEntries[random() % [expectedEntries count]];
+        PGScalarKey key = PGScalarKeyMakeInt64([entry[0] longLongValue]);
+        XCTAssertTrue([tree containsKey:key], @"tree does not contain a key that was added.");
+
+        NSUInteger firstIndex = [tree countOfKeysLessThanKey:key];
+        XCTAssertEqualObjects([tree objectForKey:key], expectedEntries[firstIndex], @"-objectForKey: did not return the first entry with the key.");
+        XCTAssertTrue([tree removeKey:key], @"-removeKey: did not remove a key that was added.");
+        [expectedEntries removeObjectAtIndex:firstIndex];
+
+        XCTAssertEqual([tree count], [expectedEntries count], @"tree's count was not correctly set after removing a key.");
+        if ([expectedEntries count] % 97 == 0) {
+            XCTAssertTrue([tree fulfillsProperties], @"tree does not fulfill red-black properties after removing keys.");
+            NSUInteger count = [expectedEntries count];
+            id *objects = calloc(count, sizeof(id));
+            [tree getKeys:NULL objects:objects range:NSMakeRange(0, count)];
+            XCTAssertEqualObjects([NSArray arrayWithObjects:objects count:count], expectedEntries, @"entries are incorrect after removing keys.");
+            free(objects);
+        }
+    }
+
+    XCTAssertFalse([tree removeKey:PGScalarKeyMakeInt64(0)], @"-removeKey: removed a key from an empty tree.");
+    [expectedEntries release];
+    [tree release];
+}
+
+
+- (void)testKeyTypes
+{
+    PGScalarRedBlackTree *tree = [PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeUInt64];
+    [tree addKey:PGScalarKeyMakeUInt64(UINT64_MAX) object:@"max"];
+    [tree addKey:PGScalarKeyMakeUInt64(0) object:@"zero"];
+    [tree addKey:PGScalarKeyMakeUInt64(1ull << 63) object:@"half"];
+
+    PGScalarKey key;
+    id object;
+    [tree getKey:&key object:&object atIndex:0];
+    XCTAssertEqual(key.uint64Value, 0ull, @"uint64 keys are not compared as unsigned.");
+    [tree getKey:&key object:&object atIndex:2];
+    XCTAssertEqualObjects(object, @"max", @"uint64 keys are not compared as unsigned.");
+
+    tree = [PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeDouble];
+    [tree addKey:PGScalarKeyMakeDouble(2.5) object:nil];
+    [tree addKey:PGScalarKeyMakeDouble(-0.5) object:nil];
+    [tree addKey:PGScalarKeyMakeDouble(2.25) object:nil];
+    XCTAssertTrue([tree containsKey:PGScalarKeyMakeDouble(2.25)], @"tree does not contain a double key that was added.");
+    XCTAssertFalse([tree containsKey:PGScalarKeyMakeDouble(2.0)], @"tree contains a double key that was not added.");
+    XCTAssertNil([tree objectForKey:PGScalarKeyMakeDouble(2.5)], @"nil objects are not allowed.");
+    XCTAssertEqual([tree countOfKeysLessThanKey:PGScalarKeyMakeDouble(2.3)], 2lu, @"double keys are not compared correctly.");
+    XCTAssertTrue([tree fulfillsProperties], @"tree with nil objects does not fulfill red-black properties.");
+
+    tree = [PGScalarRedBlackTree treeWithKeyComparisonFunction:PGReverseInt64Compare];
+    for (int64_t i = 0; i < 100; ++i) {
+        [tree addKey:PGScalarKeyMakeInt64(i) object:@(i)];
+    }
+
+    XCTAssertTrue([tree fulfillsProperties], @"tree with custom comparison function does not fulfill red-black properties.");
+    [tree getKey:&key object:NULL atIndex:0];
+    XCTAssertEqual(key.int64Value, 99ll, @"tree does not use its comparison function.");
+    XCTAssertEqual([tree countOfKeysLessThanKey:PGScalarKeyMakeInt64(90)], 9lu, @"tree does not use its comparison function.");
+}
+
+
+- (void)testOrderStatistics
+{
+    PGScalarRedBlackTree *tree = [PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeInt64];
+    for (int64_t i = 0; i < (int64_t)PGLargeTreeSize; ++i) {
+        [tree addKey:PGScalarKeyMakeInt64(i * 2) object:nil];
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; i += 37) {
+        PGScalarKey key;
+        [tree getKey:&key object:NULL atIndex:i];
+        XCTAssertEqual(key.int64Value, (int64_t)i * 2, @"-getKey:object:atIndex: returned the wrong key.");
+        XCTAssertEqual([tree countOfKeysLessThanKey:key], i, @"-countOfKeysLessThanKey: returned the wrong count.");
+        XCTAssertEqual([tree countOfKeysLessThanOrEqualToKey:key], i + 1, @"-countOfKeysLessThanOrEqualToKey: returned the wrong count.");
+        XCTAssertEqual([tree countOfKeysLessThanKey:PGScalarKeyMakeInt64(key.int64Value + 1)], i + 1, @"-countOfKeysLessThanKey: returned the wrong count.");
+    }
+
+    XCTAssertThrowsSpecificNamed([tree getKey:NULL object:NULL atIndex:PGLargeTreeSize], NSException, NSRangeException,
+                                 @"-getKey:object:atIndex: does not throw when index is out of bounds.");
+    XCTAssertThrowsSpecificNamed([tree getKeys:NULL objects:NULL range:NSMakeRange(PGLargeTreeSize - 1, 2)], NSException, NSRangeException,
+                                 @"-getKeys:objects:range: does not throw when range is out of bounds.");
+}
+
+
+- (void)testEnumerateKeysInRange
+{
+    PGScalarRedBlackTree *tree = [PGScalarRedBlackTree treeWithKeyType:PGScalarKeyTypeInt64];
+    for (int64_t i = 0; i < 100; ++i) {
+        [tree addKey:PGScalarKeyMakeInt64(i) object:@(i)];
+    }
+
+    for (NSUInteger options = 0; options < 2; ++options) {
+        NSEnumerationOptions enumerationOptions = options ? NSEnumerationReverse : 0;
+        for (NSUInteger inclusive = 0; inclusive < 4; ++inclusive) {
+            BOOL fromInclusive = inclusive & 1;
+            BOOL toInclusive = (inclusive & 2) != 0;
+
+            NSMutableArray *expectedObjects = [NSMutableArray array];
+            for (int64_t i = fromInclusive ? 20 : 21; i <= (toInclusive ? 40 : 39); ++i) {
+                [expectedObjects addObject:@(i)];
+            }
+
+            if (enumerationOptions & NSEnumerationReverse) {
+                expectedObjects = [[[[expectedObjects reverseObjectEnumerator] allObjects] mutableCopy] autorelease];
+            }
+
+            NSMutableArray *objects = [NSMutableArray array];
+            [tree enumerateKeysAndObjectsFromKey:PGScalarKeyMakeInt64(20) inclusive:fromInclusive
+                                           toKey:PGScalarKeyMakeInt64(40) inclusive:toInclusive
+                                         options:enumerationOptions
+                                      usingBlock:^(PGScalarKey key, id object, BOOL *stop) {
+                                          XCTAssertEqual(key.int64Value, [object longLongValue], @"entry's object does not match its key.");
+                                          [objects addObject:object];
+                                      }];
+
+            XCTAssertEqualObjects(objects, expectedObjects, @"range enumeration returned the wrong entries.");
+        }
+    }
+
+    __block NSUInteger count = 0;
+    [tree enumerateKeysAndObjectsFromKey:PGScalarKeyMakeInt64(50) inclusive:YES toKey:PGScalarKeyMakeInt64(10) inclusive:YES
+                                 options:0 usingBlock:^(PGScalarKey key, id object, BOOL *stop) { ++count; }];
+    XCTAssertEqual(count, 0lu, @"enumeration of an empty range visited entries.");
+
+    [tree enumerateKeysAndObjectsFromKey:PGScalarKeyMakeInt64(0) inclusive:YES toKey:PGScalarKeyMakeInt64(99) inclusive:YES
+                                 options:0 usingBlock:^(PGScalarKey key, id object, BOOL *stop) { *stop = ++count == 5; }];
+    XCTAssertEqual(count, 5lu, @"enumeration did not stop when requested.");
+
+    XCTAssertThrowsSpecificNamed([tree enumerateKeysAndObjectsUsingBlock:nil], NSException, NSInvalidArgumentException,
+                                 @"enumeration does not throw when block is nil.");
+}
+
+@end
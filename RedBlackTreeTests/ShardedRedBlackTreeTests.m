@@ -0,0 +1,418 @@
+//
+//  ShardedRedBlackTreeTests.m
+//  RedBlackTreeTests
+//
+//  Copyright (c) 2013 Prachi Gauriar.
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//  THE SOFTWARE.
+//
+
+#import "ShardedRedBlackTreeTests.h"
+
+static const NSUInteger PGLargeTreeSize = 10000;
+
+
+@implementation ShardedRedBlackTreeTests
+
+- (void)testInit
+{
+    XCTAssertNil([[[PGShardedRedBlackTree alloc] initWithComparator:nil shardCount:4] autorelease],
+                 @"-initWithComparator:shardCount: does not return nil when comparator is nil.");
+    XCTAssertNil([PGShardedRedBlackTree treeWithShardCount:0], @"+treeWithShardCount: does not return nil when shardCount is 0.");
+
+    PGShardedRedBlackTree *tree = [[[PGShardedRedBlackTree alloc] init] autorelease];
+    XCTAssertEqual([tree shardCount], [[NSProcessInfo processInfo] activeProcessorCount], @"tree does not have one shard per processor.");
+    XCTAssertEqual([tree count], 0lu, @"new tree is not empty.");
+    XCTAssertNil([tree firstObject], @"empty tree has a first object.");
+    XCTAssertNil([tree lastObject], @"empty tree has a last object.");
+    XCTAssertEqualObjects([tree allObjects], @[ ], @"empty tree has objects.");
+    XCTAssertThrowsSpecificNamed([tree addObject:nil], NSException, NSInvalidArgumentException, @"adding nil does not throw.");
+
+    tree = [PGShardedRedBlackTree treeWithShardCount:4];
+    XCTAssertEqual([tree shardCount], 4lu, @"tree's shard count is incorrect.");
+    XCTAssertTrue([tree rebalancesAutomatically], @"tree with a shard count does not rebalance automatically.");
+    XCTAssertEqualObjects([tree splitObjects], @[ ], @"tree has split objects before rebalancing.");
+}
+
+
+- (void)testFixedSplitObjects
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    NSComparator comparator = ^NSComparisonResult(id object1, id object2) {
+        return [object1 compare:object2];
+    };
+
+    NSArray *splitObjects = @[ @(PGLargeTreeSize * 3 / 4), @(PGLargeTreeSize / 4), @(PGLargeTreeSize / 2) ];
+    PGShardedRedBlackTree *tree = [[[PGShardedRedBlackTree alloc] initWithComparator:comparator splitObjects:splitObjects] autorelease];
+    XCTAssertEqual([tree shardCount], 4lu, @"tree does not have one more shard than split objects.");
+    XCTAssertFalse([tree rebalancesAutomatically], @"tree with fixed split objects rebalances automatically.");
+    XCTAssertEqualObjects([tree splitObjects], [splitObjects sortedArrayUsingSelector:@selector(compare:)], @"split objects are not sorted.");
+
+    NSMutableArray *expectedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        [tree addObject:number];
+        [expectedObjects addObject:number];
+    }
+
+    // Objects equal to split objects, too, must be found in the shards they were added to
+    for (NSNumber *splitObject in splitObjects) {
+        [tree addObject:splitObject];
+        [expectedObjects addObject:splitObject];
+        XCTAssertEqualObjects([tree member:splitObject], splitObject, @"-member: did not find a split object.");
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 2; ++i) {
+        NSUInteger index = random() % [expectedObjects count];
+        [tree removeObject:expectedObjects[index]];
+        [expectedObjects removeObjectAtIndex:index];
+    }
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        XCTAssertEqual([tree containsObject:number], [expectedObjects containsObject:number], @"tree's membership is incorrect.");
+    }
+
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect.");
+    XCTAssertEqualObjects([tree firstObject], [expectedObjects firstObject], @"tree's first object is incorrect.");
+    XCTAssertEqualObjects([tree lastObject], [expectedObjects lastObject], @"tree's last object is incorrect.");
+
+    [tree removeAllObjects];
+    XCTAssertEqual([tree count], 0lu, @"tree is not empty after removing all objects.");
+    XCTAssertEqual([[tree splitObjects] count], [splitObjects count], @"removing all objects changed the split objects.");
+}
+
+
+- (void)testRebalancing
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    // Adding increasing numbers puts all the writes in the last shard, so the tree must keep rebalancing
+    NSUInteger shardCount = 8;
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:shardCount];
+    NSMutableArray *expectedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize * 2];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [tree addObject:@(i)];
+        [expectedObjects addObject:@(i)];
+    }
+
+    NSArray *splitObjects = [tree splitObjects];
+    XCTAssertEqual([splitObjects count], shardCount - 1, @"tree did not rebalance.");
+    XCTAssertTrue([splitObjects[0] unsignedIntegerValue] > PGLargeTreeSize / shardCount / 2,
+                  @"tree's split objects do not divide its objects evenly.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after rebalancing.");
+
+    // Batches with duplicates can trigger rebalancing, too
+    NSMutableArray *batch = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        [batch addObject:@(random() % 10)];
+    }
+
+    [tree addObjectsFromArray:batch];
+    [expectedObjects addObjectsFromArray:batch];
+    [expectedObjects sortUsingSelector:@selector(compare:)];
+    XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after adding a batch.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after adding a batch.");
+
+    for (NSUInteger i = 0; i < 10; ++i) {
+        XCTAssertTrue([tree containsObject:@(i)], @"tree does not contain a duplicated object after rebalancing.");
+    }
+
+    // Rebalancing a tree with fewer objects than shards leaves some shards empty
+    PGShardedRedBlackTree *smallTree = [PGShardedRedBlackTree treeWithShardCount:shardCount];
+    [smallTree addObjectsFromArray:@[ @3, @1, @2 ]];
+    [smallTree rebalance];
+    XCTAssertEqualObjects([smallTree allObjects], (@[ @1, @2, @3 ]), @"small tree's objects are incorrect after rebalancing.");
+    XCTAssertEqualObjects([smallTree member:@2], @2, @"-member: did not find an object in a small rebalanced tree.");
+}
+
+
+- (void)testRangeQueries
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:8];
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        [tree addObject:number];
+        [objects addObject:number];
+    }
+
+    [tree rebalance];
+    [objects sortUsingSelector:@selector(compare:)];
+
+    // Compare against the same range in the sorted array, using split objects as bounds sometimes since they're where
+    // shards are stitched together
+    NSArray *splitObjects = [tree splitObjects];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        NSNumber *from = i % 4 == 0 ? splitObjects[random() % [splitObjects count]] : @(random() % PGLargeTreeSize);
+        NSNumber *to = i % 4 == 1 ? splitObjects[random() % [splitObjects count]] : @(random() % PGLargeTreeSize);
+        BOOL fromInclusive = random() % 2;
+        BOOL toInclusive = random() % 2;
+
+        NSPredicate *predicate = [NSPredicate predicateWithBlock:^BOOL(NSNumber *number, NSDictionary *bindings) {
+            NSComparisonResult fromResult = [number compare:from];
+            NSComparisonResult toResult = [number compare:to];
+            return (fromResult == NSOrderedDescending || (fromInclusive && fromResult == NSOrderedSame)) &&
+                   (toResult == NSOrderedAscending || (toInclusive && toResult == NSOrderedSame));
+        }];
+
+        XCTAssertEqualObjects([tree objectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive],
+                              [objects filteredArrayUsingPredicate:predicate], @"range query returned incorrect objects.");
+    }
+
+    // Stopping partway through should visit exactly the objects before the stop
+    __block NSUInteger visitedCount = 0;
+    [tree enumerateObjectsUsingBlock:^(id obj, BOOL *stop) {
+        XCTAssertEqualObjects(obj, objects[visitedCount], @"enumeration visited objects out of order.");
+        *stop = ++visitedCount == PGLargeTreeSize / 2;
+    }];
+
+    XCTAssertEqual(visitedCount, PGLargeTreeSize / 2, @"enumeration did not stop.");
+
+    // The block may mutate the tree
+    [tree enumerateObjectsFromObject:nil inclusive:NO toObject:@(PGLargeTreeSize / 2) inclusive:NO usingBlock:^(id obj, BOOL *stop) {
+        [tree removeObject:obj];
+    }];
+
+    XCTAssertEqualObjects([tree firstObject], [objects filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF >= %@", @(PGLargeTreeSize / 2)]][0],
+                          @"removing objects while enumerating did not remove them.");
+    XCTAssertThrowsSpecificNamed([tree enumerateObjectsUsingBlock:nil], NSException, NSInvalidArgumentException,
+                                 @"enumerating with a nil block does not throw.");
+}
+
+
+- (void)testOrderStatistics
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:8];
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % (PGLargeTreeSize / 4));
+        [tree addObject:number];
+        [objects addObject:number];
+    }
+
+    [tree rebalance];
+    [objects sortUsingSelector:@selector(compare:)];
+
+    for (NSUInteger i = 0; i < PGLargeTreeSize; i += random() % 50 + 1) {
+        XCTAssertEqualObjects([tree objectAtIndex:i], objects[i], @"-objectAtIndex: returned an incorrect object.");
+    }
+
+    XCTAssertThrowsSpecificNamed([tree objectAtIndex:PGLargeTreeSize], NSException, NSRangeException,
+                                 @"-objectAtIndex: with an out-of-bounds index does not throw.");
+
+    NSRange range = NSMakeRange(PGLargeTreeSize / 3, PGLargeTreeSize / 3);
+    XCTAssertEqualObjects([tree objectsInRange:range], [objects subarrayWithRange:range], @"-objectsInRange: returned incorrect objects.");
+    XCTAssertThrowsSpecificNamed([tree objectsInRange:NSMakeRange(PGLargeTreeSize - 1, 2)], NSException, NSRangeException,
+                                 @"-objectsInRange: with an out-of-bounds range does not throw.");
+
+    // Split objects are where counts from several shards are added together
+    NSMutableArray *probes = [NSMutableArray arrayWithArray:[tree splitObjects]];
+    for (NSUInteger i = 0; i < 50; ++i) {
+        [probes addObject:@(random() % (PGLargeTreeSize / 4 + 10))];
+    }
+
+    for (NSNumber *probe in probes) {
+        NSUInteger lessCount = [objects indexOfObjectPassingTest:^BOOL(NSNumber *number, NSUInteger index, BOOL *stop) {
+            return [number compare:probe] != NSOrderedAscending;
+        }];
+
+        if (lessCount == NSNotFound) lessCount = [objects count];
+        NSUInteger equalCount = [[objects filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF == %@", probe]] count];
+
+        XCTAssertEqual([tree countOfObjectsLessThanObject:probe], lessCount, @"-countOfObjectsLessThanObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsLessThanOrEqualToObject:probe], lessCount + equalCount,
+                       @"-countOfObjectsLessThanOrEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsEqualToObject:probe], equalCount, @"-countOfObjectsEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsGreaterThanOrEqualToObject:probe], [objects count] - lessCount,
+                       @"-countOfObjectsGreaterThanOrEqualToObject: is incorrect.");
+        XCTAssertEqual([tree countOfObjectsGreaterThanObject:probe], [objects count] - lessCount - equalCount,
+                       @"-countOfObjectsGreaterThanObject: is incorrect.");
+        XCTAssertEqual([tree indexOfObject:probe], equalCount > 0 ? lessCount : NSNotFound, @"-indexOfObject: is incorrect.");
+        XCTAssertEqualObjects([tree objectsEqualToObject:probe], [objects subarrayWithRange:NSMakeRange(lessCount, equalCount)],
+                              @"-objectsEqualToObject: returned incorrect objects.");
+    }
+}
+
+
+- (void)testReverseAndFastEnumeration
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:8];
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        [tree addObject:number];
+        [objects addObject:number];
+    }
+
+    [tree rebalance];
+    [objects sortUsingSelector:@selector(compare:)];
+
+    NSMutableArray *fastEnumeratedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (id object in tree) {
+        [fastEnumeratedObjects addObject:object];
+    }
+
+    XCTAssertEqualObjects(fastEnumeratedObjects, objects, @"fast enumeration visited incorrect objects.");
+
+    NSArray *splitObjects = [tree splitObjects];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        NSNumber *from = i % 4 == 0 ? splitObjects[random() % [splitObjects count]] : @(random() % PGLargeTreeSize);
+        NSNumber *to = i % 4 == 1 ? splitObjects[random() % [splitObjects count]] : @(random() % PGLargeTreeSize);
+        BOOL fromInclusive = random() % 2;
+        BOOL toInclusive = random() % 2;
+
+        NSMutableArray *reversedObjects = [NSMutableArray array];
+        [tree enumerateObjectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive
+                                 options:NSEnumerationReverse usingBlock:^(id obj, BOOL *stop) {
+            [reversedObjects addObject:obj];
+        }];
+
+        NSArray *expectedObjects = [tree objectsFromObject:from inclusive:fromInclusive toObject:to inclusive:toInclusive];
+        XCTAssertEqualObjects(reversedObjects, [[expectedObjects reverseObjectEnumerator] allObjects],
+                              @"reverse enumeration visited incorrect objects.");
+    }
+
+    NSNumber *pivot = objects[PGLargeTreeSize / 2];
+    XCTAssertEqualObjects([tree objectsLessThanObject:pivot], [objects filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF < %@", pivot]],
+                          @"-objectsLessThanObject: returned incorrect objects.");
+    XCTAssertEqualObjects([tree objectsGreaterThanObject:pivot], [objects filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF > %@", pivot]],
+                          @"-objectsGreaterThanObject: returned incorrect objects.");
+
+    __block NSUInteger visitedCount = 0;
+    [tree enumerateObjectsGreaterThanOrEqualToObject:pivot usingBlock:^(id obj, BOOL *stop) {
+        XCTAssertTrue([obj compare:pivot] != NSOrderedAscending, @"enumeration visited an object less than its bound.");
+        ++visitedCount;
+    }];
+
+    XCTAssertEqual(visitedCount, [tree countOfObjectsGreaterThanOrEqualToObject:pivot], @"enumeration visited the wrong number of objects.");
+    XCTAssertEqualObjects([tree objectsPassingTest:^BOOL(NSNumber *number, BOOL *stop) { return [number unsignedIntegerValue] % 2 == 0; }],
+                          [objects filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"modulus:by:(SELF, 2) == 0"]],
+                          @"-objectsPassingTest: returned incorrect objects.");
+}
+
+
+- (void)testBatchRemoval
+{
+    srandomdev();
+    unsigned seed = (unsigned)random();
+    NSLog(@"Using seed %d", seed);
+    srandom(seed);
+
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:8];
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize; ++i) {
+        NSNumber *number = @(random() % PGLargeTreeSize);
+        [tree addObject:number];
+        [objects addObject:number];
+    }
+
+    [tree rebalance];
+    [objects sortUsingSelector:@selector(compare:)];
+
+    // Remove one copy of each of a random selection of objects
+    NSMutableArray *removedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize / 4];
+    for (NSUInteger i = 0; i < PGLargeTreeSize / 4; ++i) {
+        NSUInteger index = random() % [objects count];
+        [removedObjects addObject:objects[index]];
+        [objects removeObjectAtIndex:index];
+    }
+
+    [tree removeObjectsInArray:removedObjects];
+    XCTAssertEqualObjects([tree allObjects], objects, @"-removeObjectsInArray: removed incorrect objects.");
+
+    NSArray *splitObjects = [tree splitObjects];
+    NSNumber *from = splitObjects[1];
+    NSNumber *to = @([splitObjects[4] unsignedIntegerValue] + 1);
+    [tree removeObjectsInRangeFromObject:from toObject:to];
+    [objects filterUsingPredicate:[NSPredicate predicateWithFormat:@"SELF < %@ OR SELF >= %@", from, to]];
+    XCTAssertEqualObjects([tree allObjects], objects, @"-removeObjectsInRangeFromObject:toObject: removed incorrect objects.");
+
+    NSNumber *bound = objects[[objects count] / 4];
+    [tree removeObjectsLessThanObject:bound];
+    [objects filterUsingPredicate:[NSPredicate predicateWithFormat:@"SELF >= %@", bound]];
+    XCTAssertEqualObjects([tree allObjects], objects, @"-removeObjectsLessThanObject: removed incorrect objects.");
+
+    XCTAssertEqualObjects([tree popFirstObject], [objects firstObject], @"-popFirstObject returned an incorrect object.");
+    XCTAssertEqualObjects([tree popLastObject], [objects lastObject], @"-popLastObject returned an incorrect object.");
+    [objects removeObjectAtIndex:0];
+    [objects removeLastObject];
+    XCTAssertEqual([tree count], [objects count], @"popping objects did not remove them.");
+
+    [tree removeObjectsInRangeFromObject:nil toObject:nil];
+    XCTAssertEqual([tree count], 0lu, @"removing an unbounded range did not empty the tree.");
+    XCTAssertNil([tree popFirstObject], @"-popFirstObject on an empty tree did not return nil.");
+    XCTAssertNil([tree popLastObject], @"-popLastObject on an empty tree did not return nil.");
+}
+
+
+- (void)testConcurrentWriters
+{
+    PGShardedRedBlackTree *tree = [PGShardedRedBlackTree treeWithShardCount:8];
+
+    // Each writer adds and removes its own numbers while the tree rebalances underneath it
+    NSUInteger writerCount = 8;
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_apply(writerCount, queue, ^(size_t writer) {
+        @autoreleasepool {
+            for (NSUInteger i = writer; i < PGLargeTreeSize * 2; i += writerCount) {
+                [tree addObject:@(i)];
+            }
+
+            for (NSUInteger i = writer; i < PGLargeTreeSize * 2; i += 2 * writerCount) {
+                [tree removeObject:@(i)];
+            }
+        }
+    });
+
+    NSMutableArray *expectedObjects = [NSMutableArray arrayWithCapacity:PGLargeTreeSize];
+    for (NSUInteger i = 0; i < PGLargeTreeSize * 2; ++i) {
+        if (i % (2 * writerCount) >= writerCount) [expectedObjects addObject:@(i)];
+    }
+
+    XCTAssertEqual([tree count], [expectedObjects count], @"tree's count is incorrect after concurrent writes.");
+    XCTAssertEqualObjects([tree allObjects], expectedObjects, @"tree's objects are incorrect after concurrent writes.");
+    XCTAssertEqual([[tree splitObjects] count], 7lu, @"tree did not rebalance during concurrent writes.");
+}
+
+@end